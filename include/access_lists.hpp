@@ -0,0 +1,163 @@
+/*
+ * access_lists.hpp - Header file for AccessLists.
+ *
+ * Filters the frames each port receives through access control lists (ACLs), which may be applied
+ * to a port, to a VLAN, or both. An ACL is a list of rules, each of which permits or denies the
+ * frames matching all of its fields: MAC addresses, EtherType, VLAN, IPv4 or IPv6 source and
+ * destination prefixes, IP protocol, and TCP/UDP ports. The first rule (by sequence number) that
+ * matches a frame decides it, and frames matching no rule are denied. Every rule counts the frames
+ * it matches. A frame has to be permitted by both its port's ACL and its VLAN's ACL, if they have
+ * them, before it is learned from or forwarded. An ACL which is applied but does not exist permits
+ * everything.
+ *
+ * Each applied ACL is compiled for tuple space search: its rules are grouped by which bits they
+ * match on (their tuple), and each tuple is a hash table from those bits to the first rule with
+ * them. Classifying a frame takes one hash lookup per tuple rather than a comparison per rule, so
+ * it scales with the number of distinct combinations of fields and prefix lengths, not the number
+ * of rules. Tuples are searched in order of their first rule, stopping once no later tuple can
+ * hold an earlier match.
+ *
+ * The compiled tables are rebuilt by the CLI whenever the configuration changes, and published as
+ * a whole. Like Policers, each capture thread notices a new version through a generation number,
+ * and only then takes the lock to pick it up, so classification itself takes no locks.
+ */
+
+#ifndef ACCESS_LISTS_HPP
+#define ACCESS_LISTS_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <RawPacket.h>
+#include "ports.hpp"
+#include "vlans.hpp"
+
+class AccessLists {
+public:
+    static const int MAX_VLAN = 4094;
+
+    enum action {
+	PERMIT, DENY
+    };
+
+    enum match_field {
+	SRC_MAC, DST_MAC, ETHER_TYPE, VLAN_ID, SRC_IP, DST_IP, PROTOCOL, SRC_PORT, DST_PORT,
+	NUM_FIELDS
+    };
+
+    AccessLists(int num_intfs, Vlans *vlans);
+    void set_rule(const std::string &acl, int seq, action act);
+    bool set_match(const std::string &acl, int seq, match_field field, const std::string &value);
+    bool reset_match(const std::string &acl, int seq, match_field field);
+    bool remove_rule(const std::string &acl, int seq);
+    bool remove_acl(const std::string &acl);
+    bool has_acl(const std::string &acl);
+    bool apply_intf(int intf, const std::string &acl);
+    bool apply_vlan(int vlan, const std::string &acl);
+    void reset_intf(int intf);
+    bool permit(int intf, const pcpp::RawPacket &pckt);
+    void clear_counters();
+    void print_acls(std::ostream &out, const std::vector<Ports::PortInfo> &ports);
+    void write_config(std::ostream &out, const std::vector<Ports::PortInfo> &ports);
+
+private:
+    // The fields a frame is classified by, packed into 64-bit words so that they can be masked and
+    // hashed a word at a time
+    static const int KEY_WORDS = 7;
+    using Key = std::array<uint64_t, KEY_WORDS>;
+
+    struct KeyHash {
+	size_t operator()(const Key &key) const;
+    };
+
+    /*
+     * Rule - A single rule, with its fields as they were given on the CLI (empty if they are not
+     * matched on), and as the bits it matches.
+     */
+    struct Rule {
+	action act = PERMIT;
+	std::array<std::string, NUM_FIELDS> matches;
+	Key value{};
+	Key mask{};
+	std::shared_ptr<std::atomic<uint64_t>> hits = std::make_shared<std::atomic<uint64_t>>(0);
+    };
+
+    /*
+     * Acl - A single ACL's rules, by sequence number, and a count of the frames it denied for
+     * matching none of them.
+     */
+    struct Acl {
+	std::map<int, Rule> rules;
+	std::shared_ptr<std::atomic<uint64_t>> unmatched =
+	    std::make_shared<std::atomic<uint64_t>>(0);
+    };
+
+    /*
+     * Classifier - An ACL compiled for tuple space search. Each rule is known by its position in
+     * the ACL, and the counters it updates are kept alive for as long as the Classifier is.
+     */
+    struct Classifier {
+	struct Match {
+	    int order;
+	    action act;
+	    std::atomic<uint64_t> *hits;
+	};
+
+	struct Tuple {
+	    Key mask;
+	    int first; // the order of the tuple's first rule
+	    std::unordered_map<Key, Match, KeyHash> rules;
+	};
+
+	std::vector<Tuple> tuples; // by their first rule
+	std::atomic<uint64_t> *unmatched;
+	std::vector<std::shared_ptr<std::atomic<uint64_t>>> counters;
+    };
+
+    /*
+     * Tables - The Classifiers applied to each port and VLAN, null where there are none. Never
+     * changed once published.
+     */
+    struct Tables {
+	std::vector<std::shared_ptr<const Classifier>> intfs;
+	std::vector<std::shared_ptr<const Classifier>> vlans;
+	bool any_vlans = false;
+    };
+
+    /*
+     * ActiveTables - The Tables in use by a single port's capture thread, which is the only thread
+     * to touch them.
+     */
+    struct alignas(64) ActiveTables {
+	std::shared_ptr<const Tables> tables;
+	unsigned generation = 0;
+    };
+
+    Vlans *vlans;
+
+    std::map<std::string, Acl> acls;
+    std::vector<std::string> intf_acls; // the ACL applied to each port, if any
+    std::map<int, std::string> vlan_acls;
+    std::shared_ptr<const Tables> tables;
+    std::mutex config_access;
+
+    std::atomic<unsigned> generation{0};
+    std::vector<ActiveTables> active;
+
+    Rule *find_rule(const std::string &acl, int seq);
+    void rebuild();
+    static std::shared_ptr<const Classifier> compile(const Acl &acl);
+    static bool classify(const Classifier &classifier, const Key &key);
+    static void make_key(const pcpp::RawPacket &pckt, int vlan, Key &key);
+    static bool parse_match(match_field field, const std::string &text, Key &value, Key &mask);
+    static void update_rule(Rule &rule);
+};
+
+#endif // ACCESS_LISTS_HPP
@@ -0,0 +1,57 @@
+/*
+ * capture_settings.hpp - Header file for CaptureSettings.
+ *
+ * Holds the settings each port's capture handle is opened with: the kernel buffer size, snapshot
+ * length, read timeout, immediate mode, and promiscuous mode. Every setting has a switch-wide
+ * default, which may be overridden for individual ports by name. Overrides are kept by name rather
+ * than by port index so that they may be given for interfaces which have not been created yet.
+ *
+ * Settings take effect when a port is opened, which happens after the startup configuration has
+ * been applied, or when the interface is created while the switch is running.
+ */
+
+#ifndef CAPTURE_SETTINGS_HPP
+#define CAPTURE_SETTINGS_HPP
+
+#include <array>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+#include <PcapLiveDevice.h>
+#include "ports.hpp"
+
+class CaptureSettings {
+public:
+    enum setting {
+	BUFFER_SIZE, SNAPLEN, TIMEOUT, IMMEDIATE, PROMISC, NUM_SETTINGS
+    };
+
+    // Bounds on the values accepted for each numeric setting
+    static const int MAX_SNAPLEN = 262144;
+    static const int MAX_TIMEOUT = 60000;
+
+    CaptureSettings();
+    bool set(setting type, int value);
+    bool set(const std::string &intf, setting type, int value);
+    void reset(setting type);
+    void reset(const std::string &intf, setting type);
+    pcpp::PcapLiveDevice::DeviceConfiguration get_config(const std::string &intf);
+    void print_settings(std::ostream &out, const std::vector<Ports::PortInfo> &ports);
+    void write_config(std::ostream &out);
+
+private:
+    using Overrides = std::array<std::optional<int>, NUM_SETTINGS>;
+
+    Overrides defaults;
+    std::map<std::string, Overrides> intf_overrides;
+    std::mutex settings_access;
+
+    static bool is_valid(setting type, int value);
+    Overrides resolve(const std::string &intf);
+    static void write_setting(std::ostream &out, const std::string &intf, setting type, int value);
+};
+
+#endif // CAPTURE_SETTINGS_HPP
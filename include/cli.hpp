@@ -4,13 +4,20 @@
  * This class maintains a tree of valid serieses of CLI tokens and the functions that should be
  * called when they are inputted. When given a series of tokens and their literal values through the
  * interpret() function, the appropriate function will be called if the series is valid. Otherwise,
- * it will return an error code.
+ * it will return an error code. interpret_line() does the same for a line of raw text, scanning it
+ * into tokens first. check_refs() looks up what a line refers to without running it, so that a
+ * batch of commands may be rejected before any of it takes effect.
+ *
+ * All command output is written to the stream passed in by the caller, so commands may be served to
+ * clients other than the terminal (see ControlServer).
  */
 
 #ifndef CLI_HPP
 #define CLI_HPP
 
 #include <functional>
+#include <map>
+#include <ostream>
 #include <string>
 #include <vector>
 #include "vswitch_shmem.hpp"
@@ -18,17 +25,47 @@
 class CliInterpreter {
 public:
     enum token {
-	ROOT, NL, EXIT, SHOW, MAC, ADDR_TBL, INTF, COUNT, NAME, UINT, VLAN, NO, CLEAR, AGE_TIME
+	ROOT, NL, EXIT, SHOW, MAC, ADDR_TBL, INTF, COUNT, NAME, UINT, VLAN, NO, CLEAR, AGE_TIME,
+	WRITE, MEMORY, RUN_CFG, INTF_ONE, ADDRESS, MAC_ADDR, COUNT_ONLY, PAGE, CAPTURE, BUF_SIZE,
+	SNAPLEN, TIMEOUT, IMMEDIATE, PROMISC, THREAD, THREADS, FORWARDING, EGRESS, HOUSEKEEPING,
+	CPUS, PRIORITY, LOCK, CPU_LIST, QUEUE, WAIT, BUSY_POLL, ADAPTIVE, BLOCK, QOS, STRICT, WEIGHT,
+	QUEUES, POLICE, RATE, BURST, PEAK_RATE, PPS, BPS, POLICERS, STORM_CONTROL, BROADCAST,
+	MULTICAST, UNKNOWN_UNICAST, LEVEL, SNOOPING, GROUPS, ROUTERS, SPANNING_TREE, COST, EDGE,
+	CHANNEL_GROUP, PORT_CHANNEL, LOAD_BALANCE, SRC_DST_MAC, SRC_DST_IP, SRC_DST_PORT,
+	ACCESS_LIST, ACCESS_LISTS, ACCESS_GROUP, PERMIT, DENY, MATCH, SRC_MAC, DST_MAC, ETHERTYPE,
+	SRC_IP, DST_IP, PROTOCOL, SRC_PORT, DST_PORT, IP_PREFIX, HEX_UINT, MONITOR, SESSION, SOURCE,
+	DESTINATION, RX, TX, BOTH, TRUNCATE, SAMPLE, PCAP_FILE, FILE_PATH
+    };
+
+    // Return values of interpret() and interpret_line()
+    enum status {
+	BAD_CMD = -1, OK = 0, FAILED = 1
+    };
+
+    /*
+     * BatchRefs - The VLANs and access lists which the earlier commands of a batch create (true)
+     * or remove (false), so that check_refs() knows what will exist by the time a later one runs.
+     */
+    struct BatchRefs {
+	std::map<int, bool> vlans;
+	std::map<std::string, bool> acls;
     };
 
     CliInterpreter(VswitchShmem *shmem);
-    int interpret(std::vector<token> tokens, std::vector<std::string> args);
+    static void write_running_config(std::ostream &out);
+    int interpret(std::vector<token> tokens, std::vector<std::string> args, std::ostream &out);
+    int interpret_line(const std::string &line, std::ostream &out);
+    bool is_valid(const std::string &line);
+    bool check_refs(const std::string &line, BatchRefs &refs, std::ostream &out);
+    static bool tokenize(const std::string &line,
+			 std::vector<token> &tokens,
+			 std::vector<std::string> &args);
 
 private:
     // Aliases to replace some of the unpleasant types used frequently here.
     using StrVec = std::vector<std::string>;
     using TokenVec = std::vector<CliInterpreter::token>;
-    using CliFunc = std::function<void(std::vector<std::string>)>;
+    using CliFunc = std::function<int(std::vector<std::string>, std::ostream &)>;
 
     /*
      * InterpreterTreeNode - A single node in the interpreter tree. Each node contains a
@@ -45,6 +82,19 @@ private:
 	std::vector<InterpreterTreeNode> children;
     };
 
+    // Ways of narrowing down and presenting the MAC address table in "show mac address-table"
+    enum mac_filter {
+	ALL_MACS, BY_VLAN, BY_INTF, BY_ADDR
+    };
+    enum mac_output {
+	LIST, COUNT_MACS, PAGED
+    };
+
+    // Changes that may be made to a capture setting, switch-wide or for a single port
+    enum capture_op {
+	SET_VALUE, ENABLE, DISABLE, RESET
+    };
+
     InterpreterTreeNode root;
     static VswitchShmem *shmem;
 
@@ -52,8 +102,11 @@ private:
 		 TokenVec::iterator cur,
 		 TokenVec::iterator end,
 		 CliFunc func);
+    InterpreterTreeNode *find_cmd(const TokenVec &tokens);
+    static bool has_arg(token tkn);
 
     // CLI functions
+    static CliFunc show_mac_addrtbl_with(mac_filter filter, mac_output output);
     const static CliFunc show_mac_addrtbl;
     const static CliFunc show_interfaces;
     const static CliFunc show_vlan;
@@ -65,6 +118,66 @@ private:
     const static CliFunc clear_counters;
     const static CliFunc mac_addrtbl_agetime;
     const static CliFunc show_mac_addrtbl_agetime;
+    const static CliFunc show_running_config;
+    const static CliFunc write_memory;
+    static CliFunc capture_setting_with(CaptureSettings::setting type, capture_op op, bool intf);
+    const static CliFunc show_intf_capture;
+    static CliFunc capture_file_with(bool count, bool snaplen);
+    const static CliFunc no_capture_file;
+    const static CliFunc show_capture;
+    static CliFunc thread_cpus_with(ThreadPlacement::role type, bool reset);
+    static CliFunc thread_priority_with(ThreadPlacement::role type, bool reset);
+    const static CliFunc memory_lock;
+    const static CliFunc no_memory_lock;
+    const static CliFunc show_threads;
+    static CliFunc queue_wait_with(PacketQueue::wait_policy policy);
+    const static CliFunc show_queue;
+    const static CliFunc qos_priority_queue;
+    const static CliFunc no_qos_priority_queue;
+    const static CliFunc qos_queue_strict;
+    const static CliFunc qos_queue_weight;
+    const static CliFunc no_qos_queue;
+    const static CliFunc intf_qos_priority;
+    const static CliFunc no_intf_qos_priority;
+    const static CliFunc show_qos;
+    const static CliFunc show_intf_queues;
+    static CliFunc police_with(Policers::rate_unit unit, bool two_rate);
+    const static CliFunc no_police;
+    const static CliFunc show_intf_policers;
+    static CliFunc storm_control_with(StormControl::traffic_class type,
+				      StormControl::level_unit unit);
+    const static CliFunc show_intf_storm_control;
+    static CliFunc multicast_snooping_with(bool enabled);
+    const static CliFunc show_multicast_groups;
+    const static CliFunc show_multicast_routers;
+    static CliFunc spanning_tree_with(bool enabled);
+    const static CliFunc spanning_tree_priority;
+    const static CliFunc no_spanning_tree_priority;
+    const static CliFunc intf_spanning_tree_cost;
+    const static CliFunc intf_spanning_tree_priority;
+    static CliFunc intf_spanning_tree_reset_with(token setting);
+    static CliFunc intf_spanning_tree_edge_with(bool edge);
+    const static CliFunc show_spanning_tree;
+    const static CliFunc intf_channel_group;
+    const static CliFunc no_intf_channel_group;
+    static CliFunc port_channel_load_balance_with(LinkAggregation::hash_fields fields);
+    const static CliFunc show_port_channel;
+    static CliFunc access_list_rule_with(AccessLists::action act);
+    static CliFunc access_list_match_with(AccessLists::match_field field, bool reset);
+    const static CliFunc no_access_list_rule;
+    const static CliFunc no_access_list;
+    const static CliFunc intf_access_group;
+    const static CliFunc no_intf_access_group;
+    const static CliFunc vlan_access_group;
+    const static CliFunc no_vlan_access_group;
+    const static CliFunc show_access_lists;
+    static CliFunc monitor_source_with(PortMirror::direction dir, bool vlan);
+    static CliFunc no_monitor_source_with(bool vlan);
+    const static CliFunc monitor_destination;
+    const static CliFunc no_monitor_destination;
+    static CliFunc monitor_setting_with(token setting, bool reset);
+    const static CliFunc no_monitor_session;
+    const static CliFunc show_monitor;
 
     // Valid CLI commands
     const static std::vector<std::pair<TokenVec, CliFunc>> commands;
@@ -0,0 +1,52 @@
+/*
+ * control_client.hpp - Header file for ControlClient.
+ *
+ * A client for the vswitch control socket (see ControlServer). The protocol is line based:
+ *
+ *   Request:  A single CLI command terminated by a newline, e.g. "vswitch-host1 vlan 2\n".
+ *             Multiple commands may be sent as one batch by first sending "batch {n}\n" followed by
+ *             n command lines. Every line of a batch is checked before any of them run, and the
+ *             whole batch is rejected if one of them is not a valid command ("bad"), or names an
+ *             interface, VLAN, or access list which would not exist by the time it ran ("failed").
+ *             A line which fails for any other reason does not undo the lines before it.
+ *
+ *   Response: "{status} {len}\n" followed by exactly len bytes of command output. The status is one
+ *             of "ok", "failed" (the command was valid but did not take effect), or "bad" (the
+ *             command was not recognized).
+ *
+ * Requests may be pipelined, and responses are returned in the order requests were sent. This
+ * header does not depend on PcapPlusPlus so that external tools may be built without it.
+ */
+
+#ifndef CONTROL_CLIENT_HPP
+#define CONTROL_CLIENT_HPP
+
+#include <string>
+#include <vector>
+
+class ControlClient {
+public:
+    static constexpr const char *DEFAULT_PATH = "/run/vswitch.sock";
+    static constexpr const char *STATUS_OK = "ok";
+    static constexpr const char *STATUS_FAILED = "failed";
+    static constexpr const char *STATUS_BAD = "bad";
+    static constexpr const char *BATCH = "batch";
+
+    ControlClient() = default;
+    ControlClient(const ControlClient &) = delete;
+    ControlClient &operator=(const ControlClient &) = delete;
+    ~ControlClient();
+
+    bool connect(const std::string &path);
+    bool request(const std::string &cmd, std::string &status, std::string &output);
+    bool batch(const std::vector<std::string> &cmds, std::string &status, std::string &output);
+
+private:
+    int fd = -1;
+    std::string buf;
+
+    bool send_all(const std::string &data);
+    bool read_response(std::string &status, std::string &output);
+};
+
+#endif // CONTROL_CLIENT_HPP
@@ -0,0 +1,49 @@
+/*
+ * control_server.hpp - Header file for ControlServer.
+ *
+ * Serves every command understood by CliInterpreter over a Unix domain socket, using the protocol
+ * described in control_client.hpp. Each connected client is handled on its own thread, but
+ * batches are executed one at a time, so that no client's commands are interleaved with another's.
+ *
+ * A batch is rejected before any of it runs if a line is malformed, or refers to an interface,
+ * VLAN, or access list which would not exist by then. Batches are not atomic beyond that: a line
+ * which fails for any other reason, such as a value out of range, leaves the lines before it
+ * applied, and the forwarding threads see each line take effect as it runs.
+ *
+ * The listening socket may be adopted from another switch process rather than created (see
+ * HandoffServer), in which case clients never see it close.
+ */
+
+#ifndef CONTROL_SERVER_HPP
+#define CONTROL_SERVER_HPP
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include "cli.hpp"
+#include "vswitch_shmem.hpp"
+
+class ControlServer {
+public:
+    ControlServer(VswitchShmem *shmem);
+    ~ControlServer();
+    bool listen_unix(const std::string &path);
+    void adopt(int fd, const std::string &path);
+    int get_listen_fd() const;
+    void serve();
+    void stop();
+    int execute(const std::vector<std::string> &cmds, std::string &output);
+    std::unique_lock<std::mutex> hold_commands();
+
+private:
+    CliInterpreter interpreter;
+    std::mutex cmd_lock;
+    std::mutex serve_access;
+    bool stopped = false;
+    int listen_fd = -1;
+    std::string path;
+
+    void handle_client(int client_fd);
+};
+
+#endif // CONTROL_SERVER_HPP
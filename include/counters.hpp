@@ -12,7 +12,7 @@
 #include <iostream>
 #include <mutex>
 #include <vector>
-#include <PcapLiveDevice.h>
+#include "ports.hpp"
 
 class Counters {
 public:
@@ -20,19 +20,22 @@ public:
 	ING, EGR
     };
 
+    struct CounterData {
+	long unsigned ingress_pckts = 0;
+	long unsigned egress_pckts = 0;
+	long unsigned ingress_bytes = 0;
+	long unsigned egress_bytes = 0;
+    };
+
     Counters(long unsigned size);
     void increment_counters(int intf, int bytes, CntType type);
     void create_snapshot();
-    void print_counters(std::ostream &out, const std::vector<pcpp::PcapLiveDevice *> &veth_intfs);
+    void reset(int intf);
+    void restore(int intf, const struct CounterData &totals);
+    std::vector<struct CounterData> get_totals();
+    void print_counters(std::ostream &out, const std::vector<Ports::PortInfo> &ports);
 
 private:
-    struct CounterData {
-	int ingress_pckts = 0;
-	int egress_pckts = 0;
-	int ingress_bytes = 0;
-	int egress_bytes = 0;
-    };
-
     std::vector<struct CounterData> counters;
     std::vector<struct CounterData> counters_snapshot;
     std::vector<std::mutex> ingress_locks;
@@ -21,6 +21,7 @@ public:
     DuplicateManager(int total_intfs);
     void mark_duplicate(int intf_indx, pcpp::RawPacket pckt);
     bool check_duplicate(int intf_indx, pcpp::RawPacket pckt);
+    void clear(int intf_indx);
     std::string to_string(std::string prefix = "");
     int num_packets_for_intf(long unsigned int intf_indx);
 
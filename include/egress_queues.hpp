@@ -0,0 +1,114 @@
+/*
+ * egress_queues.hpp - Header file for EgressQueues.
+ *
+ * Gives every port a small set of egress queues, so that latency sensitive traffic is not stuck
+ * behind bulk transfers on its way out. Each packet is classified by the 802.1p priority (PCP) in
+ * its VLAN tag, or by its ingress port's default priority when it is untagged, and each priority
+ * maps to one of the queues. Strict queues are always served first, highest numbered first. The
+ * rest share what is left in proportion to their weights, using deficit round robin (DRR). Ports
+ * with packets waiting are served round robin, one packet at a time.
+ *
+ * Packets are only queued here in the pipeline forwarding mode. The egress thread moves packets
+ * out of the PacketQueue in bursts, so that a backlog builds up here, where it is scheduled, rather
+ * than in the shared FIFO. Each queue holds a bounded number of packets, and drops new ones once it
+ * is full. Queue contents are only ever touched by the egress thread, so they need no locking. The
+ * configuration and counters are atomics, which the CLI reads and writes directly.
+ */
+
+#ifndef EGRESS_QUEUES_HPP
+#define EGRESS_QUEUES_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include "packet_queue.hpp"
+#include "ports.hpp"
+
+class EgressQueues {
+public:
+    static const int NUM_QUEUES = 4;
+    static const int NUM_PRIORITIES = 8;
+    static const int MAX_WEIGHT = 100;
+
+    // How many packets each queue holds before dropping
+    static const int QUEUE_LIMIT = 128;
+
+    /*
+     * QueueCounters - A copy of a single queue's counters, as returned by get_counters().
+     */
+    struct QueueCounters {
+	uint64_t enqueued_pckts = 0;
+	uint64_t sent_pckts = 0;
+	uint64_t sent_bytes = 0;
+	uint64_t dropped_pckts = 0;
+	int depth = 0;
+    };
+
+    EgressQueues(int num_intfs);
+    bool set_queue_for_priority(int priority, int queue);
+    void reset_queue_for_priority(int priority);
+    bool set_strict(int queue);
+    bool set_weight(int queue, int weight);
+    void reset_queue(int queue);
+    bool set_intf_priority(int intf, int priority);
+    void reset_intf(int intf);
+    void enqueue(const std::shared_ptr<PQueueEntry> &entry);
+    bool dequeue(int &intf, std::shared_ptr<PQueueEntry> &entry);
+    bool is_empty() const;
+    std::vector<QueueCounters> get_counters(int intf);
+    void clear_counters();
+    void print_qos(std::ostream &out);
+    void print_queues(std::ostream &out, const std::vector<Ports::PortInfo> &ports);
+    void write_config(std::ostream &out, const std::vector<Ports::PortInfo> &ports);
+
+private:
+    // Bytes a DRR queue may send per round for each unit of weight, about one full sized frame
+    static const int QUANTUM = 1514;
+
+    /*
+     * Queue - A single bounded FIFO of packets, along with its counters. Its slots are only
+     * allocated once something is queued on it, since most ports only ever use a few queues.
+     */
+    struct Queue {
+	std::vector<std::shared_ptr<PQueueEntry>> slots;
+	int head = 0;
+	int count = 0;
+	int deficit = 0;
+
+	std::atomic<uint64_t> enqueued_pckts{0};
+	std::atomic<uint64_t> sent_pckts{0};
+	std::atomic<uint64_t> sent_bytes{0};
+	std::atomic<uint64_t> dropped_pckts{0};
+	std::atomic<int> depth{0};
+    };
+
+    /*
+     * PortQueues - Every queue of a single port, and where DRR left off on it.
+     */
+    struct PortQueues {
+	std::array<Queue, NUM_QUEUES> queues;
+	int backlog = 0;
+	int drr_queue = 0;
+	bool drr_credited = false;
+    };
+
+    std::array<std::atomic<int>, NUM_PRIORITIES> priority_queue;
+    std::array<std::atomic<bool>, NUM_QUEUES> strict;
+    std::array<std::atomic<int>, NUM_QUEUES> weight;
+    std::vector<std::atomic<int>> intf_priority;
+    std::vector<PortQueues> ports;
+
+    // Only used by the egress thread
+    int backlog = 0;
+    int next_port = 0;
+    int high_water = 0;
+
+    static int classify(const pcpp::RawPacket &pckt, int default_priority);
+    std::shared_ptr<PQueueEntry> pop(PortQueues &port, int queue);
+    std::shared_ptr<PQueueEntry> schedule(PortQueues &port);
+};
+
+#endif // EGRESS_QUEUES_HPP
@@ -0,0 +1,76 @@
+/*
+ * ethernet_view.hpp - Header file for EthernetView.
+ *
+ * Reads a frame's Ethernet header where it lies in the captured buffer: the destination and source
+ * MAC addresses, up to MAX_TAGS VLAN tags (802.1Q or 802.1ad), and the EtherType after them. It
+ * allocates nothing and copies nothing, and checks every read against the frame's length, so it is
+ * cheap enough to build for every frame on the forwarding path. Features which need to look past
+ * the Ethernet header, at IP or TCP/UDP, start from its payload.
+ *
+ * A view only points into the buffer it was made from, and must not outlive it.
+ */
+
+#ifndef ETHERNET_VIEW_HPP
+#define ETHERNET_VIEW_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <RawPacket.h>
+
+class EthernetView {
+public:
+    static const int MAX_TAGS = 2;
+    static const size_t HEADER_LEN = 14; // bytes, without tags
+    static const size_t TAG_LEN = 4;
+    static const uint16_t TPID_8021Q = 0x8100;
+    static const uint16_t TPID_8021AD = 0x88a8;
+    static const uint16_t ETHER_TYPE_IPV4 = 0x0800;
+    static const uint16_t ETHER_TYPE_IPV6 = 0x86dd;
+
+    EthernetView(const uint8_t *data, size_t len);
+    explicit EthernetView(const pcpp::RawPacket &pckt);
+
+    // Whether the frame is long enough to have an Ethernet header. Nothing else may be read if not.
+    bool is_valid() const {
+	return len >= HEADER_LEN;
+    }
+
+    const uint8_t *dst_mac() const {
+	return data;
+    }
+
+    const uint8_t *src_mac() const {
+	return data + 6;
+    }
+
+    int num_tags() const {
+	return tags;
+    }
+
+    // The tag control information of a tag, the outermost being 0
+    uint16_t tci(int tag) const {
+	return tcis[tag];
+    }
+
+    uint16_t ether_type() const {
+	return type;
+    }
+
+    const uint8_t *payload() const {
+	return data + payload_offset;
+    }
+
+    size_t payload_len() const {
+	return len - payload_offset;
+    }
+
+private:
+    const uint8_t *data;
+    size_t len;
+    size_t payload_offset = HEADER_LEN;
+    uint16_t type = 0;
+    int tags = 0;
+    uint16_t tcis[MAX_TAGS] = {};
+};
+
+#endif // ETHERNET_VIEW_HPP
@@ -0,0 +1,48 @@
+/*
+ * forwarding.hpp - Header for the switch's forwarding decision.
+ *
+ * The forwarding decision (learning the source address, then choosing egress ports from the MAC
+ * address table and VLAN membership) is shared by both forwarding modes. In the pipeline mode it is
+ * made by the packet processing thread for each packet in the PacketQueue. In the run-to-completion
+ * mode, each capture thread makes it for the packets it receives and transmits them itself, so that
+ * packets never change threads.
+ */
+
+#ifndef FORWARDING_HPP
+#define FORWARDING_HPP
+
+#include <vector>
+#include <RawPacket.h>
+#include "link_aggregation.hpp"
+#include "mac_addr_table.hpp"
+#include "multicast_snooping.hpp"
+#include "ports.hpp"
+#include "storm_control.hpp"
+#include "vlans.hpp"
+
+enum forwarding_mode {
+    PIPELINE, RUN_TO_COMPLETION
+};
+
+/*
+ * decide_forwarding() - Learns the packet's source address on its ingress interface, then fills in
+ * dst_intfs with the port indices the packet should be sent out of. Packets from ports which have
+ * been removed, or which the spanning tree has discarding, are neither learned from nor forwarded,
+ * and packets from ports which are only learning are not forwarded. Packets which would be flooded
+ * are first checked against the ingress port's storm control levels, and are dropped if over them.
+ * Multicast packets to groups known through snooping only go to the group's members and router
+ * ports. Link aggregation groups are learned and forwarded to as their anchor port, and a single
+ * member of each is picked by the packet's hash to send it out of. Unicast decisions are cached
+ * by each thread making them (see ForwardingCache).
+ */
+void decide_forwarding(pcpp::RawPacket *pckt,
+		       int src_intf,
+		       MacAddrTable *mac_tbl,
+		       Vlans *vlans,
+		       Ports *ports,
+		       StormControl *storm_ctl,
+		       MulticastSnooping *snooping,
+		       LinkAggregation *lags,
+		       std::vector<int> &dst_intfs);
+
+#endif // FORWARDING_HPP
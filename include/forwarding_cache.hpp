@@ -0,0 +1,52 @@
+/*
+ * forwarding_cache.hpp - Header file for ForwardingCache.
+ *
+ * A small, direct-mapped cache of unicast forwarding decisions, keyed on the ingress port and the
+ * frame's destination and source MAC addresses. Each thread which makes forwarding decisions keeps
+ * its own, so it needs no locking. A hit skips parsing the frame, the locked MAC address table
+ * lookup, and the VLAN checks, at the cost of a single probe.
+ *
+ * Entries are stamped with the generation numbers of the MAC address table, the VLANs and the link
+ * aggregation groups as they were when the decision was made, and are stale as soon as any of them
+ * changes. A port's VLAN only changes along with the Vlans generation, so it does not need to be
+ * part of the key. Port and spanning tree states are not covered by the generations, and are still
+ * checked on every hit.
+ */
+
+#ifndef FORWARDING_CACHE_HPP
+#define FORWARDING_CACHE_HPP
+
+#include <array>
+#include <cstdint>
+#include <ctime>
+
+class ForwardingCache {
+public:
+    static const int SIZE = 1024; // entries, a power of 2
+
+    /*
+     * Entry - A single cached decision, and when its source address was last learned.
+     */
+    struct Entry {
+	uint64_t dst_key = 0; // the destination MAC address, with the ingress port above it
+	uint64_t src_mac = 0;
+	uint64_t generation = 0;
+	std::time_t learned = 0; // in seconds, by capture timestamp
+	int dst_intf = -1; // -1 while the entry is empty
+    };
+
+    Entry *find(int src_intf, const uint8_t *macs, uint64_t generation);
+    void insert(int src_intf,
+		const uint8_t *macs,
+		uint64_t generation,
+		int dst_intf,
+		std::time_t learned);
+
+private:
+    std::array<Entry, SIZE> entries;
+
+    static uint64_t read_mac(const uint8_t *mac);
+    static long unsigned slot(uint64_t dst_key, uint64_t src_mac);
+};
+
+#endif // FORWARDING_CACHE_HPP
@@ -0,0 +1,87 @@
+/*
+ * handoff.hpp - Header file for HandoffServer and HandoffClient.
+ *
+ * Lets a newly started switch take over from one that is already running, so that the switch may be
+ * upgraded without stopping traffic for more than a moment. The running switch listens on a Unix
+ * domain socket for a switch started with -T, and the two exchange line based messages:
+ *
+ *   1. The server sends "handoff {n}\n" with n listening sockets attached as SCM_RIGHTS: its
+ *      control socket, its handoff socket, and then each of its metrics sockets. The client serves
+ *      these in place of its own, so no client of the switch ever finds them closed.
+ *   2. The server sends "config {n}\n" followed by n lines of running configuration, and then
+ *      "mac {n}\n" followed by n lines of "{mac address} {port} {timestamp}". It holds off any
+ *      further configuration commands from here on, so that none of them are lost.
+ *   3. The client applies the configuration, opens its ports and starts capturing on them in
+ *      standby, dropping every packet. It then restores the MAC address table and sends "ready\n".
+ *   4. The server stops accepting on the listening sockets, stops capturing, drains its packet
+ *      queue, and sends "counters {n}\n" followed by n lines of
+ *      "{port} {ingress pckts} {ingress bytes} {egress pckts} {egress bytes}", then "stp {n}\n"
+ *      followed by n lines of spanning tree state (see Rstp::write_state()), and then "done\n".
+ *      The client restores the counters, adopts the spanning tree, and leaves standby, and the
+ *      server exits.
+ *
+ * Ports are referred to by name, since the two switches may not have given them the same indices.
+ * If the client goes away before sending "ready", the server carries on as if nothing happened.
+ */
+
+#ifndef HANDOFF_HPP
+#define HANDOFF_HPP
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "control_server.hpp"
+#include "metrics_server.hpp"
+#include "vswitch_shmem.hpp"
+
+class HandoffServer {
+public:
+    static constexpr const char *DEFAULT_PATH = "/run/vswitch-handoff.sock";
+
+    HandoffServer(VswitchShmem *shmem,
+		  ControlServer *ctl_server,
+		  MetricsServer *metrics_server,
+		  std::function<void()> stop_forwarding);
+    ~HandoffServer();
+    bool listen_unix(const std::string &path);
+    void adopt(int fd, const std::string &path);
+    bool serve();
+
+private:
+    VswitchShmem *shmem;
+    ControlServer *ctl_server;
+    MetricsServer *metrics_server;
+    std::function<void()> stop_forwarding;
+    int listen_fd = -1;
+    std::string path;
+
+    bool hand_off(int client_fd);
+};
+
+class HandoffClient {
+public:
+    /*
+     * Listeners - The listening sockets inherited from the switch being taken over.
+     */
+    struct Listeners {
+	int ctl_fd = -1;
+	int handoff_fd = -1;
+	std::vector<int> metrics_fds;
+    };
+
+    HandoffClient() = default;
+    HandoffClient(const HandoffClient &) = delete;
+    HandoffClient &operator=(const HandoffClient &) = delete;
+    ~HandoffClient();
+
+    bool connect(const std::string &path);
+    bool receive_state(Listeners &listeners, std::vector<std::string> &config);
+    bool take_over(VswitchShmem *shmem);
+
+private:
+    int fd = -1;
+    std::string buf;
+    std::vector<std::string> mac_entries;
+};
+
+#endif // HANDOFF_HPP
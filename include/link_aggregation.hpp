@@ -0,0 +1,84 @@
+/*
+ * link_aggregation.hpp - Header file for LinkAggregation.
+ *
+ * Groups ports into static link aggregation groups (port channels), so that several links to the
+ * same host or switch act as one logical port with their combined capacity. Every group is
+ * represented by its lowest-numbered member, its anchor: addresses learned on any member are
+ * learned on the anchor, and all members share the anchor's VLAN. Nothing is negotiated with the
+ * other end, so the links must be grouped the same way there.
+ *
+ * A frame sent to a group leaves through just one of its members, chosen by hashing the frame's
+ * MAC addresses, IP addresses, or IP addresses and TCP/UDP ports, so that each flow stays in order
+ * on a single link. Only members which are forwarding are chosen from, so traffic fails over to
+ * the remaining members when a link goes down. Floods also go out one member of each group, and
+ * never back into the group they arrived from.
+ *
+ * Membership is read without locking by forwarding threads, and changed under a lock by the CLI.
+ * A frame forwarded while a group is being changed may go out a port which was just removed from
+ * it, or one member too many or too few.
+ */
+
+#ifndef LINK_AGGREGATION_HPP
+#define LINK_AGGREGATION_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <vector>
+#include <RawPacket.h>
+#include "mac_addr_table.hpp"
+#include "ports.hpp"
+#include "vlans.hpp"
+
+class LinkAggregation {
+public:
+    static const int MAX_GROUPS = 64;
+    static constexpr int MAX_MEMBERS = 8;
+
+    // Which header fields pick the member a frame leaves through
+    enum hash_fields {
+	SRC_DST_MAC, SRC_DST_IP, SRC_DST_PORT
+    };
+
+    LinkAggregation(int num_intfs, MacAddrTable *mac_tbl, Vlans *vlans);
+    bool add_member(int group, int intf);
+    void remove_member(int intf);
+    void reset_intf(int intf);
+    int get_group(int intf) const;
+    std::vector<int> get_members(int intf);
+    void set_hash_fields(hash_fields fields);
+    hash_fields get_hash_fields() const;
+    uint64_t get_generation() const;
+    bool is_active() const;
+    int logical_port(int intf) const;
+    int select_member(int logical, uint32_t hash, const Ports &ports) const;
+    uint32_t hash(const pcpp::RawPacket &pckt) const;
+    void print_groups(std::ostream &out, const Ports &ports);
+    void write_config(std::ostream &out, const std::vector<Ports::PortInfo> &ports);
+
+private:
+    /*
+     * Group - A single group's members, kept sorted so that the first is its anchor.
+     */
+    struct Group {
+	std::array<std::atomic<int>, MAX_MEMBERS> members;
+	std::atomic<int> num_members{0};
+    };
+
+    MacAddrTable *mac_tbl;
+    Vlans *vlans;
+
+    std::array<Group, MAX_GROUPS> groups;
+    std::vector<std::atomic<int>> group_of; // the index into groups of each port, or -1
+    std::atomic<int> num_grouped{0}; // ports in any group, so that forwarding can skip hashing
+    std::atomic<int> fields{SRC_DST_MAC};
+    std::atomic<uint64_t> generation{0}; // bumped whenever members or hash fields change
+    std::mutex config_access;
+
+    void set_members(int group, const std::vector<int> &members);
+    std::vector<int> copy_members(int group) const;
+};
+
+#endif // LINK_AGGREGATION_HPP
@@ -3,25 +3,64 @@
  *
  * An abstraction for the table used to make forwarding decisions. This enables self learning, where
  * mappings from a given MAC address to an interface are added as frames arrive, read from when
- * deciding where to forward frames, and aged out over time.
+ * deciding where to forward frames, and aged out over time. Interfaces are identified by their
+ * port index (see Ports).
+ *
+ * Every change to which interface a known address maps to (an address moving, addresses aging out
+ * or being flushed, or the table being restored) bumps a generation number, so that decisions
+ * cached from the table (see ForwardingCache) can tell when they are stale. Learning a new address
+ * does not, since frames to an unknown address are flooded, and floods are never cached.
+ *
+ * For display, the table is copied out into a vector of compact entries while its lock is held,
+ * and formatted only after the lock has been released, so that showing a large table never stalls
+ * learning or forwarding.
  */
 
 #ifndef MAC_ADDR_TABLE_HPP
 #define MAC_ADDR_TABLE_HPP
 
+#include <atomic>
+#include <cstdint>
+#include <ctime>
 #include <map>
 #include <mutex>
+#include <vector>
 #include <MacAddress.h>
-#include <PcapLiveDevice.h>
+#include "ports.hpp"
 
 class MacAddrTable {
 public:
-    void push_mapping(pcpp::MacAddress mac_addr, pcpp::PcapLiveDevice *intf);
-    pcpp::PcapLiveDevice *get_mapping(pcpp::MacAddress mac_addr);
+    /*
+     * Entry - A copy of a single mapping, as returned by snapshot().
+     */
+    struct Entry {
+	pcpp::MacAddress mac_addr;
+	int intf;
+	std::time_t timestamp;
+    };
+
+    // Returned by get_mapping() for addresses which have not been learned
+    static const int NO_INTF = -1;
+
+    void push_mapping(pcpp::MacAddress mac_addr, int intf);
+    int get_mapping(pcpp::MacAddress mac_addr);
     int age_mappings();
+    int flush_intf(int intf);
+    uint64_t get_generation() const;
     unsigned get_max_age();
+    long unsigned get_size();
     bool modify_aging_time(unsigned int new_age);
-    void print_mactbl(std::ostream &out);
+    std::vector<Entry> snapshot(int intf = NO_INTF);
+    void restore(const std::vector<Entry> &entries);
+    bool lookup(pcpp::MacAddress mac_addr, Entry &entry);
+    void print_mactbl(std::ostream &out, const Ports &ports);
+    static void print_entries(std::ostream &out,
+			      const std::vector<Entry> &entries,
+			      const Ports &ports,
+			      unsigned max_age,
+			      long unsigned first = 0,
+			      long unsigned count = -1);
+    void write_config(std::ostream &out);
 
 private:
     /*
@@ -34,9 +73,10 @@ private:
 
 
     std::map<pcpp::MacAddress,
-	     std::pair<pcpp::PcapLiveDevice *, std::time_t>,
+	     std::pair<int, std::time_t>,
 	     MacAddrCompare> table;
     std::mutex table_access;
+    std::atomic<uint64_t> generation{0};
     int max_age = 15; // in seconds
 };
 
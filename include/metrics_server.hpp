@@ -0,0 +1,52 @@
+/*
+ * metrics_server.hpp - Header file for MetricsServer.
+ *
+ * Serves the state of the virtual switch (interface counters, MAC address table size, packet queue
+ * depths, and VLAN membership) in the OpenMetrics text format over HTTP. It can listen on a TCP
+ * port bound to the loopback address, a Unix domain socket, or both. Every scrape copies a snapshot
+ * of the switch's state before rendering it, so locks shared with forwarding threads are only held
+ * long enough to copy a few integers.
+ */
+
+#ifndef METRICS_SERVER_HPP
+#define METRICS_SERVER_HPP
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "vswitch_shmem.hpp"
+
+class MetricsServer {
+public:
+    MetricsServer(VswitchShmem *shmem);
+    ~MetricsServer();
+    bool listen_tcp(int port);
+    bool listen_unix(const std::string &path);
+    void adopt(int fd);
+    const std::vector<int> &get_listen_fds() const;
+    void serve();
+    void stop();
+    std::string render_metrics();
+
+private:
+    /*
+     * Client - A connection which has not yet sent all of its request.
+     */
+    struct Client {
+	int fd;
+	std::string request;
+	std::chrono::steady_clock::time_point deadline;
+    };
+
+    VswitchShmem *shmem;
+    std::vector<int> listen_fds;
+    std::string unix_path;
+    std::mutex serve_access;
+    bool stopped = false;
+
+    bool handle_client(Client &client);
+    static void close_clients(std::vector<Client> &clients);
+};
+
+#endif // METRICS_SERVER_HPP
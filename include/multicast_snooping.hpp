@@ -0,0 +1,121 @@
+/*
+ * multicast_snooping.hpp - Header file for MulticastSnooping.
+ *
+ * Multicast addresses are never learned as sources, so without snooping every multicast frame is
+ * flooded to its whole VLAN. When snooping is enabled, IGMP (v1, v2 and v3) and MLD (v1 and v2)
+ * messages are inspected as they pass through the switch, to learn which ports have listeners for
+ * each group in each VLAN. Frames sent to a known group then only go to its member ports, plus any
+ * ports multicast routers have been seen on. Frames sent to unknown groups are still flooded.
+ *
+ * Ports which queries arrive on are router ports. Membership reports and leaves are sent only to
+ * router ports, so that hosts on other ports do not suppress their own reports, while queries are
+ * flooded as usual. Members and router ports time out unless they are refreshed, and a leave
+ * shortens a member's time to a couple of seconds, giving other listeners on the port a chance to
+ * answer the querier. Expired entries are removed by the MAC address table's ager thread.
+ *
+ * Groups are kept by IP address, since several IPv4 groups share each multicast MAC address. The
+ * ports for each multicast MAC address are also kept, so that forwarding only needs the frame's
+ * destination address. Source filters in IGMPv3 and MLDv2 reports are not tracked; any report
+ * which does not leave a group counts as joining it. Groups with link-local scope (224.0.0.0/24,
+ * ff02::/16), and IPv4 groups sharing their MAC addresses, are never snooped, since protocols
+ * depend on them reaching every port.
+ */
+
+#ifndef MULTICAST_SNOOPING_HPP
+#define MULTICAST_SNOOPING_HPP
+
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <cstdint>
+#include <ctime>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include <MacAddress.h>
+#include <RawPacket.h>
+#include "ports.hpp"
+
+class MulticastSnooping {
+public:
+    using PortMask = std::bitset<Ports::MAX_PORTS>;
+
+    // IP addresses are kept in IPv6 form, with IPv4 groups stored as IPv4-mapped addresses
+    using IpAddr = std::array<uint8_t, 16>;
+
+    // How long, in seconds, members and router ports last without being refreshed. These are the
+    // group membership and other querier present intervals for the default IGMP/MLD timers.
+    static const int MEMBER_TIMEOUT = 260;
+    static const int ROUTER_TIMEOUT = 255;
+    static const int LEAVE_TIMEOUT = 2;
+
+    /*
+     * GroupInfo - A copy of a single group's members, as returned by snapshot_groups().
+     */
+    struct GroupInfo {
+	int vlan;
+	IpAddr group;
+	std::vector<int> intfs;
+    };
+
+    /*
+     * RouterInfo - A copy of a single router port, as returned by snapshot_routers().
+     */
+    struct RouterInfo {
+	int vlan;
+	int intf;
+	std::time_t expires;
+    };
+
+    void set_enabled(bool enabled);
+    bool is_enabled() const;
+    bool filter_flood(const pcpp::RawPacket &pckt,
+		      const pcpp::MacAddress &dst_mac,
+		      int src_intf,
+		      int vlan,
+		      PortMask &dst_intfs);
+    int age_entries();
+    void reset_intf(int intf);
+    std::vector<GroupInfo> snapshot_groups();
+    std::vector<RouterInfo> snapshot_routers();
+    void print_groups(std::ostream &out, const Ports &ports);
+    void print_routers(std::ostream &out, const Ports &ports);
+    void write_config(std::ostream &out);
+
+private:
+    // What snooping made of an IGMP or MLD message
+    enum message_kind {
+	NOT_SNOOPED, QUERY, REPORT
+    };
+
+    std::atomic<bool> enabled{false};
+
+    // Members of each group by VLAN and address, and when each membership expires
+    std::map<std::pair<int, IpAddr>, std::map<int, std::time_t>> groups;
+
+    // The ports each multicast MAC address is forwarded to by VLAN, as the union of its groups
+    std::map<std::pair<int, uint64_t>, PortMask> group_macs;
+
+    // Router ports in each VLAN, and when each expires
+    std::map<int, std::map<int, std::time_t>> routers;
+
+    std::mutex table_access;
+
+    message_kind snoop(const pcpp::RawPacket &pckt, int src_intf, int vlan);
+    message_kind snoop_igmp(const uint8_t *msg, size_t len, int src_intf, int vlan);
+    message_kind snoop_mld(const uint8_t *msg, size_t len, int src_intf, int vlan);
+    void join(int vlan, const IpAddr &group, int intf);
+    void leave(int vlan, const IpAddr &group, int intf);
+    void add_router(int vlan, int intf);
+    void update_group_mac(int vlan, uint64_t mac);
+    PortMask get_router_mask(int vlan);
+    static uint64_t mac_for_group(const IpAddr &group);
+    static bool is_link_local(const IpAddr &group);
+    static bool is_ipv4(const IpAddr &group);
+    static std::string to_string(const IpAddr &group);
+};
+
+#endif // MULTICAST_SNOOPING_HPP
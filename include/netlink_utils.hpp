@@ -0,0 +1,50 @@
+/*
+ * netlink_utils.hpp - Header for rtnetlink utilities.
+ *
+ * Contains declarations for functions which query the kernel over an rtnetlink socket for the
+ * state of network interfaces, so that the switch never needs to fork and exec tools like `ip` to
+ * learn about its own ports.
+ */
+
+#ifndef NETLINK_UTILS_HPP
+#define NETLINK_UTILS_HPP
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <linux/if_link.h>
+#include <linux/netlink.h>
+
+/*
+ * LinkInfo - The kernel's view of a single network interface: its link state, MTU, hardware
+ * address, assigned IP addresses, and the kernel-level packet statistics for it.
+ */
+struct LinkInfo {
+    int index = 0;
+    std::string name;
+    unsigned flags = 0;
+    unsigned char operstate = 0;
+    unsigned mtu = 0;
+    std::string mac_addr;
+    std::vector<std::string> ip_addrs;
+    struct rtnl_link_stats64 stats = {};
+};
+
+/*
+ * parse_link_msg() - Fills in a LinkInfo from an RTM_NEWLINK or RTM_DELLINK message. Returns false
+ * if the message does not describe a link.
+ */
+bool parse_link_msg(const struct nlmsghdr *msg, LinkInfo &link);
+
+/*
+ * dump_links() - Retrieves every link on the system, along with its addresses, using a single
+ * rtnetlink socket and one RTM_GETLINK and one RTM_GETADDR dump. Returns false on failure.
+ */
+bool dump_links(std::vector<LinkInfo> &links);
+
+/*
+ * print_link() - Prints a LinkInfo in a format resembling `ip -s address show`.
+ */
+void print_link(std::ostream &out, const LinkInfo &link);
+
+#endif // NETLINK_UTILS_HPP
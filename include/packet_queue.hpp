@@ -3,47 +3,136 @@
  *
  * PacketQueue is a thread-safe, FIFO queue implemented using a fixed size circular buffer.
  * It follows the "best effort" model; if the queue is full when attemping to push a new element,
- * that element is immediately dropped (rather than waiting for space to be made).
+ * that element is immediately dropped (rather than waiting for space to be made). Any number of
+ * threads may push packets, but only one thread may process them and only one may pop them.
+ *
+ * How the processing and popping threads wait for work is set by the queue's wait policy: they may
+ * busy-poll, block right away, or adaptively spin, then yield, then block. Waking a blocked thread
+ * is only done when it has announced that it is about to sleep, so that busy threads never pay for
+ * a wakeup on every packet.
+ *
+ * Closing the queue lets both threads finish whatever was pushed before it was closed, after which
+ * process_packet() and pop_packet() return false. Capture must be stopped before the queue is
+ * closed, since anything pushed afterwards may never be processed.
  *
  * PQueueEntry represents a queue entry in the PacketQueue class. The raw packet itself and the
- * interface it came in on are recorded when initially pushed onto the queue. Other information is
- * filled in during processing, and that info is used when popping and egressing the packet.
+ * port index of the interface it came in on are recorded when initially pushed onto the queue.
+ * Other information is filled in during processing, and that info is used when popping and
+ * egressing the packet. Ports are always referred to by index, so no stage ever has to search for
+ * an interface. Entries made with a buffer capacity keep the packet's data in a buffer of their
+ * own, which copy_from() reuses, so that entries recycled by the egress thread allocate nothing.
  */
 
 #ifndef PACKET_QUEUE_HPP
 #define PACKET_QUEUE_HPP
 
+#include <atomic>
 #include <condition_variable>
+#include <iostream>
+#include <vector>
+#include "link_aggregation.hpp"
+#include "mac_addr_table.hpp"
+#include "multicast_snooping.hpp"
+#include "ports.hpp"
+#include "storm_control.hpp"
 #include "vlans.hpp"
 
 class PQueueEntry {
 public:
     PQueueEntry();
-    PQueueEntry(pcpp::RawPacket pckt, pcpp::PcapLiveDevice *src_intf);
+    PQueueEntry(pcpp::RawPacket pckt, int src_intf);
+    explicit PQueueEntry(size_t capacity);
+    PQueueEntry(const PQueueEntry &) = delete;
+    PQueueEntry &operator=(const PQueueEntry &) = delete;
+    void copy_from(const PQueueEntry &other);
 
     pcpp::RawPacket pckt;
-    pcpp::PcapLiveDevice *src_intf;
-    std::vector<pcpp::PcapLiveDevice *> dst_intfs;
+    int src_intf;
+    std::vector<int> dst_intfs;
+    uint64_t epoch = 0; // the Ports epoch the forwarding decision was made in
+
+private:
+    std::vector<uint8_t> buffer;
+    bool buffered = false; // pckt points into buffer, and must only be set through copy_from()
 };
 
 class PacketQueue {
 public:
-    bool push_packet(pcpp::RawPacket pckt, pcpp::PcapLiveDevice *src_intf);
-    void process_packet(MacAddrTable *mac_tbl,
+    enum wait_policy {
+	BUSY_POLL, ADAPTIVE, BLOCK
+    };
+
+    /*
+     * QueueDepths - A point-in-time view of how many entries are sitting in each stage of the
+     * queue, used for monitoring.
+     */
+    struct QueueDepths {
+	int to_process;
+	int to_egress;
+	int capacity;
+    };
+
+    bool push_packet(pcpp::RawPacket pckt, int src_intf);
+    bool process_packet(MacAddrTable *mac_tbl,
 			Vlans *vlans,
-			std::vector<pcpp::PcapLiveDevice *> *veth_intfs);
-    PQueueEntry pop_packet();
+			Ports *ports,
+			StormControl *storm_ctl,
+			MulticastSnooping *snooping,
+			LinkAggregation *lags);
+    bool pop_packet(PQueueEntry &entry);
+    bool try_pop_packet(PQueueEntry &entry);
+    void close();
+    QueueDepths get_depths();
+    void set_wait_policy(wait_policy policy);
+    wait_policy get_wait_policy();
+    void print_queue(std::ostream &out);
+    void write_config(std::ostream &out);
 
 private:
-    int in = 0, space = queue_size; // producer
-    int proc = 0, to_proc = 0;      // packet processor
-    int out = 0, objects = 0;       // consumer
+    // Bounds on how many times an adaptive waiter spins before yielding, and how often it yields
+    // before blocking. The spin limit doubles whenever spinning finds work and halves otherwise.
+    constexpr static int MIN_SPIN = 64;
+    constexpr static int MAX_SPIN = 16384;
+    constexpr static int NUM_YIELDS = 16;
 
-    std::condition_variable proc_cond, cons_cond;
-    std::mutex prod_mtx, proc_mtx, cons_mtx;
+    /*
+     * StageWaiter - Lets the single thread which consumes from a stage of the queue wait for that
+     * stage's count to become non-zero, according to the queue's wait policy. Producers call
+     * notify() after incrementing the count, which only touches the lock and condition variable if
+     * the consumer has gone to sleep. Once the stage has been closed, wait() returns false instead
+     * of waiting on an empty stage.
+     */
+    class StageWaiter {
+    public:
+	bool wait(const std::atomic<wait_policy> &policy, const std::atomic<int> &count);
+	void notify();
+	void close();
+	int get_spin_limit();
+
+    private:
+	std::atomic<bool> sleeping{false};
+	std::atomic<bool> closed{false};
+	std::atomic<int> spin_limit{MIN_SPIN};
+	std::mutex mtx;
+	std::condition_variable cond;
+    };
 
     const static int queue_size = 50;
+
+    int in = 0;                         // producer
+    std::atomic<int> space{queue_size};
+    int proc = 0;                       // packet processor
+    std::atomic<int> to_proc{0};
+    int out = 0;                        // consumer
+    std::atomic<int> objects{0};
+
+    std::mutex prod_mtx;
+    StageWaiter proc_waiter, cons_waiter;
+    std::atomic<wait_policy> policy{ADAPTIVE};
+
     PQueueEntry packet_queue[queue_size];
+
+    void take_packet(PQueueEntry &entry);
 };
 
 #endif // PACKET_QUEUE_HPP
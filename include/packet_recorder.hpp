@@ -0,0 +1,83 @@
+/*
+ * packet_recorder.hpp - Header file for PacketRecorder.
+ *
+ * Records the frames a port receives and sends to a pcap file, for troubleshooting without an
+ * external capture tool. Each port may have one recording at a time, which optionally stops after
+ * a number of frames, and may truncate frames to a snapshot length.
+ *
+ * The forwarding path never touches the disk. Frames are copied into a PacketRing, and a writer
+ * thread of its own writes them out through a large stdio buffer, so the file sees a few big writes
+ * rather than one per frame. The buffer is flushed whenever the ring goes idle, so a recording is
+ * readable soon after traffic stops. Like PortMirror, frames which do not fit in the ring because
+ * the writer has fallen behind are dropped and counted, rather than slowing down forwarding.
+ *
+ * Each recording a port starts is a new session, and frames are queued with their session's
+ * number, so that frames left in the ring by an earlier recording never end up in a later one's
+ * file. A recording whose file cannot be written is stopped, and "show capture" says why.
+ *
+ * Files are written in the classic pcap format with nanosecond timestamps, since that is what the
+ * capture timestamps carry.
+ */
+
+#ifndef PACKET_RECORDER_HPP
+#define PACKET_RECORDER_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <RawPacket.h>
+#include "packet_ring.hpp"
+#include "ports.hpp"
+
+class PacketRecorder {
+public:
+    static const int MIN_SNAPLEN = 14; // bytes, an Ethernet header
+    static const int MAX_SNAPLEN = 262144;
+    static const int RING_SIZE = 4096; // frames, a power of 2
+    static const int BUFFER_SIZE = 1 << 20; // bytes of each file's write buffer
+
+    PacketRecorder();
+    bool start(int intf, const std::string &path, uint64_t limit, int snaplen);
+    bool stop(int intf);
+    void reset_intf(int intf);
+    void record(int intf, const pcpp::RawPacket &pckt);
+    void write_pending();
+    void print_recordings(std::ostream &out, const Ports &ports);
+
+private:
+    // How long write_pending() waits for frames before flushing, in milliseconds
+    static const int WAIT_MS = 100;
+
+    /*
+     * Recording - A single port's recording. The file, path, and error are only touched with
+     * files_access held, while the rest is also read by the forwarding path. A limit of 0 records
+     * until stopped, and a snapshot length of 0 records whole frames.
+     */
+    struct Recording {
+	FILE *file = nullptr;
+	std::string path;
+	std::string error; // why the file stopped being written, if it failed
+
+	std::atomic<bool> active{false};
+	std::atomic<uint64_t> session{0};
+	std::atomic<uint64_t> limit{0};
+	std::atomic<uint32_t> snaplen{0};
+	std::atomic<uint64_t> claimed{0};
+	std::atomic<uint64_t> written{0};
+	std::atomic<uint64_t> dropped{0};
+    };
+
+    PacketRing ring;
+    std::array<Recording, Ports::MAX_PORTS> recordings;
+    std::mutex files_access;
+
+    static bool write_header(FILE *file, uint32_t snaplen);
+    void close(Recording &rec);
+    void fail(Recording &rec);
+};
+
+#endif // PACKET_RECORDER_HPP
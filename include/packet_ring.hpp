@@ -0,0 +1,65 @@
+/*
+ * packet_ring.hpp - Header file for PacketRing.
+ *
+ * A bounded, lock-free queue of packet copies, for handing packets from the forwarding path to a
+ * thread which does something slow with them, such as sending them out of a mirror port. Any
+ * number of threads may push packets, and one thread consumes them. Pushing never waits: if the
+ * ring is full, the packet is dropped and counted, so a consumer which falls behind costs the
+ * forwarding path nothing.
+ *
+ * Each slot owns its buffer, which is reused by every packet that passes through it, so pushing
+ * only allocates when a slot sees a packet longer than any it has held before. Packets may be
+ * truncated as they are copied in, and their original length is kept.
+ *
+ * Slots are claimed with a compare-and-swap on the tail, and carry a sequence number which tells
+ * the consumer when their copy is complete, and producers when the consumer is done with them.
+ */
+
+#ifndef PACKET_RING_HPP
+#define PACKET_RING_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <RawPacket.h>
+
+class PacketRing {
+public:
+    /*
+     * Slot - A single queued copy, the port it belongs to, and whatever tag the producer gave it.
+     */
+    struct Slot {
+	std::atomic<uint64_t> seq{0};
+	int intf = -1;
+	uint64_t tag = 0;
+	timespec timestamp = {0, 0};
+	uint32_t orig_len = 0;
+	std::vector<uint8_t> data;
+    };
+
+    PacketRing(int size, int reserve_len);
+    bool push(const pcpp::RawPacket &pckt, int intf, uint32_t max_len, uint64_t tag = 0);
+    Slot *front();
+    void pop();
+    bool wait(int timeout_ms);
+    uint64_t get_dropped() const;
+
+private:
+    std::unique_ptr<Slot[]> slots;
+    uint64_t mask;
+    std::atomic<uint64_t> tail{0};
+    std::atomic<uint64_t> dropped{0};
+
+    // Only used by the consumer
+    uint64_t head = 0;
+
+    std::mutex mtx;
+    std::condition_variable cond;
+    std::atomic<bool> sleeping{false};
+};
+
+#endif // PACKET_RING_HPP
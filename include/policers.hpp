@@ -0,0 +1,98 @@
+/*
+ * policers.hpp - Header file for Policers.
+ *
+ * Limits the rate at which each port may send traffic into the switch, so that no single port can
+ * fill the PacketQueue and starve the others. A port's policer is a token bucket, measured in
+ * packets or in bits per second, which is applied by the port's capture thread before a packet is
+ * queued or forwarded.
+ *
+ * A single-rate policer has one bucket, refilled at the committed rate and holding up to the
+ * committed burst. Packets which find enough tokens in it conform, and are forwarded. The rest
+ * exceed, and are dropped. A two-rate policer (RFC 2698) adds a second bucket, refilled at a higher
+ * peak rate. Packets which find enough tokens in both conform. Packets which only fit in the peak
+ * bucket exceed, but are still forwarded. Packets which do not fit in the peak bucket violate, and
+ * are dropped.
+ *
+ * Buckets are refilled using each packet's capture timestamp, so policing makes no system calls. A
+ * port's bucket is only ever touched by the thread capturing on it, while its configuration is
+ * changed by the CLI. The capture thread notices changes through a generation number, and only then
+ * takes the lock to copy the new configuration.
+ */
+
+#ifndef POLICERS_HPP
+#define POLICERS_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <vector>
+#include <RawPacket.h>
+#include "ports.hpp"
+
+class Policers {
+public:
+    enum rate_unit {
+	PPS, BPS
+    };
+
+    /*
+     * Config - A single port's policer. Rates are in packets or bits per second, and bursts are in
+     * packets or bytes, depending on the unit. A peak rate of 0 makes it a single-rate policer.
+     */
+    struct Config {
+	bool enabled = false;
+	rate_unit unit = PPS;
+	uint64_t rate = 0;
+	uint64_t burst = 0;
+	uint64_t peak_rate = 0;
+	uint64_t peak_burst = 0;
+    };
+
+    /*
+     * PolicerCounters - A copy of a single port's counters, as returned by get_counters().
+     */
+    struct PolicerCounters {
+	uint64_t conform = 0;
+	uint64_t exceed = 0;
+	uint64_t violate = 0;
+    };
+
+    Policers(int num_intfs);
+    bool set(int intf, const Config &config);
+    void reset_intf(int intf);
+    bool police(int intf, const pcpp::RawPacket &pckt);
+    PolicerCounters get_counters(int intf);
+    void clear_counters();
+    void print_policers(std::ostream &out, const std::vector<Ports::PortInfo> &ports);
+    void write_config(std::ostream &out, const std::vector<Ports::PortInfo> &ports);
+
+private:
+    /*
+     * PortPolicer - A single port's configuration, the copy of it in use by the capture thread,
+     * and its buckets and counters.
+     */
+    struct PortPolicer {
+	Config config;
+	std::mutex config_access;
+	std::atomic<unsigned> generation{0};
+
+	// Only used by the thread capturing on the port
+	Config active;
+	unsigned active_generation = 0;
+	double tokens = 0;
+	double peak_tokens = 0;
+	int64_t last_ns = 0;
+
+	std::atomic<uint64_t> conform{0};
+	std::atomic<uint64_t> exceed{0};
+	std::atomic<uint64_t> violate{0};
+    };
+
+    std::vector<PortPolicer> policers;
+
+    static bool is_valid(const Config &config);
+    Config get_config(int intf);
+};
+
+#endif // POLICERS_HPP
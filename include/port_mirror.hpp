@@ -0,0 +1,112 @@
+/*
+ * port_mirror.hpp - Header file for PortMirror.
+ *
+ * Mirrors the traffic of chosen ports or VLANs to a destination port (SPAN), for analysis by
+ * whatever is attached to it. There are up to MAX_SESSIONS sessions, each with its own sources and
+ * destination. A source may be a port or a VLAN, and is mirrored as it is received (rx), as it is
+ * sent (tx), or both. A session may also truncate its copies to a fixed length, and sample only one
+ * in every so many of its sources' frames. The destination still switches traffic as usual, and
+ * none of its own frames are mirrored back to it.
+ *
+ * Copies are handed to a thread of their own through a PacketRing, which sends them out of their
+ * destination. The forwarding path never waits on it: when the ring is full, because a destination
+ * cannot keep up, copies are dropped and counted rather than slowing down forwarding. Copies are
+ * truncated before they are copied into the ring, so only the bytes that are sent are copied.
+ *
+ * Each port and VLAN keeps a bitmask of the sessions it is a source of, for each direction, so a
+ * frame which is not mirrored costs a single load. Like LinkAggregation, sessions are configured
+ * under a lock, and published to the forwarding path through atomics.
+ */
+
+#ifndef PORT_MIRROR_HPP
+#define PORT_MIRROR_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <RawPacket.h>
+#include "duplicate_manager.hpp"
+#include "packet_ring.hpp"
+#include "ports.hpp"
+#include "vlans.hpp"
+
+class PortMirror {
+public:
+    static const int MAX_SESSIONS = 4;
+    static const int MAX_VLAN = 4094;
+    static const int MIN_TRUNCATE = 14; // bytes, an Ethernet header
+    static const int MAX_TRUNCATE = 65535;
+    static const int MAX_SAMPLE = 65535;
+    static const int RING_SIZE = 1024; // copies, a power of 2
+
+    enum direction {
+	RX = 1, TX = 2, BOTH = RX | TX
+    };
+
+    PortMirror(Ports *ports, Vlans *vlans, DuplicateManager *dup_mgr);
+    bool add_source_intf(int session, int intf, direction dir);
+    bool add_source_vlan(int session, int vlan, direction dir);
+    bool remove_source_intf(int session, int intf);
+    bool remove_source_vlan(int session, int vlan);
+    bool set_destination(int session, int intf);
+    bool set_truncate(int session, int len);
+    bool set_sample(int session, int rate);
+    bool remove_session(int session);
+    void reset_intf(int intf);
+    void mirror(int intf, direction dir, const pcpp::RawPacket &pckt);
+    void send_pending();
+    void clear_counters();
+    void print_sessions(std::ostream &out);
+    void write_config(std::ostream &out);
+
+private:
+    // How long send_pending() waits for copies, in milliseconds
+    static const int WAIT_MS = 100;
+
+    /*
+     * Session - A single session, as it was configured. A truncate length of 0 mirrors whole
+     * frames, and a sample rate of 1 mirrors every frame.
+     */
+    struct Session {
+	int dst = -1;
+	std::map<int, direction> intfs;
+	std::map<int, direction> vlans;
+	int truncate = 0;
+	int sample = 1;
+    };
+
+    /*
+     * ActiveSession - The parts of a session read by the forwarding path, and its counters.
+     */
+    struct ActiveSession {
+	std::atomic<int> dst{-1};
+	std::atomic<uint32_t> truncate{0};
+	std::atomic<uint32_t> sample{1};
+	std::atomic<uint64_t> mirrored{0};
+	std::atomic<uint64_t> dropped{0};
+    };
+
+    Ports *ports;
+    Vlans *vlans;
+    DuplicateManager *dup_mgr;
+    PacketRing ring;
+
+    std::array<Session, MAX_SESSIONS> sessions;
+    std::mutex config_access;
+
+    // The sessions each port and VLAN is a rx source of in their low 4 bits, and a tx source of in
+    // their high 4 bits
+    std::array<ActiveSession, MAX_SESSIONS> active;
+    std::vector<std::atomic<uint8_t>> intf_masks;
+    std::vector<std::atomic<uint8_t>> vlan_masks;
+    std::atomic<int> num_vlan_sources{0};
+
+    bool is_valid_session(int session) const;
+    void publish();
+};
+
+#endif // PORT_MIRROR_HPP
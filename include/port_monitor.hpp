@@ -0,0 +1,44 @@
+/*
+ * port_monitor.hpp - Header file for PortMonitor.
+ *
+ * Keeps the switch's set of ports in sync with the kernel at runtime. PortMonitor subscribes to
+ * rtnetlink link notifications, so that interfaces matching the switch's prefix are opened and
+ * begin capturing as soon as they are created, and are retired when they are deleted. It also
+ * tracks each port's link state: a port whose link goes down is left out of floods and has its MAC
+ * address table entries flushed until its link comes back up, and a port whose link comes up has
+ * its link speed passed on to storm control.
+ */
+
+#ifndef PORT_MONITOR_HPP
+#define PORT_MONITOR_HPP
+
+#include <map>
+#include <string>
+#include <PcapLiveDevice.h>
+#include "netlink_utils.hpp"
+#include "vswitch_shmem.hpp"
+
+class PortMonitor {
+public:
+    PortMonitor(VswitchShmem *shmem,
+		const std::string &prefix,
+		pcpp::OnPacketArrivesCallback on_packet);
+    ~PortMonitor();
+    bool listen();
+    void sync();
+    void serve();
+
+private:
+    VswitchShmem *shmem;
+    std::string prefix;
+    pcpp::OnPacketArrivesCallback on_packet;
+    int nl_fd = -1;
+    std::map<int, int> kernel_to_port; // kernel ifindex to port index
+
+    void update_link(const LinkInfo &link);
+    void remove_link(int kernel_index);
+    void add_port(const LinkInfo &link);
+    void set_link(int port, bool up);
+};
+
+#endif // PORT_MONITOR_HPP
@@ -0,0 +1,87 @@
+/*
+ * ports.hpp - Header file for Ports.
+ *
+ * Keeps track of the interfaces the virtual switch forwards between. Each interface occupies one
+ * of a fixed number of slots, and its slot number is used as its index by every other per-port
+ * structure (Counters, DuplicateManager, Vlans). Since the number of slots never changes, those
+ * structures are sized once at startup, while interfaces may still come and go as the switch runs.
+ *
+ * Slots are read without locking by forwarding threads, which only ever refer to ports by index.
+ * The find() functions search the table, and are meant for the control path. A slot whose
+ * interface has been removed holds nullptr, and a port whose link is down is present but not
+ * forwarding. Adding and removing interfaces is serialized internally.
+ *
+ * A port may also be held back by the spanning tree (see Rstp), which may have it discard
+ * everything, or learn from what it receives without forwarding it. The link and spanning tree
+ * states are kept in the same word, so that checking whether a port forwards is still a single
+ * load on the forwarding path.
+ *
+ * A slot may be reused as soon as its interface is removed, while packets queued for the old
+ * interface are still on their way out. Every removal is numbered, and each slot remembers the
+ * number of its last one, so a packet stamped with get_epoch() before its forwarding decision can
+ * tell with is_current() whether its destination has been replaced since.
+ */
+
+#ifndef PORTS_HPP
+#define PORTS_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <PcapLiveDevice.h>
+
+class Ports {
+public:
+    static const int MAX_PORTS = 256;
+
+    enum stp_state {
+	STP_DISCARDING, STP_LEARNING, STP_FORWARDING
+    };
+
+    /*
+     * PortInfo - A copy of a single occupied slot, as returned by snapshot().
+     */
+    struct PortInfo {
+	int index;
+	pcpp::PcapLiveDevice *dev;
+	bool link_up;
+    };
+
+    Ports(const std::vector<pcpp::PcapLiveDevice *> &intfs);
+    int add(pcpp::PcapLiveDevice *dev);
+    pcpp::PcapLiveDevice *remove(int index);
+    pcpp::PcapLiveDevice *get(int index) const;
+    bool is_forwarding(int index) const;
+    bool is_link_up(int index) const;
+    void set_link(int index, bool up);
+    stp_state get_stp_state(int index) const;
+    void set_stp_state(int index, stp_state state);
+    void set_initial_stp_state(stp_state state);
+    int find(const pcpp::PcapLiveDevice *dev) const;
+    int find(const std::string &name) const;
+    int end() const;
+    uint64_t get_epoch() const;
+    bool is_current(int index, uint64_t epoch) const;
+    std::vector<PortInfo> snapshot() const;
+
+private:
+    // Reasons a port may not be forwarding. A port forwards only while none of them apply.
+    static const uint8_t LINK_DOWN = 0x1;
+    static const uint8_t STP_BLOCKED = 0x2;
+    static const uint8_t STP_NOT_FORWARDING = 0x4;
+
+    std::array<std::atomic<pcpp::PcapLiveDevice *>, MAX_PORTS> devs;
+    std::array<std::atomic<uint8_t>, MAX_PORTS> blocked;
+    std::atomic<uint8_t> initial_blocked; // the spanning tree state new ports start in
+    std::atomic<int> high_water; // one past the highest slot ever used, to bound scans
+    std::array<std::atomic<uint64_t>, MAX_PORTS> removed_at; // the epoch each slot was emptied at
+    std::atomic<uint64_t> removals{0};
+    std::mutex membership;
+
+    static uint8_t stp_bits(stp_state state);
+};
+
+#endif // PORTS_HPP
@@ -0,0 +1,146 @@
+/*
+ * rstp.hpp - Header file for Rstp.
+ *
+ * Implements the Rapid Spanning Tree Protocol (802.1w, as merged into 802.1D-2004), so that loops
+ * in the network around the switch are broken instead of circulating floods forever. Bridges
+ * exchange BPDUs to elect a root bridge, then each port takes on a role: the root port leads
+ * towards the root, designated ports lead away from it, and alternate and backup ports are
+ * redundant paths, which discard everything. Only root and designated ports ever forward.
+ *
+ * Convergence is fast because a designated port does not have to wait out the forward delay once
+ * the bridge on the other end agrees to its proposal. A bridge which receives a proposal on its
+ * root port first blocks its own designated ports (syncs), then agrees, so that the new forwarding
+ * path can never close a loop. Ports which hear no BPDUs shortly after proposing are treated as
+ * edge ports, as are ports configured as edge ports, and they forward right away. A port which
+ * starts forwarding, or a topology change notice from another bridge, flushes learned addresses
+ * from the switch's other ports.
+ *
+ * The protocol runs under a single lock, from the capture threads as BPDUs arrive and from a
+ * thread ticking once per second. Its results reach the forwarding path only through each port's
+ * spanning tree state in Ports, so that blocked ports cost nothing per packet. Legacy STP BPDUs are
+ * understood, but the switch always sends RST BPDUs. Port roles are reworked as a whole whenever
+ * anything they depend on changes, rather than through the standard's per-port state machines.
+ *
+ * A switch taking over from another (see handoff.hpp) adopts its spanning tree as it stood, so
+ * that no port stops forwarding and nothing learned is flushed just because the switch changed.
+ */
+
+#ifndef RSTP_HPP
+#define RSTP_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <RawPacket.h>
+#include "duplicate_manager.hpp"
+#include "mac_addr_table.hpp"
+#include "ports.hpp"
+
+class Rstp {
+public:
+    enum port_role {
+	DISABLED, ROOT, DESIGNATED, ALTERNATE, BACKUP
+    };
+
+    static const int DEFAULT_BRIDGE_PRIORITY = 32768;
+    static const int DEFAULT_PORT_PRIORITY = 128;
+
+    // Protocol timers, in seconds
+    static const int HELLO_TIME = 2;
+    static const int MAX_AGE = 20;
+    static const int FORWARD_DELAY = 15;
+    static const int EDGE_DELAY = 3;
+
+    Rstp(Ports *ports, MacAddrTable *mac_tbl, DuplicateManager *dup_mgr);
+    void set_enabled(bool enabled);
+    bool is_enabled() const;
+    bool set_bridge_priority(int priority);
+    bool set_port_priority(int intf, int priority);
+    bool set_port_cost(int intf, uint32_t cost);
+    void set_edge(int intf, bool edge);
+    void reset_intf(int intf);
+    static bool is_bpdu(const pcpp::RawPacket &pckt);
+    void receive_bpdu(int intf, const pcpp::RawPacket &pckt);
+    void tick();
+    void print_spanning_tree(std::ostream &out, const std::vector<Ports::PortInfo> &ports);
+    void write_config(std::ostream &out, const std::vector<Ports::PortInfo> &ports);
+    void write_state(std::vector<std::string> &lines);
+    void adopt_state(const std::vector<std::string> &lines);
+
+private:
+    /*
+     * PriorityVector - What BPDUs advertise, and what ports and bridges are compared by. Lower is
+     * better in every field, and fields are compared in order.
+     */
+    struct PriorityVector {
+	uint64_t root_id = 0;
+	uint32_t root_cost = 0;
+	uint64_t bridge_id = 0;
+	uint16_t port_id = 0;
+
+	bool operator<(const PriorityVector &other) const;
+    };
+
+    /*
+     * PortState - A single port's configuration, and its part in the spanning tree.
+     */
+    struct PortState {
+	int priority = DEFAULT_PORT_PRIORITY;
+	uint32_t admin_cost = 0; // 0 picks a cost from the link speed
+	bool admin_edge = false;
+
+	bool enabled = false;
+	uint32_t cost = 0;
+	bool oper_edge = false;
+	port_role role = DISABLED;
+	Ports::stp_state state = Ports::STP_DISCARDING;
+
+	// The best information received on the port, while it lasts
+	bool has_info = false;
+	PriorityVector info;
+	int info_age = 0;
+	int info_while = 0;
+
+	bool proposing = false;
+	bool agreed = false;
+	bool agree = false;
+	bool send_now = false;
+	int fd_while = 0;
+	int tc_while = 0;
+	int quiet_for = 0; // seconds spent proposing without hearing a BPDU
+    };
+
+    Ports *ports;
+    MacAddrTable *mac_tbl;
+    DuplicateManager *dup_mgr;
+
+    std::atomic<bool> enabled{false};
+    int bridge_priority = DEFAULT_BRIDGE_PRIORITY;
+    uint64_t bridge_mac = 0;
+    PriorityVector root;
+    int root_port = -1;
+    int root_age = 0;
+    int hello_while = 0;
+    std::vector<PortState> port_states;
+    std::mutex state_access;
+
+    uint64_t bridge_id() const;
+    uint16_t port_id(int intf) const;
+    uint32_t path_cost(int intf) const;
+    PriorityVector designated_vector(int intf) const;
+    void choose_bridge_mac();
+    void update_ports();
+    void update_roles();
+    void set_role(int intf, port_role role);
+    void set_state(int intf, Ports::stp_state state);
+    void sync(int except);
+    void topology_change(int intf, bool received);
+    void advance(int intf);
+    void send_bpdu(int intf);
+    void send_pending();
+};
+
+#endif // RSTP_HPP
@@ -0,0 +1,91 @@
+/*
+ * stats_segment.hpp - Header file for StatsSegment.
+ *
+ * A versioned, seqlock protected POSIX shared memory segment (found under /dev/shm) that vswitch
+ * periodically publishes its counters, packet queue occupancy, and MAC address table size into.
+ * Readers such as vswitch-stat attach to it read-only, so monitoring the switch never touches the
+ * locks or threads used for forwarding.
+ *
+ * The segment is laid out as a StatsHeader followed by max_ports StatsPort entries. A single
+ * writer bumps the header's sequence number to an odd value before updating the segment and back
+ * to an even value afterwards. Readers retry any copy taken while the sequence number was odd or
+ * changed underneath them.
+ *
+ * This header intentionally does not depend on PcapPlusPlus so that readers may be built without
+ * it.
+ */
+
+#ifndef STATS_SEGMENT_HPP
+#define STATS_SEGMENT_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct StatsPort {
+    char name[32];
+    uint64_t ingress_pckts;
+    uint64_t ingress_bytes;
+    uint64_t egress_pckts;
+    uint64_t egress_bytes;
+    int32_t vlan;
+    uint32_t reserved;
+};
+
+struct StatsHeader {
+    uint32_t magic;
+    uint32_t version;
+    std::atomic<uint64_t> seq;
+    uint64_t timestamp_ns;
+    uint64_t mac_tbl_size;
+    int32_t queue_to_process;
+    int32_t queue_to_egress;
+    int32_t queue_capacity;
+    uint32_t num_ports;
+    uint32_t max_ports;
+    uint32_t writer_pid;
+};
+
+class StatsSegment {
+public:
+    static const uint32_t MAGIC = 0x76737774; // "vswt"
+    static const uint32_t VERSION = 1;
+    static constexpr const char *DEFAULT_NAME = "/vswitch-stats";
+
+    /*
+     * Snapshot - A consistent copy of the segment's contents.
+     */
+    struct Snapshot {
+	uint64_t timestamp_ns = 0;
+	uint64_t mac_tbl_size = 0;
+	int32_t queue_to_process = 0;
+	int32_t queue_to_egress = 0;
+	int32_t queue_capacity = 0;
+	std::vector<StatsPort> ports;
+    };
+
+    StatsSegment() = default;
+    StatsSegment(const StatsSegment &) = delete;
+    StatsSegment &operator=(const StatsSegment &) = delete;
+    ~StatsSegment();
+
+    bool create(const std::string &name, uint32_t max_ports);
+    bool attach(const std::string &name);
+    void publish(const Snapshot &snapshot);
+    void stop();
+    void remove();
+    bool read(Snapshot &snapshot) const;
+
+private:
+    std::string name;
+    bool owner = false;
+    bool stopped = false;
+    std::mutex publish_access;
+    StatsHeader *header = nullptr;
+    StatsPort *ports = nullptr;
+    long unsigned map_len = 0;
+};
+
+#endif // STATS_SEGMENT_HPP
@@ -0,0 +1,76 @@
+/*
+ * storm_control.hpp - Header file for StormControl.
+ *
+ * Limits how much flooded traffic each port may send into the switch. Broadcast, multicast, and
+ * unknown unicast frames are flooded to every port in their VLAN, so a storm of them on one port
+ * multiplies the egress work of the whole switch. Each port may be given a level for each of these
+ * classes of traffic, either as a percentage of its link speed or in packets per second.
+ *
+ * Flooded traffic is measured over one second intervals. Once a port has flooded its level's worth
+ * of a class within the current interval, any more of that class is dropped before it is
+ * replicated, until the next interval begins. Intervals are measured using each packet's capture
+ * timestamp. A port's measurements are only ever touched by the thread making forwarding decisions
+ * for it, while its levels and drop counters are atomics shared with the CLI.
+ *
+ * Percentages are kept as given, and turned into bytes per interval from the port's current link
+ * speed as packets are measured, so a link which comes back up at a different speed is held to
+ * the same share of it. PortMonitor keeps the link speeds up to date.
+ */
+
+#ifndef STORM_CONTROL_HPP
+#define STORM_CONTROL_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include <MacAddress.h>
+#include <RawPacket.h>
+#include "ports.hpp"
+
+class StormControl {
+public:
+    enum traffic_class {
+	BROADCAST, MULTICAST, UNKNOWN_UNICAST, NUM_CLASSES
+    };
+
+    enum level_unit {
+	NONE, PERCENT, PPS
+    };
+
+    StormControl(int num_intfs);
+    bool set(int intf, traffic_class type, level_unit unit, uint64_t level, long link_mbps);
+    void reset(int intf, traffic_class type);
+    void reset_intf(int intf);
+    void set_link_speed(int intf, long link_mbps);
+    bool admit(int intf, const pcpp::MacAddress &dst_mac, const pcpp::RawPacket &pckt);
+    uint64_t get_dropped(int intf, traffic_class type);
+    void clear_counters();
+    void print_storm_control(std::ostream &out, const std::vector<Ports::PortInfo> &ports);
+    void write_config(std::ostream &out, const std::vector<Ports::PortInfo> &ports);
+
+private:
+    static const int64_t INTERVAL_NS = 1000000000;
+
+    /*
+     * Level - A single port's level for a single class of traffic, and its use of it during the
+     * current interval. Use is counted in bytes for percentages, and in packets otherwise.
+     */
+    struct Level {
+	std::atomic<int> unit{NONE};
+	std::atomic<uint64_t> level{0};
+	std::atomic<uint64_t> dropped{0};
+
+	// Only used by the thread making forwarding decisions for the port
+	int64_t interval_start = 0;
+	uint64_t used = 0;
+    };
+
+    std::vector<std::array<Level, NUM_CLASSES>> levels;
+    std::vector<std::atomic<long>> link_speeds; // in Mbit/s, 0 if unknown
+
+    static traffic_class classify(const pcpp::MacAddress &dst_mac);
+};
+
+#endif // STORM_CONTROL_HPP
@@ -54,6 +54,13 @@ public:
  */
 pcpp::RawPacket create_broadcast_pckt(pcpp::PcapLiveDevice *src_intf);
 
+/*
+ * create_broadcast_pckt() - As above, but with the given source MAC address in place of the
+ * interface's own, so that an address can be made to move between interfaces.
+ */
+pcpp::RawPacket create_broadcast_pckt(pcpp::PcapLiveDevice *src_intf,
+				      const pcpp::MacAddress &src_mac);
+
 pcpp::RawPacket create_pckt(pcpp::PcapLiveDevice *src_intf, pcpp::PcapLiveDevice *dst_intf);
 
 /*
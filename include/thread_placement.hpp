@@ -0,0 +1,68 @@
+/*
+ * thread_placement.hpp - Header file for ThreadPlacement.
+ *
+ * Decides which CPUs each of the switch's threads may run on, and at what real-time priority, so
+ * that the threads packets pass through are not migrated between cores or made to share them with
+ * housekeeping work. Threads are grouped by role:
+ *   - capture: the threads PcapPlusPlus starts for each port. Each one is pinned to a single CPU
+ *     from its role's set, chosen by port index.
+ *   - forwarding: the thread which makes forwarding decisions.
+ *   - egress: the thread which transmits packets.
+ *   - housekeeping: every other thread (the CLI, control and metrics servers, MAC table ager, etc.)
+ *
+ * A thread applies the placement for its role to itself when it starts, so placement is normally
+ * given in the startup configuration. Optionally, all of the process's memory may be locked into
+ * RAM, so that the forwarding path never takes a page fault.
+ */
+
+#ifndef THREAD_PLACEMENT_HPP
+#define THREAD_PLACEMENT_HPP
+
+#include <array>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <sched.h>
+
+class ThreadPlacement {
+public:
+    enum role {
+	CAPTURE, FORWARDING, EGRESS, HOUSEKEEPING, NUM_ROLES
+    };
+
+    // SCHED_FIFO priorities accepted on Linux
+    static const int MIN_PRIORITY = 1;
+    static const int MAX_PRIORITY = 99;
+
+    ThreadPlacement();
+    bool set_cpus(role type, const std::string &cpu_list);
+    void reset_cpus(role type);
+    bool set_priority(role type, int priority);
+    void reset_priority(role type);
+    void set_memory_lock(bool lock);
+    bool lock_memory();
+    bool apply(role type, int instance = 0);
+    void print_placement(std::ostream &out);
+    void write_config(std::ostream &out);
+
+private:
+    /*
+     * Placement - The CPUs and priority of a single role. An empty CPU list means any CPU the
+     * process was allowed to run on at startup, and a priority of 0 means normal scheduling.
+     */
+    struct Placement {
+	std::vector<int> cpus;
+	int priority = 0;
+    };
+
+    std::array<Placement, NUM_ROLES> placements;
+    bool memory_lock = false;
+    cpu_set_t startup_cpus;
+    std::mutex placement_access;
+
+    static bool parse_cpu_list(const std::string &cpu_list, std::vector<int> &cpus);
+    static std::string format_cpu_list(const std::vector<int> &cpus);
+};
+
+#endif // THREAD_PLACEMENT_HPP
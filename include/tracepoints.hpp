@@ -0,0 +1,46 @@
+/*
+ * tracepoints.hpp - Static tracepoints (USDT probes) along the packet path.
+ *
+ * Each probe compiles to a single nop, plus a note in the binary describing where it is and what
+ * its arguments are, so it costs nothing until a tracer such as bpftrace or perf attaches to it.
+ * All probes belong to the "vswitch" provider:
+ *
+ *   receive(intf, timestamp, data, len)     a frame was captured on intf, and is not a duplicate
+ *   enqueue(intf, timestamp)                it was added to the packet queue
+ *   queue_drop(intf, timestamp)             it was dropped because the packet queue was full
+ *   forward(intf, timestamp, count, dsts)   the forwarding decision picked count ports, in dsts
+ *   transmit(intf, timestamp, len)          a frame was sent out of intf
+ *   mac_learn(mac, intf)                    a new address was learned on intf
+ *   mac_move(mac, old_intf, new_intf)       an address moved from one port to another
+ *   mac_age(mac, intf)                      an address aged out
+ *
+ * The timestamp is the frame's capture timestamp in nanoseconds, which stays with the frame from
+ * capture to transmission, so together with the ingress port it can be used to follow one frame
+ * through each stage. mac is a pointer to the six bytes of the address.
+ *
+ * Probes are left out when sys/sdt.h is not available, or when VSWITCH_NO_USDT is defined.
+ */
+
+#ifndef TRACEPOINTS_HPP
+#define TRACEPOINTS_HPP
+
+#include <cstdint>
+#include <RawPacket.h>
+
+#if !defined(VSWITCH_NO_USDT) && __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define VSWITCH_TRACE(name, ...) STAP_PROBEV(vswitch, name, __VA_ARGS__)
+#else
+#define VSWITCH_TRACE(name, ...) do {} while(0)
+#endif
+
+/*
+ * trace_timestamp() - Returns a frame's capture timestamp in nanoseconds, for use as a probe
+ * argument.
+ */
+inline uint64_t trace_timestamp(const pcpp::RawPacket &pckt) {
+    timespec ts = pckt.getPacketTimeStamp();
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+#endif // TRACEPOINTS_HPP
@@ -6,19 +6,22 @@
  * accessor and mutator functions to ensure users of this class do not attempt to create or operate
  * on interfaces and VLANs which should not or do not exist.
  *
- * Thread safe access has only been implemented for the intf-to-VLAN mapping vector since it is the
- * only data structure that should be accessed by multiple threads. Any accessing or mutating of the
- * VLAN set (add_vlan(), remove_vlan(), and add_intf_to_vlan()) is not thread safe since only one
- * thread, the CLI user, should call them.
+ * Thread safe access has been implemented for the intf-to-VLAN mapping vector since it is read by
+ * the packet processing thread. The VLAN set is only mutated by the CLI user, but is guarded by its
+ * own lock so that monitoring threads may copy it out through get_vlans(). Changes to the mapping
+ * bump a generation number, which tells cached forwarding decisions they are stale.
  */
 
 #ifndef VLANS_HPP
 #define VLANS_HPP
 
+#include <atomic>
+#include <cstdint>
 #include <iostream>
 #include <mutex>
 #include <set>
 #include <vector>
+#include "ports.hpp"
 
 class Vlans {
 public:
@@ -27,13 +30,20 @@ public:
     bool add_vlan(int vlan);
     bool remove_vlan(int vlan);
     bool add_intf_to_vlan(int intf, int vlan);
-    void print_vlans(std::ostream &out, const std::vector<pcpp::PcapLiveDevice *> &veth_intfs);
+    void reset_intf(int intf);
+    uint64_t get_generation() const;
+    std::set<int> get_vlans();
+    std::vector<int> get_intf_vlans();
+    void print_vlans(std::ostream &out, const std::vector<Ports::PortInfo> &ports);
+    void write_config(std::ostream &out, const std::vector<Ports::PortInfo> &ports);
 
 private:
     const int DEFAULT_VLAN = 1;
     std::vector<int> intf_to_vlan;
     std::vector<std::mutex> intf_vlan_mapping_access;
     std::set<int> vlans;
+    std::mutex vlan_set_access;
+    std::atomic<uint64_t> generation{0};
 };
 
 #endif // VLANS_HPP
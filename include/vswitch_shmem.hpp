@@ -8,27 +8,86 @@
 #ifndef VSWITCH_SHMEM_HPP
 #define VSWITCH_SHMEM_HPP
 
+#include <array>
+#include <atomic>
+#include "access_lists.hpp"
+#include "capture_settings.hpp"
 #include "counters.hpp"
 #include "mac_addr_table.hpp"
+#include "multicast_snooping.hpp"
 #include "packet_queue.hpp"
+#include "packet_recorder.hpp"
 #include "duplicate_manager.hpp"
+#include "egress_queues.hpp"
+#include "forwarding.hpp"
+#include "link_aggregation.hpp"
+#include "policers.hpp"
+#include "port_mirror.hpp"
+#include "ports.hpp"
+#include "rstp.hpp"
+#include "storm_control.hpp"
+#include "thread_placement.hpp"
 #include "vlans.hpp"
 
+class VswitchShmem;
+
+/*
+ * PortCookie - Passed as the user cookie when starting capture on a port, so that the capture
+ * callback knows which port a packet arrived on without searching for it. There is one for each
+ * port index, and it never changes, since a port's index is fixed for as long as it is capturing.
+ */
+struct PortCookie {
+    VswitchShmem *shmem;
+    int intf;
+};
+
 class VswitchShmem {
 public:
     VswitchShmem(std::vector<pcpp::PcapLiveDevice *> veth_intfs)
-	: veth_intfs(veth_intfs),
-	  counters(veth_intfs.size()),
-	  dup_mgr(veth_intfs.size()),
-	  vlans(veth_intfs.size())
-	{}
+	: ports(veth_intfs),
+	  counters(Ports::MAX_PORTS),
+	  dup_mgr(Ports::MAX_PORTS),
+	  vlans(Ports::MAX_PORTS),
+	  lags(Ports::MAX_PORTS, &mac_tbl, &vlans),
+	  acls(Ports::MAX_PORTS, &vlans),
+	  egress_queues(Ports::MAX_PORTS),
+	  policers(Ports::MAX_PORTS),
+	  storm_ctl(Ports::MAX_PORTS),
+	  rstp(&ports, &mac_tbl, &dup_mgr),
+	  mirror(&ports, &vlans, &dup_mgr)
+	{
+	    for(int i = 0; i < Ports::MAX_PORTS; i++) {
+		port_cookies[i] = {this, i};
+	    }
+	}
+
+    PortCookie *cookie_for(int intf) {
+	return &port_cookies[intf];
+    }
 
-    std::vector<pcpp::PcapLiveDevice *> veth_intfs;
+    Ports ports;
+    std::string config_path; // where "write memory" saves the running configuration
+    forwarding_mode mode = PIPELINE;
+    std::atomic<bool> standby{false}; // set while another process forwards in this one's place
     Counters counters;
     PacketQueue packet_queue;
     DuplicateManager dup_mgr;
     MacAddrTable mac_tbl;
+    MulticastSnooping snooping;
     Vlans vlans;
+    LinkAggregation lags;
+    AccessLists acls;
+    EgressQueues egress_queues;
+    Policers policers;
+    StormControl storm_ctl;
+    Rstp rstp;
+    PortMirror mirror;
+    PacketRecorder recorder;
+    CaptureSettings capture;
+    ThreadPlacement placement;
+
+private:
+    std::array<PortCookie, Ports::MAX_PORTS> port_cookies;
 };
 
 #endif // VSWITCH_SHMEM_HPP
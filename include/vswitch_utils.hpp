@@ -7,10 +7,21 @@
 #ifndef VSWITCH_UTILS_HPP
 #define VSWITCH_UTILS_HPP
 
+#include <functional>
 #include <string>
 #include <vector>
 #include <PcapLiveDevice.h>
 
+// Chooses the configuration an interface's capture handle is opened with, given its name
+using IntfConfigFunc =
+    std::function<pcpp::PcapLiveDevice::DeviceConfiguration(const std::string &)>;
+
+std::vector<pcpp::PcapLiveDevice *> find_intfs_prefixed_by(const std::string &prefix);
+std::vector<pcpp::PcapLiveDevice *> open_intfs(const std::vector<pcpp::PcapLiveDevice *> &intfs,
+					       IntfConfigFunc config_for);
 std::vector<pcpp::PcapLiveDevice *> get_intfs_prefixed_by(const std::string &prefix);
+pcpp::PcapLiveDevice *open_intf(const std::string &name,
+				const pcpp::PcapLiveDevice::DeviceConfiguration &config);
+long get_link_speed(const std::string &name);
 
 #endif // VSWITCH_UTILS_HPP
@@ -2,16 +2,48 @@
  * main.cpp - The project's entry point.
  *
  * It opens the appropriate interfaces for capturing, creates all threads necessary for the switch
- * to function, and closes the interfaces when it receives an exit command from the CLI.
+ * to function, and closes the interfaces when it receives an exit command from the CLI. The switch
+ * is configured through its control socket, which the interactive CLI is a client of. Interfaces
+ * created or deleted while the switch runs are picked up by the PortMonitor.
+ *
+ * A switch started with -T takes over from the one already running instead (see handoff.hpp), and
+ * the switch it took over from drains its queue and exits.
  */
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <unistd.h>
 #include <PcapLiveDeviceList.h>
 #include <SystemUtils.h>
-#include <FlexLexer.h>
 #include "cli.hpp"
+#include "control_client.hpp"
+#include "control_server.hpp"
+#include "handoff.hpp"
+#include "metrics_server.hpp"
+#include "port_monitor.hpp"
+#include "stats_segment.hpp"
+#include "tracepoints.hpp"
 #include "vswitch_shmem.hpp"
 #include "vswitch_utils.hpp"
 
+const std::chrono::milliseconds STATS_PUBLISH_INTERVAL(250);
+
+// How many packets the egress thread moves into the egress queues for each packet it transmits
+const int EGRESS_BURST = 8;
+
+// How many entries the egress thread starts with, and the bytes of packet data each has room for
+const int EGRESS_POOL_SIZE = 512;
+const int EGRESS_ENTRY_CAPACITY = 2048;
+
 // Logo produced using: https://patorjk.com/software/taag/#p=display&f=Big%20Money-ne&t=vswitch
 const std::string vswitch_header =
     "                                   /$$   /$$               /$$      \n"
@@ -23,137 +55,624 @@ const std::string vswitch_header =
     "   \\  $/   /$$$$$$$/|  $$$$$/$$$$/| $$  |  $$$$/|  $$$$$$$| $$  | $$\n"
     "    \\_/   |_______/  \\_____/\\___/ |__/   \\___/   \\_______/|__/  |__/\n";
 
+// Set once the switch should exit, either from the CLI or because another switch has taken over.
+static std::mutex exit_mtx;
+static std::condition_variable exit_cond;
+static bool exit_requested = false;
+
+/*
+ * request_exit() - Wakes the main thread so that it stops forwarding and exits.
+ */
+static void request_exit() {
+    {
+	std::lock_guard<std::mutex> guard(exit_mtx);
+	exit_requested = true;
+    }
+    exit_cond.notify_all();
+}
+
+/*
+ * transmit_packet() - Sends a packet out of the given port, marking it so that it is not mistaken
+ * for a new packet when it is captured again on its way out (see DuplicateManager). A copy is
+ * queued for any monitor session mirroring what the port sends, and for the port's recording. The
+ * epoch is the one the forwarding decision was made in (see Ports::get_epoch()).
+ */
+static void transmit_packet(VswitchShmem *data, const pcpp::RawPacket &pckt, int dst_intf,
+			    uint64_t epoch) {
+    // Skip ports removed after the forwarding decision was made, even if their slot has been
+    // taken by another interface since
+    pcpp::PcapLiveDevice *intf_ptr = data->ports.get(dst_intf);
+    if(intf_ptr == nullptr || !data->ports.is_current(dst_intf, epoch)) {
+	return;
+    }
+
+    data->dup_mgr.mark_duplicate(dst_intf, pckt);
+    intf_ptr->sendPacket(pckt);
+    VSWITCH_TRACE(transmit, dst_intf, trace_timestamp(pckt), pckt.getRawDataLen());
+    data->counters.increment_counters(dst_intf, pckt.getRawDataLen(), Counters::EGR);
+    data->mirror.mirror(dst_intf, PortMirror::TX, pckt);
+    data->recorder.record(dst_intf, pckt);
+}
+
 /*
  * receive_packet() - Passed to pcpp::PcapLiveDevice.startCapture(), which is called for every
  * vswitch interface. startCapture() creates a new thread which listens for traffic on the
- * corresponding interface, and this function is called whenever a new packet arrives. If the packet
- * is not a duplicate (see DuplicateManager), then it is queued to be sent.
+ * corresponding interface, and this function is called whenever a new packet arrives. The cookie
+ * is the interface's PortCookie. If the packet is not a duplicate (see DuplicateManager), then it is
+ * queued to be sent, or in the run-to-completion mode, forwarded right away, unless an access list
+ * denies it or the port's policer drops it. BPDUs go to the spanning tree instead while it is
+ * enabled. Everything received is mirrored to monitor sessions and recorded first, as it arrived.
+ * Packets are dropped while another switch process is forwarding in this one's place.
  */
-static void receive_packet(pcpp::RawPacket *packet, pcpp::PcapLiveDevice *dev, void *cookie) {
-    VswitchShmem *data = static_cast<VswitchShmem *>(cookie);
+static void receive_packet(pcpp::RawPacket *packet, pcpp::PcapLiveDevice *, void *cookie) {
+    PortCookie *port = static_cast<PortCookie *>(cookie);
+    VswitchShmem *data = port->shmem;
+    int i = port->intf;
 
-    for(long unsigned int i = 0; i < data->veth_intfs.size(); i++) {
-	if(dev == data->veth_intfs[i]) {
-	    if(data->dup_mgr.check_duplicate(i, *packet)) {
-		return;
-	    }
+    // PcapPlusPlus creates the capture thread, so it places itself on its first packet.
+    thread_local bool placed = false;
+    if(!placed) {
+	data->placement.apply(ThreadPlacement::CAPTURE, i);
+	placed = true;
+    }
 
-	    data->counters.increment_counters(i, packet->getRawDataLen(), Counters::ING);
-	    data->packet_queue.push_packet(*packet, dev);
-	    break;
-	}
+    if(data->standby.load(std::memory_order_relaxed)) {
+	return;
     }
 
+    if(data->dup_mgr.check_duplicate(i, *packet)) {
+	return;
+    }
+    VSWITCH_TRACE(receive, i, trace_timestamp(*packet), packet->getRawData(),
+		  packet->getRawDataLen());
+
+    data->counters.increment_counters(i, packet->getRawDataLen(), Counters::ING);
+    data->mirror.mirror(i, PortMirror::RX, *packet);
+    data->recorder.record(i, *packet);
+    if(data->rstp.is_enabled() && Rstp::is_bpdu(*packet)) {
+	data->rstp.receive_bpdu(i, *packet);
+	return;
+    }
+
+    if(!data->acls.permit(i, *packet) || !data->policers.police(i, *packet)) {
+	return;
+    }
+
+    if(data->mode == RUN_TO_COMPLETION) {
+	thread_local std::vector<int> dst_intfs;
+	uint64_t epoch = data->ports.get_epoch();
+	decide_forwarding(packet, i, &data->mac_tbl, &data->vlans, &data->ports, &data->storm_ctl,
+			  &data->snooping, &data->lags, dst_intfs);
+	VSWITCH_TRACE(forward, i, trace_timestamp(*packet), dst_intfs.size(), dst_intfs.data());
+	for(int j : dst_intfs) {
+	    transmit_packet(data, *packet, j, epoch);
+	}
+    } else {
+	data->packet_queue.push_packet(*packet, i);
+    }
     return;
 }
 
 /*
  * process_packets() - A single thread is made with this function, which waits for packets to
  * process on the packet queue. During processing, it fills in various metadata stored in the
- * PQueueEntry class. Most notably, it makes the forwarding decision for each queued packet.
+ * PQueueEntry class. Most notably, it makes the forwarding decision for each queued packet. It
+ * returns once the queue has been closed and everything in it has been processed.
  */
 void process_packets(VswitchShmem *data) {
-    while(true) {
-	data->packet_queue.process_packet(&(data->mac_tbl), &(data->vlans), &(data->veth_intfs));
+    bool more = true;
+    data->placement.apply(ThreadPlacement::FORWARDING);
+    while(more) {
+	more = data->packet_queue.process_packet(&(data->mac_tbl), &(data->vlans), &(data->ports),
+						 &(data->storm_ctl), &(data->snooping),
+						 &(data->lags));
     }
 }
 
 /*
- * send_packets() - A single thread is made with this function, which waits on the packet queue in
- * in the VswitchShmem instance, and transmits the packet whenever it is available.
+ * send_packets() - A single thread is made with this function, which moves processed packets from
+ * the packet queue into each port's egress queues, and transmits them in the order the egress
+ * scheduler chooses (see EgressQueues). It takes in up to EGRESS_BURST packets for every one it
+ * sends, so that any backlog builds up in the egress queues, where it is prioritized. It only waits
+ * on the packet queue once nothing is left to send, and returns once the queue has been closed and
+ * everything has been sent.
+ *
+ * Entries come from a pool, and go back to it once sent out of every port they were queued for, so
+ * that nothing is allocated per packet. The pool only grows if the backlog outgrows it.
  */
 void send_packets(VswitchShmem *data) {
-    long unsigned int i, j;
-    while(true) {
-	PQueueEntry entry = data->packet_queue.pop_packet();
+    std::vector<std::shared_ptr<PQueueEntry>> pool;
+    for(int i = 0; i < EGRESS_POOL_SIZE; i++) {
+	pool.push_back(std::make_shared<PQueueEntry>(EGRESS_ENTRY_CAPACITY));
+    }
+    auto take_entry = [&pool]() {
+	if(pool.empty()) {
+	    return std::make_shared<PQueueEntry>(EGRESS_ENTRY_CAPACITY);
+	}
+	auto entry = std::move(pool.back());
+	pool.pop_back();
+	return entry;
+    };
 
-	for(i = 0; i < entry.dst_intfs.size(); i++) {
-	    auto intf_ptr = entry.dst_intfs[i];
+    auto entry = take_entry();
+    std::shared_ptr<PQueueEntry> next;
+    bool open = true;
+    int intf;
 
-	    // TODO: Update the veth_intf vector to be a set instead, to avoid this redundant loop.
-	    // This requires changes across the entire program, mainly in DuplicateManager.
-	    for(j = 0; j < data->veth_intfs.size(); j++) {
-		if(data->veth_intfs[j] == entry.dst_intfs[i]) {
-		    break;
-		}
+    data->placement.apply(ThreadPlacement::EGRESS);
+    while(open || !data->egress_queues.is_empty()) {
+	for(int i = 0; open && i < EGRESS_BURST; i++) {
+	    bool popped;
+	    if(data->egress_queues.is_empty()) {
+		popped = open = data->packet_queue.pop_packet(*entry);
+	    } else {
+		popped = data->packet_queue.try_pop_packet(*entry);
+	    }
+
+	    if(!popped) {
+		break;
+	    }
+	    // Only the egress thread holds entries, so an entry no queue took may be reused at once
+	    data->egress_queues.enqueue(entry);
+	    if(entry.use_count() > 1) {
+		entry = take_entry();
 	    }
+	}
 
-	    data->dup_mgr.mark_duplicate(j, entry.pckt);
-	    intf_ptr->sendPacket(entry.pckt);
-	    data->counters.increment_counters(j, entry.pckt.getRawDataLen(), Counters::EGR);
+	if(data->egress_queues.dequeue(intf, next)) {
+	    transmit_packet(data, next->pckt, intf, next->epoch);
+	    if(next.use_count() == 1) {
+		pool.push_back(std::move(next));
+	    }
+	    next.reset();
 	}
     }
 }
 
+/*
+ * stop_forwarding() - Stops capturing on every port, then closes the packet queue and waits for the
+ * pipeline threads to send everything left in it. Once this returns, the switch transmits nothing
+ * more. It may be called from more than one thread at once, as when the CLI exits during a
+ * handoff. Only the first call does anything, and the rest wait for it to finish.
+ */
+static void stop_forwarding(VswitchShmem *data, std::thread &process, std::thread &egress) {
+    static std::once_flag stopped;
+    std::call_once(stopped, [data, &process, &egress]() {
+	data->standby.store(true);
+	for(auto &port : data->ports.snapshot()) {
+	    port.dev->stopCapture();
+	}
+
+	data->packet_queue.close();
+	if(process.joinable()) {
+	    process.join();
+	}
+	if(egress.joinable()) {
+	    egress.join();
+	}
+    });
+}
+
 /*
  * age_mac_addrs() - A single thread is made with this function, which removes old MAC to interface
- * mappings at a regular interval, that interval being the default maximum age all entries have.
+ * mappings at a regular interval, that interval being the default maximum age all entries have. It
+ * also removes multicast group members and router ports which have not been refreshed.
  */
 void age_mac_addrs(VswitchShmem *data) {
     while(true) {
 	pcpp::multiPlatformSleep(1);
 	data->mac_tbl.age_mappings();
+	data->snooping.age_entries();
+    }
+}
+
+/*
+ * run_spanning_tree() - A single thread is made with this function, which drives the spanning
+ * tree's timers, sending BPDUs and moving ports between states (see Rstp). The timers stand still
+ * in standby, since no BPDUs are received then, and ports would otherwise start forwarding.
+ */
+void run_spanning_tree(VswitchShmem *data) {
+    while(true) {
+	pcpp::multiPlatformSleep(1);
+	if(!data->standby.load()) {
+	    data->rstp.tick();
+	}
+    }
+}
+
+/*
+ * mirror_packets() - A single thread is made with this function, which sends the copies queued for
+ * monitor sessions out of their destination ports (see PortMirror).
+ */
+void mirror_packets(VswitchShmem *data) {
+    while(true) {
+	data->mirror.send_pending();
+    }
+}
+
+/*
+ * record_packets() - A single thread is made with this function, which writes the frames queued for
+ * recordings to their files (see PacketRecorder).
+ */
+void record_packets(VswitchShmem *data) {
+    while(true) {
+	data->recorder.write_pending();
     }
 }
 
 /*
  * cli() - A single thread is made with this function, which handles the vswitch command line
- * interface. The function parses each line of user input through the help of a Flex file and passes
- * the output to CliInterpreter::interpret() to interpret the text.
+ * interface. It is a client of the control socket: each line of user input is sent to the
+ * ControlServer to be interpreted, and the server's output is printed back to the user.
  */
-void cli(VswitchShmem *data) {
-    CliInterpreter interpreter(data);
-    FlexLexer *lexer = new yyFlexLexer;
-    CliInterpreter::token token;
+void cli(std::string ctl_path) {
+    ControlClient client;
+    std::string line, status, output;
+
+    if(!client.connect(ctl_path)) {
+	std::cerr << "Could not connect to the control socket " << ctl_path << std::endl;
+	request_exit();
+	return;
+    }
 
     std::cout << std::endl << vswitch_header << std::endl;
     while(true) {
 	std::cout << "vswitch# " << std::flush;
+	if(!std::getline(std::cin, line)) {
+	    break;
+	}
+
 	std::vector<CliInterpreter::token> tokens;
 	std::vector<std::string> args;
-	while((token = static_cast<CliInterpreter::token>(lexer->yylex())) != interpreter.NL) {
-	    tokens.push_back(token);
-	    if(token == interpreter.NAME || token == interpreter.UINT) {
-		args.push_back(std::string(lexer->YYText(), lexer->YYLeng()));
-	    }
+	if(!CliInterpreter::tokenize(line, tokens, args)) {
+	    continue;
+	} else if(tokens.size() == 1 && tokens[0] == CliInterpreter::EXIT) {
+	    break;
 	}
 
-	if(tokens.size() == 0) {
-	    continue;
-	} else if(tokens.size() == 1 && tokens[0] == interpreter.EXIT) {
+	if(!client.request(line, status, output)) {
+	    std::cerr << "Lost connection to the control socket." << std::endl;
 	    break;
-	} else if(interpreter.interpret(tokens, args ) == -1) {
+	}
+
+	if(status == ControlClient::STATUS_BAD) {
 	    std::cout << "Bad command" << std::endl;
+	} else {
+	    std::cout << output << std::flush;
 	}
     }
 
-    delete lexer;
+    request_exit();
     return;
 }
 
+/*
+ * serve_control() - A single thread is made with this function, which accepts connections on the
+ * control socket. Each client is then served on a thread of its own.
+ */
+void serve_control(ControlServer *server) {
+    server->serve();
+}
+
+/*
+ * serve_metrics() - A single thread is made with this function, which answers OpenMetrics scrapes
+ * on the endpoints the server was told to listen on.
+ */
+void serve_metrics(MetricsServer *server) {
+    server->serve();
+}
+
+/*
+ * serve_handoff() - A single thread is made with this function, which waits for another switch to
+ * take over from this one, and then has this one exit.
+ */
+void serve_handoff(HandoffServer *server) {
+    if(server->serve()) {
+	request_exit();
+    }
+}
+
+/*
+ * monitor_ports() - A single thread is made with this function, which adds and removes ports and
+ * tracks their link state as the kernel reports changes to its interfaces.
+ */
+void monitor_ports(PortMonitor *monitor) {
+    monitor->serve();
+}
+
+/*
+ * publish_stats() - A single thread is made with this function, which periodically copies the
+ * switch's counters, queue occupancy, and MAC address table size into the shared memory stats
+ * segment read by vswitch-stat.
+ */
+void publish_stats(VswitchShmem *data, StatsSegment *segment) {
+    StatsSegment::Snapshot snapshot;
+
+    while(true) {
+	auto ports = data->ports.snapshot();
+	auto totals = data->counters.get_totals();
+	auto intf_vlans = data->vlans.get_intf_vlans();
+	auto depths = data->packet_queue.get_depths();
+
+	snapshot.ports.assign(ports.size(), StatsPort());
+	for(long unsigned i = 0; i < ports.size(); i++) {
+	    int index = ports[i].index;
+	    strncpy(snapshot.ports[i].name, ports[i].dev->getName().c_str(),
+		    sizeof(snapshot.ports[i].name) - 1);
+	    snapshot.ports[i].ingress_pckts = totals[index].ingress_pckts;
+	    snapshot.ports[i].ingress_bytes = totals[index].ingress_bytes;
+	    snapshot.ports[i].egress_pckts = totals[index].egress_pckts;
+	    snapshot.ports[i].egress_bytes = totals[index].egress_bytes;
+	    snapshot.ports[i].vlan = intf_vlans[index];
+	}
+
+	snapshot.timestamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+	    std::chrono::system_clock::now().time_since_epoch()).count();
+	snapshot.mac_tbl_size = data->mac_tbl.get_size();
+	snapshot.queue_to_process = depths.to_process;
+	snapshot.queue_to_egress = depths.to_egress;
+	snapshot.queue_capacity = depths.capacity;
+
+	segment->publish(snapshot);
+	std::this_thread::sleep_for(STATS_PUBLISH_INTERVAL);
+    }
+}
+
+/*
+ * apply_startup_config() - Reads every command in the startup configuration file and applies them
+ * as one batch, before any packets are captured. Blank lines and lines beginning with '!' or '#'
+ * are ignored. A missing file is treated as an empty configuration so that it may be created with
+ * "write memory". Returns false if any line is invalid or fails to apply.
+ */
+static bool apply_startup_config(const std::string &path, ControlServer &server) {
+    std::ifstream file(path);
+    if(!file) {
+	std::cerr << "Startup configuration " << path << " does not exist. Using defaults."
+		  << std::endl;
+	return true;
+    }
+
+    std::vector<std::string> cmds;
+    std::string line, output;
+    while(std::getline(file, line)) {
+	auto first = line.find_first_not_of(" \t\r");
+	if(first == std::string::npos || line[first] == '!' || line[first] == '#') {
+	    continue;
+	}
+	cmds.push_back(line);
+    }
+
+    if(server.execute(cmds, output) != CliInterpreter::OK) {
+	std::cerr << output << "Could not apply startup configuration " << path << std::endl;
+	return false;
+    }
+
+    return true;
+}
+
+/*
+ * usage() - Prints the accepted command line options.
+ */
+static void usage(const char *prog) {
+    std::cerr
+	<< "Usage: " << prog
+	<< " [-c startup_config] [-C control_socket] [-p metrics_port] [-s metrics_socket]"
+	<< " [-S stats_segment] [-m forwarding_mode] [-H handoff_socket] [-T]" << std::endl
+	<< "  -c  Apply startup_config before forwarding any packets" << std::endl
+	<< "  -C  Path of the control socket (default " << ControlClient::DEFAULT_PATH << ")"
+	<< std::endl
+	<< "  -p  Serve OpenMetrics on 127.0.0.1:metrics_port, e.g. 9273 (off by default)"
+	<< std::endl
+	<< "  -s  Serve OpenMetrics on the Unix socket metrics_socket" << std::endl
+	<< "  -S  Name of the shared memory stats segment (default "
+	<< StatsSegment::DEFAULT_NAME << ")" << std::endl
+	<< "  -m  Forwarding mode: \"pipeline\" (default) hands each packet from its capture thread"
+	<< std::endl
+	<< "      to a processing thread and then an egress thread, while \"run-to-completion\""
+	<< std::endl
+	<< "      forwards each packet entirely on the thread which captured it" << std::endl
+	<< "  -H  Path of the handoff socket (default " << HandoffServer::DEFAULT_PATH << ")"
+	<< std::endl
+	<< "  -T  Take over from the switch listening on the handoff socket, inheriting its"
+	<< std::endl
+	<< "      configuration, sockets, MAC address table, and counters" << std::endl;
+}
+
 /*
  * main() - Initializes the capturing threads for the appropriate interfaces (those whose names are
  * prefixed by "vswitch") and the single sending thread.
  */
-int main(void) {
-    std::vector<pcpp::PcapLiveDevice *> veth_intfs = get_intfs_prefixed_by("vswitch");
+int main(int argc, char *argv[]) {
+    int opt, metrics_port = 0;
+    std::string metrics_sock, stats_name = StatsSegment::DEFAULT_NAME;
+    std::string ctl_path = ControlClient::DEFAULT_PATH, config_path;
+    std::string handoff_path = HandoffServer::DEFAULT_PATH;
+    forwarding_mode mode = PIPELINE;
+    bool takeover = false;
+
+    while((opt = getopt(argc, argv, "c:C:p:s:S:m:H:T")) != -1) {
+	switch(opt) {
+	case 'c':
+	    config_path = optarg;
+	    break;
+	case 'C':
+	    ctl_path = optarg;
+	    break;
+	case 'p':
+	    metrics_port = atoi(optarg);
+	    break;
+	case 's':
+	    metrics_sock = optarg;
+	    break;
+	case 'S':
+	    stats_name = optarg;
+	    break;
+	case 'm':
+	    if(strcmp(optarg, "pipeline") == 0) {
+		mode = PIPELINE;
+	    } else if(strcmp(optarg, "run-to-completion") == 0) {
+		mode = RUN_TO_COMPLETION;
+	    } else {
+		usage(argv[0]);
+		return 1;
+	    }
+	    break;
+	case 'H':
+	    handoff_path = optarg;
+	    break;
+	case 'T':
+	    takeover = true;
+	    break;
+	default:
+	    usage(argv[0]);
+	    return 1;
+	}
+    }
+
+    std::vector<pcpp::PcapLiveDevice *> veth_intfs = find_intfs_prefixed_by("vswitch");
     VswitchShmem data(veth_intfs);
 
+    // Ports only has room for so many interfaces. Any past that are never opened.
+    std::erase_if(veth_intfs, [&data](pcpp::PcapLiveDevice *intf) {
+	if(data.ports.find(intf) != -1) {
+	    return false;
+	}
+	std::cerr << "Cannot add port " << intf->getName() << ". The switch already has "
+		  << Ports::MAX_PORTS << " ports." << std::endl;
+	return true;
+    });
+    data.config_path = config_path;
+    data.mode = mode;
+    data.standby.store(takeover);
+
+    // When taking over, the running configuration of the switch being replaced is applied in place
+    // of the startup configuration, which is then only used by "write memory".
+    ControlServer ctl_server(&data);
+    HandoffClient handoff_client;
+    HandoffClient::Listeners listeners;
+    if(takeover) {
+	std::vector<std::string> cmds;
+	std::string output;
+	if(!handoff_client.connect(handoff_path) || !handoff_client.receive_state(listeners, cmds)) {
+	    std::cerr << "Could not take over from the switch at " << handoff_path << std::endl;
+	    return 1;
+	}
+
+	if(ctl_server.execute(cmds, output) != CliInterpreter::OK) {
+	    std::cerr << output << "Could not apply the configuration of the switch at "
+		      << handoff_path << std::endl;
+	    return 1;
+	}
+    } else if(!config_path.empty() && !apply_startup_config(config_path, ctl_server)) {
+	return 1;
+    }
+
+    // Every thread created from here on inherits the housekeeping placement from the main thread,
+    // and those on the forwarding path replace it with their own once they start.
+    data.placement.lock_memory();
+    data.placement.apply(ThreadPlacement::HOUSEKEEPING);
+    if(!takeover && !ctl_server.listen_unix(ctl_path)) {
+	return 1;
+    }
+
+    MetricsServer metrics_server(&data);
+    if(!takeover && metrics_port > 0) {
+	metrics_server.listen_tcp(metrics_port);
+    }
+    if(!takeover && !metrics_sock.empty()) {
+	metrics_server.listen_unix(metrics_sock);
+    }
+
+    // Ports are only opened once the startup configuration has chosen their capture settings.
+    // Any that cannot be opened are dropped from the switch.
+    auto opened_intfs = open_intfs(veth_intfs, [&data](const std::string &name) {
+	return data.capture.get_config(name);
+    });
     for(auto intf : veth_intfs) {
-	intf->startCapture(receive_packet, &data);
+	if(std::find(opened_intfs.begin(), opened_intfs.end(), intf) == opened_intfs.end()) {
+	    data.ports.remove(data.ports.find(intf));
+	}
+    }
+
+    // Subscribe to link notifications before capturing, so that no interface created from here on
+    // is missed. The initial sync then catches up on anything that changed since startup.
+    PortMonitor port_monitor(&data, "vswitch", receive_packet);
+    port_monitor.listen();
+    for(auto intf : opened_intfs) {
+	intf->startCapture(receive_packet, data.cookie_for(data.ports.find(intf)));
+    }
+    port_monitor.sync();
+
+    // Capture is already running in standby, so forwarding moves over as soon as the old switch
+    // stops. Its sockets are only adopted once it has committed to the handoff, so that failing
+    // before then leaves it untouched.
+    if(takeover) {
+	if(!handoff_client.take_over(&data)) {
+	    std::cerr << "The switch at " << handoff_path << " did not hand off." << std::endl;
+	    return 1;
+	}
+
+	ctl_server.adopt(listeners.ctl_fd, ctl_path);
+	for(int fd : listeners.metrics_fds) {
+	    metrics_server.adopt(fd);
+	}
+    }
+
+    // Creating the segment truncates it, so when taking over, it is only created once the old
+    // switch has stopped publishing to it.
+    StatsSegment stats_segment;
+    if(!stats_segment.create(stats_name, Ports::MAX_PORTS)) {
+	std::cerr << "Stats will not be published to shared memory." << std::endl;
+    }
+
+    // Only the pipeline mode hands packets off to other threads
+    std::thread process, egress;
+    HandoffServer handoff_server(&data, &ctl_server, &metrics_server,
+				 [&data, &process, &egress, &stats_segment]() {
+	stats_segment.stop();
+	stop_forwarding(&data, process, egress);
+    });
+    if(takeover) {
+	handoff_server.adopt(listeners.handoff_fd, handoff_path);
+    } else if(!handoff_server.listen_unix(handoff_path)) {
+	std::cerr << "The switch cannot be handed off to another without stopping." << std::endl;
     }
 
-    std::thread process(process_packets, &data);
-    std::thread egress(send_packets, &data);
+    if(mode == PIPELINE) {
+	process = std::thread(process_packets, &data);
+	egress = std::thread(send_packets, &data);
+    }
     std::thread mac_tbl_ager(age_mac_addrs, &data);
-    std::thread cmd_line(cli, &data);
+    std::thread spanning_tree(run_spanning_tree, &data);
+    std::thread mirror(mirror_packets, &data);
+    std::thread recorder(record_packets, &data);
+    std::thread control(serve_control, &ctl_server);
+    std::thread metrics(serve_metrics, &metrics_server);
+    std::thread stats_publisher(publish_stats, &data, &stats_segment);
+    std::thread port_tracker(monitor_ports, &port_monitor);
+    std::thread handoff(serve_handoff, &handoff_server);
 
-    cmd_line.join();
+    // The terminal belongs to the switch being taken over, so only it runs the interactive CLI
+    std::thread cmd_line;
+    if(!takeover) {
+	cmd_line = std::thread(cli, ctl_path);
+    }
 
-    for(auto intf : veth_intfs) {
-	intf->stopCapture();
-	intf->close();
+    std::unique_lock<std::mutex> exit_lock(exit_mtx);
+    exit_cond.wait(exit_lock, []() {
+	return exit_requested;
+    });
+
+    stop_forwarding(&data, process, egress);
+    for(auto &port : data.ports.snapshot()) {
+	port.dev->close();
     }
+    stats_segment.remove();
 
-    return 0;
+    // The remaining threads never return, so the process exits without tearing down the state they
+    // share. The sockets are left in place for whichever switch has taken them over, or for the
+    // next one to start, which replaces them. The stats segment is only left to a switch which
+    // has taken it over.
+    std::cout << std::flush;
+    std::exit(0);
 }
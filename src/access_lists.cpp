@@ -0,0 +1,496 @@
+/*
+ * access_lists.cpp - Implementation of the AccessLists class.
+ */
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <MacAddress.h>
+#include "access_lists.hpp"
+#include "ethernet_view.hpp"
+
+// The CLI keyword for each action and field, in the order of their enums
+static const char *action_names[] = {
+    "permit", "deny"
+};
+static const char *field_names[] = {
+    "src-mac", "dst-mac", "ethertype", "vlan", "src-ip", "dst-ip", "protocol", "src-port",
+    "dst-port"
+};
+
+// Where each field sits in a key, in bytes, and the largest value each numeric field may match.
+// Addresses are stored as they appear in the frame, with IPv4 addresses in IPv4-mapped form, and
+// numbers are big-endian.
+static const int field_offsets[] = {6, 0, 12, 14, 16, 32, 48, 49, 51};
+static const int field_lengths[] = {6, 6, 2, 2, 16, 16, 1, 2, 2};
+static const unsigned long field_limits[] = {0, 0, 0xffff, 4094, 0, 0, 0xff, 0xffff, 0xffff};
+
+size_t AccessLists::KeyHash::operator()(const Key &key) const {
+    uint64_t hash = 0;
+    for(uint64_t word : key) {
+	hash ^= word + 0x9e3779b97f4a7c15 + (hash << 6) + (hash >> 2);
+    }
+    return hash;
+}
+
+AccessLists::AccessLists(int num_intfs, Vlans *vlans)
+    : vlans(vlans),
+      intf_acls(num_intfs),
+      active(num_intfs) {}
+
+void AccessLists::set_rule(const std::string &acl, int seq, action act) {
+    std::lock_guard<std::mutex> guard(config_access);
+    acls[acl].rules[seq].act = act;
+    rebuild();
+}
+
+bool AccessLists::set_match(const std::string &acl,
+			    int seq,
+			    match_field field,
+			    const std::string &value) {
+    std::lock_guard<std::mutex> guard(config_access);
+    Rule *rule = find_rule(acl, seq);
+    Key unused_value{}, unused_mask{};
+    if(rule == nullptr || !parse_match(field, value, unused_value, unused_mask)) {
+	return false;
+    }
+
+    rule->matches[field] = value;
+    update_rule(*rule);
+    rebuild();
+    return true;
+}
+
+bool AccessLists::reset_match(const std::string &acl, int seq, match_field field) {
+    std::lock_guard<std::mutex> guard(config_access);
+    Rule *rule = find_rule(acl, seq);
+    if(rule == nullptr) {
+	return false;
+    }
+
+    rule->matches[field].clear();
+    update_rule(*rule);
+    rebuild();
+    return true;
+}
+
+bool AccessLists::remove_rule(const std::string &acl, int seq) {
+    std::lock_guard<std::mutex> guard(config_access);
+    auto found = acls.find(acl);
+    if(found == acls.end() || found->second.rules.erase(seq) == 0) {
+	return false;
+    }
+
+    // An ACL only exists for as long as it has rules
+    if(found->second.rules.empty()) {
+	acls.erase(found);
+    }
+    rebuild();
+    return true;
+}
+
+bool AccessLists::remove_acl(const std::string &acl) {
+    std::lock_guard<std::mutex> guard(config_access);
+    if(acls.erase(acl) == 0) {
+	return false;
+    }
+
+    rebuild();
+    return true;
+}
+
+bool AccessLists::has_acl(const std::string &acl) {
+    std::lock_guard<std::mutex> guard(config_access);
+    return acls.count(acl) != 0;
+}
+
+bool AccessLists::apply_intf(int intf, const std::string &acl) {
+    if(intf < 0 || intf >= static_cast<int>(intf_acls.size())) {
+	return false;
+    }
+
+    std::lock_guard<std::mutex> guard(config_access);
+    intf_acls[intf] = acl;
+    rebuild();
+    return true;
+}
+
+bool AccessLists::apply_vlan(int vlan, const std::string &acl) {
+    if(vlan <= 0 || vlan > MAX_VLAN) {
+	return false;
+    }
+
+    std::lock_guard<std::mutex> guard(config_access);
+    if(acl.empty()) {
+	vlan_acls.erase(vlan);
+    } else {
+	vlan_acls[vlan] = acl;
+    }
+    rebuild();
+    return true;
+}
+
+void AccessLists::reset_intf(int intf) {
+    apply_intf(intf, "");
+}
+
+bool AccessLists::permit(int intf, const pcpp::RawPacket &pckt) {
+    ActiveTables &cur = active[intf];
+
+    // Pick up the tables rebuilt since this port's last packet
+    unsigned latest = generation.load(std::memory_order_acquire);
+    if(latest != cur.generation) {
+	std::lock_guard<std::mutex> guard(config_access);
+	cur.tables = tables;
+	cur.generation = generation.load();
+    }
+
+    const Tables *cur_tables = cur.tables.get();
+    if(cur_tables == nullptr) {
+	return true;
+    }
+
+    // The port's VLAN is only looked up once some ACL applies to the frame
+    int vlan = -1;
+    const Classifier *intf_acl = cur_tables->intfs[intf].get();
+    const Classifier *vlan_acl = nullptr;
+    if(cur_tables->any_vlans) {
+	vlan = vlans->get_vlan_for_intf(intf);
+	if(vlan > 0 && vlan <= MAX_VLAN) {
+	    vlan_acl = cur_tables->vlans[vlan].get();
+	}
+    }
+    if(intf_acl == nullptr && vlan_acl == nullptr) {
+	return true;
+    }
+    if(vlan == -1) {
+	vlan = vlans->get_vlan_for_intf(intf);
+    }
+
+    Key key;
+    make_key(pckt, vlan, key);
+    return (intf_acl == nullptr || classify(*intf_acl, key)) &&
+	(vlan_acl == nullptr || classify(*vlan_acl, key));
+}
+
+void AccessLists::clear_counters() {
+    std::lock_guard<std::mutex> guard(config_access);
+    for(auto &[name, acl] : acls) {
+	for(auto &[seq, rule] : acl.rules) {
+	    rule.hits->store(0);
+	}
+	acl.unmatched->store(0);
+    }
+}
+
+void AccessLists::print_acls(std::ostream &out, const std::vector<Ports::PortInfo> &ports) {
+    int pad = 14, rule_pad = 64;
+
+    std::lock_guard<std::mutex> guard(config_access);
+    for(auto &[name, acl] : acls) {
+	out << "Access list " << name << std::endl;
+	out << std::setw(rule_pad + 2) << std::left << "  Rule" << std::right << std::setw(pad)
+	    << "Matches" << std::endl;
+
+	for(auto &[seq, rule] : acl.rules) {
+	    std::string text = std::to_string(seq) + " " + action_names[rule.act];
+	    for(int i = 0; i < NUM_FIELDS; i++) {
+		if(!rule.matches[i].empty()) {
+		    text += std::string(" ") + field_names[i] + " " + rule.matches[i];
+		}
+	    }
+	    out << "  " << std::setw(rule_pad) << std::left << text << std::right
+		<< std::setw(pad) << rule.hits->load() << std::endl;
+	}
+	out << "  " << std::setw(rule_pad) << std::left << "(no match) deny" << std::right
+	    << std::setw(pad) << acl.unmatched->load() << std::endl;
+
+	std::string applied;
+	for(auto &port : ports) {
+	    if(intf_acls[port.index] == name) {
+		applied += std::string(" ") + port.dev->getName();
+	    }
+	}
+	for(auto &[vlan, vlan_acl] : vlan_acls) {
+	    if(vlan_acl == name) {
+		applied += " vlan " + std::to_string(vlan);
+	    }
+	}
+	out << "Applied to:" << (applied.empty() ? " -" : applied) << std::endl << std::endl;
+    }
+}
+
+void AccessLists::write_config(std::ostream &out, const std::vector<Ports::PortInfo> &ports) {
+    std::lock_guard<std::mutex> guard(config_access);
+    for(auto &[name, acl] : acls) {
+	for(auto &[seq, rule] : acl.rules) {
+	    out << "access-list " << name << " " << seq << " " << action_names[rule.act]
+		<< std::endl;
+	    for(int i = 0; i < NUM_FIELDS; i++) {
+		if(!rule.matches[i].empty()) {
+		    out << "access-list " << name << " " << seq << " match " << field_names[i]
+			<< " " << rule.matches[i] << std::endl;
+		}
+	    }
+	}
+    }
+
+    for(auto &port : ports) {
+	if(!intf_acls[port.index].empty()) {
+	    out << port.dev->getName() << " access-group " << intf_acls[port.index] << std::endl;
+	}
+    }
+    for(auto &[vlan, acl] : vlan_acls) {
+	out << "vlan " << vlan << " access-group " << acl << std::endl;
+    }
+}
+
+/*
+ * find_rule() - Returns the given rule, or nullptr if it does not exist. Must be called with
+ * config_access held.
+ */
+AccessLists::Rule *AccessLists::find_rule(const std::string &acl, int seq) {
+    auto found_acl = acls.find(acl);
+    if(found_acl == acls.end()) {
+	return nullptr;
+    }
+
+    auto found_rule = found_acl->second.rules.find(seq);
+    return found_rule == found_acl->second.rules.end() ? nullptr : &found_rule->second;
+}
+
+/*
+ * rebuild() - Compiles every applied ACL into new tables, and publishes them for the capture
+ * threads to pick up. Must be called with config_access held.
+ */
+void AccessLists::rebuild() {
+    auto next = std::make_shared<Tables>();
+    next->intfs.resize(intf_acls.size());
+    next->vlans.resize(MAX_VLAN + 1);
+
+    // ACLs applied in several places are only compiled once
+    std::map<std::string, std::shared_ptr<const Classifier>> compiled;
+    auto classifier_for = [this, &compiled](const std::string &name) {
+	std::shared_ptr<const Classifier> classifier;
+	auto acl = acls.find(name);
+	if(acl != acls.end()) {
+	    auto &cached = compiled[name];
+	    if(cached == nullptr) {
+		cached = compile(acl->second);
+	    }
+	    classifier = cached;
+	}
+	return classifier;
+    };
+
+    for(long unsigned i = 0; i < intf_acls.size(); i++) {
+	if(!intf_acls[i].empty()) {
+	    next->intfs[i] = classifier_for(intf_acls[i]);
+	}
+    }
+    for(auto &[vlan, name] : vlan_acls) {
+	next->vlans[vlan] = classifier_for(name);
+	next->any_vlans |= next->vlans[vlan] != nullptr;
+    }
+
+    tables = next;
+    generation.fetch_add(1, std::memory_order_release);
+}
+
+/*
+ * compile() - Groups an ACL's rules into tuples by their masks. Tuples are created in the order of
+ * their first rules, and a rule whose tuple already has an earlier rule with the same value is
+ * left out, since it could never match first.
+ */
+std::shared_ptr<const AccessLists::Classifier> AccessLists::compile(const Acl &acl) {
+    auto classifier = std::make_shared<Classifier>();
+    classifier->unmatched = acl.unmatched.get();
+    classifier->counters.push_back(acl.unmatched);
+
+    std::map<Key, long unsigned> tuple_for_mask;
+    int order = 0;
+    for(auto &[seq, rule] : acl.rules) {
+	auto [found, added] = tuple_for_mask.try_emplace(rule.mask, classifier->tuples.size());
+	if(added) {
+	    classifier->tuples.push_back({rule.mask, order, {}});
+	}
+
+	Classifier::Tuple &tuple = classifier->tuples[found->second];
+	tuple.rules.try_emplace(rule.value, Classifier::Match{order, rule.act, rule.hits.get()});
+	classifier->counters.push_back(rule.hits);
+	order++;
+    }
+    return classifier;
+}
+
+/*
+ * classify() - Returns whether the classifier permits a frame with the given key, counting the
+ * rule which decided it.
+ */
+bool AccessLists::classify(const Classifier &classifier, const Key &key) {
+    const Classifier::Match *best = nullptr;
+    for(auto &tuple : classifier.tuples) {
+	if(best != nullptr && tuple.first > best->order) {
+	    break;
+	}
+
+	Key masked;
+	for(int i = 0; i < KEY_WORDS; i++) {
+	    masked[i] = key[i] & tuple.mask[i];
+	}
+
+	auto found = tuple.rules.find(masked);
+	if(found != tuple.rules.end() && (best == nullptr || found->second.order < best->order)) {
+	    best = &found->second;
+	}
+    }
+
+    if(best == nullptr) {
+	classifier.unmatched->fetch_add(1, std::memory_order_relaxed);
+	return false;
+    }
+
+    best->hits->fetch_add(1, std::memory_order_relaxed);
+    return best->act == PERMIT;
+}
+
+/*
+ * make_key() - Fills in key with the frame's fields. Fields the frame does not have, such as IP
+ * addresses of non-IP frames or ports of non-TCP/UDP packets, are left as 0. IPv6 extension
+ * headers are not followed.
+ */
+void AccessLists::make_key(const pcpp::RawPacket &pckt, int vlan, Key &key) {
+    key.fill(0);
+    uint8_t *bytes = reinterpret_cast<uint8_t *>(key.data());
+    EthernetView eth(pckt);
+    if(!eth.is_valid()) {
+	return;
+    }
+
+    // Both MAC addresses are in the same order in the key as in the frame
+    memcpy(bytes, eth.dst_mac(), 12);
+    uint16_t ether_type = eth.ether_type();
+    bytes[field_offsets[ETHER_TYPE]] = ether_type >> 8;
+    bytes[field_offsets[ETHER_TYPE] + 1] = ether_type & 0xff;
+    bytes[field_offsets[VLAN_ID]] = vlan >> 8;
+    bytes[field_offsets[VLAN_ID] + 1] = vlan & 0xff;
+
+    // The IP header follows any VLAN tags
+    const uint8_t *ip = eth.payload();
+    size_t len = eth.payload_len();
+    const uint8_t *l4 = nullptr;
+    uint8_t protocol;
+    if(ether_type == EthernetView::ETHER_TYPE_IPV4 && len >= 20) {
+	size_t header_len = (ip[0] & 0x0f) * 4;
+	for(int field : {SRC_IP, DST_IP}) {
+	    bytes[field_offsets[field] + 10] = 0xff;
+	    bytes[field_offsets[field] + 11] = 0xff;
+	}
+	memcpy(bytes + field_offsets[SRC_IP] + 12, ip + 12, 4);
+	memcpy(bytes + field_offsets[DST_IP] + 12, ip + 16, 4);
+	protocol = ip[9];
+
+	// Only the first fragment of a packet carries its ports
+	bool later_fragment = (ip[6] & 0x1f) != 0 || ip[7] != 0;
+	if(!later_fragment && len >= header_len + 4) {
+	    l4 = ip + header_len;
+	}
+    } else if(ether_type == EthernetView::ETHER_TYPE_IPV6 && len >= 40) {
+	memcpy(bytes + field_offsets[SRC_IP], ip + 8, 16);
+	memcpy(bytes + field_offsets[DST_IP], ip + 24, 16);
+	protocol = ip[6];
+	if(len >= 44) {
+	    l4 = ip + 40;
+	}
+    } else {
+	return;
+    }
+
+    bytes[field_offsets[PROTOCOL]] = protocol;
+    if(l4 != nullptr && (protocol == 6 || protocol == 17)) {
+	memcpy(bytes + field_offsets[SRC_PORT], l4, 4);
+    }
+}
+
+/*
+ * parse_match() - Sets the bits of value and mask for a field, given as it was on the CLI.
+ * Returns false if it is not a valid value for the field.
+ */
+bool AccessLists::parse_match(match_field field, const std::string &text, Key &value, Key &mask) {
+    uint8_t *value_bytes = reinterpret_cast<uint8_t *>(value.data()) + field_offsets[field];
+    uint8_t *mask_bytes = reinterpret_cast<uint8_t *>(mask.data()) + field_offsets[field];
+    int len = field_lengths[field];
+
+    switch(field) {
+    case SRC_MAC:
+    case DST_MAC:
+	pcpp::MacAddress(text).copyTo(value_bytes);
+	memset(mask_bytes, 0xff, len);
+	return true;
+
+    case SRC_IP:
+    case DST_IP: {
+	size_t slash = text.find('/');
+	std::string addr = text.substr(0, slash);
+	uint8_t ip[16] = {};
+	int bits = 128;
+	if(inet_pton(AF_INET, addr.c_str(), ip + 12) == 1) {
+	    ip[10] = ip[11] = 0xff;
+	    bits = 32;
+	} else if(inet_pton(AF_INET6, addr.c_str(), ip) != 1) {
+	    return false;
+	}
+
+	long prefix = bits;
+	if(slash != std::string::npos) {
+	    errno = 0;
+	    prefix = strtol(text.c_str() + slash + 1, nullptr, 10);
+	    if(errno != 0 || prefix < 0 || prefix > bits) {
+		return false;
+	    }
+	}
+
+	// IPv4 prefixes also match the IPv4-mapped prefix before them
+	long masked = prefix + 128 - bits;
+	for(int i = 0; i < len; i++) {
+	    long byte_bits = std::clamp(masked - 8 * i, 0l, 8l);
+	    mask_bytes[i] = 0xff00 >> byte_bits;
+	    value_bytes[i] = ip[i] & mask_bytes[i];
+	}
+	return true;
+    }
+
+    default: {
+	errno = 0;
+	char *end;
+	unsigned long number = strtoul(text.c_str(), &end, 0);
+	if(errno != 0 || *end != '\0' || number > field_limits[field] ||
+	   (field == VLAN_ID && number == 0)) {
+	    return false;
+	}
+
+	for(int i = 0; i < len; i++) {
+	    value_bytes[i] = number >> (8 * (len - 1 - i));
+	    mask_bytes[i] = 0xff;
+	}
+	return true;
+    }
+    }
+}
+
+/*
+ * update_rule() - Recomputes the bits a rule matches from its fields, which have already been
+ * checked by parse_match().
+ */
+void AccessLists::update_rule(Rule &rule) {
+    rule.value.fill(0);
+    rule.mask.fill(0);
+    for(int i = 0; i < NUM_FIELDS; i++) {
+	if(!rule.matches[i].empty()) {
+	    parse_match(static_cast<match_field>(i), rule.matches[i], rule.value, rule.mask);
+	}
+    }
+}
@@ -0,0 +1,174 @@
+/*
+ * capture_settings.cpp - Implementation of the CaptureSettings class.
+ */
+
+#include <iomanip>
+#include "capture_settings.hpp"
+
+// The CLI keyword for each setting, in the order of CaptureSettings::setting
+static const char *setting_names[] = {
+    "buffer-size", "snaplen", "timeout", "immediate", "promiscuous"
+};
+
+CaptureSettings::CaptureSettings() {
+    // Ports are promiscuous by default, since a switch must see frames for every host behind it.
+    // Everything else defaults to whatever libpcap would choose.
+    defaults[PROMISC] = 1;
+}
+
+bool CaptureSettings::is_valid(setting type, int value) {
+    switch(type) {
+    case BUFFER_SIZE:
+	return value > 0;
+    case SNAPLEN:
+	return value > 0 && value <= MAX_SNAPLEN;
+    case TIMEOUT:
+	return value > 0 && value <= MAX_TIMEOUT;
+    case IMMEDIATE:
+    case PROMISC:
+	return value == 0 || value == 1;
+    default:
+	return false;
+    }
+}
+
+bool CaptureSettings::set(setting type, int value) {
+    if(!is_valid(type, value)) {
+	return false;
+    }
+
+    std::lock_guard<std::mutex> guard(settings_access);
+    defaults[type] = value;
+    return true;
+}
+
+bool CaptureSettings::set(const std::string &intf, setting type, int value) {
+    if(!is_valid(type, value)) {
+	return false;
+    }
+
+    std::lock_guard<std::mutex> guard(settings_access);
+    intf_overrides[intf][type] = value;
+    return true;
+}
+
+void CaptureSettings::reset(setting type) {
+    std::lock_guard<std::mutex> guard(settings_access);
+    defaults[type] = CaptureSettings().defaults[type];
+}
+
+void CaptureSettings::reset(const std::string &intf, setting type) {
+    std::lock_guard<std::mutex> guard(settings_access);
+    auto overrides = intf_overrides.find(intf);
+    if(overrides == intf_overrides.end()) {
+	return;
+    }
+
+    overrides->second[type].reset();
+    for(auto &value : overrides->second) {
+	if(value.has_value()) {
+	    return;
+	}
+    }
+    intf_overrides.erase(overrides);
+}
+
+CaptureSettings::Overrides CaptureSettings::resolve(const std::string &intf) {
+    std::lock_guard<std::mutex> guard(settings_access);
+    Overrides resolved = defaults;
+
+    auto overrides = intf_overrides.find(intf);
+    if(overrides != intf_overrides.end()) {
+	for(int i = 0; i < NUM_SETTINGS; i++) {
+	    if(overrides->second[i].has_value()) {
+		resolved[i] = overrides->second[i];
+	    }
+	}
+    }
+
+    return resolved;
+}
+
+pcpp::PcapLiveDevice::DeviceConfiguration CaptureSettings::get_config(const std::string &intf) {
+    Overrides settings = resolve(intf);
+    pcpp::PcapLiveDevice::DeviceConfiguration config;
+
+    config.mode = settings[PROMISC].value_or(1) ?
+	pcpp::PcapLiveDevice::Promiscuous : pcpp::PcapLiveDevice::Normal;
+    config.packetBufferSize = settings[BUFFER_SIZE].value_or(0);
+    config.snapshotLength = settings[SNAPLEN].value_or(0);
+    config.packetBufferTimeoutMs = settings[TIMEOUT].value_or(0);
+
+    // PcapPlusPlus does not expose libpcap's immediate mode, so it is approximated with the
+    // shortest read timeout, which bounds how long a packet may sit in the kernel buffer.
+    if(settings[IMMEDIATE].value_or(0)) {
+	config.packetBufferTimeoutMs = 1;
+    }
+
+    return config;
+}
+
+void CaptureSettings::print_settings(std::ostream &out, const std::vector<Ports::PortInfo> &ports) {
+    int pad = 14;
+    std::vector<std::string> headers = {"Port", "Promiscuous", "Immediate", "Snaplen", "BufSize",
+					"Timeout"};
+
+    out << std::setw(pad + 2) << std::left << headers[0];
+    for(long unsigned i = 1; i < headers.size(); i++) {
+	out << std::setw(pad) << std::right << headers[i];
+    }
+    out << std::endl;
+
+    out << std::string(pad + 2, '-');
+    for(long unsigned i = 1; i < headers.size(); i++) {
+	out << std::setw(pad) << std::right << std::string(pad - 2, '-');
+    }
+    out << std::endl;
+
+    // Unset numeric settings are left to libpcap, and shown as such.
+    auto show = [](const std::optional<int> &value) {
+	return value.has_value() ? std::to_string(*value) : std::string("default");
+    };
+
+    for(auto &port : ports) {
+	Overrides settings = resolve(port.dev->getName());
+	out << std::setw(pad + 2) << std::left << port.dev->getName() << std::right
+	    << std::setw(pad) << (settings[PROMISC].value_or(1) ? "yes" : "no")
+	    << std::setw(pad) << (settings[IMMEDIATE].value_or(0) ? "yes" : "no")
+	    << std::setw(pad) << show(settings[SNAPLEN])
+	    << std::setw(pad) << show(settings[BUFFER_SIZE])
+	    << std::setw(pad) << show(settings[TIMEOUT]) << std::endl;
+    }
+    out << std::endl;
+}
+
+void CaptureSettings::write_setting(std::ostream &out,
+				    const std::string &intf,
+				    setting type,
+				    int value) {
+    std::string prefix = intf.empty() ? "capture " : intf + " capture ";
+    if(type == IMMEDIATE || type == PROMISC) {
+	out << (value ? "" : "no ") << prefix << setting_names[type] << std::endl;
+    } else {
+	out << prefix << setting_names[type] << " " << value << std::endl;
+    }
+}
+
+void CaptureSettings::write_config(std::ostream &out) {
+    Overrides builtin = CaptureSettings().defaults;
+
+    std::lock_guard<std::mutex> guard(settings_access);
+    for(int i = 0; i < NUM_SETTINGS; i++) {
+	if(defaults[i].has_value() && defaults[i] != builtin[i]) {
+	    write_setting(out, "", static_cast<setting>(i), *defaults[i]);
+	}
+    }
+
+    for(auto &[intf, overrides] : intf_overrides) {
+	for(int i = 0; i < NUM_SETTINGS; i++) {
+	    if(overrides[i].has_value()) {
+		write_setting(out, intf, static_cast<setting>(i), *overrides[i]);
+	    }
+	}
+    }
+}
@@ -1,109 +1,970 @@
 /*
  * cli.cpp - Implementation of the CliInterpreter class, as well as its private
  * InterpreterTreeNode class.
+ *
+ * Each CLI function writes its output to the given stream and returns OK if the command took
+ * effect, or FAILED (along with an explanation in its output) if it did not.
  */
 
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
-#include <err.h>
-#include <sys/types.h>
-#include <sys/wait.h>
+#include <sstream>
+#include <FlexLexer.h>
 #include "cli.hpp"
+#include "netlink_utils.hpp"
+#include "vswitch_utils.hpp"
 
 // Aliases to replace some of the unpleasant types used frequently here.
 using StrVec = std::vector<std::string>;
 using TokenVec = std::vector<CliInterpreter::token>;
-using CliFunc = std::function<void(std::vector<std::string>)>;
+using CliFunc = std::function<int(std::vector<std::string>, std::ostream &)>;
 
 VswitchShmem *CliInterpreter::shmem = nullptr;
 
+/*
+ * to_int() - Converts a {uint} argument to an int, returning -1 if it is too large to fit, so that
+ * range checks reject it rather than the conversion throwing.
+ */
+static int to_int(const std::string &arg) {
+    errno = 0;
+    long value = strtol(arg.c_str(), nullptr, 10);
+    return errno == 0 && value <= INT_MAX ? value : -1;
+}
+
+/*
+ * to_rate() - Converts a {uint} argument to a rate or burst, which may not fit in an int, returning
+ * 0 if it is too large to fit so that range checks reject it.
+ */
+static uint64_t to_rate(const std::string &arg) {
+    errno = 0;
+    unsigned long long value = strtoull(arg.c_str(), nullptr, 10);
+    return errno == 0 ? value : 0;
+}
+
 // CLI functions
-const CliFunc CliInterpreter::show_mac_addrtbl = [](StrVec) {
-    shmem->mac_tbl.print_mactbl(std::cout);
-};
-
-const CliFunc CliInterpreter::show_interfaces = [](StrVec) {
-    for(auto intf : shmem->veth_intfs) {
-	pid_t cur_ip_call;
-	const char *ip_args[] = {"ip", "-c", "address", "show", intf->getName().c_str(), NULL};
-	switch(cur_ip_call = fork()) {
-	case -1:
-	    warn("fork() failed. Cannot show interface data.");
-	    return;
-	case 0:
-	    if(execvp(ip_args[0], const_cast<char* const*>(ip_args)) == -1) {
-		warn("execvp() failed. Cannot show interface data.");
+// Number of MAC address table entries shown per page by "show mac address-table ... page {uint}"
+static const long unsigned MAC_TBL_PAGE_SIZE = 100;
+
+/*
+ * show_mac_addrtbl_with() - Creates the CLI function for a variant of "show mac address-table".
+ * The table is copied out before any filtering or formatting is done, so the table's lock is only
+ * held for the copy. The filter's argument, if any, comes first in args, followed by the page
+ * number for paged output.
+ */
+CliFunc CliInterpreter::show_mac_addrtbl_with(mac_filter filter, mac_output output) {
+    return [filter, output](StrVec args, std::ostream &out) {
+	std::vector<MacAddrTable::Entry> entries;
+	long unsigned arg = 0;
+
+	switch(filter) {
+	case ALL_MACS:
+	    entries = shmem->mac_tbl.snapshot();
+	    break;
+
+	case BY_INTF: {
+	    int intf = shmem->ports.find(args[arg]);
+	    if(intf == -1) {
+		out << "The interface " << args[arg] << " does not exist." << std::endl;
+		return FAILED;
+	    }
+	    entries = shmem->mac_tbl.snapshot(intf);
+	    arg++;
+	    break;
+	}
+
+	case BY_ADDR: {
+	    MacAddrTable::Entry entry;
+	    if(shmem->mac_tbl.lookup(pcpp::MacAddress(args[arg]), entry)) {
+		entries.push_back(entry);
+	    }
+	    arg++;
+	    break;
+	}
+
+	case BY_VLAN: {
+	    int vlan = to_int(args[arg]);
+	    if(vlan == -1) {
+		out << "VLAN " << args[arg] << " does not exist." << std::endl;
+		return FAILED;
+	    }
+	    auto intf_vlans = shmem->vlans.get_intf_vlans();
+	    entries = shmem->mac_tbl.snapshot();
+	    std::erase_if(entries, [&intf_vlans, vlan](const MacAddrTable::Entry &entry) {
+		return intf_vlans[entry.intf] != vlan;
+	    });
+	    arg++;
+	    break;
+	}
+	}
+
+	long unsigned first = 0, count = entries.size();
+	if(output == COUNT_MACS) {
+	    out << "Total Mac Addresses: " << entries.size() << std::endl;
+	    return OK;
+	} else if(output == PAGED) {
+	    int page = to_int(args[arg]);
+	    long unsigned num_pages = (entries.size() + MAC_TBL_PAGE_SIZE - 1) / MAC_TBL_PAGE_SIZE;
+	    if(page < 1 || (static_cast<long unsigned>(page) > num_pages && num_pages > 0)) {
+		out << "Page " << args[arg] << " does not exist. There are " << num_pages
+		    << " pages." << std::endl;
+		return FAILED;
+	    }
+
+	    first = (page - 1) * MAC_TBL_PAGE_SIZE;
+	    count = MAC_TBL_PAGE_SIZE;
+	    out << "Page " << page << " of " << std::max(num_pages, 1ul) << " ("
+		<< entries.size() << " entries)" << std::endl;
+	}
+
+	MacAddrTable::print_entries(out, entries, shmem->ports, shmem->mac_tbl.get_max_age(), first,
+				    count);
+	return OK;
+    };
+}
+
+const CliFunc CliInterpreter::show_mac_addrtbl = show_mac_addrtbl_with(ALL_MACS, LIST);
+
+const CliFunc CliInterpreter::show_interfaces = [](StrVec, std::ostream &out) {
+    std::vector<LinkInfo> links;
+    if(!dump_links(links)) {
+	out << "Cannot show interface data." << std::endl;
+	return FAILED;
+    }
+
+    for(auto &port : shmem->ports.snapshot()) {
+	for(auto &link : links) {
+	    if(link.name == port.dev->getName()) {
+		print_link(out, link);
+		break;
 	    }
-	    return;
 	}
-	waitpid(cur_ip_call, NULL, 0);
     }
-    std::cout << std::endl;
+    out << std::endl;
+    return OK;
 };
 
-const CliFunc CliInterpreter::show_vlan = [](StrVec) {
-    shmem->vlans.print_vlans(std::cout, shmem->veth_intfs);
+const CliFunc CliInterpreter::show_vlan = [](StrVec, std::ostream &out) {
+    shmem->vlans.print_vlans(out, shmem->ports.snapshot());
+    return OK;
 };
 
-const CliFunc CliInterpreter::vlan_add = [](StrVec args) {
-    if(shmem->vlans.add_vlan(stoi(args[0])) == false) {
-	std::cout << "Failed to add VLAN " << args[0] << ". VLANS must be greater than 0 and "
+const CliFunc CliInterpreter::vlan_add = [](StrVec args, std::ostream &out) {
+    if(shmem->vlans.add_vlan(to_int(args[0])) == false) {
+	out << "Failed to add VLAN " << args[0] << ". VLANS must be greater than 0 and "
 	    "smaller than 4095." << std::endl;
+	return FAILED;
     }
 
-    return;
+    return OK;
 };
 
-const CliFunc CliInterpreter::vlan_remove = [](StrVec args) {
-    if(shmem->vlans.remove_vlan(stoi(args[0])) == false) {
-	std::cout << "Cannot remove VLAN " << args[0] << "." << std::endl;
+const CliFunc CliInterpreter::vlan_remove = [](StrVec args, std::ostream &out) {
+    if(shmem->vlans.remove_vlan(to_int(args[0])) == false) {
+	out << "Cannot remove VLAN " << args[0] << "." << std::endl;
+	return FAILED;
     }
 
-    return;
+    return OK;
 };
 
-const CliFunc CliInterpreter::add_intf_to_vlan = [](StrVec args) {
-    bool found_intf = false;
-    long unsigned intf;
-    for(intf = 0; intf < shmem->veth_intfs.size(); intf++) {
-	if(shmem->veth_intfs[intf]->getName() == args[0]) {
-	    found_intf = true;
-	    break;
+const CliFunc CliInterpreter::add_intf_to_vlan = [](StrVec args, std::ostream &out) {
+    int intf = shmem->ports.find(args[0]);
+    if(intf == -1) {
+	out << "The interface " << args[0] << " does not exist." << std::endl;
+	return FAILED;
+    }
+
+    // Every member of a link aggregation group is kept in the same VLAN. Memberships learned in
+    // the old VLAN no longer apply.
+    for(int member : shmem->lags.get_members(intf)) {
+	if(shmem->vlans.add_intf_to_vlan(member, to_int(args[1])) == false) {
+	    out << "Cannot add interface " << args[0] << " to " << args[1] << "." << std::endl;
+	    return FAILED;
 	}
+	shmem->snooping.reset_intf(member);
     }
+    return OK;
+};
+
+const CliFunc CliInterpreter::show_intf_counters = [](StrVec, std::ostream &out) {
+    shmem->counters.print_counters(out, shmem->ports.snapshot());
+    return OK;
+};
 
-    if(!found_intf) {
-	std::cout << "The interface " << args[0] << " does not exist." << std::endl;
+const CliFunc CliInterpreter::clear_counters = [](StrVec, std::ostream &) {
+    shmem->counters.create_snapshot();
+    shmem->egress_queues.clear_counters();
+    shmem->policers.clear_counters();
+    shmem->storm_ctl.clear_counters();
+    shmem->acls.clear_counters();
+    shmem->mirror.clear_counters();
+    return OK;
+};
+
+const CliFunc CliInterpreter::mac_addrtbl_agetime = [](StrVec arg, std::ostream &out) {
+    int new_age = to_int(arg[0]);
+    if(new_age < 1 || shmem->mac_tbl.modify_aging_time(new_age) == false) {
+	out << "Cannot set global aging time to " << arg[0] << std::endl;
+	return FAILED;
     }
 
-    if(shmem->vlans.add_intf_to_vlan(intf, stoi(args[1])) == false) {
-	std::cout << "Cannot add interface " << args[0] << " to " << args[1] << "." << std::endl;
+    return OK;
+};
+
+const CliFunc CliInterpreter::show_mac_addrtbl_agetime = [](StrVec, std::ostream &out) {
+    out << "Global Aging Time: " << shmem->mac_tbl.get_max_age() << std::endl;
+    return OK;
+};
+
+const CliFunc CliInterpreter::show_running_config = [](StrVec, std::ostream &out) {
+    write_running_config(out);
+    return OK;
+};
+
+const CliFunc CliInterpreter::write_memory = [](StrVec, std::ostream &out) {
+    if(shmem->config_path.empty()) {
+	out << "No startup configuration file was given (see -c). Cannot save the running "
+	    "configuration." << std::endl;
+	return FAILED;
     }
 
-    return;
+    // Write to a temporary file first so a failed write never leaves a truncated configuration.
+    std::string tmp_path = shmem->config_path + ".tmp";
+    std::ofstream file(tmp_path, std::ios::trunc);
+    write_running_config(file);
+    file.close();
+
+    if(!file || rename(tmp_path.c_str(), shmem->config_path.c_str()) == -1) {
+	out << "Cannot save the running configuration to " << shmem->config_path << std::endl;
+	remove(tmp_path.c_str());
+	return FAILED;
+    }
+
+    out << "Saved the running configuration to " << shmem->config_path << std::endl;
+    return OK;
 };
 
-const CliFunc CliInterpreter::show_intf_counters = [](StrVec) {
-    shmem->counters.print_counters(std::cout, shmem->veth_intfs);
+/*
+ * capture_setting_with() - Creates the CLI function for one of the "capture" commands, which
+ * change how ports' capture handles are opened. When intf is set, the interface's name comes first
+ * in args and only that interface's setting is changed. Any value comes last.
+ */
+CliFunc CliInterpreter::capture_setting_with(CaptureSettings::setting type,
+					     capture_op op,
+					     bool intf) {
+    return [type, op, intf](StrVec args, std::ostream &out) {
+	std::string scope = intf ? args[0] : "all ports";
+	bool ok = true;
+	int value = op == ENABLE ? 1 : 0;
+
+	if(op == SET_VALUE) {
+	    value = to_int(args.back());
+	}
+
+	if(op == RESET) {
+	    intf ? shmem->capture.reset(args[0], type) : shmem->capture.reset(type);
+	} else {
+	    ok = intf ? shmem->capture.set(args[0], type, value) : shmem->capture.set(type, value);
+	}
+
+	if(!ok) {
+	    out << "Cannot set the capture setting to " << args.back() << " for " << scope << "."
+		<< std::endl;
+	    return FAILED;
+	}
+
+	if(intf && shmem->ports.find(args[0]) != -1) {
+	    out << "Capture settings for " << args[0] << " will take effect the next time it is "
+		"opened." << std::endl;
+	}
+	return OK;
+    };
+}
+
+const CliFunc CliInterpreter::show_intf_capture = [](StrVec, std::ostream &out) {
+    shmem->capture.print_settings(out, shmem->ports.snapshot());
+    return OK;
 };
 
-const CliFunc CliInterpreter::clear_counters = [](StrVec) {
-    shmem->counters.create_snapshot();
+/*
+ * capture_file_with() - Creates the CLI function for "capture interface {intf} file {path}", which
+ * may be followed by "count {uint}", "snaplen {uint}", or both, in that order.
+ */
+CliFunc CliInterpreter::capture_file_with(bool count, bool snaplen) {
+    return [count, snaplen](StrVec args, std::ostream &out) {
+	int intf = shmem->ports.find(args[0]);
+	if(intf == -1) {
+	    out << "The interface " << args[0] << " does not exist." << std::endl;
+	    return FAILED;
+	}
+
+	int limit = count ? to_int(args[2]) : 0;
+	int len = snaplen ? to_int(args.back()) : 0;
+	if(limit < 0 || (count && limit == 0)) {
+	    out << "Cannot record " << args[2] << " frames. The count must be between 1 and "
+		<< INT_MAX << "." << std::endl;
+	    return FAILED;
+	}
+
+	if(!shmem->recorder.start(intf, args[1], limit, len)) {
+	    out << "Cannot record " << args[0] << " to " << args[1] << ". The file must be "
+		"writable, and the snapshot length between " << PacketRecorder::MIN_SNAPLEN
+		<< " and " << PacketRecorder::MAX_SNAPLEN << "." << std::endl;
+	    return FAILED;
+	}
+	return OK;
+    };
+}
+
+const CliFunc CliInterpreter::no_capture_file = [](StrVec args, std::ostream &out) {
+    int intf = shmem->ports.find(args[0]);
+    if(intf == -1) {
+	out << "The interface " << args[0] << " does not exist." << std::endl;
+	return FAILED;
+    }
+
+    if(!shmem->recorder.stop(intf)) {
+	out << args[0] << " is not being recorded." << std::endl;
+	return FAILED;
+    }
+    return OK;
+};
+
+const CliFunc CliInterpreter::show_capture = [](StrVec, std::ostream &out) {
+    shmem->recorder.print_recordings(out, shmem->ports);
+    return OK;
+};
+
+/*
+ * thread_cpus_with() - Creates the CLI function for "thread {role} cpus {cpu-list}", or for its
+ * "no" form when reset is set.
+ */
+CliFunc CliInterpreter::thread_cpus_with(ThreadPlacement::role type, bool reset) {
+    return [type, reset](StrVec args, std::ostream &out) {
+	if(reset) {
+	    shmem->placement.reset_cpus(type);
+	} else if(!shmem->placement.set_cpus(type, args[0])) {
+	    out << "Cannot use CPUs " << args[0] << ". CPUs are given as a list like 0,2-4, and "
+		"must exist on this machine." << std::endl;
+	    return FAILED;
+	}
+
+	return OK;
+    };
+}
+
+/*
+ * thread_priority_with() - Creates the CLI function for "thread {role} priority {uint}", or for
+ * its "no" form when reset is set.
+ */
+CliFunc CliInterpreter::thread_priority_with(ThreadPlacement::role type, bool reset) {
+    return [type, reset](StrVec args, std::ostream &out) {
+	if(reset) {
+	    shmem->placement.reset_priority(type);
+	} else if(!shmem->placement.set_priority(type, to_int(args[0]))) {
+	    out << "Cannot set priority " << args[0] << ". Priorities must be between "
+		<< ThreadPlacement::MIN_PRIORITY << " and " << ThreadPlacement::MAX_PRIORITY << "."
+		<< std::endl;
+	    return FAILED;
+	}
+
+	return OK;
+    };
+}
+
+const CliFunc CliInterpreter::memory_lock = [](StrVec, std::ostream &) {
+    shmem->placement.set_memory_lock(true);
+    return OK;
+};
+
+const CliFunc CliInterpreter::no_memory_lock = [](StrVec, std::ostream &) {
+    shmem->placement.set_memory_lock(false);
+    return OK;
+};
+
+const CliFunc CliInterpreter::show_threads = [](StrVec, std::ostream &out) {
+    shmem->placement.print_placement(out);
+    return OK;
+};
+
+/*
+ * queue_wait_with() - Creates the CLI function for "queue wait {policy}".
+ */
+CliFunc CliInterpreter::queue_wait_with(PacketQueue::wait_policy policy) {
+    return [policy](StrVec, std::ostream &) {
+	shmem->packet_queue.set_wait_policy(policy);
+	return OK;
+    };
+}
+
+const CliFunc CliInterpreter::show_queue = [](StrVec, std::ostream &out) {
+    shmem->packet_queue.print_queue(out);
+    return OK;
+};
+
+const CliFunc CliInterpreter::qos_priority_queue = [](StrVec args, std::ostream &out) {
+    if(!shmem->egress_queues.set_queue_for_priority(to_int(args[0]), to_int(args[1]))) {
+	out << "Cannot map priority " << args[0] << " to queue " << args[1] << ". Priorities must "
+	    "be between 0 and " << EgressQueues::NUM_PRIORITIES - 1 << ", and queues between 0 and "
+	    << EgressQueues::NUM_QUEUES - 1 << "." << std::endl;
+	return FAILED;
+    }
+    return OK;
+};
+
+const CliFunc CliInterpreter::no_qos_priority_queue = [](StrVec args, std::ostream &) {
+    shmem->egress_queues.reset_queue_for_priority(to_int(args[0]));
+    return OK;
+};
+
+const CliFunc CliInterpreter::qos_queue_strict = [](StrVec args, std::ostream &out) {
+    if(!shmem->egress_queues.set_strict(to_int(args[0]))) {
+	out << "Queue " << args[0] << " does not exist." << std::endl;
+	return FAILED;
+    }
+    return OK;
+};
+
+const CliFunc CliInterpreter::qos_queue_weight = [](StrVec args, std::ostream &out) {
+    if(!shmem->egress_queues.set_weight(to_int(args[0]), to_int(args[1]))) {
+	out << "Cannot give queue " << args[0] << " a weight of " << args[1] << ". Weights must be "
+	    "between 1 and " << EgressQueues::MAX_WEIGHT << "." << std::endl;
+	return FAILED;
+    }
+    return OK;
+};
+
+const CliFunc CliInterpreter::no_qos_queue = [](StrVec args, std::ostream &) {
+    shmem->egress_queues.reset_queue(to_int(args[0]));
+    return OK;
+};
+
+const CliFunc CliInterpreter::intf_qos_priority = [](StrVec args, std::ostream &out) {
+    int intf = shmem->ports.find(args[0]);
+    if(intf == -1) {
+	out << "The interface " << args[0] << " does not exist." << std::endl;
+	return FAILED;
+    }
+
+    if(!shmem->egress_queues.set_intf_priority(intf, to_int(args[1]))) {
+	out << "Cannot give " << args[0] << " priority " << args[1] << ". Priorities must be "
+	    "between 0 and " << EgressQueues::NUM_PRIORITIES - 1 << "." << std::endl;
+	return FAILED;
+    }
+    return OK;
+};
+
+const CliFunc CliInterpreter::no_intf_qos_priority = [](StrVec args, std::ostream &out) {
+    int intf = shmem->ports.find(args[0]);
+    if(intf == -1) {
+	out << "The interface " << args[0] << " does not exist." << std::endl;
+	return FAILED;
+    }
+
+    shmem->egress_queues.set_intf_priority(intf, 0);
+    return OK;
+};
+
+const CliFunc CliInterpreter::show_qos = [](StrVec, std::ostream &out) {
+    shmem->egress_queues.print_qos(out);
+    return OK;
+};
+
+const CliFunc CliInterpreter::show_intf_queues = [](StrVec, std::ostream &out) {
+    shmem->egress_queues.print_queues(out, shmem->ports.snapshot());
+    return OK;
+};
+
+/*
+ * police_with() - Creates the CLI function for "{intf} police rate {uint} {unit} burst {uint}",
+ * which is followed by "peak-rate {uint} burst {uint}" for two-rate policers.
+ */
+CliFunc CliInterpreter::police_with(Policers::rate_unit unit, bool two_rate) {
+    return [unit, two_rate](StrVec args, std::ostream &out) {
+	int intf = shmem->ports.find(args[0]);
+	if(intf == -1) {
+	    out << "The interface " << args[0] << " does not exist." << std::endl;
+	    return FAILED;
+	}
+
+	Policers::Config config;
+	config.enabled = true;
+	config.unit = unit;
+	config.rate = to_rate(args[1]);
+	config.burst = to_rate(args[2]);
+	if(two_rate) {
+	    config.peak_rate = to_rate(args[3]);
+	    config.peak_burst = to_rate(args[4]);
+	}
+
+	if(!shmem->policers.set(intf, config)) {
+	    out << "Cannot police " << args[0] << " at that rate. Rates and bursts must be greater "
+		"than 0, and the peak rate may not be lower than the committed rate." << std::endl;
+	    return FAILED;
+	}
+	return OK;
+    };
+}
+
+const CliFunc CliInterpreter::no_police = [](StrVec args, std::ostream &out) {
+    int intf = shmem->ports.find(args[0]);
+    if(intf == -1) {
+	out << "The interface " << args[0] << " does not exist." << std::endl;
+	return FAILED;
+    }
+
+    shmem->policers.set(intf, Policers::Config());
+    return OK;
+};
+
+const CliFunc CliInterpreter::show_intf_policers = [](StrVec, std::ostream &out) {
+    shmem->policers.print_policers(out, shmem->ports.snapshot());
+    return OK;
+};
+
+/*
+ * storm_control_with() - Creates the CLI function for "{intf} storm-control {class} level {uint}",
+ * given as a percentage of the port's link speed, "{intf} storm-control {class} level pps {uint}",
+ * and "no {intf} storm-control {class}", which is made by passing NONE as the unit.
+ */
+CliFunc CliInterpreter::storm_control_with(StormControl::traffic_class type,
+					   StormControl::level_unit unit) {
+    return [type, unit](StrVec args, std::ostream &out) {
+	int intf = shmem->ports.find(args[0]);
+	if(intf == -1) {
+	    out << "The interface " << args[0] << " does not exist." << std::endl;
+	    return FAILED;
+	}
+
+	if(unit == StormControl::NONE) {
+	    shmem->storm_ctl.reset(intf, type);
+	    return OK;
+	}
+
+	long link_mbps = 0;
+	if(unit == StormControl::PERCENT) {
+	    link_mbps = get_link_speed(args[0]);
+	    if(link_mbps == -1) {
+		out << "The link speed of " << args[0] << " is unknown. Give its level in packets "
+		    "per second instead." << std::endl;
+		return FAILED;
+	    }
+	}
+
+	if(!shmem->storm_ctl.set(intf, type, unit, to_rate(args[1]), link_mbps)) {
+	    out << "Cannot set that storm control level on " << args[0] << ". Levels must be "
+		"greater than 0, and percentages may not be greater than 100." << std::endl;
+	    return FAILED;
+	}
+	return OK;
+    };
+}
+
+const CliFunc CliInterpreter::show_intf_storm_control = [](StrVec, std::ostream &out) {
+    shmem->storm_ctl.print_storm_control(out, shmem->ports.snapshot());
+    return OK;
 };
 
-const CliFunc CliInterpreter::mac_addrtbl_agetime = [](StrVec arg) {
-    unsigned new_age = stoi(arg[0]);
-    if(shmem->mac_tbl.modify_aging_time(new_age) == false) {
-	std::cout << "Cannot set global aging time to " << arg[0] << std::endl;
+/*
+ * multicast_snooping_with() - Creates the CLI function for "multicast snooping" or
+ * "no multicast snooping".
+ */
+CliFunc CliInterpreter::multicast_snooping_with(bool enabled) {
+    return [enabled](StrVec, std::ostream &) {
+	shmem->snooping.set_enabled(enabled);
+	return OK;
+    };
+}
+
+const CliFunc CliInterpreter::show_multicast_groups = [](StrVec, std::ostream &out) {
+    shmem->snooping.print_groups(out, shmem->ports);
+    return OK;
+};
+
+const CliFunc CliInterpreter::show_multicast_routers = [](StrVec, std::ostream &out) {
+    shmem->snooping.print_routers(out, shmem->ports);
+    return OK;
+};
+
+/*
+ * spanning_tree_with() - Creates the CLI function for "spanning-tree" or "no spanning-tree".
+ */
+CliFunc CliInterpreter::spanning_tree_with(bool enabled) {
+    return [enabled](StrVec, std::ostream &) {
+	shmem->rstp.set_enabled(enabled);
+	return OK;
+    };
+}
+
+const CliFunc CliInterpreter::spanning_tree_priority = [](StrVec args, std::ostream &out) {
+    if(!shmem->rstp.set_bridge_priority(to_int(args[0]))) {
+	out << "Cannot set the bridge priority to " << args[0] << ". It must be a multiple of 4096 "
+	    "between 0 and 61440." << std::endl;
+	return FAILED;
+    }
+    return OK;
+};
+
+const CliFunc CliInterpreter::no_spanning_tree_priority = [](StrVec, std::ostream &) {
+    shmem->rstp.set_bridge_priority(Rstp::DEFAULT_BRIDGE_PRIORITY);
+    return OK;
+};
+
+const CliFunc CliInterpreter::intf_spanning_tree_cost = [](StrVec args, std::ostream &out) {
+    int intf = shmem->ports.find(args[0]);
+    if(intf == -1) {
+	out << "The interface " << args[0] << " does not exist." << std::endl;
+	return FAILED;
+    }
+
+    int cost = to_int(args[1]);
+    if(cost < 1 || !shmem->rstp.set_port_cost(intf, cost)) {
+	out << "Cannot set the path cost of " << args[0] << " to " << args[1] << ". It must be "
+	    "between 1 and 200000000." << std::endl;
+	return FAILED;
+    }
+    return OK;
+};
+
+const CliFunc CliInterpreter::intf_spanning_tree_priority = [](StrVec args, std::ostream &out) {
+    int intf = shmem->ports.find(args[0]);
+    if(intf == -1) {
+	out << "The interface " << args[0] << " does not exist." << std::endl;
+	return FAILED;
+    }
+
+    if(!shmem->rstp.set_port_priority(intf, to_int(args[1]))) {
+	out << "Cannot set the port priority of " << args[0] << " to " << args[1] << ". It must "
+	    "be a multiple of 16 between 0 and 240." << std::endl;
+	return FAILED;
+    }
+    return OK;
+};
+
+/*
+ * intf_spanning_tree_reset_with() - Creates the CLI function for "no {intf} spanning-tree cost" or
+ * "no {intf} spanning-tree priority", which return the setting to its default.
+ */
+CliFunc CliInterpreter::intf_spanning_tree_reset_with(token setting) {
+    return [setting](StrVec args, std::ostream &out) {
+	int intf = shmem->ports.find(args[0]);
+	if(intf == -1) {
+	    out << "The interface " << args[0] << " does not exist." << std::endl;
+	    return FAILED;
+	}
+
+	if(setting == COST) {
+	    shmem->rstp.set_port_cost(intf, 0);
+	} else {
+	    shmem->rstp.set_port_priority(intf, Rstp::DEFAULT_PORT_PRIORITY);
+	}
+	return OK;
+    };
+}
+
+/*
+ * intf_spanning_tree_edge_with() - Creates the CLI function for "{intf} spanning-tree edge" or
+ * "no {intf} spanning-tree edge".
+ */
+CliFunc CliInterpreter::intf_spanning_tree_edge_with(bool edge) {
+    return [edge](StrVec args, std::ostream &out) {
+	int intf = shmem->ports.find(args[0]);
+	if(intf == -1) {
+	    out << "The interface " << args[0] << " does not exist." << std::endl;
+	    return FAILED;
+	}
+
+	shmem->rstp.set_edge(intf, edge);
+	return OK;
+    };
+}
+
+const CliFunc CliInterpreter::show_spanning_tree = [](StrVec, std::ostream &out) {
+    shmem->rstp.print_spanning_tree(out, shmem->ports.snapshot());
+    return OK;
+};
+
+const CliFunc CliInterpreter::intf_channel_group = [](StrVec args, std::ostream &out) {
+    int intf = shmem->ports.find(args[0]);
+    if(intf == -1) {
+	out << "The interface " << args[0] << " does not exist." << std::endl;
+	return FAILED;
+    }
+
+    if(!shmem->lags.add_member(to_int(args[1]), intf)) {
+	out << "Cannot add " << args[0] << " to channel group " << args[1] << ". Groups must be "
+	    "between 1 and " << LinkAggregation::MAX_GROUPS << ", and may have at most "
+	    << LinkAggregation::MAX_MEMBERS << " members." << std::endl;
+	return FAILED;
+    }
+    return OK;
+};
+
+const CliFunc CliInterpreter::no_intf_channel_group = [](StrVec args, std::ostream &out) {
+    int intf = shmem->ports.find(args[0]);
+    if(intf == -1) {
+	out << "The interface " << args[0] << " does not exist." << std::endl;
+	return FAILED;
+    }
+
+    shmem->lags.remove_member(intf);
+    return OK;
+};
+
+/*
+ * port_channel_load_balance_with() - Creates the CLI function for "port-channel load-balance
+ * {src-dst-mac|src-dst-ip|src-dst-port}".
+ */
+CliFunc CliInterpreter::port_channel_load_balance_with(LinkAggregation::hash_fields fields) {
+    return [fields](StrVec, std::ostream &) {
+	shmem->lags.set_hash_fields(fields);
+	return OK;
+    };
+}
+
+const CliFunc CliInterpreter::show_port_channel = [](StrVec, std::ostream &out) {
+    shmem->lags.print_groups(out, shmem->ports);
+    return OK;
+};
+
+/*
+ * access_list_rule_with() - Creates the CLI function for "access-list {name} {seq} permit" or
+ * "access-list {name} {seq} deny", which adds the rule if it is new, or changes its action.
+ */
+CliFunc CliInterpreter::access_list_rule_with(AccessLists::action act) {
+    return [act](StrVec args, std::ostream &out) {
+	int seq = to_int(args[1]);
+	if(seq < 1) {
+	    out << "Cannot add rule " << args[1] << " to access list " << args[0] << ". Sequence "
+		"numbers must be between 1 and " << INT_MAX << "." << std::endl;
+	    return FAILED;
+	}
+
+	shmem->acls.set_rule(args[0], seq, act);
+	return OK;
+    };
+}
+
+/*
+ * access_list_match_with() - Creates the CLI function for "access-list {name} {seq} match {field}
+ * {value}", or with reset set, "no access-list {name} {seq} match {field}".
+ */
+CliFunc CliInterpreter::access_list_match_with(AccessLists::match_field field, bool reset) {
+    return [field, reset](StrVec args, std::ostream &out) {
+	int seq = to_int(args[1]);
+	if(reset) {
+	    if(!shmem->acls.reset_match(args[0], seq, field)) {
+		out << "Rule " << args[1] << " of access list " << args[0] << " does not exist."
+		    << std::endl;
+		return FAILED;
+	    }
+	    return OK;
+	}
+
+	if(!shmem->acls.set_match(args[0], seq, field, args[2])) {
+	    out << "Cannot match " << args[2] << " in rule " << args[1] << " of access list "
+		<< args[0] << ". The rule must exist, and the value must be valid for the field."
+		<< std::endl;
+	    return FAILED;
+	}
+	return OK;
+    };
+}
+
+const CliFunc CliInterpreter::no_access_list_rule = [](StrVec args, std::ostream &out) {
+    if(!shmem->acls.remove_rule(args[0], to_int(args[1]))) {
+	out << "Rule " << args[1] << " of access list " << args[0] << " does not exist."
+	    << std::endl;
+	return FAILED;
+    }
+    return OK;
+};
+
+const CliFunc CliInterpreter::no_access_list = [](StrVec args, std::ostream &out) {
+    if(!shmem->acls.remove_acl(args[0])) {
+	out << "The access list " << args[0] << " does not exist." << std::endl;
+	return FAILED;
+    }
+    return OK;
+};
+
+const CliFunc CliInterpreter::intf_access_group = [](StrVec args, std::ostream &out) {
+    int intf = shmem->ports.find(args[0]);
+    if(intf == -1) {
+	out << "The interface " << args[0] << " does not exist." << std::endl;
+	return FAILED;
+    }
+
+    shmem->acls.apply_intf(intf, args[1]);
+    return OK;
+};
+
+const CliFunc CliInterpreter::no_intf_access_group = [](StrVec args, std::ostream &out) {
+    int intf = shmem->ports.find(args[0]);
+    if(intf == -1) {
+	out << "The interface " << args[0] << " does not exist." << std::endl;
+	return FAILED;
+    }
+
+    shmem->acls.apply_intf(intf, "");
+    return OK;
+};
+
+const CliFunc CliInterpreter::vlan_access_group = [](StrVec args, std::ostream &out) {
+    if(!shmem->acls.apply_vlan(to_int(args[0]), args[1])) {
+	out << "Cannot apply an access list to VLAN " << args[0] << ". VLANs must be greater "
+	    "than 0 and smaller than 4095." << std::endl;
+	return FAILED;
+    }
+    return OK;
+};
+
+const CliFunc CliInterpreter::no_vlan_access_group = [](StrVec args, std::ostream &out) {
+    if(!shmem->acls.apply_vlan(to_int(args[0]), "")) {
+	out << "VLAN " << args[0] << " does not exist." << std::endl;
+	return FAILED;
+    }
+    return OK;
+};
+
+const CliFunc CliInterpreter::show_access_lists = [](StrVec, std::ostream &out) {
+    shmem->acls.print_acls(out, shmem->ports.snapshot());
+    return OK;
+};
+
+/*
+ * monitor_source_with() - Creates the CLI function for "monitor session {uint} source interface
+ * {intf} {rx|tx|both}", or with vlan set, "monitor session {uint} source vlan {uint} {rx|tx|both}".
+ */
+CliFunc CliInterpreter::monitor_source_with(PortMirror::direction dir, bool vlan) {
+    return [dir, vlan](StrVec args, std::ostream &out) {
+	if(vlan) {
+	    if(!shmem->mirror.add_source_vlan(to_int(args[0]), to_int(args[1]), dir)) {
+		out << "Cannot mirror VLAN " << args[1] << " in session " << args[0]
+		    << ". Sessions must be between 1 and " << PortMirror::MAX_SESSIONS
+		    << ", and VLANs between 1 and " << PortMirror::MAX_VLAN << "." << std::endl;
+		return FAILED;
+	    }
+	    return OK;
+	}
+
+	int intf = shmem->ports.find(args[1]);
+	if(intf == -1) {
+	    out << "The interface " << args[1] << " does not exist." << std::endl;
+	    return FAILED;
+	}
+
+	if(!shmem->mirror.add_source_intf(to_int(args[0]), intf, dir)) {
+	    out << "Cannot mirror " << args[1] << " in session " << args[0] << ". Sessions must be "
+		"between 1 and " << PortMirror::MAX_SESSIONS << "." << std::endl;
+	    return FAILED;
+	}
+	return OK;
+    };
+}
+
+/*
+ * no_monitor_source_with() - Creates the CLI function for "no monitor session {uint} source
+ * interface {intf}", or with vlan set, "no monitor session {uint} source vlan {uint}".
+ */
+CliFunc CliInterpreter::no_monitor_source_with(bool vlan) {
+    return [vlan](StrVec args, std::ostream &out) {
+	bool removed;
+	if(vlan) {
+	    removed = shmem->mirror.remove_source_vlan(to_int(args[0]), to_int(args[1]));
+	} else {
+	    int intf = shmem->ports.find(args[1]);
+	    removed = intf != -1 && shmem->mirror.remove_source_intf(to_int(args[0]), intf);
+	}
+
+	if(!removed) {
+	    out << (vlan ? "VLAN " : "") << args[1] << " is not a source of session " << args[0]
+		<< "." << std::endl;
+	    return FAILED;
+	}
+	return OK;
+    };
+}
+
+const CliFunc CliInterpreter::monitor_destination = [](StrVec args, std::ostream &out) {
+    int intf = shmem->ports.find(args[1]);
+    if(intf == -1) {
+	out << "The interface " << args[1] << " does not exist." << std::endl;
+	return FAILED;
+    }
+
+    if(!shmem->mirror.set_destination(to_int(args[0]), intf)) {
+	out << "Cannot mirror session " << args[0] << " to " << args[1] << ". Sessions must be "
+	    "between 1 and " << PortMirror::MAX_SESSIONS << "." << std::endl;
+	return FAILED;
+    }
+    return OK;
+};
+
+const CliFunc CliInterpreter::no_monitor_destination = [](StrVec args, std::ostream &out) {
+    if(!shmem->mirror.set_destination(to_int(args[0]), -1)) {
+	out << "Monitor session " << args[0] << " does not exist." << std::endl;
+	return FAILED;
+    }
+    return OK;
+};
+
+/*
+ * monitor_setting_with() - Creates the CLI function for "monitor session {uint} truncate {uint}" or
+ * "monitor session {uint} sample {uint}", or with reset set, the "no" form which returns the
+ * setting to its default of mirroring whole frames, or every frame.
+ */
+CliFunc CliInterpreter::monitor_setting_with(token setting, bool reset) {
+    return [setting, reset](StrVec args, std::ostream &out) {
+	int session = to_int(args[0]);
+	if(setting == TRUNCATE) {
+	    if(!shmem->mirror.set_truncate(session, reset ? 0 : to_int(args[1]))) {
+		out << "Cannot truncate session " << args[0] << "'s copies to " << args[1]
+		    << " bytes. Sessions must be between 1 and " << PortMirror::MAX_SESSIONS
+		    << ", and lengths between " << PortMirror::MIN_TRUNCATE << " and "
+		    << PortMirror::MAX_TRUNCATE << "." << std::endl;
+		return FAILED;
+	    }
+	} else if(!shmem->mirror.set_sample(session, reset ? 1 : to_int(args[1]))) {
+	    out << "Cannot sample 1 in " << args[1] << " frames in session " << args[0]
+		<< ". Sessions must be between 1 and " << PortMirror::MAX_SESSIONS
+		<< ", and rates between 1 and " << PortMirror::MAX_SAMPLE << "." << std::endl;
+	    return FAILED;
+	}
+	return OK;
+    };
+}
+
+const CliFunc CliInterpreter::no_monitor_session = [](StrVec args, std::ostream &out) {
+    if(!shmem->mirror.remove_session(to_int(args[0]))) {
+	out << "Monitor session " << args[0] << " does not exist." << std::endl;
+	return FAILED;
     }
+    return OK;
 };
 
-const CliFunc CliInterpreter::show_mac_addrtbl_agetime = [](StrVec) {
-    std::cout << "Global Aging Time: " << shmem->mac_tbl.get_max_age() << std::endl;
+const CliFunc CliInterpreter::show_monitor = [](StrVec, std::ostream &out) {
+    shmem->mirror.print_sessions(out);
+    return OK;
 };
 
 // CLI token to function mapping
 const std::vector<std::pair<TokenVec, CliFunc>> CliInterpreter::commands = {
     {{SHOW, MAC, ADDR_TBL}, show_mac_addrtbl},
+    {{SHOW, MAC, ADDR_TBL, COUNT_ONLY}, show_mac_addrtbl_with(ALL_MACS, COUNT_MACS)},
+    {{SHOW, MAC, ADDR_TBL, PAGE, UINT}, show_mac_addrtbl_with(ALL_MACS, PAGED)},
+    {{SHOW, MAC, ADDR_TBL, VLAN, UINT}, show_mac_addrtbl_with(BY_VLAN, LIST)},
+    {{SHOW, MAC, ADDR_TBL, VLAN, UINT, COUNT_ONLY}, show_mac_addrtbl_with(BY_VLAN, COUNT_MACS)},
+    {{SHOW, MAC, ADDR_TBL, VLAN, UINT, PAGE, UINT}, show_mac_addrtbl_with(BY_VLAN, PAGED)},
+    {{SHOW, MAC, ADDR_TBL, INTF_ONE, NAME}, show_mac_addrtbl_with(BY_INTF, LIST)},
+    {{SHOW, MAC, ADDR_TBL, INTF_ONE, NAME, COUNT_ONLY}, show_mac_addrtbl_with(BY_INTF, COUNT_MACS)},
+    {{SHOW, MAC, ADDR_TBL, INTF_ONE, NAME, PAGE, UINT}, show_mac_addrtbl_with(BY_INTF, PAGED)},
+    {{SHOW, MAC, ADDR_TBL, ADDRESS, MAC_ADDR}, show_mac_addrtbl_with(BY_ADDR, LIST)},
     {{SHOW, INTF}, show_interfaces},
     {{SHOW, VLAN}, show_vlan},
     {{VLAN, UINT}, vlan_add},
@@ -112,7 +973,233 @@ const std::vector<std::pair<TokenVec, CliFunc>> CliInterpreter::commands = {
     {{SHOW, INTF, COUNT}, show_intf_counters},
     {{CLEAR, COUNT}, clear_counters},
     {{MAC, ADDR_TBL, AGE_TIME, UINT}, mac_addrtbl_agetime},
-    {{SHOW, MAC, ADDR_TBL, AGE_TIME}, show_mac_addrtbl_agetime}
+    {{SHOW, MAC, ADDR_TBL, AGE_TIME}, show_mac_addrtbl_agetime},
+    {{SHOW, RUN_CFG}, show_running_config},
+    {{WRITE, MEMORY}, write_memory},
+    {{SHOW, INTF, CAPTURE}, show_intf_capture},
+    {{CAPTURE, BUF_SIZE, UINT},
+     capture_setting_with(CaptureSettings::BUFFER_SIZE, SET_VALUE, false)},
+    {{CAPTURE, SNAPLEN, UINT},
+     capture_setting_with(CaptureSettings::SNAPLEN, SET_VALUE, false)},
+    {{CAPTURE, TIMEOUT, UINT},
+     capture_setting_with(CaptureSettings::TIMEOUT, SET_VALUE, false)},
+    {{CAPTURE, IMMEDIATE},
+     capture_setting_with(CaptureSettings::IMMEDIATE, ENABLE, false)},
+    {{CAPTURE, PROMISC},
+     capture_setting_with(CaptureSettings::PROMISC, ENABLE, false)},
+    {{NO, CAPTURE, BUF_SIZE},
+     capture_setting_with(CaptureSettings::BUFFER_SIZE, RESET, false)},
+    {{NO, CAPTURE, SNAPLEN},
+     capture_setting_with(CaptureSettings::SNAPLEN, RESET, false)},
+    {{NO, CAPTURE, TIMEOUT},
+     capture_setting_with(CaptureSettings::TIMEOUT, RESET, false)},
+    {{NO, CAPTURE, IMMEDIATE},
+     capture_setting_with(CaptureSettings::IMMEDIATE, DISABLE, false)},
+    {{NO, CAPTURE, PROMISC},
+     capture_setting_with(CaptureSettings::PROMISC, DISABLE, false)},
+    {{NAME, CAPTURE, BUF_SIZE, UINT},
+     capture_setting_with(CaptureSettings::BUFFER_SIZE, SET_VALUE, true)},
+    {{NAME, CAPTURE, SNAPLEN, UINT},
+     capture_setting_with(CaptureSettings::SNAPLEN, SET_VALUE, true)},
+    {{NAME, CAPTURE, TIMEOUT, UINT},
+     capture_setting_with(CaptureSettings::TIMEOUT, SET_VALUE, true)},
+    {{NAME, CAPTURE, IMMEDIATE},
+     capture_setting_with(CaptureSettings::IMMEDIATE, ENABLE, true)},
+    {{NAME, CAPTURE, PROMISC},
+     capture_setting_with(CaptureSettings::PROMISC, ENABLE, true)},
+    {{NO, NAME, CAPTURE, BUF_SIZE},
+     capture_setting_with(CaptureSettings::BUFFER_SIZE, RESET, true)},
+    {{NO, NAME, CAPTURE, SNAPLEN},
+     capture_setting_with(CaptureSettings::SNAPLEN, RESET, true)},
+    {{NO, NAME, CAPTURE, TIMEOUT},
+     capture_setting_with(CaptureSettings::TIMEOUT, RESET, true)},
+    {{NO, NAME, CAPTURE, IMMEDIATE},
+     capture_setting_with(CaptureSettings::IMMEDIATE, DISABLE, true)},
+    {{NO, NAME, CAPTURE, PROMISC},
+     capture_setting_with(CaptureSettings::PROMISC, DISABLE, true)},
+    {{CAPTURE, INTF_ONE, NAME, PCAP_FILE, FILE_PATH}, capture_file_with(false, false)},
+    {{CAPTURE, INTF_ONE, NAME, PCAP_FILE, FILE_PATH, COUNT_ONLY, UINT},
+     capture_file_with(true, false)},
+    {{CAPTURE, INTF_ONE, NAME, PCAP_FILE, FILE_PATH, SNAPLEN, UINT},
+     capture_file_with(false, true)},
+    {{CAPTURE, INTF_ONE, NAME, PCAP_FILE, FILE_PATH, COUNT_ONLY, UINT, SNAPLEN, UINT},
+     capture_file_with(true, true)},
+    {{NO, CAPTURE, INTF_ONE, NAME}, no_capture_file},
+    {{SHOW, CAPTURE}, show_capture},
+    {{THREAD, CAPTURE, CPUS, UINT},
+     thread_cpus_with(ThreadPlacement::CAPTURE, false)},
+    {{THREAD, CAPTURE, CPUS, CPU_LIST},
+     thread_cpus_with(ThreadPlacement::CAPTURE, false)},
+    {{NO, THREAD, CAPTURE, CPUS},
+     thread_cpus_with(ThreadPlacement::CAPTURE, true)},
+    {{THREAD, CAPTURE, PRIORITY, UINT},
+     thread_priority_with(ThreadPlacement::CAPTURE, false)},
+    {{NO, THREAD, CAPTURE, PRIORITY},
+     thread_priority_with(ThreadPlacement::CAPTURE, true)},
+    {{THREAD, FORWARDING, CPUS, UINT},
+     thread_cpus_with(ThreadPlacement::FORWARDING, false)},
+    {{THREAD, FORWARDING, CPUS, CPU_LIST},
+     thread_cpus_with(ThreadPlacement::FORWARDING, false)},
+    {{NO, THREAD, FORWARDING, CPUS},
+     thread_cpus_with(ThreadPlacement::FORWARDING, true)},
+    {{THREAD, FORWARDING, PRIORITY, UINT},
+     thread_priority_with(ThreadPlacement::FORWARDING, false)},
+    {{NO, THREAD, FORWARDING, PRIORITY},
+     thread_priority_with(ThreadPlacement::FORWARDING, true)},
+    {{THREAD, EGRESS, CPUS, UINT},
+     thread_cpus_with(ThreadPlacement::EGRESS, false)},
+    {{THREAD, EGRESS, CPUS, CPU_LIST},
+     thread_cpus_with(ThreadPlacement::EGRESS, false)},
+    {{NO, THREAD, EGRESS, CPUS},
+     thread_cpus_with(ThreadPlacement::EGRESS, true)},
+    {{THREAD, EGRESS, PRIORITY, UINT},
+     thread_priority_with(ThreadPlacement::EGRESS, false)},
+    {{NO, THREAD, EGRESS, PRIORITY},
+     thread_priority_with(ThreadPlacement::EGRESS, true)},
+    {{THREAD, HOUSEKEEPING, CPUS, UINT},
+     thread_cpus_with(ThreadPlacement::HOUSEKEEPING, false)},
+    {{THREAD, HOUSEKEEPING, CPUS, CPU_LIST},
+     thread_cpus_with(ThreadPlacement::HOUSEKEEPING, false)},
+    {{NO, THREAD, HOUSEKEEPING, CPUS},
+     thread_cpus_with(ThreadPlacement::HOUSEKEEPING, true)},
+    {{THREAD, HOUSEKEEPING, PRIORITY, UINT},
+     thread_priority_with(ThreadPlacement::HOUSEKEEPING, false)},
+    {{NO, THREAD, HOUSEKEEPING, PRIORITY},
+     thread_priority_with(ThreadPlacement::HOUSEKEEPING, true)},
+    {{MEMORY, LOCK}, memory_lock},
+    {{NO, MEMORY, LOCK}, no_memory_lock},
+    {{SHOW, THREADS}, show_threads},
+    {{QUEUE, WAIT, BUSY_POLL}, queue_wait_with(PacketQueue::BUSY_POLL)},
+    {{QUEUE, WAIT, ADAPTIVE}, queue_wait_with(PacketQueue::ADAPTIVE)},
+    {{QUEUE, WAIT, BLOCK}, queue_wait_with(PacketQueue::BLOCK)},
+    {{SHOW, QUEUE}, show_queue},
+    {{QOS, PRIORITY, UINT, QUEUE, UINT}, qos_priority_queue},
+    {{NO, QOS, PRIORITY, UINT}, no_qos_priority_queue},
+    {{QOS, QUEUE, UINT, STRICT}, qos_queue_strict},
+    {{QOS, QUEUE, UINT, WEIGHT, UINT}, qos_queue_weight},
+    {{NO, QOS, QUEUE, UINT}, no_qos_queue},
+    {{NAME, QOS, PRIORITY, UINT}, intf_qos_priority},
+    {{NO, NAME, QOS, PRIORITY}, no_intf_qos_priority},
+    {{SHOW, QOS}, show_qos},
+    {{SHOW, INTF, QUEUES}, show_intf_queues},
+    {{NAME, POLICE, RATE, UINT, PPS, BURST, UINT}, police_with(Policers::PPS, false)},
+    {{NAME, POLICE, RATE, UINT, BPS, BURST, UINT}, police_with(Policers::BPS, false)},
+    {{NAME, POLICE, RATE, UINT, PPS, BURST, UINT, PEAK_RATE, UINT, BURST, UINT},
+     police_with(Policers::PPS, true)},
+    {{NAME, POLICE, RATE, UINT, BPS, BURST, UINT, PEAK_RATE, UINT, BURST, UINT},
+     police_with(Policers::BPS, true)},
+    {{NO, NAME, POLICE}, no_police},
+    {{SHOW, INTF, POLICERS}, show_intf_policers},
+    {{NAME, STORM_CONTROL, BROADCAST, LEVEL, UINT},
+     storm_control_with(StormControl::BROADCAST, StormControl::PERCENT)},
+    {{NAME, STORM_CONTROL, BROADCAST, LEVEL, PPS, UINT},
+     storm_control_with(StormControl::BROADCAST, StormControl::PPS)},
+    {{NO, NAME, STORM_CONTROL, BROADCAST},
+     storm_control_with(StormControl::BROADCAST, StormControl::NONE)},
+    {{NAME, STORM_CONTROL, MULTICAST, LEVEL, UINT},
+     storm_control_with(StormControl::MULTICAST, StormControl::PERCENT)},
+    {{NAME, STORM_CONTROL, MULTICAST, LEVEL, PPS, UINT},
+     storm_control_with(StormControl::MULTICAST, StormControl::PPS)},
+    {{NO, NAME, STORM_CONTROL, MULTICAST},
+     storm_control_with(StormControl::MULTICAST, StormControl::NONE)},
+    {{NAME, STORM_CONTROL, UNKNOWN_UNICAST, LEVEL, UINT},
+     storm_control_with(StormControl::UNKNOWN_UNICAST, StormControl::PERCENT)},
+    {{NAME, STORM_CONTROL, UNKNOWN_UNICAST, LEVEL, PPS, UINT},
+     storm_control_with(StormControl::UNKNOWN_UNICAST, StormControl::PPS)},
+    {{NO, NAME, STORM_CONTROL, UNKNOWN_UNICAST},
+     storm_control_with(StormControl::UNKNOWN_UNICAST, StormControl::NONE)},
+    {{SHOW, INTF, STORM_CONTROL}, show_intf_storm_control},
+    {{MULTICAST, SNOOPING}, multicast_snooping_with(true)},
+    {{NO, MULTICAST, SNOOPING}, multicast_snooping_with(false)},
+    {{SHOW, MULTICAST, GROUPS}, show_multicast_groups},
+    {{SHOW, MULTICAST, ROUTERS}, show_multicast_routers},
+    {{SPANNING_TREE}, spanning_tree_with(true)},
+    {{NO, SPANNING_TREE}, spanning_tree_with(false)},
+    {{SPANNING_TREE, PRIORITY, UINT}, spanning_tree_priority},
+    {{NO, SPANNING_TREE, PRIORITY}, no_spanning_tree_priority},
+    {{NAME, SPANNING_TREE, COST, UINT}, intf_spanning_tree_cost},
+    {{NO, NAME, SPANNING_TREE, COST}, intf_spanning_tree_reset_with(COST)},
+    {{NAME, SPANNING_TREE, PRIORITY, UINT}, intf_spanning_tree_priority},
+    {{NO, NAME, SPANNING_TREE, PRIORITY}, intf_spanning_tree_reset_with(PRIORITY)},
+    {{NAME, SPANNING_TREE, EDGE}, intf_spanning_tree_edge_with(true)},
+    {{NO, NAME, SPANNING_TREE, EDGE}, intf_spanning_tree_edge_with(false)},
+    {{SHOW, SPANNING_TREE}, show_spanning_tree},
+    {{NAME, CHANNEL_GROUP, UINT}, intf_channel_group},
+    {{NO, NAME, CHANNEL_GROUP}, no_intf_channel_group},
+    {{PORT_CHANNEL, LOAD_BALANCE, SRC_DST_MAC},
+     port_channel_load_balance_with(LinkAggregation::SRC_DST_MAC)},
+    {{PORT_CHANNEL, LOAD_BALANCE, SRC_DST_IP},
+     port_channel_load_balance_with(LinkAggregation::SRC_DST_IP)},
+    {{PORT_CHANNEL, LOAD_BALANCE, SRC_DST_PORT},
+     port_channel_load_balance_with(LinkAggregation::SRC_DST_PORT)},
+    {{SHOW, PORT_CHANNEL}, show_port_channel},
+    {{ACCESS_LIST, NAME, UINT, PERMIT}, access_list_rule_with(AccessLists::PERMIT)},
+    {{ACCESS_LIST, NAME, UINT, DENY}, access_list_rule_with(AccessLists::DENY)},
+    {{ACCESS_LIST, NAME, UINT, MATCH, SRC_MAC, MAC_ADDR},
+     access_list_match_with(AccessLists::SRC_MAC, false)},
+    {{ACCESS_LIST, NAME, UINT, MATCH, DST_MAC, MAC_ADDR},
+     access_list_match_with(AccessLists::DST_MAC, false)},
+    {{ACCESS_LIST, NAME, UINT, MATCH, ETHERTYPE, UINT},
+     access_list_match_with(AccessLists::ETHER_TYPE, false)},
+    {{ACCESS_LIST, NAME, UINT, MATCH, ETHERTYPE, HEX_UINT},
+     access_list_match_with(AccessLists::ETHER_TYPE, false)},
+    {{ACCESS_LIST, NAME, UINT, MATCH, VLAN, UINT},
+     access_list_match_with(AccessLists::VLAN_ID, false)},
+    {{ACCESS_LIST, NAME, UINT, MATCH, SRC_IP, IP_PREFIX},
+     access_list_match_with(AccessLists::SRC_IP, false)},
+    {{ACCESS_LIST, NAME, UINT, MATCH, DST_IP, IP_PREFIX},
+     access_list_match_with(AccessLists::DST_IP, false)},
+    {{ACCESS_LIST, NAME, UINT, MATCH, PROTOCOL, UINT},
+     access_list_match_with(AccessLists::PROTOCOL, false)},
+    {{ACCESS_LIST, NAME, UINT, MATCH, SRC_PORT, UINT},
+     access_list_match_with(AccessLists::SRC_PORT, false)},
+    {{ACCESS_LIST, NAME, UINT, MATCH, DST_PORT, UINT},
+     access_list_match_with(AccessLists::DST_PORT, false)},
+    {{NO, ACCESS_LIST, NAME, UINT, MATCH, SRC_MAC},
+     access_list_match_with(AccessLists::SRC_MAC, true)},
+    {{NO, ACCESS_LIST, NAME, UINT, MATCH, DST_MAC},
+     access_list_match_with(AccessLists::DST_MAC, true)},
+    {{NO, ACCESS_LIST, NAME, UINT, MATCH, ETHERTYPE},
+     access_list_match_with(AccessLists::ETHER_TYPE, true)},
+    {{NO, ACCESS_LIST, NAME, UINT, MATCH, VLAN},
+     access_list_match_with(AccessLists::VLAN_ID, true)},
+    {{NO, ACCESS_LIST, NAME, UINT, MATCH, SRC_IP},
+     access_list_match_with(AccessLists::SRC_IP, true)},
+    {{NO, ACCESS_LIST, NAME, UINT, MATCH, DST_IP},
+     access_list_match_with(AccessLists::DST_IP, true)},
+    {{NO, ACCESS_LIST, NAME, UINT, MATCH, PROTOCOL},
+     access_list_match_with(AccessLists::PROTOCOL, true)},
+    {{NO, ACCESS_LIST, NAME, UINT, MATCH, SRC_PORT},
+     access_list_match_with(AccessLists::SRC_PORT, true)},
+    {{NO, ACCESS_LIST, NAME, UINT, MATCH, DST_PORT},
+     access_list_match_with(AccessLists::DST_PORT, true)},
+    {{NO, ACCESS_LIST, NAME, UINT}, no_access_list_rule},
+    {{NO, ACCESS_LIST, NAME}, no_access_list},
+    {{NAME, ACCESS_GROUP, NAME}, intf_access_group},
+    {{NO, NAME, ACCESS_GROUP}, no_intf_access_group},
+    {{VLAN, UINT, ACCESS_GROUP, NAME}, vlan_access_group},
+    {{NO, VLAN, UINT, ACCESS_GROUP}, no_vlan_access_group},
+    {{SHOW, ACCESS_LISTS}, show_access_lists},
+    {{MONITOR, SESSION, UINT, SOURCE, INTF_ONE, NAME, RX},
+     monitor_source_with(PortMirror::RX, false)},
+    {{MONITOR, SESSION, UINT, SOURCE, INTF_ONE, NAME, TX},
+     monitor_source_with(PortMirror::TX, false)},
+    {{MONITOR, SESSION, UINT, SOURCE, INTF_ONE, NAME, BOTH},
+     monitor_source_with(PortMirror::BOTH, false)},
+    {{MONITOR, SESSION, UINT, SOURCE, VLAN, UINT, RX}, monitor_source_with(PortMirror::RX, true)},
+    {{MONITOR, SESSION, UINT, SOURCE, VLAN, UINT, TX}, monitor_source_with(PortMirror::TX, true)},
+    {{MONITOR, SESSION, UINT, SOURCE, VLAN, UINT, BOTH},
+     monitor_source_with(PortMirror::BOTH, true)},
+    {{NO, MONITOR, SESSION, UINT, SOURCE, INTF_ONE, NAME}, no_monitor_source_with(false)},
+    {{NO, MONITOR, SESSION, UINT, SOURCE, VLAN, UINT}, no_monitor_source_with(true)},
+    {{MONITOR, SESSION, UINT, DESTINATION, INTF_ONE, NAME}, monitor_destination},
+    {{NO, MONITOR, SESSION, UINT, DESTINATION}, no_monitor_destination},
+    {{MONITOR, SESSION, UINT, TRUNCATE, UINT}, monitor_setting_with(TRUNCATE, false)},
+    {{NO, MONITOR, SESSION, UINT, TRUNCATE}, monitor_setting_with(TRUNCATE, true)},
+    {{MONITOR, SESSION, UINT, SAMPLE, UINT}, monitor_setting_with(SAMPLE, false)},
+    {{NO, MONITOR, SESSION, UINT, SAMPLE}, monitor_setting_with(SAMPLE, true)},
+    {{NO, MONITOR, SESSION, UINT}, no_monitor_session},
+    {{SHOW, MONITOR}, show_monitor}
 };
 
 CliInterpreter::CliInterpreter(VswitchShmem *shmem) : root(ROOT) {
@@ -127,7 +1214,136 @@ CliInterpreter::CliInterpreter(VswitchShmem *shmem) : root(ROOT) {
     return;
 }
 
-int CliInterpreter::interpret(TokenVec tokens, StrVec args) {
+void CliInterpreter::write_running_config(std::ostream &out) {
+    shmem->mac_tbl.write_config(out);
+    shmem->vlans.write_config(out, shmem->ports.snapshot());
+    shmem->capture.write_config(out);
+    shmem->placement.write_config(out);
+    shmem->packet_queue.write_config(out);
+    shmem->egress_queues.write_config(out, shmem->ports.snapshot());
+    shmem->policers.write_config(out, shmem->ports.snapshot());
+    shmem->storm_ctl.write_config(out, shmem->ports.snapshot());
+    shmem->snooping.write_config(out);
+    shmem->rstp.write_config(out, shmem->ports.snapshot());
+    shmem->lags.write_config(out, shmem->ports.snapshot());
+    shmem->acls.write_config(out, shmem->ports.snapshot());
+    shmem->mirror.write_config(out);
+}
+
+int CliInterpreter::interpret(TokenVec tokens, StrVec args, std::ostream &out) {
+    auto cmd_node = find_cmd(tokens);
+    if(cmd_node == nullptr) {
+	return BAD_CMD;
+    }
+
+    return cmd_node->func(args, out);
+}
+
+int CliInterpreter::interpret_line(const std::string &line, std::ostream &out) {
+    TokenVec tokens;
+    StrVec args;
+    if(!tokenize(line, tokens, args)) {
+	return BAD_CMD;
+    }
+
+    return interpret(tokens, args, out);
+}
+
+/*
+ * has_arg() - Returns whether the token's literal text is passed to CLI functions as an argument.
+ */
+bool CliInterpreter::has_arg(token tkn) {
+    return tkn == NAME || tkn == UINT || tkn == MAC_ADDR || tkn == CPU_LIST || tkn == IP_PREFIX ||
+	tkn == HEX_UINT || tkn == FILE_PATH;
+}
+
+bool CliInterpreter::is_valid(const std::string &line) {
+    TokenVec tokens;
+    StrVec args;
+    return tokenize(line, tokens, args) && find_cmd(tokens) != nullptr;
+}
+
+/*
+ * check_refs() - Checks, without running the command, that every interface, VLAN, and access list
+ * it needs exists, either now or once the earlier commands recorded in refs have run. Any VLAN or
+ * access list the command creates or removes is then recorded in refs. Returns false, with an
+ * explanation in out, if the command would fail for want of something it refers to.
+ */
+bool CliInterpreter::check_refs(const std::string &line, BatchRefs &refs, std::ostream &out) {
+    TokenVec tokens;
+    StrVec args;
+    if(!tokenize(line, tokens, args) || find_cmd(tokens) == nullptr) {
+	return false;
+    }
+
+    // Which argument each token carries, if any
+    std::vector<long unsigned> arg_of(tokens.size());
+    for(long unsigned i = 0, arg = 0; i < tokens.size(); i++) {
+	arg_of[i] = arg;
+	arg += has_arg(tokens[i]);
+    }
+
+    // Interfaces are named first, after "no", or after "interface". Capture settings are the
+    // exception, since they may be given for interfaces which are yet to be opened.
+    bool no = tokens[0] == NO;
+    for(long unsigned i = 0; i < tokens.size(); i++) {
+	bool first = i == static_cast<long unsigned>(no);
+	bool settings = first && i + 1 < tokens.size() && tokens[i + 1] == CAPTURE;
+	bool intf = (first && !settings) || (i > 0 && tokens[i - 1] == INTF_ONE);
+	if(tokens[i] == NAME && intf && shmem->ports.find(args[arg_of[i]]) == -1) {
+	    out << "The interface " << args[arg_of[i]] << " does not exist." << std::endl;
+	    return false;
+	}
+    }
+
+    // "vlan {uint}", "no vlan {uint}", and "{intf} vlan {uint}"
+    if(tokens.size() == 2u + no && tokens[no] == VLAN) {
+	refs.vlans[to_int(args[0])] = !no;
+    } else if(tokens.size() == 3 && tokens[0] == NAME && tokens[1] == VLAN) {
+	int vlan = to_int(args[1]);
+	auto found = refs.vlans.find(vlan);
+	if(!(found != refs.vlans.end() ? found->second : shmem->vlans.get_vlans().count(vlan))) {
+	    out << "VLAN " << args[1] << " does not exist." << std::endl;
+	    return false;
+	}
+    }
+
+    // Every access list command but adding a rule needs the list to exist. Removing a rule may
+    // remove the list along with it, which is left for the command itself to find out.
+    if(tokens[no] == ACCESS_LIST) {
+	const std::string &acl = args[0];
+	bool add_rule = !no && tokens.size() == 4 && (tokens[3] == PERMIT || tokens[3] == DENY);
+	auto found = refs.acls.find(acl);
+	if(!add_rule &&
+	   !(found != refs.acls.end() ? found->second : shmem->acls.has_acl(acl))) {
+	    out << "The access list " << acl << " does not exist." << std::endl;
+	    return false;
+	}
+
+	if(add_rule || (no && tokens.size() == 3)) {
+	    refs.acls[acl] = add_rule;
+	}
+    }
+    return true;
+}
+
+bool CliInterpreter::tokenize(const std::string &line, TokenVec &tokens, StrVec &args) {
+    std::istringstream in(line + "\n");
+    yyFlexLexer lexer(&in);
+    token tkn;
+
+    // The lexer returns 0 (ROOT) once it runs out of input.
+    while((tkn = static_cast<token>(lexer.yylex())) != NL && tkn != ROOT) {
+	tokens.push_back(tkn);
+	if(has_arg(tkn)) {
+	    args.push_back(std::string(lexer.YYText(), lexer.YYLeng()));
+	}
+    }
+
+    return tokens.size() > 0;
+}
+
+CliInterpreter::InterpreterTreeNode *CliInterpreter::find_cmd(const TokenVec &tokens) {
     long unsigned int i, j;
     auto cur_node = &root;
     for(i = 0; i < tokens.size(); i++) {
@@ -141,16 +1357,15 @@ int CliInterpreter::interpret(TokenVec tokens, StrVec args) {
 	}
 
 	if(found == false) {
-	    return -1;
+	    return nullptr;
 	}
     }
 
     if(cur_node->func == nullptr) {
-	return -1;
+	return nullptr;
     }
 
-    cur_node->func(args);
-    return 0;
+    return cur_node;
 }
 
 void CliInterpreter::add_cmd(InterpreterTreeNode &node,
@@ -6,15 +6,35 @@
 
 %{
 enum token {
-     ROOT, NL, EXIT, SHOW, MAC, ADDR_TBL, INTF, COUNT, NAME, UINT, VLAN, NO, CLEAR, AGE_TIME
+     ROOT, NL, EXIT, SHOW, MAC, ADDR_TBL, INTF, COUNT, NAME, UINT, VLAN, NO, CLEAR, AGE_TIME,
+     WRITE, MEMORY, RUN_CFG, INTF_ONE, ADDRESS, MAC_ADDR, COUNT_ONLY, PAGE, CAPTURE, BUF_SIZE,
+     SNAPLEN, TIMEOUT, IMMEDIATE, PROMISC, THREAD, THREADS, FORWARDING, EGRESS, HOUSEKEEPING,
+     CPUS, PRIORITY, LOCK, CPU_LIST, QUEUE, WAIT, BUSY_POLL, ADAPTIVE, BLOCK, QOS, STRICT, WEIGHT,
+     QUEUES, POLICE, RATE, BURST, PEAK_RATE, PPS, BPS, POLICERS, STORM_CONTROL, BROADCAST,
+     MULTICAST, UNKNOWN_UNICAST, LEVEL, SNOOPING, GROUPS, ROUTERS, SPANNING_TREE, COST, EDGE,
+     CHANNEL_GROUP, PORT_CHANNEL, LOAD_BALANCE, SRC_DST_MAC, SRC_DST_IP, SRC_DST_PORT,
+     ACCESS_LIST, ACCESS_LISTS, ACCESS_GROUP, PERMIT, DENY, MATCH, SRC_MAC, DST_MAC, ETHERTYPE,
+     SRC_IP, DST_IP, PROTOCOL, SRC_PORT, DST_PORT, IP_PREFIX, HEX_UINT, MONITOR, SESSION, SOURCE,
+     DESTINATION, RX, TX, BOTH, TRUNCATE, SAMPLE, PCAP_FILE, FILE_PATH
 };
 %}
 
 ws	[ \t]+
 alpha	[A-Za-z]
 digit	[0-9]
+hex	[0-9A-Fa-f]
+mac_addr	{hex}{2}(:{hex}{2}){5}
 uint	[0-9]+
-name	({alpha})({alpha}|{digit}|-)*
+hex_uint	0[xX]{hex}+
+ipv4	{uint}\.{uint}\.{uint}\.{uint}
+ipv6	({hex}{0,4}:){2,7}({hex}{0,4}|{ipv4})
+ip_prefix	({ipv4}|{ipv6})(\/{uint})?
+cpu_list	{uint}([-,]{uint})+
+name	({alpha})({alpha}|{digit}|[-_.])*
+path_char	[A-Za-z0-9_.~/-]
+
+/* A file path may only follow "file", so that it never takes the place of a name */
+%x PATH
 
 %%
 {ws}	        /* ignore whitespace */
@@ -29,7 +49,93 @@ vlan		{return VLAN;}
 no		{return NO;}
 clear		{return CLEAR;}
 aging-time	{return AGE_TIME;}
+write		{return WRITE;}
+memory		{return MEMORY;}
+running-config	{return RUN_CFG;}
+interface	{return INTF_ONE;}
+address		{return ADDRESS;}
+count		{return COUNT_ONLY;}
+page		{return PAGE;}
+capture		{return CAPTURE;}
+buffer-size	{return BUF_SIZE;}
+snaplen		{return SNAPLEN;}
+timeout		{return TIMEOUT;}
+immediate	{return IMMEDIATE;}
+promiscuous	{return PROMISC;}
+thread		{return THREAD;}
+threads		{return THREADS;}
+forwarding	{return FORWARDING;}
+egress		{return EGRESS;}
+housekeeping	{return HOUSEKEEPING;}
+cpus		{return CPUS;}
+priority	{return PRIORITY;}
+lock		{return LOCK;}
+queue		{return QUEUE;}
+wait		{return WAIT;}
+busy-poll	{return BUSY_POLL;}
+adaptive	{return ADAPTIVE;}
+block		{return BLOCK;}
+qos		{return QOS;}
+strict		{return STRICT;}
+weight		{return WEIGHT;}
+queues		{return QUEUES;}
+police		{return POLICE;}
+rate		{return RATE;}
+burst		{return BURST;}
+peak-rate	{return PEAK_RATE;}
+pps		{return PPS;}
+bps		{return BPS;}
+policers	{return POLICERS;}
+storm-control	{return STORM_CONTROL;}
+broadcast	{return BROADCAST;}
+multicast	{return MULTICAST;}
+unknown-unicast	{return UNKNOWN_UNICAST;}
+level		{return LEVEL;}
+snooping	{return SNOOPING;}
+groups		{return GROUPS;}
+routers		{return ROUTERS;}
+spanning-tree	{return SPANNING_TREE;}
+cost		{return COST;}
+edge		{return EDGE;}
+channel-group	{return CHANNEL_GROUP;}
+port-channel	{return PORT_CHANNEL;}
+load-balance	{return LOAD_BALANCE;}
+src-dst-mac	{return SRC_DST_MAC;}
+src-dst-ip	{return SRC_DST_IP;}
+src-dst-port	{return SRC_DST_PORT;}
+access-list	{return ACCESS_LIST;}
+access-lists	{return ACCESS_LISTS;}
+access-group	{return ACCESS_GROUP;}
+permit		{return PERMIT;}
+deny		{return DENY;}
+match		{return MATCH;}
+src-mac		{return SRC_MAC;}
+dst-mac		{return DST_MAC;}
+ethertype	{return ETHERTYPE;}
+src-ip		{return SRC_IP;}
+dst-ip		{return DST_IP;}
+protocol	{return PROTOCOL;}
+src-port	{return SRC_PORT;}
+dst-port	{return DST_PORT;}
+monitor		{return MONITOR;}
+session		{return SESSION;}
+source		{return SOURCE;}
+destination	{return DESTINATION;}
+rx		{return RX;}
+tx		{return TX;}
+both		{return BOTH;}
+truncate	{return TRUNCATE;}
+sample		{return SAMPLE;}
+file		{BEGIN(PATH); return PCAP_FILE;}
+<PATH>{ws}	/* ignore whitespace */
+<PATH>\n	{BEGIN(INITIAL); return NL;}
+<PATH>{path_char}+	{BEGIN(INITIAL); return FILE_PATH;}
+<PATH>.		/* ignore anything else */
+{mac_addr}	{return MAC_ADDR;}
+{ip_prefix}	{return IP_PREFIX;}
+{hex_uint}	{return HEX_UINT;}
 {name}		{return NAME;}
 {uint}		{return UINT;}
+{cpu_list}	{return CPU_LIST;}
 .		/* ignore anything else */
 %%
@@ -0,0 +1,97 @@
+/*
+ * control_client.cpp - Implementation of the ControlClient class.
+ */
+
+#include <cstring>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "control_client.hpp"
+
+ControlClient::~ControlClient() {
+    if(fd != -1) {
+	close(fd);
+    }
+}
+
+bool ControlClient::connect(const std::string &path) {
+    struct sockaddr_un addr;
+    if(path.size() >= sizeof(addr.sun_path)) {
+	return false;
+    }
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd == -1) {
+	return false;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    if(::connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == -1) {
+	close(fd);
+	fd = -1;
+	return false;
+    }
+
+    return true;
+}
+
+bool ControlClient::request(const std::string &cmd, std::string &status, std::string &output) {
+    return send_all(cmd + "\n") && read_response(status, output);
+}
+
+bool ControlClient::batch(const std::vector<std::string> &cmds,
+			  std::string &status,
+			  std::string &output) {
+    std::string req = std::string(BATCH) + " " + std::to_string(cmds.size()) + "\n";
+    for(auto &cmd : cmds) {
+	req.append(cmd).append("\n");
+    }
+
+    return send_all(req) && read_response(status, output);
+}
+
+bool ControlClient::send_all(const std::string &data) {
+    long unsigned sent = 0;
+    while(sent < data.size()) {
+	ssize_t ret = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+	if(ret <= 0) {
+	    return false;
+	}
+	sent += ret;
+    }
+    return true;
+}
+
+bool ControlClient::read_response(std::string &status, std::string &output) {
+    char chunk[4096];
+    long unsigned header_end, len;
+
+    while((header_end = buf.find('\n')) == std::string::npos) {
+	ssize_t ret = recv(fd, chunk, sizeof(chunk), 0);
+	if(ret <= 0) {
+	    return false;
+	}
+	buf.append(chunk, ret);
+    }
+
+    std::istringstream header(buf.substr(0, header_end));
+    if(!(header >> status >> len)) {
+	return false;
+    }
+    buf.erase(0, header_end + 1);
+
+    while(buf.size() < len) {
+	ssize_t ret = recv(fd, chunk, sizeof(chunk), 0);
+	if(ret <= 0) {
+	    return false;
+	}
+	buf.append(chunk, ret);
+    }
+
+    output = buf.substr(0, len);
+    buf.erase(0, len);
+    return true;
+}
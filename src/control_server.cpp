@@ -0,0 +1,255 @@
+/*
+ * control_server.cpp - Implementation of the ControlServer class.
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <err.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "control_client.hpp"
+#include "control_server.hpp"
+
+// Upper bounds on what a single client may send, to protect the switch from runaway clients.
+static const long unsigned MAX_LINE_LEN = 4096;
+static const long unsigned MAX_BATCH_SIZE = 65536;
+
+// How often serve() checks whether it has been stopped, in milliseconds.
+static const int STOP_POLL_MS = 100;
+
+/*
+ * read_line() - Reads a single newline terminated line from the client, buffering anything read
+ * past it for the next call. Returns false once the client disconnects or misbehaves.
+ */
+static bool read_line(int fd, std::string &buf, std::string &line) {
+    char chunk[4096];
+    long unsigned end;
+
+    while((end = buf.find('\n')) == std::string::npos) {
+	if(buf.size() > MAX_LINE_LEN) {
+	    return false;
+	}
+
+	ssize_t ret = recv(fd, chunk, sizeof(chunk), 0);
+	if(ret <= 0) {
+	    return false;
+	}
+	buf.append(chunk, ret);
+    }
+
+    line = buf.substr(0, end);
+    buf.erase(0, end + 1);
+    if(!line.empty() && line.back() == '\r') {
+	line.pop_back();
+    }
+    return true;
+}
+
+/*
+ * send_response() - Sends a status line and the output that goes with it.
+ */
+static bool send_response(int fd, int status, const std::string &output) {
+    const char *status_str =
+	status == CliInterpreter::OK ? ControlClient::STATUS_OK :
+	status == CliInterpreter::FAILED ? ControlClient::STATUS_FAILED :
+	ControlClient::STATUS_BAD;
+
+    std::string resp = std::string(status_str) + " " + std::to_string(output.size()) + "\n";
+    resp.append(output);
+
+    long unsigned sent = 0;
+    while(sent < resp.size()) {
+	ssize_t ret = send(fd, resp.data() + sent, resp.size() - sent, MSG_NOSIGNAL);
+	if(ret <= 0) {
+	    return false;
+	}
+	sent += ret;
+    }
+    return true;
+}
+
+ControlServer::ControlServer(VswitchShmem *shmem) : interpreter(shmem) {}
+
+ControlServer::~ControlServer() {
+    if(listen_fd != -1) {
+	close(listen_fd);
+	unlink(path.c_str());
+    }
+}
+
+bool ControlServer::listen_unix(const std::string &path) {
+    struct sockaddr_un addr;
+    if(path.size() >= sizeof(addr.sun_path)) {
+	std::cerr << "Control socket path " << path << " is too long." << std::endl;
+	return false;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd == -1) {
+	warn("socket() failed. Cannot create the control socket.");
+	return false;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    unlink(path.c_str());
+
+    if(bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == -1 ||
+       listen(fd, 16) == -1) {
+	warn("Cannot listen for control connections on %s", path.c_str());
+	close(fd);
+	return false;
+    }
+
+    this->path = path;
+    listen_fd = fd;
+    return true;
+}
+
+void ControlServer::adopt(int fd, const std::string &path) {
+    this->path = path;
+    listen_fd = fd;
+}
+
+int ControlServer::get_listen_fd() const {
+    return listen_fd;
+}
+
+void ControlServer::serve() {
+    if(listen_fd == -1) {
+	return;
+    }
+
+    struct pollfd pfd = {listen_fd, POLLIN, 0};
+    while(true) {
+	int ready = poll(&pfd, 1, STOP_POLL_MS);
+	if(ready == -1 && errno != EINTR) {
+	    warn("poll() failed. No longer accepting control connections.");
+	    return;
+	}
+
+	std::lock_guard<std::mutex> lock(serve_access);
+	if(stopped) {
+	    return;
+	} else if(ready <= 0) {
+	    continue;
+	}
+
+	int client_fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+	if(client_fd == -1) {
+	    if(errno == EINTR || errno == ECONNABORTED) {
+		continue;
+	    }
+	    warn("accept() failed. No longer accepting control connections.");
+	    return;
+	}
+
+	std::thread(&ControlServer::handle_client, this, client_fd).detach();
+    }
+}
+
+/*
+ * stop() - Stops accepting control connections, leaving the listening socket open for whichever
+ * switch it was handed off to. No connection is accepted once this returns.
+ */
+void ControlServer::stop() {
+    std::lock_guard<std::mutex> lock(serve_access);
+    stopped = true;
+}
+
+int ControlServer::execute(const std::vector<std::string> &cmds, std::string &output) {
+    std::ostringstream out;
+    std::lock_guard<std::mutex> lock(cmd_lock);
+
+    // Reject the entire batch up front if any part of it is not a valid command, or refers to an
+    // interface, VLAN, or access list which would not exist by the time it ran. This is done under
+    // cmd_lock, so that no other client's commands change what the batch refers to before it runs.
+    int status = CliInterpreter::OK;
+    CliInterpreter::BatchRefs refs;
+    for(long unsigned i = 0; i < cmds.size(); i++) {
+	std::ostringstream reason;
+	if(!interpreter.is_valid(cmds[i])) {
+	    status = CliInterpreter::BAD_CMD;
+	    reason << "Bad command: " << cmds[i] << std::endl;
+	} else if(interpreter.check_refs(cmds[i], refs, reason)) {
+	    continue;
+	} else if(status == CliInterpreter::OK) {
+	    status = CliInterpreter::FAILED;
+	}
+
+	if(cmds.size() > 1) {
+	    out << "Line " << (i + 1) << ": ";
+	}
+	out << reason.str();
+    }
+
+    if(status != CliInterpreter::OK) {
+	output = out.str();
+	return status;
+    }
+
+    for(auto &cmd : cmds) {
+	if(interpreter.interpret_line(cmd, out) != CliInterpreter::OK) {
+	    status = CliInterpreter::FAILED;
+	}
+    }
+
+    output = out.str();
+    return status;
+}
+
+std::unique_lock<std::mutex> ControlServer::hold_commands() {
+    return std::unique_lock<std::mutex>(cmd_lock);
+}
+
+void ControlServer::handle_client(int client_fd) {
+    std::string buf, line, output;
+
+    while(read_line(client_fd, buf, line)) {
+	std::vector<std::string> cmds;
+	std::istringstream words(line);
+	std::string first;
+	long unsigned batch_size;
+
+	words >> first;
+	if(first == ControlClient::BATCH && words >> batch_size && batch_size <= MAX_BATCH_SIZE) {
+	    cmds.resize(batch_size);
+	    bool complete = true;
+	    for(auto &cmd : cmds) {
+		if(!read_line(client_fd, buf, cmd)) {
+		    complete = false;
+		    break;
+		}
+	    }
+
+	    if(!complete) {
+		break;
+	    }
+	} else {
+	    cmds.push_back(line);
+	}
+
+	// A command which throws fails on its own, rather than taking the whole switch down with it
+	int status;
+	try {
+	    status = execute(cmds, output);
+	} catch(const std::exception &e) {
+	    status = CliInterpreter::FAILED;
+	    output = std::string("Command failed: ") + e.what() + "\n";
+	}
+
+	if(!send_response(client_fd, status, output)) {
+	    break;
+	}
+    }
+
+    close(client_fd);
+    return;
+}
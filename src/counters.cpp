@@ -3,7 +3,8 @@
  *
  * Contains the implementation for all functions in include/counters.hpp, including ones to
  * increment interface byte and packet counts, create a snapshot of the class's current state,
- * and print the current values stored in the class (subtracted by the latest snapshot).
+ * copy out the raw running totals, and print the current values stored in the class (subtracted by
+ * the latest snapshot).
  */
 
 #include <iomanip>
@@ -56,32 +57,89 @@ void Counters::create_snapshot() {
     return;
 }
 
-void Counters::print_counters(std::ostream &out,
-			      const std::vector<pcpp::PcapLiveDevice *> &veth_intfs) {
-    int pad = 16;
-    std::vector<std::string> headers = {"Port", "InBytes", "InPckts", "OutBytes", "OutPckts"};
+void Counters::reset(int intf) {
+    if(intf < 0 || intf >= static_cast<int>(counters.size())) {
+	return;
+    }
 
-    out << std::setw(pad) << std::left << headers[0];
-    for(long unsigned int i = 1; i < headers.size(); i++) {
-	out << std::setw(pad) << std::right << headers[i];
+    ingress_locks[intf].lock();
+    counters[intf].ingress_bytes = counters_snapshot[intf].ingress_bytes = 0;
+    counters[intf].ingress_pckts = counters_snapshot[intf].ingress_pckts = 0;
+    ingress_locks[intf].unlock();
+
+    egress_locks[intf].lock();
+    counters[intf].egress_bytes = counters_snapshot[intf].egress_bytes = 0;
+    counters[intf].egress_pckts = counters_snapshot[intf].egress_pckts = 0;
+    egress_locks[intf].unlock();
+}
+
+void Counters::restore(int intf, const struct CounterData &totals) {
+    if(intf < 0 || intf >= static_cast<int>(counters.size())) {
+	return;
     }
-    out << std::endl;
 
-    for(long unsigned int i = 0; i < veth_intfs.size(); i++) {
-	out << std::setw(pad) << std::left << veth_intfs[i]->getName();
+    ingress_locks[intf].lock();
+    counters[intf].ingress_bytes = totals.ingress_bytes;
+    counters[intf].ingress_pckts = totals.ingress_pckts;
+    ingress_locks[intf].unlock();
 
-	out << std::right;
+    egress_locks[intf].lock();
+    counters[intf].egress_bytes = totals.egress_bytes;
+    counters[intf].egress_pckts = totals.egress_pckts;
+    egress_locks[intf].unlock();
+}
+
+std::vector<struct Counters::CounterData> Counters::get_totals() {
+    std::vector<struct CounterData> totals(counters.size());
+    for(long unsigned i = 0; i < counters.size(); i++) {
+	ingress_locks[i].lock();
+	totals[i].ingress_bytes = counters[i].ingress_bytes;
+	totals[i].ingress_pckts = counters[i].ingress_pckts;
+	ingress_locks[i].unlock();
+
+	egress_locks[i].lock();
+	totals[i].egress_bytes = counters[i].egress_bytes;
+	totals[i].egress_pckts = counters[i].egress_pckts;
+	egress_locks[i].unlock();
+    }
+
+    return totals;
+}
+
+void Counters::print_counters(std::ostream &out, const std::vector<Ports::PortInfo> &ports) {
+    int pad = 16;
+    std::vector<std::string> headers = {"Port", "InBytes", "InPckts", "OutBytes", "OutPckts"};
 
+    // Copy the totals and the latest snapshot out first, so no lock is held while formatting.
+    auto totals = get_totals();
+    std::vector<struct CounterData> snapshot(counters_snapshot.size());
+    for(long unsigned i = 0; i < counters_snapshot.size(); i++) {
 	ingress_locks[i].lock();
-	out << std::setw(pad) << (counters[i].ingress_bytes - counters_snapshot[i].ingress_bytes);
-	out << std::setw(pad) << (counters[i].ingress_pckts - counters_snapshot[i].ingress_pckts);
+	snapshot[i].ingress_bytes = counters_snapshot[i].ingress_bytes;
+	snapshot[i].ingress_pckts = counters_snapshot[i].ingress_pckts;
 	ingress_locks[i].unlock();
 
 	egress_locks[i].lock();
-	out << std::setw(pad) << (counters[i].egress_bytes - counters_snapshot[i].egress_bytes);
-	out << std::setw(pad) << (counters[i].egress_pckts - counters_snapshot[i].egress_pckts);
+	snapshot[i].egress_bytes = counters_snapshot[i].egress_bytes;
+	snapshot[i].egress_pckts = counters_snapshot[i].egress_pckts;
 	egress_locks[i].unlock();
+    }
 
+    out << std::setw(pad) << std::left << headers[0];
+    for(long unsigned int i = 1; i < headers.size(); i++) {
+	out << std::setw(pad) << std::right << headers[i];
+    }
+    out << std::endl;
+
+    for(auto &port : ports) {
+	int i = port.index;
+	out << std::setw(pad) << std::left << port.dev->getName();
+
+	out << std::right;
+	out << std::setw(pad) << (totals[i].ingress_bytes - snapshot[i].ingress_bytes);
+	out << std::setw(pad) << (totals[i].ingress_pckts - snapshot[i].ingress_pckts);
+	out << std::setw(pad) << (totals[i].egress_bytes - snapshot[i].egress_bytes);
+	out << std::setw(pad) << (totals[i].egress_pckts - snapshot[i].egress_pckts);
 	out << std::endl;
     }
 
@@ -47,6 +47,12 @@ bool DuplicateManager::check_duplicate(int intf_indx, pcpp::RawPacket pckt) {
     return is_dup;
 }
 
+void DuplicateManager::clear(int intf_indx) {
+    intf_locks[intf_indx].lock();
+    seen[intf_indx].clear();
+    intf_locks[intf_indx].unlock();
+}
+
 std::string DuplicateManager::to_string(std::string prefix) {
     std::ostringstream oss;
 
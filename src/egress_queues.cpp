@@ -0,0 +1,321 @@
+/*
+ * egress_queues.cpp - Implementation of the EgressQueues class.
+ */
+
+#include <iomanip>
+#include "egress_queues.hpp"
+#include "ethernet_view.hpp"
+
+// The queue each priority maps to by default, following the 802.1Q recommendation for four traffic
+// classes. Note that priority 1 (background) ranks below priority 0 (best effort).
+static const int DEFAULT_PRIORITY_QUEUE[EgressQueues::NUM_PRIORITIES] = {0, 0, 1, 1, 2, 2, 3, 3};
+
+// By default the highest queue, which carries network control traffic, is strict, and the others
+// are weighted so that each gets twice the share of the one below it.
+static const bool DEFAULT_STRICT[EgressQueues::NUM_QUEUES] = {false, false, false, true};
+static const int DEFAULT_WEIGHT[EgressQueues::NUM_QUEUES] = {1, 2, 4, 8};
+
+EgressQueues::EgressQueues(int num_intfs) : intf_priority(num_intfs), ports(num_intfs) {
+    for(int i = 0; i < NUM_PRIORITIES; i++) {
+	priority_queue[i].store(DEFAULT_PRIORITY_QUEUE[i]);
+    }
+
+    for(int i = 0; i < NUM_QUEUES; i++) {
+	strict[i].store(DEFAULT_STRICT[i]);
+	weight[i].store(DEFAULT_WEIGHT[i]);
+    }
+
+    for(auto &priority : intf_priority) {
+	priority.store(0);
+    }
+}
+
+bool EgressQueues::set_queue_for_priority(int priority, int queue) {
+    if(priority < 0 || priority >= NUM_PRIORITIES || queue < 0 || queue >= NUM_QUEUES) {
+	return false;
+    }
+    priority_queue[priority].store(queue);
+    return true;
+}
+
+void EgressQueues::reset_queue_for_priority(int priority) {
+    if(priority < 0 || priority >= NUM_PRIORITIES) {
+	return;
+    }
+    priority_queue[priority].store(DEFAULT_PRIORITY_QUEUE[priority]);
+}
+
+bool EgressQueues::set_strict(int queue) {
+    if(queue < 0 || queue >= NUM_QUEUES) {
+	return false;
+    }
+    strict[queue].store(true);
+    return true;
+}
+
+bool EgressQueues::set_weight(int queue, int new_weight) {
+    if(queue < 0 || queue >= NUM_QUEUES || new_weight < 1 || new_weight > MAX_WEIGHT) {
+	return false;
+    }
+    weight[queue].store(new_weight);
+    strict[queue].store(false);
+    return true;
+}
+
+void EgressQueues::reset_queue(int queue) {
+    if(queue < 0 || queue >= NUM_QUEUES) {
+	return;
+    }
+    strict[queue].store(DEFAULT_STRICT[queue]);
+    weight[queue].store(DEFAULT_WEIGHT[queue]);
+}
+
+bool EgressQueues::set_intf_priority(int intf, int priority) {
+    if(intf < 0 || intf >= static_cast<int>(intf_priority.size()) ||
+       priority < 0 || priority >= NUM_PRIORITIES) {
+	return false;
+    }
+    intf_priority[intf].store(priority);
+    return true;
+}
+
+void EgressQueues::reset_intf(int intf) {
+    if(intf < 0 || intf >= static_cast<int>(intf_priority.size())) {
+	return;
+    }
+
+    // Anything still queued for the port is dropped by the egress thread, which finds it removed.
+    intf_priority[intf].store(0);
+    for(auto &queue : ports[intf].queues) {
+	queue.enqueued_pckts.store(0);
+	queue.sent_pckts.store(0);
+	queue.sent_bytes.store(0);
+	queue.dropped_pckts.store(0);
+    }
+}
+
+int EgressQueues::classify(const pcpp::RawPacket &pckt, int default_priority) {
+    // The priority is taken from the outermost tag
+    EthernetView eth(pckt);
+    if(!eth.is_valid() || eth.num_tags() == 0) {
+	return default_priority;
+    }
+    return eth.tci(0) >> 13;
+}
+
+void EgressQueues::enqueue(const std::shared_ptr<PQueueEntry> &entry) {
+    int default_priority = 0;
+    if(entry->src_intf >= 0 && entry->src_intf < static_cast<int>(intf_priority.size())) {
+	default_priority = intf_priority[entry->src_intf].load(std::memory_order_relaxed);
+    }
+
+    int priority = classify(entry->pckt, default_priority);
+    int queue_num = priority_queue[priority].load(std::memory_order_relaxed);
+
+    // A flooded packet is queued once for each of its ports, all sharing a single copy
+    for(int intf : entry->dst_intfs) {
+	PortQueues &port = ports[intf];
+	Queue &queue = port.queues[queue_num];
+	if(queue.count == QUEUE_LIMIT) {
+	    queue.dropped_pckts.fetch_add(1, std::memory_order_relaxed);
+	    continue;
+	}
+
+	if(queue.slots.empty()) {
+	    queue.slots.resize(QUEUE_LIMIT);
+	}
+	queue.slots[(queue.head + queue.count) % QUEUE_LIMIT] = entry;
+	queue.count++;
+	queue.depth.store(queue.count, std::memory_order_relaxed);
+	queue.enqueued_pckts.fetch_add(1, std::memory_order_relaxed);
+
+	port.backlog++;
+	backlog++;
+	if(intf >= high_water) {
+	    high_water = intf + 1;
+	}
+    }
+}
+
+std::shared_ptr<PQueueEntry> EgressQueues::pop(PortQueues &port, int queue_num) {
+    Queue &queue = port.queues[queue_num];
+    std::shared_ptr<PQueueEntry> entry = std::move(queue.slots[queue.head]);
+
+    queue.head = (queue.head + 1) % QUEUE_LIMIT;
+    queue.count--;
+    queue.depth.store(queue.count, std::memory_order_relaxed);
+    queue.sent_pckts.fetch_add(1, std::memory_order_relaxed);
+    queue.sent_bytes.fetch_add(entry->pckt.getRawDataLen(), std::memory_order_relaxed);
+
+    port.backlog--;
+    backlog--;
+    return entry;
+}
+
+std::shared_ptr<PQueueEntry> EgressQueues::schedule(PortQueues &port) {
+    // The CLI may change which queues are strict at any time, so decide once for this packet.
+    std::array<bool, NUM_QUEUES> is_strict;
+    for(int i = NUM_QUEUES - 1; i >= 0; i--) {
+	is_strict[i] = strict[i].load(std::memory_order_relaxed);
+	if(port.queues[i].count > 0 && is_strict[i]) {
+	    return pop(port, i);
+	}
+    }
+
+    // Every packet waiting is in a DRR queue. Each queue is credited its quantum once per visit,
+    // and sends as long as the packet at its head fits within its deficit. Since the deficit only
+    // grows until it does, this always finds a packet within a few rounds.
+    while(true) {
+	int i = port.drr_queue;
+	Queue &queue = port.queues[i];
+
+	if(queue.count == 0 || is_strict[i]) {
+	    queue.deficit = 0;
+	} else {
+	    if(!port.drr_credited) {
+		queue.deficit += weight[i].load(std::memory_order_relaxed) * QUANTUM;
+		port.drr_credited = true;
+	    }
+
+	    int len = queue.slots[queue.head]->pckt.getRawDataLen();
+	    if(len <= queue.deficit) {
+		queue.deficit -= len;
+		auto entry = pop(port, i);
+		if(queue.count == 0) {
+		    queue.deficit = 0;
+		    port.drr_queue = (i + 1) % NUM_QUEUES;
+		    port.drr_credited = false;
+		}
+		return entry;
+	    }
+	}
+
+	port.drr_queue = (i + 1) % NUM_QUEUES;
+	port.drr_credited = false;
+    }
+}
+
+bool EgressQueues::dequeue(int &intf, std::shared_ptr<PQueueEntry> &entry) {
+    if(backlog == 0) {
+	return false;
+    }
+
+    for(int i = 0; i < high_water; i++) {
+	int cur = (next_port + i) % high_water;
+	if(ports[cur].backlog > 0) {
+	    intf = cur;
+	    entry = schedule(ports[cur]);
+	    next_port = (cur + 1) % high_water;
+	    return true;
+	}
+    }
+    return false;
+}
+
+bool EgressQueues::is_empty() const {
+    return backlog == 0;
+}
+
+std::vector<EgressQueues::QueueCounters> EgressQueues::get_counters(int intf) {
+    std::vector<QueueCounters> counters(NUM_QUEUES);
+    if(intf < 0 || intf >= static_cast<int>(ports.size())) {
+	return counters;
+    }
+
+    for(int i = 0; i < NUM_QUEUES; i++) {
+	Queue &queue = ports[intf].queues[i];
+	counters[i].enqueued_pckts = queue.enqueued_pckts.load(std::memory_order_relaxed);
+	counters[i].sent_pckts = queue.sent_pckts.load(std::memory_order_relaxed);
+	counters[i].sent_bytes = queue.sent_bytes.load(std::memory_order_relaxed);
+	counters[i].dropped_pckts = queue.dropped_pckts.load(std::memory_order_relaxed);
+	counters[i].depth = queue.depth.load(std::memory_order_relaxed);
+    }
+    return counters;
+}
+
+void EgressQueues::clear_counters() {
+    for(auto &port : ports) {
+	for(auto &queue : port.queues) {
+	    queue.enqueued_pckts.store(0);
+	    queue.sent_pckts.store(0);
+	    queue.sent_bytes.store(0);
+	    queue.dropped_pckts.store(0);
+	}
+    }
+}
+
+void EgressQueues::print_qos(std::ostream &out) {
+    out << "Priority to queue:";
+    for(int i = 0; i < NUM_PRIORITIES; i++) {
+	out << " " << i << "->" << priority_queue[i].load();
+    }
+    out << std::endl << std::endl;
+
+    out << std::setw(8) << std::left << "Queue" << std::setw(12) << std::left << "Scheduling"
+	<< std::setw(8) << std::right << "Weight" << std::endl;
+    out << std::setw(8) << std::left << "-----" << std::setw(12) << std::left << "----------"
+	<< std::setw(8) << std::right << "------" << std::endl;
+    for(int i = NUM_QUEUES - 1; i >= 0; i--) {
+	bool is_strict = strict[i].load();
+	out << std::setw(8) << std::left << i << std::setw(12) << std::left
+	    << (is_strict ? "strict" : "drr") << std::setw(8) << std::right
+	    << (is_strict ? std::string("-") : std::to_string(weight[i].load())) << std::endl;
+    }
+    out << std::endl;
+}
+
+void EgressQueues::print_queues(std::ostream &out, const std::vector<Ports::PortInfo> &ports) {
+    int pad = 14;
+    std::vector<std::string> headers = {"Port", "Queue", "Depth", "Enqueued", "Sent", "SentBytes",
+					"Dropped"};
+
+    out << std::setw(pad + 2) << std::left << headers[0];
+    for(long unsigned i = 1; i < headers.size(); i++) {
+	out << std::setw(pad) << std::right << headers[i];
+    }
+    out << std::endl;
+
+    for(auto &port : ports) {
+	auto counters = get_counters(port.index);
+	for(int i = 0; i < NUM_QUEUES; i++) {
+	    out << std::setw(pad + 2) << std::left << (i == 0 ? port.dev->getName() : "")
+		<< std::right << std::setw(pad) << i
+		<< std::setw(pad) << counters[i].depth
+		<< std::setw(pad) << counters[i].enqueued_pckts
+		<< std::setw(pad) << counters[i].sent_pckts
+		<< std::setw(pad) << counters[i].sent_bytes
+		<< std::setw(pad) << counters[i].dropped_pckts << std::endl;
+	}
+    }
+    out << std::endl;
+}
+
+void EgressQueues::write_config(std::ostream &out, const std::vector<Ports::PortInfo> &ports) {
+    for(int i = 0; i < NUM_PRIORITIES; i++) {
+	int queue = priority_queue[i].load();
+	if(queue != DEFAULT_PRIORITY_QUEUE[i]) {
+	    out << "qos priority " << i << " queue " << queue << std::endl;
+	}
+    }
+
+    for(int i = 0; i < NUM_QUEUES; i++) {
+	bool is_strict = strict[i].load();
+	int cur_weight = weight[i].load();
+	if(is_strict == DEFAULT_STRICT[i] && (is_strict || cur_weight == DEFAULT_WEIGHT[i])) {
+	    continue;
+	}
+
+	if(is_strict) {
+	    out << "qos queue " << i << " strict" << std::endl;
+	} else {
+	    out << "qos queue " << i << " weight " << cur_weight << std::endl;
+	}
+    }
+
+    for(auto &port : ports) {
+	int priority = intf_priority[port.index].load();
+	if(priority != 0) {
+	    out << port.dev->getName() << " qos priority " << priority << std::endl;
+	}
+    }
+}
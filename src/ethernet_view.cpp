@@ -0,0 +1,33 @@
+/*
+ * ethernet_view.cpp - Implementation of the EthernetView class.
+ */
+
+#include "ethernet_view.hpp"
+
+static uint16_t read16(const uint8_t *data) {
+    return data[0] << 8 | data[1];
+}
+
+/*
+ * EthernetView() - Reads the header of the len byte frame at data. A tag which is cut short is left
+ * unread, and its TPID taken as the EtherType.
+ */
+EthernetView::EthernetView(const uint8_t *data, size_t len) : data(data), len(len) {
+    if(len < HEADER_LEN) {
+	payload_offset = len;
+	return;
+    }
+
+    size_t offset = 12;
+    type = read16(data + offset);
+    while((type == TPID_8021Q || type == TPID_8021AD) && tags < MAX_TAGS &&
+	  len >= offset + TAG_LEN + 2) {
+	tcis[tags++] = read16(data + offset + 2);
+	offset += TAG_LEN;
+	type = read16(data + offset);
+    }
+    payload_offset = offset + 2;
+}
+
+EthernetView::EthernetView(const pcpp::RawPacket &pckt)
+    : EthernetView(pckt.getRawData(), pckt.getRawDataLen()) {}
@@ -0,0 +1,105 @@
+/*
+ * forwarding.cpp - Implementation of the forwarding decision declared in include/forwarding.hpp.
+ */
+
+#include "ethernet_view.hpp"
+#include "forwarding.hpp"
+#include "forwarding_cache.hpp"
+
+void decide_forwarding(pcpp::RawPacket *pckt,
+		       int src_intf,
+		       MacAddrTable *mac_tbl,
+		       Vlans *vlans,
+		       Ports *ports,
+		       StormControl *storm_ctl,
+		       MulticastSnooping *snooping,
+		       LinkAggregation *lags,
+		       std::vector<int> &dst_intfs) {
+    dst_intfs.clear();
+
+    // The ingress port may have been removed from the switch since the packet arrived, in which
+    // case nothing is learned from it and it is not forwarded. The spanning tree may also have it
+    // discard everything, or only learn.
+    Ports::stp_state src_state = ports->get_stp_state(src_intf);
+    if(ports->get(src_intf) == nullptr || src_state == Ports::STP_DISCARDING) {
+	return;
+    }
+
+    // Only the Ethernet header is read here. Features which look further into the packet read it
+    // themselves.
+    EthernetView eth(*pckt);
+    if(!eth.is_valid()) {
+	return;
+    }
+
+    // Unicast frames whose decision is cached, and still current, skip the rest. Their source
+    // address is only learned again once a second, to keep it from aging out.
+    thread_local ForwardingCache cache;
+    const uint8_t *macs = eth.dst_mac();
+    uint64_t generation =
+	mac_tbl->get_generation() + vlans->get_generation() + lags->get_generation();
+    std::time_t now = pckt->getPacketTimeStamp().tv_sec;
+    if(src_state == Ports::STP_FORWARDING) {
+	ForwardingCache::Entry *cached = cache.find(src_intf, macs, generation);
+	if(cached != nullptr && ports->is_forwarding(cached->dst_intf)) {
+	    if(cached->learned != now) {
+		pcpp::MacAddress src_mac(eth.src_mac());
+		mac_tbl->push_mapping(src_mac, lags->logical_port(src_intf));
+		cached->learned = now;
+	    }
+	    dst_intfs.push_back(cached->dst_intf);
+	    return;
+	}
+    }
+
+    // Update MAC address table based on incoming packet. Ports in a link aggregation group are
+    // learned as the group's anchor.
+    int src_port = lags->logical_port(src_intf);
+    mac_tbl->push_mapping(pcpp::MacAddress(eth.src_mac()), src_port);
+    if(src_state != Ports::STP_FORWARDING) {
+	return;
+    }
+
+    // Make forwarding decision based on MAC table
+    pcpp::MacAddress dst_mac(eth.dst_mac());
+    int mapping = mac_tbl->get_mapping(dst_mac);
+    int in_intf_vlan = vlans->get_vlan_for_intf(src_intf);
+    uint32_t hash = lags->is_active() ? lags->hash(*pckt) : 0;
+    if(mapping == MacAddrTable::NO_INTF) {
+	// Drop floods over the ingress port's storm control level before they are replicated
+	if(!storm_ctl->admit(src_intf, dst_mac, *pckt)) {
+	    return;
+	}
+
+	// Broadcast to intfs in VLAN if no mapping exists, skipping any whose link is down. Known
+	// multicast groups, and snooped reports, are only sent to the ports snooping chose. Link
+	// aggregation groups get one copy, through the member the hash picks, and none go back
+	// into the group the packet came from.
+	MulticastSnooping::PortMask snooped;
+	bool pruned = snooping->filter_flood(*pckt, dst_mac, src_port, in_intf_vlan, snooped);
+	for(int i = 0; i < ports->end(); i++) {
+	    int port = lags->logical_port(i);
+	    if(port == src_port || !ports->is_forwarding(i) ||
+	       vlans->get_vlan_for_intf(i) != in_intf_vlan || (pruned && !snooped.test(port)) ||
+	       lags->select_member(i, hash, *ports) != i) {
+		continue;
+	    }
+
+	    dst_intfs.push_back(i);
+	}
+    } else if(mapping != src_port) {
+	// Otherwise, if the packet is destined for a different intf from the src and exists on the
+	// same VLAN, forward to it
+	int dst_intf = lags->select_member(mapping, hash, *ports);
+	if(dst_intf != -1 && ports->is_forwarding(dst_intf) &&
+	   vlans->get_vlan_for_intf(dst_intf) == in_intf_vlan) {
+	    dst_intfs.push_back(dst_intf);
+
+	    // The member of a link aggregation group may depend on more than the addresses
+	    if(lags->get_group(mapping) == 0 ||
+	       lags->get_hash_fields() == LinkAggregation::SRC_DST_MAC) {
+		cache.insert(src_intf, macs, generation, dst_intf, now);
+	    }
+	}
+    }
+}
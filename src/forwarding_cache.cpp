@@ -0,0 +1,49 @@
+/*
+ * forwarding_cache.cpp - Implementation of the ForwardingCache class.
+ */
+
+#include "forwarding_cache.hpp"
+
+/*
+ * find() - Returns the entry for a frame from src_intf, whose destination and source MAC addresses
+ * start at macs, or nullptr if it is not cached or is stale.
+ */
+ForwardingCache::Entry *ForwardingCache::find(int src_intf,
+					      const uint8_t *macs,
+					      uint64_t generation) {
+    uint64_t dst_key = read_mac(macs) | static_cast<uint64_t>(src_intf) << 48;
+    uint64_t src_mac = read_mac(macs + 6);
+    Entry &entry = entries[slot(dst_key, src_mac)];
+    if(entry.dst_intf == -1 || entry.dst_key != dst_key || entry.src_mac != src_mac ||
+       entry.generation != generation) {
+	return nullptr;
+    }
+    return &entry;
+}
+
+/*
+ * insert() - Caches the decision to send frames from src_intf, with the MAC addresses at macs, out
+ * of dst_intf, replacing whatever shared its slot.
+ */
+void ForwardingCache::insert(int src_intf,
+			     const uint8_t *macs,
+			     uint64_t generation,
+			     int dst_intf,
+			     std::time_t learned) {
+    uint64_t dst_key = read_mac(macs) | static_cast<uint64_t>(src_intf) << 48;
+    uint64_t src_mac = read_mac(macs + 6);
+    entries[slot(dst_key, src_mac)] = {dst_key, src_mac, generation, learned, dst_intf};
+}
+
+uint64_t ForwardingCache::read_mac(const uint8_t *mac) {
+    uint64_t value = 0;
+    for(int i = 0; i < 6; i++) {
+	value = value << 8 | mac[i];
+    }
+    return value;
+}
+
+long unsigned ForwardingCache::slot(uint64_t dst_key, uint64_t src_mac) {
+    uint64_t hash = (dst_key ^ (src_mac * 0x9e3779b97f4a7c15)) * 0xff51afd7ed558ccd;
+    return (hash >> 32) & (SIZE - 1);
+}
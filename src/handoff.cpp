@@ -0,0 +1,409 @@
+/*
+ * handoff.cpp - Implementation of the HandoffServer and HandoffClient classes.
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <err.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "handoff.hpp"
+
+// Upper bounds on what either side accepts, so that a misbehaving peer cannot exhaust memory.
+static const long unsigned MAX_LINE_LEN = 4096;
+static const long unsigned MAX_SECTION_LEN = 1 << 20;
+static const int MAX_FDS = 16;
+
+// How long the server waits, in seconds, for the client to open its ports and become ready.
+static const int READY_TIMEOUT = 60;
+
+/*
+ * read_line() - Reads a single newline terminated line from the peer, buffering anything read past
+ * it for the next call. Any file descriptors passed along with the data are appended to fds, or
+ * closed if fds is nullptr. Returns false once the peer disconnects or misbehaves.
+ */
+static bool read_line(int fd, std::string &buf, std::string &line, std::vector<int> *fds) {
+    char chunk[4096];
+    char control[CMSG_SPACE(sizeof(int) * MAX_FDS)];
+    long unsigned end;
+
+    while((end = buf.find('\n')) == std::string::npos) {
+	if(buf.size() > MAX_LINE_LEN) {
+	    return false;
+	}
+
+	struct iovec iov = {chunk, sizeof(chunk)};
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	ssize_t ret = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+	if(ret <= 0) {
+	    return false;
+	}
+
+	for(auto cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+	    if(cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+		continue;
+	    }
+
+	    int num_fds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+	    for(int i = 0; i < num_fds; i++) {
+		int passed_fd;
+		memcpy(&passed_fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+		if(fds != nullptr) {
+		    fds->push_back(passed_fd);
+		} else {
+		    close(passed_fd);
+		}
+	    }
+	}
+
+	buf.append(chunk, ret);
+    }
+
+    line = buf.substr(0, end);
+    buf.erase(0, end + 1);
+    return true;
+}
+
+/*
+ * read_section() - Reads a "{name} {n}" line followed by n lines, which are returned in lines.
+ */
+static bool read_section(int fd,
+			 std::string &buf,
+			 const std::string &name,
+			 std::vector<std::string> &lines) {
+    std::string line, first;
+    long unsigned num_lines;
+
+    if(!read_line(fd, buf, line, nullptr)) {
+	return false;
+    }
+
+    std::istringstream words(line);
+    if(!(words >> first >> num_lines) || first != name || num_lines > MAX_SECTION_LEN) {
+	return false;
+    }
+
+    lines.resize(num_lines);
+    for(auto &cur : lines) {
+	if(!read_line(fd, buf, cur, nullptr)) {
+	    return false;
+	}
+    }
+    return true;
+}
+
+/*
+ * write_section() - Appends a "{name} {n}" line followed by the n lines to out.
+ */
+static void write_section(std::string &out,
+			  const std::string &name,
+			  const std::vector<std::string> &lines) {
+    out.append(name).append(" ").append(std::to_string(lines.size())).append("\n");
+    for(auto &line : lines) {
+	out.append(line).append("\n");
+    }
+}
+
+/*
+ * send_all() - Sends the entire buffer to the peer, retrying on short writes.
+ */
+static bool send_all(int fd, const std::string &data) {
+    long unsigned sent = 0;
+    while(sent < data.size()) {
+	ssize_t ret = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+	if(ret <= 0) {
+	    return false;
+	}
+	sent += ret;
+    }
+    return true;
+}
+
+/*
+ * send_fds() - Sends a single short line with the given file descriptors attached.
+ */
+static bool send_fds(int fd, const std::string &line, const std::vector<int> &fds) {
+    if(fds.empty() || fds.size() > MAX_FDS) {
+	return false;
+    }
+
+    char control[CMSG_SPACE(sizeof(int) * MAX_FDS)];
+    memset(control, 0, sizeof(control));
+
+    struct iovec iov = {const_cast<char *>(line.data()), line.size()};
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+    memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+
+    return sendmsg(fd, &msg, MSG_NOSIGNAL) == static_cast<ssize_t>(line.size());
+}
+
+HandoffServer::HandoffServer(VswitchShmem *shmem,
+			     ControlServer *ctl_server,
+			     MetricsServer *metrics_server,
+			     std::function<void()> stop_forwarding)
+    : shmem(shmem),
+      ctl_server(ctl_server),
+      metrics_server(metrics_server),
+      stop_forwarding(stop_forwarding)
+{}
+
+HandoffServer::~HandoffServer() {
+    if(listen_fd != -1) {
+	close(listen_fd);
+	unlink(path.c_str());
+    }
+}
+
+bool HandoffServer::listen_unix(const std::string &path) {
+    struct sockaddr_un addr;
+    if(path.size() >= sizeof(addr.sun_path)) {
+	std::cerr << "Handoff socket path " << path << " is too long." << std::endl;
+	return false;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd == -1) {
+	warn("socket() failed. Cannot create the handoff socket.");
+	return false;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    unlink(path.c_str());
+
+    if(bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == -1 ||
+       listen(fd, 1) == -1) {
+	warn("Cannot listen for handoffs on %s", path.c_str());
+	close(fd);
+	return false;
+    }
+
+    this->path = path;
+    listen_fd = fd;
+    return true;
+}
+
+void HandoffServer::adopt(int fd, const std::string &path) {
+    this->path = path;
+    listen_fd = fd;
+}
+
+bool HandoffServer::serve() {
+    if(listen_fd == -1) {
+	return false;
+    }
+
+    while(true) {
+	int client_fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+	if(client_fd == -1) {
+	    if(errno == EINTR || errno == ECONNABORTED) {
+		continue;
+	    }
+	    warn("accept() failed. No longer accepting handoffs.");
+	    return false;
+	}
+
+	bool handed_off = hand_off(client_fd);
+	close(client_fd);
+	if(handed_off) {
+	    return true;
+	}
+	std::cerr << "A handoff was abandoned. Still forwarding." << std::endl;
+    }
+}
+
+bool HandoffServer::hand_off(int client_fd) {
+    std::vector<int> fds = {ctl_server->get_listen_fd(), listen_fd};
+    for(int fd : metrics_server->get_listen_fds()) {
+	fds.push_back(fd);
+    }
+
+    struct timeval timeout = {READY_TIMEOUT, 0};
+    setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    // Configuration changes made from here on would not be carried over, so none are allowed.
+    auto held_cmds = ctl_server->hold_commands();
+
+    std::ostringstream running_config;
+    std::string line;
+    std::vector<std::string> config, macs, counters, stp;
+    CliInterpreter::write_running_config(running_config);
+    std::istringstream config_lines(running_config.str());
+    while(std::getline(config_lines, line)) {
+	config.push_back(line);
+    }
+
+    for(auto &entry : shmem->mac_tbl.snapshot()) {
+	pcpp::PcapLiveDevice *intf = shmem->ports.get(entry.intf);
+	if(intf != nullptr) {
+	    macs.push_back(entry.mac_addr.toString() + " " + intf->getName() + " " +
+			   std::to_string(entry.timestamp));
+	}
+    }
+
+    std::string state, buf;
+    write_section(state, "config", config);
+    write_section(state, "mac", macs);
+    if(!send_fds(client_fd, "handoff " + std::to_string(fds.size()) + "\n", fds) ||
+       !send_all(client_fd, state) ||
+       !read_line(client_fd, buf, line, nullptr) || line != "ready") {
+	return false;
+    }
+
+    // The client serves the listening sockets from here on. Any connection this switch accepted
+    // would only be dropped when it exits, with its commands held until then.
+    ctl_server->stop();
+    metrics_server->stop();
+
+    // There is no going back once forwarding has stopped, since the client is capturing by now.
+    stop_forwarding();
+
+    auto totals = shmem->counters.get_totals();
+    for(auto &port : shmem->ports.snapshot()) {
+	auto &total = totals[port.index];
+	counters.push_back(port.dev->getName() + " " +
+			   std::to_string(total.ingress_pckts) + " " +
+			   std::to_string(total.ingress_bytes) + " " +
+			   std::to_string(total.egress_pckts) + " " +
+			   std::to_string(total.egress_bytes));
+    }
+
+    // The spanning tree's timers stand still in standby, so it no longer changes from here on
+    shmem->rstp.write_state(stp);
+
+    state.clear();
+    write_section(state, "counters", counters);
+    write_section(state, "stp", stp);
+    state.append("done\n");
+    if(!send_all(client_fd, state)) {
+	std::cerr << "Lost the switch taking over before its counters were sent." << std::endl;
+    }
+
+    // The commands stay held until the process exits, since the new switch owns the configuration.
+    held_cmds.release();
+    return true;
+}
+
+HandoffClient::~HandoffClient() {
+    if(fd != -1) {
+	close(fd);
+    }
+}
+
+bool HandoffClient::connect(const std::string &path) {
+    struct sockaddr_un addr;
+    if(path.size() >= sizeof(addr.sun_path)) {
+	return false;
+    }
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd == -1) {
+	return false;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    if(::connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == -1) {
+	close(fd);
+	fd = -1;
+	return false;
+    }
+
+    return true;
+}
+
+bool HandoffClient::receive_state(Listeners &listeners, std::vector<std::string> &config) {
+    std::vector<int> fds;
+    std::string line, first;
+    long unsigned num_fds;
+
+    if(!read_line(fd, buf, line, &fds)) {
+	for(int passed_fd : fds) {
+	    close(passed_fd);
+	}
+	return false;
+    }
+
+    std::istringstream words(line);
+    if(!(words >> first >> num_fds) || first != "handoff" || num_fds != fds.size() ||
+       num_fds < 2) {
+	for(int passed_fd : fds) {
+	    close(passed_fd);
+	}
+	return false;
+    }
+
+    listeners.ctl_fd = fds[0];
+    listeners.handoff_fd = fds[1];
+    listeners.metrics_fds.assign(fds.begin() + 2, fds.end());
+
+    return read_section(fd, buf, "config", config) && read_section(fd, buf, "mac", mac_entries);
+}
+
+bool HandoffClient::take_over(VswitchShmem *shmem) {
+    std::vector<MacAddrTable::Entry> entries;
+    for(auto &line : mac_entries) {
+	std::istringstream words(line);
+	std::string mac_addr, name;
+	long long timestamp;
+	if(!(words >> mac_addr >> name >> timestamp)) {
+	    continue;
+	}
+
+	int intf = shmem->ports.find(name);
+	if(intf != -1) {
+	    entries.push_back({pcpp::MacAddress(mac_addr), intf, timestamp});
+	}
+    }
+    shmem->mac_tbl.restore(entries);
+
+    if(!send_all(fd, "ready\n")) {
+	return false;
+    }
+
+    // The old switch stops forwarding as soon as it reads "ready", so this switch must forward from
+    // here on even if the rest of the exchange fails.
+    std::vector<std::string> counters, stp;
+    std::string line;
+    if(read_section(fd, buf, "counters", counters) && read_section(fd, buf, "stp", stp) &&
+       read_line(fd, buf, line, nullptr) && line == "done") {
+	shmem->rstp.adopt_state(stp);
+	for(auto &cur : counters) {
+	    std::istringstream words(cur);
+	    std::string name;
+	    Counters::CounterData totals;
+	    if(words >> name >> totals.ingress_pckts >> totals.ingress_bytes >>
+	       totals.egress_pckts >> totals.egress_bytes) {
+		shmem->counters.restore(shmem->ports.find(name), totals);
+	    }
+	}
+    } else {
+	std::cerr << "Lost the switch being taken over. Its counters and spanning tree were not "
+		  << "carried over." << std::endl;
+    }
+
+    shmem->standby.store(false);
+    return true;
+}
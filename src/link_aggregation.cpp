@@ -0,0 +1,259 @@
+/*
+ * link_aggregation.cpp - Implementation of the LinkAggregation class.
+ */
+
+#include <algorithm>
+#include <iomanip>
+#include <string>
+#include "ethernet_view.hpp"
+#include "link_aggregation.hpp"
+
+// The CLI keyword for each choice of hash fields, in the order of LinkAggregation::hash_fields
+static const char *field_names[] = {
+    "src-dst-mac", "src-dst-ip", "src-dst-port"
+};
+
+/*
+ * fnv1a() - Continues a 32-bit FNV-1a hash over len bytes of data.
+ */
+static uint32_t fnv1a(uint32_t hash, const uint8_t *data, size_t len) {
+    for(size_t i = 0; i < len; i++) {
+	hash = (hash ^ data[i]) * 16777619;
+    }
+    return hash;
+}
+
+LinkAggregation::LinkAggregation(int num_intfs, MacAddrTable *mac_tbl, Vlans *vlans)
+    : mac_tbl(mac_tbl),
+      vlans(vlans),
+      group_of(num_intfs) {
+    for(auto &group : group_of) {
+	group.store(-1);
+    }
+}
+
+bool LinkAggregation::add_member(int group, int intf) {
+    if(group < 1 || group > MAX_GROUPS || intf < 0 || intf >= static_cast<int>(group_of.size())) {
+	return false;
+    }
+
+    std::lock_guard<std::mutex> lock(config_access);
+    int index = group - 1;
+    if(group_of[intf].load() == index) {
+	return true;
+    }
+
+    std::vector<int> members = copy_members(index);
+    if(members.size() >= MAX_MEMBERS) {
+	return false;
+    }
+
+    int old_index = group_of[intf].load();
+    if(old_index != -1) {
+	std::vector<int> old_members = copy_members(old_index);
+	group_of[intf].store(-1);
+	num_grouped.fetch_sub(1);
+	mac_tbl->flush_intf(old_members[0]);
+	old_members.erase(std::find(old_members.begin(), old_members.end(), intf));
+	set_members(old_index, old_members);
+    }
+
+    // A new member takes on the group's VLAN, and may become its anchor, so addresses learned on
+    // either side are forgotten
+    if(!members.empty()) {
+	vlans->add_intf_to_vlan(intf, vlans->get_vlan_for_intf(members[0]));
+	mac_tbl->flush_intf(members[0]);
+    }
+    mac_tbl->flush_intf(intf);
+
+    members.insert(std::lower_bound(members.begin(), members.end(), intf), intf);
+    set_members(index, members);
+    group_of[intf].store(index);
+    num_grouped.fetch_add(1);
+    generation.fetch_add(1, std::memory_order_release);
+    return true;
+}
+
+void LinkAggregation::remove_member(int intf) {
+    if(intf < 0 || intf >= static_cast<int>(group_of.size())) {
+	return;
+    }
+
+    std::lock_guard<std::mutex> lock(config_access);
+    int index = group_of[intf].load();
+    if(index == -1) {
+	return;
+    }
+
+    // The port stops being treated as part of the group before the group itself changes
+    std::vector<int> members = copy_members(index);
+    group_of[intf].store(-1);
+    num_grouped.fetch_sub(1);
+    mac_tbl->flush_intf(members[0]);
+    members.erase(std::find(members.begin(), members.end(), intf));
+    set_members(index, members);
+    generation.fetch_add(1, std::memory_order_release);
+}
+
+void LinkAggregation::reset_intf(int intf) {
+    remove_member(intf);
+}
+
+int LinkAggregation::get_group(int intf) const {
+    if(intf < 0 || intf >= static_cast<int>(group_of.size())) {
+	return 0;
+    }
+    return group_of[intf].load() + 1;
+}
+
+std::vector<int> LinkAggregation::get_members(int intf) {
+    if(intf < 0 || intf >= static_cast<int>(group_of.size())) {
+	return {};
+    }
+
+    std::lock_guard<std::mutex> lock(config_access);
+    int index = group_of[intf].load();
+    return index == -1 ? std::vector<int>{intf} : copy_members(index);
+}
+
+void LinkAggregation::set_hash_fields(hash_fields fields) {
+    this->fields.store(fields);
+    generation.fetch_add(1, std::memory_order_release);
+}
+
+LinkAggregation::hash_fields LinkAggregation::get_hash_fields() const {
+    return static_cast<hash_fields>(fields.load(std::memory_order_relaxed));
+}
+
+uint64_t LinkAggregation::get_generation() const {
+    return generation.load(std::memory_order_acquire);
+}
+
+bool LinkAggregation::is_active() const {
+    return num_grouped.load(std::memory_order_relaxed) != 0;
+}
+
+int LinkAggregation::logical_port(int intf) const {
+    int index = group_of[intf].load(std::memory_order_relaxed);
+    return index == -1 ? intf : groups[index].members[0].load(std::memory_order_relaxed);
+}
+
+int LinkAggregation::select_member(int logical, uint32_t hash, const Ports &ports) const {
+    int index = group_of[logical].load(std::memory_order_relaxed);
+    if(index == -1) {
+	return logical;
+    }
+
+    const Group &group = groups[index];
+    int count = std::min(group.num_members.load(std::memory_order_acquire), MAX_MEMBERS);
+    int candidates[MAX_MEMBERS];
+    int num_candidates = 0;
+    for(int i = 0; i < count; i++) {
+	int member = group.members[i].load(std::memory_order_relaxed);
+	if(ports.is_forwarding(member)) {
+	    candidates[num_candidates++] = member;
+	}
+    }
+
+    return num_candidates == 0 ? -1 : candidates[hash % num_candidates];
+}
+
+uint32_t LinkAggregation::hash(const pcpp::RawPacket &pckt) const {
+    EthernetView eth(pckt);
+    uint32_t hash = 2166136261;
+    if(!eth.is_valid()) {
+	return hash;
+    }
+
+    int use = fields.load(std::memory_order_relaxed);
+    if(use != SRC_DST_MAC) {
+	// The IP header follows any VLAN tags
+	const uint8_t *ip = eth.payload();
+	size_t len = eth.payload_len();
+
+	// Ports are only hashed for unfragmented packets, since later fragments do not carry them
+	if(eth.ether_type() == EthernetView::ETHER_TYPE_IPV4 && len >= 20) {
+	    size_t header_len = (ip[0] & 0x0f) * 4;
+	    bool fragmented = (ip[6] & 0x3f) != 0 || ip[7] != 0;
+	    hash = fnv1a(hash, ip + 12, 8);
+	    if(use == SRC_DST_PORT && (ip[9] == 6 || ip[9] == 17) && !fragmented &&
+	       len >= header_len + 4) {
+		hash = fnv1a(hash, ip + header_len, 4);
+	    }
+	    return hash ^ (hash >> 16);
+	}
+
+	if(eth.ether_type() == EthernetView::ETHER_TYPE_IPV6 && len >= 40) {
+	    hash = fnv1a(hash, ip + 8, 32);
+	    if(use == SRC_DST_PORT && (ip[6] == 6 || ip[6] == 17) && len >= 44) {
+		hash = fnv1a(hash, ip + 40, 4);
+	    }
+	    return hash ^ (hash >> 16);
+	}
+    }
+
+    // Frames without an IP header are spread by their MAC addresses
+    hash = fnv1a(hash, eth.dst_mac(), 12);
+    return hash ^ (hash >> 16);
+}
+
+void LinkAggregation::print_groups(std::ostream &out, const Ports &ports) {
+    int pad = 14;
+    std::vector<std::string> headers = {"Group", "Port", "Status"};
+
+    out << std::setw(pad + 2) << std::left << headers[0];
+    for(long unsigned i = 1; i < headers.size(); i++) {
+	out << std::setw(pad) << std::right << headers[i];
+    }
+    out << std::endl;
+
+    std::lock_guard<std::mutex> lock(config_access);
+    for(int i = 0; i < MAX_GROUPS; i++) {
+	std::vector<int> members = copy_members(i);
+	for(long unsigned j = 0; j < members.size(); j++) {
+	    pcpp::PcapLiveDevice *dev = ports.get(members[j]);
+	    out << std::setw(pad + 2) << std::left << (j == 0 ? std::to_string(i + 1) : "")
+		<< std::right << std::setw(pad) << (dev == nullptr ? "-" : dev->getName())
+		<< std::setw(pad) << (ports.is_forwarding(members[j]) ? "active" : "down")
+		<< std::endl;
+	}
+    }
+    out << std::endl << "Load balancing: " << field_names[fields.load()] << std::endl << std::endl;
+}
+
+void LinkAggregation::write_config(std::ostream &out, const std::vector<Ports::PortInfo> &ports) {
+    if(fields.load() != SRC_DST_MAC) {
+	out << "port-channel load-balance " << field_names[fields.load()] << std::endl;
+    }
+
+    for(auto &port : ports) {
+	int group = get_group(port.index);
+	if(group != 0) {
+	    out << port.dev->getName() << " channel-group " << group << std::endl;
+	}
+    }
+}
+
+/*
+ * set_members() - Publishes a group's new members. The members are written before their count, so
+ * that forwarding threads never read past the ones written. Must be called with config_access held.
+ */
+void LinkAggregation::set_members(int group, const std::vector<int> &members) {
+    for(long unsigned i = 0; i < members.size(); i++) {
+	groups[group].members[i].store(members[i]);
+    }
+    groups[group].num_members.store(members.size(), std::memory_order_release);
+}
+
+/*
+ * copy_members() - Returns a group's current members, in order. Must be called with config_access
+ * held.
+ */
+std::vector<int> LinkAggregation::copy_members(int group) const {
+    std::vector<int> members;
+    int count = groups[group].num_members.load();
+    for(int i = 0; i < count; i++) {
+	members.push_back(groups[group].members[i].load());
+    }
+    return members;
+}
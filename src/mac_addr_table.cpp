@@ -6,49 +6,88 @@
 #include <iomanip>
 #include <iostream>
 #include "mac_addr_table.hpp"
+#include "tracepoints.hpp"
 
-void MacAddrTable::push_mapping(pcpp::MacAddress mac_addr, pcpp::PcapLiveDevice *intf) {
+void MacAddrTable::push_mapping(pcpp::MacAddress mac_addr, int intf) {
+    std::time_t now = std::time(nullptr);
     table_access.lock();
-    table[mac_addr] = {intf, std::time(nullptr)};
+    auto [table_it, added] = table.try_emplace(mac_addr, intf, now);
+    if(added) {
+	// Only floods are sent to unknown addresses, and those are never cached
+	VSWITCH_TRACE(mac_learn, mac_addr.getRawData(), intf);
+    } else if(table_it->second.first != intf) {
+	VSWITCH_TRACE(mac_move, mac_addr.getRawData(), table_it->second.first, intf);
+	generation.fetch_add(1, std::memory_order_release);
+    }
+    table_it->second = {intf, now};
     table_access.unlock();
 }
 
-pcpp::PcapLiveDevice *MacAddrTable::get_mapping(pcpp::MacAddress mac_addr) {
+int MacAddrTable::get_mapping(pcpp::MacAddress mac_addr) {
     table_access.lock();
     auto table_it = table.find(mac_addr);
     if(table_it == table.end()) {
 	table_access.unlock();
-	return nullptr;
+	return NO_INTF;
     }
 
-    pcpp::PcapLiveDevice *ret_intf = table_it->second.first;
+    int ret_intf = table_it->second.first;
     table_access.unlock();
     return ret_intf;
 }
 
 int MacAddrTable::age_mappings() {
     int num_aged_out = 0;
-    auto table_it = table.begin();
     std::time_t elem_time, cur_time = std::time(nullptr);
     double diff;
 
     table_access.lock();
+    auto table_it = table.begin();
     while(table_it != table.end()) {
 	elem_time = table_it->second.second;
 	diff = difftime(cur_time, elem_time);
 
 	if(diff > max_age) {
+	    VSWITCH_TRACE(mac_age, table_it->first.getRawData(), table_it->second.first);
 	    num_aged_out++;
 	    table.erase(table_it++);
 	} else {
 	    table_it++;
 	}
     }
+    if(num_aged_out > 0) {
+	generation.fetch_add(1, std::memory_order_release);
+    }
     table_access.unlock();
 
     return num_aged_out;
 }
 
+int MacAddrTable::flush_intf(int intf) {
+    int num_flushed = 0;
+
+    table_access.lock();
+    auto table_it = table.begin();
+    while(table_it != table.end()) {
+	if(table_it->second.first == intf) {
+	    num_flushed++;
+	    table.erase(table_it++);
+	} else {
+	    table_it++;
+	}
+    }
+    if(num_flushed > 0) {
+	generation.fetch_add(1, std::memory_order_release);
+    }
+    table_access.unlock();
+
+    return num_flushed;
+}
+
+uint64_t MacAddrTable::get_generation() const {
+    return generation.load(std::memory_order_acquire);
+}
+
 unsigned MacAddrTable::get_max_age() {
     unsigned cur_max_age;
     table_access.lock();
@@ -57,6 +96,14 @@ unsigned MacAddrTable::get_max_age() {
     return cur_max_age;
 }
 
+long unsigned MacAddrTable::get_size() {
+    long unsigned size;
+    table_access.lock();
+    size = table.size();
+    table_access.unlock();
+    return size;
+}
+
 bool MacAddrTable::modify_aging_time(unsigned int new_age) {
     if(new_age < 1) {
 	return false;
@@ -67,9 +114,63 @@ bool MacAddrTable::modify_aging_time(unsigned int new_age) {
     return true;
 }
 
-void MacAddrTable::print_mactbl(std::ostream &out) {
-    this->age_mappings();
+std::vector<MacAddrTable::Entry> MacAddrTable::snapshot(int intf) {
+    std::vector<Entry> entries;
+    std::time_t cur_time = std::time(nullptr);
+
+    // Reserve outside of the lock. The table may grow a little in the meantime, which is harmless.
+    entries.reserve(get_size());
+
+    table_access.lock();
+    for(auto &[mac_addr, info] : table) {
+	auto &[entry_intf, timestamp] = info;
+	if((intf != NO_INTF && entry_intf != intf) || difftime(cur_time, timestamp) > max_age) {
+	    continue;
+	}
+	entries.push_back({mac_addr, entry_intf, timestamp});
+    }
+    table_access.unlock();
+
+    return entries;
+}
+
+void MacAddrTable::restore(const std::vector<Entry> &entries) {
+    table_access.lock();
+    for(auto &entry : entries) {
+	table[entry.mac_addr] = {entry.intf, entry.timestamp};
+    }
+    generation.fetch_add(1, std::memory_order_release);
+    table_access.unlock();
+}
+
+bool MacAddrTable::lookup(pcpp::MacAddress mac_addr, Entry &entry) {
+    bool found = false;
+
+    table_access.lock();
+    auto table_it = table.find(mac_addr);
+    if(table_it != table.end() &&
+       difftime(std::time(nullptr), table_it->second.second) <= max_age) {
+	entry = {table_it->first, table_it->second.first, table_it->second.second};
+	found = true;
+    }
+    table_access.unlock();
+
+    return found;
+}
+
+void MacAddrTable::print_mactbl(std::ostream &out, const Ports &ports) {
+    auto entries = snapshot();
+    print_entries(out, entries, ports, get_max_age());
+}
+
+void MacAddrTable::print_entries(std::ostream &out,
+				 const std::vector<Entry> &entries,
+				 const Ports &ports,
+				 unsigned max_age,
+				 long unsigned first,
+				 long unsigned count) {
     std::vector<std::string> headers = {"Mac Addresses", "Ports", "Time to Live"};
+    std::time_t cur_time = std::time(nullptr);
 
     out << std::setw(30) << "" << "Mac Address Table" << std::endl;
     out << std::string(80, '-') << std::endl << std::endl;
@@ -83,20 +184,23 @@ void MacAddrTable::print_mactbl(std::ostream &out) {
     }
     out << std::endl;
 
-    table_access.lock();
-    for(auto [mac_addr, info] : table) {
-	auto [intf, timestamp] = info;
-	double ttl = max_age - difftime(std::time(nullptr), timestamp);
+    for(long unsigned i = first; i < entries.size() && i - first < count; i++) {
+	double ttl = max_age - difftime(cur_time, entries[i].timestamp);
+	pcpp::PcapLiveDevice *intf = ports.get(entries[i].intf);
 
-	std::cout << std::setw(20) << std::left << mac_addr.toString();
-	std::cout << std::setw(20) << std::left << intf->getName();
-	std::cout << std::setw(20) << std::left << ttl << std::endl;
+	// The port may have been removed since the entries were copied out
+	out << std::setw(20) << std::left << entries[i].mac_addr.toString();
+	out << std::setw(20) << std::left << (intf != nullptr ? intf->getName() : "-");
+	out << std::setw(20) << std::left << ttl << std::endl;
     }
-    table_access.unlock();
-    std::cout << std::endl;
+    out << std::endl;
     return;
 }
 
+void MacAddrTable::write_config(std::ostream &out) {
+    out << "mac address-table aging-time " << get_max_age() << std::endl;
+}
+
 bool MacAddrTable::MacAddrCompare::operator() (const pcpp::MacAddress &a,
 					       const pcpp::MacAddress &b) const {
     uint64_t a_full = 0, b_full = 0;
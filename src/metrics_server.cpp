@@ -0,0 +1,336 @@
+/*
+ * metrics_server.cpp - Implementation of the MetricsServer class.
+ *
+ * Every connection is served from the calling thread, which polls them all at once, so a client
+ * which is slow to send its request never delays the others. Each request is answered with an
+ * HTTP/1.0 response, after which the connection is closed. Only "GET /metrics" (or "GET /") is
+ * served.
+ */
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <err.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "metrics_server.hpp"
+
+// The longest we will wait on a client to send its request, or to take its response, in
+// milliseconds.
+static const int REQUEST_TIMEOUT = 1000;
+static const long unsigned MAX_REQUEST_LEN = 4096;
+
+// How often serve() checks whether it has been stopped, in milliseconds.
+static const int STOP_POLL_MS = 100;
+
+/*
+ * escape_label() - Escapes a string for use as an OpenMetrics label value.
+ */
+static std::string escape_label(const std::string &value) {
+    std::string escaped;
+    for(char c : value) {
+	switch(c) {
+	case '\\':
+	    escaped.append("\\\\");
+	    break;
+	case '"':
+	    escaped.append("\\\"");
+	    break;
+	case '\n':
+	    escaped.append("\\n");
+	    break;
+	default:
+	    escaped.push_back(c);
+	}
+    }
+    return escaped;
+}
+
+/*
+ * write_all() - Writes the entire buffer to the given file descriptor, retrying on short writes.
+ */
+static bool write_all(int fd, const std::string &buf) {
+    long unsigned written = 0;
+    while(written < buf.size()) {
+	ssize_t ret = send(fd, buf.data() + written, buf.size() - written, MSG_NOSIGNAL);
+	if(ret <= 0) {
+	    return false;
+	}
+	written += ret;
+    }
+    return true;
+}
+
+MetricsServer::MetricsServer(VswitchShmem *shmem) : shmem(shmem) {}
+
+MetricsServer::~MetricsServer() {
+    for(int fd : listen_fds) {
+	close(fd);
+    }
+
+    if(!unix_path.empty()) {
+	unlink(unix_path.c_str());
+    }
+}
+
+bool MetricsServer::listen_tcp(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd == -1) {
+	warn("socket() failed. Cannot serve metrics over TCP.");
+	return false;
+    }
+
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if(bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == -1 ||
+       listen(fd, 16) == -1) {
+	warn("Cannot serve metrics on 127.0.0.1:%d", port);
+	close(fd);
+	return false;
+    }
+
+    listen_fds.push_back(fd);
+    return true;
+}
+
+bool MetricsServer::listen_unix(const std::string &path) {
+    struct sockaddr_un addr;
+    if(path.size() >= sizeof(addr.sun_path)) {
+	std::cerr << "Metrics socket path " << path << " is too long." << std::endl;
+	return false;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd == -1) {
+	warn("socket() failed. Cannot serve metrics over a Unix socket.");
+	return false;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    unlink(path.c_str());
+
+    if(bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == -1 ||
+       listen(fd, 16) == -1) {
+	warn("Cannot serve metrics on %s", path.c_str());
+	close(fd);
+	return false;
+    }
+
+    unix_path = path;
+    listen_fds.push_back(fd);
+    return true;
+}
+
+void MetricsServer::adopt(int fd) {
+    listen_fds.push_back(fd);
+}
+
+const std::vector<int> &MetricsServer::get_listen_fds() const {
+    return listen_fds;
+}
+
+void MetricsServer::serve() {
+    if(listen_fds.empty()) {
+	return;
+    }
+
+    std::vector<Client> clients;
+    std::vector<struct pollfd> pfds;
+    while(true) {
+	pfds.clear();
+	for(int fd : listen_fds) {
+	    pfds.push_back({fd, POLLIN, 0});
+	}
+	for(auto &client : clients) {
+	    pfds.push_back({client.fd, POLLIN, 0});
+	}
+
+	int ready = poll(pfds.data(), pfds.size(), STOP_POLL_MS);
+	if(ready == -1 && errno != EINTR) {
+	    warn("poll() failed. No longer serving metrics.");
+	    close_clients(clients);
+	    return;
+	}
+
+	// Clients are only read from once they have sent something, so an idle one never holds up
+	// the others. Any which finish, or run out of time, are closed.
+	auto now = std::chrono::steady_clock::now();
+	for(long unsigned i = 0; i < clients.size(); i++) {
+	    short revents = ready > 0 ? pfds[listen_fds.size() + i].revents : 0;
+	    if((revents != 0 && handle_client(clients[i])) || now >= clients[i].deadline) {
+		close(clients[i].fd);
+		clients[i].fd = -1;
+	    }
+	}
+	std::erase_if(clients, [](const Client &client) {
+	    return client.fd == -1;
+	});
+
+	// Connections are accepted under serve_access, so none is accepted after stop() returns
+	std::lock_guard<std::mutex> lock(serve_access);
+	if(stopped) {
+	    close_clients(clients);
+	    return;
+	}
+
+	for(long unsigned i = 0; ready > 0 && i < listen_fds.size(); i++) {
+	    if(!(pfds[i].revents & POLLIN)) {
+		continue;
+	    }
+
+	    int client_fd = accept4(pfds[i].fd, NULL, NULL, SOCK_CLOEXEC);
+	    if(client_fd == -1) {
+		continue;
+	    }
+
+	    // A client which stops reading its response only holds up the others this long
+	    struct timeval timeout = {REQUEST_TIMEOUT / 1000, (REQUEST_TIMEOUT % 1000) * 1000};
+	    setsockopt(client_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+	    clients.push_back({client_fd, "", now + std::chrono::milliseconds(REQUEST_TIMEOUT)});
+	}
+    }
+}
+
+/*
+ * stop() - Stops accepting scrapes, leaving the listening sockets open for whichever switch they
+ * were handed off to. No connection is accepted once this returns.
+ */
+void MetricsServer::stop() {
+    std::lock_guard<std::mutex> lock(serve_access);
+    stopped = true;
+}
+
+/*
+ * close_clients() - Closes every connection still waiting to send its request.
+ */
+void MetricsServer::close_clients(std::vector<Client> &clients) {
+    for(auto &client : clients) {
+	close(client.fd);
+    }
+    clients.clear();
+}
+
+/*
+ * handle_client() - Reads whatever a client has sent, and answers it once the request headers are
+ * complete. Returns true once the connection is finished with, either answered or dropped.
+ */
+bool MetricsServer::handle_client(Client &client) {
+    char buf[1024];
+    ssize_t len = recv(client.fd, buf, sizeof(buf), MSG_DONTWAIT);
+    if(len == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+	return false;
+    } else if(len <= 0) {
+	return true;
+    }
+
+    // Read until the end of the request headers. The body, if any, is ignored.
+    std::string &request = client.request;
+    request.append(buf, len);
+    if(request.find("\r\n\r\n") == std::string::npos &&
+       request.find("\n\n") == std::string::npos &&
+       request.size() < MAX_REQUEST_LEN) {
+	return false;
+    }
+
+    std::string status, content_type, body;
+    if(request.compare(0, 13, "GET /metrics ") == 0 || request.compare(0, 6, "GET / ") == 0) {
+	status = "200 OK";
+	content_type = "application/openmetrics-text; version=1.0.0; charset=utf-8";
+	body = render_metrics();
+    } else {
+	status = "404 Not Found";
+	content_type = "text/plain; charset=utf-8";
+	body = "Metrics are served at /metrics\n";
+    }
+
+    std::string response;
+    response.reserve(body.size() + 128);
+    response.append("HTTP/1.0 ").append(status).append("\r\n");
+    response.append("Content-Type: ").append(content_type).append("\r\n");
+    response.append("Content-Length: ").append(std::to_string(body.size())).append("\r\n");
+    response.append("Connection: close\r\n\r\n");
+    response.append(body);
+
+    write_all(client.fd, response);
+    return true;
+}
+
+std::string MetricsServer::render_metrics() {
+    // Take the snapshot first, so no locks are held while formatting.
+    auto totals = shmem->counters.get_totals();
+    auto mac_tbl_size = shmem->mac_tbl.get_size();
+    auto depths = shmem->packet_queue.get_depths();
+    auto vlans = shmem->vlans.get_vlans();
+    auto intf_vlans = shmem->vlans.get_intf_vlans();
+
+    auto ports = shmem->ports.snapshot();
+
+    std::vector<std::string> names;
+    for(auto &port : ports) {
+	names.push_back(escape_label(port.dev->getName()));
+    }
+
+    std::string out;
+    out.reserve(512 + names.size() * 512);
+
+    const std::vector<std::pair<std::string, long unsigned Counters::CounterData::*>> port_ctrs = {
+	{"vswitch_port_ingress_packets", &Counters::CounterData::ingress_pckts},
+	{"vswitch_port_ingress_bytes", &Counters::CounterData::ingress_bytes},
+	{"vswitch_port_egress_packets", &Counters::CounterData::egress_pckts},
+	{"vswitch_port_egress_bytes", &Counters::CounterData::egress_bytes}
+    };
+
+    for(auto [name, field] : port_ctrs) {
+	out.append("# TYPE ").append(name).append(" counter\n");
+	for(long unsigned i = 0; i < names.size(); i++) {
+	    out.append(name).append("_total{port=\"").append(names[i]).append("\"} ");
+	    out.append(std::to_string(totals[ports[i].index].*field)).append("\n");
+	}
+    }
+
+    out.append("# TYPE vswitch_port_up gauge\n");
+    for(long unsigned i = 0; i < names.size(); i++) {
+	out.append("vswitch_port_up{port=\"").append(names[i]).append("\"} ");
+	out.append(ports[i].link_up ? "1\n" : "0\n");
+    }
+
+    out.append("# TYPE vswitch_mac_table_entries gauge\n");
+    out.append("vswitch_mac_table_entries ").append(std::to_string(mac_tbl_size)).append("\n");
+
+    out.append("# TYPE vswitch_queue_depth gauge\n");
+    out.append("vswitch_queue_depth{stage=\"process\"} ");
+    out.append(std::to_string(depths.to_process)).append("\n");
+    out.append("vswitch_queue_depth{stage=\"egress\"} ");
+    out.append(std::to_string(depths.to_egress)).append("\n");
+    out.append("# TYPE vswitch_queue_capacity gauge\n");
+    out.append("vswitch_queue_capacity ").append(std::to_string(depths.capacity)).append("\n");
+
+    out.append("# TYPE vswitch_vlan info\n");
+    for(int vlan : vlans) {
+	out.append("vswitch_vlan_info{vlan=\"").append(std::to_string(vlan)).append("\"} 1\n");
+    }
+
+    out.append("# TYPE vswitch_port_vlan info\n");
+    for(long unsigned i = 0; i < names.size(); i++) {
+	out.append("vswitch_port_vlan_info{port=\"").append(names[i]).append("\",vlan=\"");
+	out.append(std::to_string(intf_vlans[ports[i].index])).append("\"} 1\n");
+    }
+
+    out.append("# EOF\n");
+    return out;
+}
@@ -0,0 +1,498 @@
+/*
+ * multicast_snooping.cpp - Implementation of the MulticastSnooping class.
+ */
+
+#include <algorithm>
+#include <iomanip>
+#include <set>
+#include <arpa/inet.h>
+#include "ethernet_view.hpp"
+#include "multicast_snooping.hpp"
+
+// IP protocol and IPv6 next header numbers
+static const int PROTO_IGMP = 2;
+static const int NEXT_HOP_BY_HOP = 0;
+static const int NEXT_ICMPV6 = 58;
+static const size_t IPV4_MIN_HEADER_LEN = 20;
+static const size_t IPV6_HEADER_LEN = 40;
+
+// IGMP message types (RFC 2236, RFC 3376)
+static const int IGMP_QUERY = 0x11;
+static const int IGMPV1_REPORT = 0x12;
+static const int IGMPV2_REPORT = 0x16;
+static const int IGMPV2_LEAVE = 0x17;
+static const int IGMPV3_REPORT = 0x22;
+
+// MLD message types (RFC 2710, RFC 3810)
+static const int MLD_QUERY = 130;
+static const int MLDV1_REPORT = 131;
+static const int MLDV1_DONE = 132;
+static const int MLDV2_REPORT = 143;
+
+// IGMPv3 and MLDv2 group record types
+static const int MODE_IS_INCLUDE = 1;
+static const int CHANGE_TO_INCLUDE = 3;
+static const int BLOCK_OLD_SOURCES = 6;
+
+static int read16(const uint8_t *data) {
+    return (data[0] << 8) | data[1];
+}
+
+static MulticastSnooping::IpAddr ipv4_group(const uint8_t *addr) {
+    MulticastSnooping::IpAddr group = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff};
+    std::copy(addr, addr + 4, group.begin() + 12);
+    return group;
+}
+
+static MulticastSnooping::IpAddr ipv6_group(const uint8_t *addr) {
+    MulticastSnooping::IpAddr group;
+    std::copy(addr, addr + 16, group.begin());
+    return group;
+}
+
+void MulticastSnooping::set_enabled(bool enabled) {
+    this->enabled.store(enabled);
+    if(enabled) {
+	return;
+    }
+
+    // Start from nothing if snooping is enabled again, rather than trusting stale memberships
+    table_access.lock();
+    groups.clear();
+    group_macs.clear();
+    routers.clear();
+    table_access.unlock();
+}
+
+bool MulticastSnooping::is_enabled() const {
+    return enabled.load();
+}
+
+bool MulticastSnooping::filter_flood(const pcpp::RawPacket &pckt,
+				     const pcpp::MacAddress &dst_mac,
+				     int src_intf,
+				     int vlan,
+				     PortMask &dst_intfs) {
+    if(!enabled.load(std::memory_order_relaxed)) {
+	return false;
+    }
+
+    uint8_t addr[6];
+    dst_mac.copyTo(addr);
+    if((addr[0] & 0x01) == 0) {
+	return false;
+    }
+
+    message_kind kind = snoop(pckt, src_intf, vlan);
+    if(kind == QUERY) {
+	return false;
+    }
+
+    uint64_t mac = 0;
+    for(uint8_t octet : addr) {
+	mac = (mac << 8) | octet;
+    }
+
+    std::lock_guard<std::mutex> guard(table_access);
+    if(kind == REPORT) {
+	dst_intfs = get_router_mask(vlan);
+	return true;
+    }
+
+    auto group_it = group_macs.find({vlan, mac});
+    if(group_it == group_macs.end()) {
+	return false;
+    }
+    dst_intfs = group_it->second | get_router_mask(vlan);
+    return true;
+}
+
+MulticastSnooping::message_kind MulticastSnooping::snoop(const pcpp::RawPacket &pckt,
+							 int src_intf,
+							 int vlan) {
+    EthernetView eth(pckt);
+    if(!eth.is_valid()) {
+	return NOT_SNOOPED;
+    }
+
+    // The IP header follows any VLAN tags
+    const uint8_t *ip = eth.payload();
+    size_t len = eth.payload_len();
+    if(eth.ether_type() == EthernetView::ETHER_TYPE_IPV4) {
+	if(len < IPV4_MIN_HEADER_LEN || (ip[0] >> 4) != 4 || ip[9] != PROTO_IGMP) {
+	    return NOT_SNOOPED;
+	}
+
+	size_t header_len = (ip[0] & 0x0f) * 4;
+	size_t total_len = read16(ip + 2);
+	if(header_len < IPV4_MIN_HEADER_LEN || total_len < header_len || total_len > len) {
+	    return NOT_SNOOPED;
+	}
+	return snoop_igmp(ip + header_len, total_len - header_len, src_intf, vlan);
+    } else if(eth.ether_type() == EthernetView::ETHER_TYPE_IPV6) {
+	if(len < IPV6_HEADER_LEN || (ip[0] >> 4) != 6) {
+	    return NOT_SNOOPED;
+	}
+
+	size_t remaining = read16(ip + 4);
+	if(IPV6_HEADER_LEN + remaining > len) {
+	    return NOT_SNOOPED;
+	}
+
+	// MLD messages carry a router alert in a hop-by-hop options header
+	int next_header = ip[6];
+	const uint8_t *header = ip + IPV6_HEADER_LEN;
+	if(next_header == NEXT_HOP_BY_HOP) {
+	    if(remaining < 8 || static_cast<size_t>(header[1] + 1) * 8 > remaining) {
+		return NOT_SNOOPED;
+	    }
+
+	    size_t options_len = (header[1] + 1) * 8;
+	    next_header = header[0];
+	    header += options_len;
+	    remaining -= options_len;
+	}
+
+	if(next_header != NEXT_ICMPV6) {
+	    return NOT_SNOOPED;
+	}
+	return snoop_mld(header, remaining, src_intf, vlan);
+    }
+
+    return NOT_SNOOPED;
+}
+
+MulticastSnooping::message_kind MulticastSnooping::snoop_igmp(const uint8_t *msg,
+							      size_t len,
+							      int src_intf,
+							      int vlan) {
+    if(len < 8) {
+	return NOT_SNOOPED;
+    }
+
+    switch(msg[0]) {
+    case IGMP_QUERY:
+	add_router(vlan, src_intf);
+	return QUERY;
+    case IGMPV1_REPORT:
+    case IGMPV2_REPORT:
+	join(vlan, ipv4_group(msg + 4), src_intf);
+	return REPORT;
+    case IGMPV2_LEAVE:
+	leave(vlan, ipv4_group(msg + 4), src_intf);
+	return REPORT;
+    case IGMPV3_REPORT:
+	break;
+    default:
+	return NOT_SNOOPED;
+    }
+
+    // Each group record is followed by its sources and auxiliary data, which are skipped
+    int num_records = read16(msg + 6);
+    size_t pos = 8;
+    for(int i = 0; i < num_records && pos + 8 <= len; i++) {
+	int type = msg[pos];
+	size_t aux_len = msg[pos + 1] * 4;
+	size_t num_sources = read16(msg + pos + 2);
+	IpAddr group = ipv4_group(msg + pos + 4);
+
+	if((type == MODE_IS_INCLUDE || type == CHANGE_TO_INCLUDE) && num_sources == 0) {
+	    leave(vlan, group, src_intf);
+	} else if(type != BLOCK_OLD_SOURCES) {
+	    join(vlan, group, src_intf);
+	}
+	pos += 8 + num_sources * 4 + aux_len;
+    }
+    return REPORT;
+}
+
+MulticastSnooping::message_kind MulticastSnooping::snoop_mld(const uint8_t *msg,
+							     size_t len,
+							     int src_intf,
+							     int vlan) {
+    if(len < 24) {
+	return NOT_SNOOPED;
+    }
+
+    switch(msg[0]) {
+    case MLD_QUERY:
+	add_router(vlan, src_intf);
+	return QUERY;
+    case MLDV1_REPORT:
+	join(vlan, ipv6_group(msg + 8), src_intf);
+	return REPORT;
+    case MLDV1_DONE:
+	leave(vlan, ipv6_group(msg + 8), src_intf);
+	return REPORT;
+    case MLDV2_REPORT:
+	break;
+    default:
+	return NOT_SNOOPED;
+    }
+
+    int num_records = read16(msg + 6);
+    size_t pos = 8;
+    for(int i = 0; i < num_records && pos + 20 <= len; i++) {
+	int type = msg[pos];
+	size_t aux_len = msg[pos + 1] * 4;
+	size_t num_sources = read16(msg + pos + 2);
+	IpAddr group = ipv6_group(msg + pos + 4);
+
+	if((type == MODE_IS_INCLUDE || type == CHANGE_TO_INCLUDE) && num_sources == 0) {
+	    leave(vlan, group, src_intf);
+	} else if(type != BLOCK_OLD_SOURCES) {
+	    join(vlan, group, src_intf);
+	}
+	pos += 20 + num_sources * 16 + aux_len;
+    }
+    return REPORT;
+}
+
+void MulticastSnooping::join(int vlan, const IpAddr &group, int intf) {
+    bool multicast = is_ipv4(group) ? (group[12] & 0xf0) == 0xe0 : group[0] == 0xff;
+    if(!multicast || is_link_local(group)) {
+	return;
+    }
+
+    std::lock_guard<std::mutex> guard(table_access);
+    auto &members = groups[{vlan, group}];
+    bool is_new = members.find(intf) == members.end();
+    members[intf] = std::time(nullptr) + MEMBER_TIMEOUT;
+    if(is_new) {
+	update_group_mac(vlan, mac_for_group(group));
+    }
+}
+
+void MulticastSnooping::leave(int vlan, const IpAddr &group, int intf) {
+    std::lock_guard<std::mutex> guard(table_access);
+    auto group_it = groups.find({vlan, group});
+    if(group_it == groups.end()) {
+	return;
+    }
+
+    auto member_it = group_it->second.find(intf);
+    if(member_it != group_it->second.end()) {
+	member_it->second = std::min(member_it->second, std::time(nullptr) + LEAVE_TIMEOUT);
+    }
+}
+
+void MulticastSnooping::add_router(int vlan, int intf) {
+    std::lock_guard<std::mutex> guard(table_access);
+    routers[vlan][intf] = std::time(nullptr) + ROUTER_TIMEOUT;
+}
+
+/*
+ * update_group_mac() - Recomputes the ports a multicast MAC address is forwarded to in a VLAN from
+ * the members of every group which maps to it. Must be called with table_access held.
+ */
+void MulticastSnooping::update_group_mac(int vlan, uint64_t mac) {
+    PortMask mask;
+    for(auto group_it = groups.lower_bound({vlan, IpAddr()});
+	group_it != groups.end() && group_it->first.first == vlan; group_it++) {
+	if(mac_for_group(group_it->first.second) != mac) {
+	    continue;
+	}
+
+	for(auto &[intf, expires] : group_it->second) {
+	    mask.set(intf);
+	}
+    }
+
+    if(mask.none()) {
+	group_macs.erase({vlan, mac});
+    } else {
+	group_macs[{vlan, mac}] = mask;
+    }
+}
+
+/*
+ * get_router_mask() - Returns the router ports in a VLAN. Must be called with table_access held.
+ */
+MulticastSnooping::PortMask MulticastSnooping::get_router_mask(int vlan) {
+    PortMask mask;
+    auto vlan_it = routers.find(vlan);
+    if(vlan_it == routers.end()) {
+	return mask;
+    }
+
+    for(auto &[intf, expires] : vlan_it->second) {
+	mask.set(intf);
+    }
+    return mask;
+}
+
+int MulticastSnooping::age_entries() {
+    int num_aged_out = 0;
+    std::set<std::pair<int, uint64_t>> changed;
+    std::time_t cur_time = std::time(nullptr);
+
+    table_access.lock();
+    auto group_it = groups.begin();
+    while(group_it != groups.end()) {
+	auto &members = group_it->second;
+	auto member_it = members.begin();
+	while(member_it != members.end()) {
+	    if(member_it->second < cur_time) {
+		num_aged_out++;
+		changed.insert({group_it->first.first, mac_for_group(group_it->first.second)});
+		members.erase(member_it++);
+	    } else {
+		member_it++;
+	    }
+	}
+
+	if(members.empty()) {
+	    groups.erase(group_it++);
+	} else {
+	    group_it++;
+	}
+    }
+
+    for(auto &[vlan, mac] : changed) {
+	update_group_mac(vlan, mac);
+    }
+
+    for(auto &[vlan, vlan_routers] : routers) {
+	num_aged_out += std::erase_if(vlan_routers, [cur_time](const auto &router) {
+	    return router.second < cur_time;
+	});
+    }
+    table_access.unlock();
+
+    return num_aged_out;
+}
+
+void MulticastSnooping::reset_intf(int intf) {
+    std::set<std::pair<int, uint64_t>> changed;
+
+    table_access.lock();
+    auto group_it = groups.begin();
+    while(group_it != groups.end()) {
+	if(group_it->second.erase(intf) != 0) {
+	    changed.insert({group_it->first.first, mac_for_group(group_it->first.second)});
+	}
+
+	if(group_it->second.empty()) {
+	    groups.erase(group_it++);
+	} else {
+	    group_it++;
+	}
+    }
+
+    for(auto &[vlan, mac] : changed) {
+	update_group_mac(vlan, mac);
+    }
+
+    for(auto &[vlan, vlan_routers] : routers) {
+	vlan_routers.erase(intf);
+    }
+    table_access.unlock();
+}
+
+std::vector<MulticastSnooping::GroupInfo> MulticastSnooping::snapshot_groups() {
+    std::vector<GroupInfo> entries;
+
+    table_access.lock();
+    for(auto &[key, members] : groups) {
+	GroupInfo info = {key.first, key.second, {}};
+	for(auto &[intf, expires] : members) {
+	    info.intfs.push_back(intf);
+	}
+	entries.push_back(info);
+    }
+    table_access.unlock();
+
+    return entries;
+}
+
+std::vector<MulticastSnooping::RouterInfo> MulticastSnooping::snapshot_routers() {
+    std::vector<RouterInfo> entries;
+
+    table_access.lock();
+    for(auto &[vlan, vlan_routers] : routers) {
+	for(auto &[intf, expires] : vlan_routers) {
+	    entries.push_back({vlan, intf, expires});
+	}
+    }
+    table_access.unlock();
+
+    return entries;
+}
+
+void MulticastSnooping::print_groups(std::ostream &out, const Ports &ports) {
+    auto entries = snapshot_groups();
+    int pad = 10;
+
+    out << std::setw(pad) << std::left << "VLAN" << std::setw(4 * pad) << "Group" << "Ports"
+	<< std::endl;
+    for(auto &entry : entries) {
+	// Ports may have been removed since the entries were copied out
+	std::string names;
+	for(int intf : entry.intfs) {
+	    pcpp::PcapLiveDevice *dev = ports.get(intf);
+	    if(dev != nullptr) {
+		names += (names.empty() ? "" : ",") + dev->getName();
+	    }
+	}
+
+	out << std::setw(pad) << std::left << entry.vlan << std::setw(4 * pad)
+	    << to_string(entry.group) << (names.empty() ? "-" : names) << std::endl;
+    }
+    out << std::endl;
+}
+
+void MulticastSnooping::print_routers(std::ostream &out, const Ports &ports) {
+    auto entries = snapshot_routers();
+    std::time_t cur_time = std::time(nullptr);
+    int pad = 14;
+
+    out << std::setw(pad) << std::left << "VLAN" << std::setw(pad) << "Port" << "Expires"
+	<< std::endl;
+    for(auto &entry : entries) {
+	pcpp::PcapLiveDevice *dev = ports.get(entry.intf);
+	out << std::setw(pad) << std::left << entry.vlan << std::setw(pad)
+	    << (dev != nullptr ? dev->getName() : "-")
+	    << std::max<double>(difftime(entry.expires, cur_time), 0) << std::endl;
+    }
+    out << std::endl;
+}
+
+void MulticastSnooping::write_config(std::ostream &out) {
+    if(is_enabled()) {
+	out << "multicast snooping" << std::endl;
+    }
+}
+
+uint64_t MulticastSnooping::mac_for_group(const IpAddr &group) {
+    // IPv4 groups map their low 23 bits into 01:00:5e:00:00:00, and IPv6 groups their low 32 bits
+    // into 33:33:00:00:00:00
+    if(is_ipv4(group)) {
+	return 0x01005e000000ULL | (static_cast<uint64_t>(group[13] & 0x7f) << 16) |
+	    (group[14] << 8) | group[15];
+    }
+    return 0x333300000000ULL | (static_cast<uint64_t>(group[12]) << 24) | (group[13] << 16) |
+	(group[14] << 8) | group[15];
+}
+
+bool MulticastSnooping::is_link_local(const IpAddr &group) {
+    // Any IPv4 group sharing a MAC address with 224.0.0.0/24 would prune it along with the group
+    if(is_ipv4(group)) {
+	return (group[13] & 0x7f) == 0 && group[14] == 0;
+    }
+    return (group[1] & 0x0f) <= 2;
+}
+
+bool MulticastSnooping::is_ipv4(const IpAddr &group) {
+    static const IpAddr prefix = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff};
+    return std::equal(prefix.begin(), prefix.begin() + 12, group.begin());
+}
+
+std::string MulticastSnooping::to_string(const IpAddr &group) {
+    char buf[INET6_ADDRSTRLEN];
+    if(is_ipv4(group)) {
+	inet_ntop(AF_INET, group.data() + 12, buf, sizeof(buf));
+    } else {
+	inet_ntop(AF_INET6, group.data(), buf, sizeof(buf));
+    }
+    return buf;
+}
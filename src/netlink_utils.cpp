@@ -0,0 +1,236 @@
+/*
+ * netlink_utils.cpp - Implementation file for rtnetlink utilities.
+ *
+ * Contains definitions for all functions in include/netlink_utils.hpp
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <err.h>
+#include <arpa/inet.h>
+#include <linux/if.h>
+#include <linux/rtnetlink.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "netlink_utils.hpp"
+
+/*
+ * format_mac() - Formats a hardware address as colon separated hex octets.
+ */
+static std::string format_mac(const unsigned char *addr, int len) {
+    std::string mac;
+    char octet[4];
+    for(int i = 0; i < len; i++) {
+	snprintf(octet, sizeof(octet), i == 0 ? "%02x" : ":%02x", addr[i]);
+	mac.append(octet);
+    }
+    return mac;
+}
+
+/*
+ * send_dump_request() - Asks the kernel to dump every object of the given type.
+ */
+static bool send_dump_request(int fd, unsigned short type, unsigned seq) {
+    struct {
+	struct nlmsghdr hdr;
+	union {
+	    struct ifinfomsg link;
+	    struct ifaddrmsg addr;
+	};
+    } req;
+
+    memset(&req, 0, sizeof(req));
+    req.hdr.nlmsg_type = type;
+    req.hdr.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.hdr.nlmsg_seq = seq;
+    if(type == RTM_GETLINK) {
+	req.hdr.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg));
+	req.link.ifi_family = AF_UNSPEC;
+    } else {
+	req.hdr.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifaddrmsg));
+	req.addr.ifa_family = AF_UNSPEC;
+    }
+
+    return send(fd, &req, req.hdr.nlmsg_len, 0) == static_cast<ssize_t>(req.hdr.nlmsg_len);
+}
+
+/*
+ * parse_addr_msg() - Appends the address described by an RTM_NEWADDR message to the link with the
+ * same interface index.
+ */
+static void parse_addr_msg(const struct nlmsghdr *msg, std::map<int, LinkInfo *> &by_index) {
+    auto ifa = static_cast<const struct ifaddrmsg *>(NLMSG_DATA(msg));
+    auto link_it = by_index.find(ifa->ifa_index);
+    if(link_it == by_index.end()) {
+	return;
+    }
+
+    const void *addr = nullptr, *local = nullptr;
+    int len = IFA_PAYLOAD(msg);
+    for(auto rta = IFA_RTA(ifa); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+	if(rta->rta_type == IFA_ADDRESS) {
+	    addr = RTA_DATA(rta);
+	} else if(rta->rta_type == IFA_LOCAL) {
+	    local = RTA_DATA(rta);
+	}
+    }
+
+    // For point-to-point links IFA_ADDRESS is the peer, so prefer IFA_LOCAL when it is present.
+    if(local != nullptr) {
+	addr = local;
+    }
+    if(addr == nullptr || (ifa->ifa_family != AF_INET && ifa->ifa_family != AF_INET6)) {
+	return;
+    }
+
+    char buf[INET6_ADDRSTRLEN];
+    if(inet_ntop(ifa->ifa_family, addr, buf, sizeof(buf)) == nullptr) {
+	return;
+    }
+
+    std::string entry = ifa->ifa_family == AF_INET ? "inet " : "inet6 ";
+    entry.append(buf).append("/").append(std::to_string(ifa->ifa_prefixlen));
+    link_it->second->ip_addrs.push_back(entry);
+}
+
+bool parse_link_msg(const struct nlmsghdr *msg, LinkInfo &link) {
+    if(msg->nlmsg_type != RTM_NEWLINK && msg->nlmsg_type != RTM_DELLINK) {
+	return false;
+    }
+
+    auto ifi = static_cast<const struct ifinfomsg *>(NLMSG_DATA(msg));
+    link.index = ifi->ifi_index;
+    link.flags = ifi->ifi_flags;
+
+    int len = IFLA_PAYLOAD(msg);
+    for(auto rta = IFLA_RTA(ifi); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+	switch(rta->rta_type) {
+	case IFLA_IFNAME:
+	    link.name = static_cast<const char *>(RTA_DATA(rta));
+	    break;
+	case IFLA_MTU:
+	    link.mtu = *static_cast<const unsigned *>(RTA_DATA(rta));
+	    break;
+	case IFLA_OPERSTATE:
+	    link.operstate = *static_cast<const unsigned char *>(RTA_DATA(rta));
+	    break;
+	case IFLA_ADDRESS:
+	    link.mac_addr = format_mac(static_cast<const unsigned char *>(RTA_DATA(rta)),
+				       RTA_PAYLOAD(rta));
+	    break;
+	case IFLA_STATS64:
+	    memcpy(&link.stats, RTA_DATA(rta),
+		   std::min<long unsigned>(RTA_PAYLOAD(rta), sizeof(link.stats)));
+	    break;
+	}
+    }
+
+    return true;
+}
+
+bool dump_links(std::vector<LinkInfo> &links) {
+    int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if(fd == -1) {
+	warn("socket() failed. Cannot query interfaces over netlink.");
+	return false;
+    }
+
+    std::map<int, LinkInfo *> by_index;
+    std::vector<char> buf(32768);
+    const unsigned short requests[] = {RTM_GETLINK, RTM_GETADDR};
+    unsigned seq = 0;
+
+    links.clear();
+    for(auto type : requests) {
+	if(!send_dump_request(fd, type, ++seq)) {
+	    warn("send() failed. Cannot query interfaces over netlink.");
+	    close(fd);
+	    return false;
+	}
+
+	// Links must all be collected before they are indexed, since the vector may reallocate.
+	if(type == RTM_GETADDR) {
+	    for(auto &link : links) {
+		by_index[link.index] = &link;
+	    }
+	}
+
+	bool done = false;
+	while(!done) {
+	    ssize_t len = recv(fd, buf.data(), buf.size(), 0);
+	    if(len <= 0) {
+		warn("recv() failed. Cannot query interfaces over netlink.");
+		close(fd);
+		return false;
+	    }
+
+	    int remaining = len;
+	    for(auto msg = reinterpret_cast<struct nlmsghdr *>(buf.data());
+		NLMSG_OK(msg, remaining);
+		msg = NLMSG_NEXT(msg, remaining)) {
+		if(msg->nlmsg_seq != seq) {
+		    continue;
+		}
+
+		if(msg->nlmsg_type == NLMSG_DONE) {
+		    done = true;
+		    break;
+		} else if(msg->nlmsg_type == NLMSG_ERROR) {
+		    std::cerr << "Netlink returned an error while dumping interfaces." << std::endl;
+		    close(fd);
+		    return false;
+		} else if(msg->nlmsg_type == RTM_NEWLINK) {
+		    LinkInfo link;
+		    if(parse_link_msg(msg, link)) {
+			links.push_back(link);
+		    }
+		} else if(msg->nlmsg_type == RTM_NEWADDR) {
+		    parse_addr_msg(msg, by_index);
+		}
+	    }
+	}
+    }
+
+    close(fd);
+    return true;
+}
+
+void print_link(std::ostream &out, const LinkInfo &link) {
+    const char *operstates[] = {
+	"UNKNOWN", "NOTPRESENT", "DOWN", "LOWERLAYERDOWN", "TESTING", "DORMANT", "UP"
+    };
+    const char *state = link.operstate < sizeof(operstates) / sizeof(operstates[0]) ?
+	operstates[link.operstate] : "UNKNOWN";
+
+    std::string flags;
+    const std::vector<std::pair<unsigned, std::string>> flag_names = {
+	{IFF_BROADCAST, "BROADCAST"},
+	{IFF_MULTICAST, "MULTICAST"},
+	{IFF_PROMISC, "PROMISC"},
+	{IFF_UP, "UP"},
+	{IFF_LOWER_UP, "LOWER_UP"}
+    };
+    for(auto [flag, name] : flag_names) {
+	if(link.flags & flag) {
+	    flags.append(flags.empty() ? "" : ",").append(name);
+	}
+    }
+
+    out << link.index << ": " << link.name << ": <" << flags << "> mtu " << link.mtu
+	<< " state " << state << std::endl;
+    out << "    link/ether " << link.mac_addr << std::endl;
+    for(auto &addr : link.ip_addrs) {
+	out << "    " << addr << std::endl;
+    }
+    out << "    RX: bytes " << link.stats.rx_bytes
+	<< " packets " << link.stats.rx_packets
+	<< " errors " << link.stats.rx_errors
+	<< " dropped " << link.stats.rx_dropped << std::endl;
+    out << "    TX: bytes " << link.stats.tx_bytes
+	<< " packets " << link.stats.tx_packets
+	<< " errors " << link.stats.tx_errors
+	<< " dropped " << link.stats.tx_dropped << std::endl;
+    return;
+}
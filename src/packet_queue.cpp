@@ -2,128 +2,248 @@
  * packet_queue.cpp - Implementation of the PacketQueue and PQueueEntry classes.
  */
 
+#include <algorithm>
+#include <thread>
 #include <vector>
-#include <EthLayer.h>
 #include <RawPacket.h>
+#include "forwarding.hpp"
 #include "mac_addr_table.hpp"
 #include "packet_queue.hpp"
+#include "tracepoints.hpp"
 #include "vlans.hpp"
 
-#include <iostream>
-
 PQueueEntry::PQueueEntry() {}
-PQueueEntry::PQueueEntry(pcpp::RawPacket pckt, pcpp::PcapLiveDevice *src_intf)
+PQueueEntry::PQueueEntry(pcpp::RawPacket pckt, int src_intf)
     : pckt(pckt),
       src_intf(src_intf)
 {}
 
-bool PacketQueue::push_packet(pcpp::RawPacket pckt, pcpp::PcapLiveDevice *src_intf) {
-    PQueueEntry obj(pckt, src_intf);
+/*
+ * PQueueEntry() - Makes an entry whose packet data is kept in a buffer of its own, which starts out
+ * with room for capacity bytes, and only grows for larger packets.
+ */
+PQueueEntry::PQueueEntry(size_t capacity)
+    : pckt(nullptr, 0, timespec{}, false),
+      src_intf(-1),
+      buffered(true) {
+    buffer.reserve(capacity);
+}
+
+/*
+ * copy_from() - Copies another entry into this one. An entry with a buffer of its own copies the
+ * packet data into it, so that nothing is allocated once it has grown to fit.
+ */
+void PQueueEntry::copy_from(const PQueueEntry &other) {
+    src_intf = other.src_intf;
+    dst_intfs = other.dst_intfs;
+    epoch = other.epoch;
+    if(!buffered) {
+	pckt = other.pckt;
+	return;
+    }
+
+    const uint8_t *data = other.pckt.getRawData();
+    buffer.assign(data, data + other.pckt.getRawDataLen());
+    pckt.setRawData(buffer.data(), buffer.size(), other.pckt.getPacketTimeStamp(),
+		    other.pckt.getLinkLayerType(), other.pckt.getFrameLength());
+}
+
+/*
+ * cpu_relax() - Tells the CPU that the calling thread is spinning, so that it may save power and
+ * give way to the other hardware thread on the same core.
+ */
+static inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+bool PacketQueue::StageWaiter::wait(const std::atomic<wait_policy> &policy,
+				    const std::atomic<int> &count) {
+    // Nothing more is added to a closed stage, so its count is final once closed has been seen.
+    while(policy.load(std::memory_order_relaxed) == BUSY_POLL) {
+	for(int i = 0; i < MAX_SPIN; i++) {
+	    if(count.load(std::memory_order_acquire) > 0) {
+		return true;
+	    }
+	    cpu_relax();
+	}
+
+	if(closed.load()) {
+	    return count.load() > 0;
+	}
+    }
 
+    if(policy.load(std::memory_order_relaxed) == ADAPTIVE) {
+	int limit = spin_limit.load(std::memory_order_relaxed);
+	for(int i = 0; i < limit; i++) {
+	    if(count.load(std::memory_order_acquire) > 0) {
+		spin_limit.store(std::min(limit * 2, MAX_SPIN), std::memory_order_relaxed);
+		return true;
+	    }
+	    cpu_relax();
+	}
+
+	for(int i = 0; i < NUM_YIELDS; i++) {
+	    if(count.load(std::memory_order_acquire) > 0) {
+		return true;
+	    }
+	    std::this_thread::yield();
+	}
+	spin_limit.store(std::max(limit / 2, MIN_SPIN), std::memory_order_relaxed);
+    }
+
+    // Announcing that we are about to sleep before checking the count one last time guarantees
+    // that any producer which increments the count afterwards sees the announcement and wakes us.
+    std::unique_lock<std::mutex> lock(mtx);
+    sleeping.store(true);
+    cond.wait(lock, [this, &count]() {
+	return count.load() > 0 || closed.load();
+    });
+    sleeping.store(false);
+
+    return count.load() > 0;
+}
+
+void PacketQueue::StageWaiter::notify() {
+    if(sleeping.load()) {
+	std::lock_guard<std::mutex> guard(mtx);
+	cond.notify_one();
+    }
+}
+
+void PacketQueue::StageWaiter::close() {
+    {
+	std::lock_guard<std::mutex> guard(mtx);
+	closed.store(true);
+    }
+    cond.notify_one();
+}
+
+int PacketQueue::StageWaiter::get_spin_limit() {
+    return spin_limit.load(std::memory_order_relaxed);
+}
+
+bool PacketQueue::push_packet(pcpp::RawPacket pckt, int src_intf) {
     prod_mtx.lock();
 
-    if(space == 0) {
+    if(space.load() == 0) {
 	prod_mtx.unlock();
+	VSWITCH_TRACE(queue_drop, src_intf, trace_timestamp(pckt));
 	return false;
     }
 
-    packet_queue[in] = obj;
+    packet_queue[in].pckt = pckt;
+    packet_queue[in].src_intf = src_intf;
     in = (in + 1) % queue_size;
-    space--;
+    space.fetch_sub(1);
     prod_mtx.unlock();
+    VSWITCH_TRACE(enqueue, src_intf, trace_timestamp(pckt));
 
-    proc_mtx.lock();
-    to_proc++;
-    proc_mtx.unlock();
-    proc_cond.notify_one();
+    to_proc.fetch_add(1);
+    proc_waiter.notify();
 
     return true;
 }
 
-void PacketQueue::process_packet(MacAddrTable *mac_tbl,
+bool PacketQueue::process_packet(MacAddrTable *mac_tbl,
 				 Vlans *vlans,
-				 std::vector<pcpp::PcapLiveDevice *> *veth_intfs) {
-    std::unique_lock<std::mutex> local_mtx(proc_mtx);
-    while(to_proc == 0) {
-	proc_cond.wait(local_mtx);
+				 Ports *ports,
+				 StormControl *storm_ctl,
+				 MulticastSnooping *snooping,
+				 LinkAggregation *lags) {
+    if(!proc_waiter.wait(policy, to_proc)) {
+	// Everything has been processed, so nothing more will reach the egress stage either
+	cons_waiter.close();
+	return false;
     }
 
-    // Update MAC address table based on incoming packet
     PQueueEntry &entry = packet_queue[proc];
-    pcpp::Packet parsed_pckt(&entry.pckt);
-    pcpp::EthLayer *eth_layer = parsed_pckt.getLayerOfType<pcpp::EthLayer>();
-    mac_tbl->push_mapping(eth_layer->getSourceMac(), entry.src_intf);
-
-    // Make forwarding decision based on MAC table
-    std::vector<pcpp::PcapLiveDevice *> out_intfs;
-    pcpp::PcapLiveDevice *mapping = mac_tbl->get_mapping(eth_layer->getDestMac());
-
-    // Get vector index of the current interface
-
-    // TODO: Change MAC address table to use interface indices rather than PcapLiveDevices for addr
-    // to intf mappings. Since the interface vector is constant through the runtime of the switch,
-    // it should be safe to use their integer index to identify them.
-    long unsigned int cur_intf;
-    for(cur_intf = 0; cur_intf < veth_intfs->size(); cur_intf++) {
-	if((*veth_intfs)[cur_intf] == entry.src_intf) {
-	    break;
-	}
-    }
+    entry.epoch = ports->get_epoch();
+    decide_forwarding(&entry.pckt, entry.src_intf, mac_tbl, vlans, ports, storm_ctl, snooping, lags,
+		      entry.dst_intfs);
+    VSWITCH_TRACE(forward, entry.src_intf, trace_timestamp(entry.pckt), entry.dst_intfs.size(),
+		  entry.dst_intfs.data());
 
-    int in_intf_vlan = vlans->get_vlan_for_intf(cur_intf);
-    if(mapping == nullptr) {
-	// Broadcast to intfs in VLAN if no mapping exists
-	for(long unsigned int i = 0; i < veth_intfs->size(); i++) {
-	    if(i == cur_intf || vlans->get_vlan_for_intf(i) != in_intf_vlan) {
-		continue;
-	    }
+    // Increment buffer pointers
+    proc = (proc + 1) % queue_size;
+    to_proc.fetch_sub(1);
 
-	    out_intfs.push_back((*veth_intfs)[i]);
-	}
-    } else if(mapping != entry.src_intf) {
-	// Otherwise, if the packet is destined for a different intf from the src and exists on the
-	// same VLAN, forward to it
-	long unsigned int dst_intf;
-	for(dst_intf = 0; dst_intf < veth_intfs->size(); dst_intf++) {
-	    if((*veth_intfs)[dst_intf] == mapping) {
-		break;
-	    }
-	}
+    objects.fetch_add(1);
+    cons_waiter.notify();
 
-	if(vlans->get_vlan_for_intf(dst_intf) == in_intf_vlan) {
-	    out_intfs.push_back(mapping);
-	}
+    return true;
+}
+
+bool PacketQueue::pop_packet(PQueueEntry &entry) {
+    if(!cons_waiter.wait(policy, objects)) {
+	return false;
     }
 
-    entry.dst_intfs = out_intfs;
+    take_packet(entry);
+    return true;
+}
 
-    // Increment buffer pointers
-    proc = (proc + 1) % queue_size;
-    to_proc--;
-    local_mtx.~unique_lock<std::mutex>();
+bool PacketQueue::try_pop_packet(PQueueEntry &entry) {
+    if(objects.load(std::memory_order_acquire) == 0) {
+	return false;
+    }
 
-    cons_mtx.lock();
-    objects++;
-    cons_mtx.unlock();
-    cons_cond.notify_one();
+    take_packet(entry);
+    return true;
+}
 
-    return;
+void PacketQueue::take_packet(PQueueEntry &entry) {
+    entry.copy_from(packet_queue[out]);
+    out = (out + 1) % queue_size;
+    objects.fetch_sub(1);
+    space.fetch_add(1);
 }
 
-PQueueEntry PacketQueue::pop_packet() {
-    std::unique_lock<std::mutex> local_mtx(cons_mtx);
-    while(objects == 0) {
-	cons_cond.wait(local_mtx);
-    }
+void PacketQueue::close() {
+    proc_waiter.close();
+}
 
-    PQueueEntry popped_val = packet_queue[out];
-    out = (out + 1) % queue_size;
-    objects--;
-    local_mtx.~unique_lock<std::mutex>();
+PacketQueue::QueueDepths PacketQueue::get_depths() {
+    QueueDepths depths;
+    depths.capacity = queue_size;
+    depths.to_process = to_proc.load();
+    depths.to_egress = objects.load();
+    return depths;
+}
 
-    prod_mtx.lock();
-    space++;
-    prod_mtx.unlock();
+void PacketQueue::set_wait_policy(wait_policy policy) {
+    this->policy.store(policy);
+}
 
-    return popped_val;
+PacketQueue::wait_policy PacketQueue::get_wait_policy() {
+    return policy.load();
+}
+
+// The CLI keyword for each wait policy, in the order of PacketQueue::wait_policy
+static const char *policy_names[] = {
+    "busy-poll", "adaptive", "block"
+};
+
+void PacketQueue::print_queue(std::ostream &out) {
+    auto depths = get_depths();
+    auto cur_policy = get_wait_policy();
+
+    out << "Wait policy: " << policy_names[cur_policy] << std::endl
+	<< "Capacity: " << depths.capacity << std::endl
+	<< "To process: " << depths.to_process << std::endl
+	<< "To egress: " << depths.to_egress << std::endl;
+
+    if(cur_policy == ADAPTIVE) {
+	out << "Spin limit: " << proc_waiter.get_spin_limit() << " (processing), "
+	    << cons_waiter.get_spin_limit() << " (egress)" << std::endl;
+    }
+}
+
+void PacketQueue::write_config(std::ostream &out) {
+    if(get_wait_policy() != ADAPTIVE) {
+	out << "queue wait " << policy_names[get_wait_policy()] << std::endl;
+    }
 }
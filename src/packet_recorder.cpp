@@ -0,0 +1,218 @@
+/*
+ * packet_recorder.cpp - Implementation of the PacketRecorder class.
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <vector>
+#include "packet_recorder.hpp"
+
+// The magic number of a pcap file with nanosecond timestamps, written in the host's byte order
+static const uint32_t PCAP_MAGIC_NS = 0xa1b23c4d;
+static const uint32_t LINKTYPE_ETHERNET = 1;
+
+PacketRecorder::PacketRecorder() : ring(RING_SIZE, 2048) {}
+
+/*
+ * start() - Starts recording intf to the file at path, replacing any recording it already has.
+ * Returns false if the file cannot be created.
+ */
+bool PacketRecorder::start(int intf, const std::string &path, uint64_t limit, int snaplen) {
+    if(intf < 0 || intf >= Ports::MAX_PORTS ||
+       (snaplen != 0 && (snaplen < MIN_SNAPLEN || snaplen > MAX_SNAPLEN))) {
+	return false;
+    }
+
+    FILE *file = fopen(path.c_str(), "wb");
+    if(file == nullptr) {
+	return false;
+    }
+    setvbuf(file, nullptr, _IOFBF, BUFFER_SIZE);
+    if(!write_header(file, snaplen == 0 ? MAX_SNAPLEN : snaplen)) {
+	fclose(file);
+	return false;
+    }
+
+    std::lock_guard<std::mutex> lock(files_access);
+    Recording &rec = recordings[intf];
+    close(rec);
+    rec.file = file;
+    rec.path = path;
+    rec.error.clear();
+    rec.session.fetch_add(1, std::memory_order_relaxed);
+    rec.limit.store(limit);
+    rec.snaplen.store(snaplen);
+    rec.claimed.store(0);
+    rec.written.store(0);
+    rec.dropped.store(0);
+    rec.active.store(true, std::memory_order_release);
+    return true;
+}
+
+/*
+ * stop() - Stops intf's recording, if it has one, and forgets about it. Returns false if it had
+ * none.
+ */
+bool PacketRecorder::stop(int intf) {
+    if(intf < 0 || intf >= Ports::MAX_PORTS) {
+	return false;
+    }
+
+    std::lock_guard<std::mutex> lock(files_access);
+    Recording &rec = recordings[intf];
+    if(rec.path.empty()) {
+	return false;
+    }
+    close(rec);
+    rec.path.clear();
+    return true;
+}
+
+void PacketRecorder::reset_intf(int intf) {
+    stop(intf);
+}
+
+/*
+ * record() - Queues a copy of a frame received or sent on intf, if it is being recorded. This is
+ * called by the forwarding path, and never waits.
+ */
+void PacketRecorder::record(int intf, const pcpp::RawPacket &pckt) {
+    Recording &rec = recordings[intf];
+    if(!rec.active.load(std::memory_order_acquire)) {
+	return;
+    }
+
+    // Frames past the limit are not recorded, and the writer closes the file once every frame up
+    // to it has been written or dropped
+    uint64_t limit = rec.limit.load(std::memory_order_relaxed);
+    if(limit != 0 && rec.claimed.fetch_add(1, std::memory_order_relaxed) >= limit) {
+	return;
+    }
+
+    uint32_t snaplen = rec.snaplen.load(std::memory_order_relaxed);
+    uint64_t session = rec.session.load(std::memory_order_relaxed);
+    if(!ring.push(pckt, intf, snaplen == 0 ? UINT32_MAX : snaplen, session)) {
+	rec.dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+/*
+ * write_pending() - Waits briefly for frames to be queued, and writes every one that is to its
+ * port's file. Buffered output is flushed once nothing is left to write. Only the writer thread may
+ * call this.
+ */
+void PacketRecorder::write_pending() {
+    bool ready = ring.wait(WAIT_MS);
+
+    std::lock_guard<std::mutex> lock(files_access);
+    PacketRing::Slot *slot;
+    while((slot = ring.front()) != nullptr) {
+	// Frames queued before their recording was stopped, or for an earlier recording of the same
+	// port, are thrown away
+	Recording &rec = recordings[slot->intf];
+	if(rec.file != nullptr && slot->tag == rec.session.load(std::memory_order_relaxed)) {
+	    uint32_t header[4] = {
+		static_cast<uint32_t>(slot->timestamp.tv_sec),
+		static_cast<uint32_t>(slot->timestamp.tv_nsec),
+		static_cast<uint32_t>(slot->data.size()),
+		slot->orig_len
+	    };
+	    if(fwrite(header, sizeof(header), 1, rec.file) != 1 ||
+	       fwrite(slot->data.data(), 1, slot->data.size(), rec.file) != slot->data.size()) {
+		fail(rec);
+	    } else {
+		rec.written.fetch_add(1, std::memory_order_relaxed);
+	    }
+	}
+	ring.pop();
+    }
+
+    for(auto &rec : recordings) {
+	if(rec.file == nullptr) {
+	    continue;
+	}
+
+	uint64_t limit = rec.limit.load();
+	if(limit != 0 && rec.written.load() + rec.dropped.load() >= limit) {
+	    close(rec);
+	} else if(!ready && fflush(rec.file) != 0) {
+	    fail(rec);
+	}
+    }
+}
+
+void PacketRecorder::print_recordings(std::ostream &out, const Ports &ports) {
+    int pad = 14;
+    std::vector<std::string> headers = {"Port", "Frames", "Dropped", "Limit", "Status"};
+
+    out << std::setw(pad + 2) << std::left << headers[0];
+    for(long unsigned i = 1; i < headers.size(); i++) {
+	out << std::setw(pad) << std::right << headers[i];
+    }
+    out << "  File" << std::endl;
+
+    std::lock_guard<std::mutex> lock(files_access);
+    for(int i = 0; i < Ports::MAX_PORTS; i++) {
+	Recording &rec = recordings[i];
+	if(rec.path.empty()) {
+	    continue;
+	}
+
+	pcpp::PcapLiveDevice *dev = ports.get(i);
+	uint64_t limit = rec.limit.load();
+	const char *status = "recording";
+	if(rec.file == nullptr) {
+	    status = rec.error.empty() ? "done" : "failed";
+	}
+
+	out << std::setw(pad + 2) << std::left << (dev == nullptr ? "-" : dev->getName())
+	    << std::right << std::setw(pad) << rec.written.load() << std::setw(pad)
+	    << rec.dropped.load() << std::setw(pad) << (limit == 0 ? "-" : std::to_string(limit))
+	    << std::setw(pad) << status << "  " << rec.path;
+	if(!rec.error.empty()) {
+	    out << " (" << rec.error << ")";
+	}
+	out << std::endl;
+    }
+    out << std::endl;
+}
+
+/*
+ * write_header() - Writes the pcap file header, returning false if it could not be written.
+ */
+bool PacketRecorder::write_header(FILE *file, uint32_t snaplen) {
+    uint32_t magic = PCAP_MAGIC_NS;
+    uint16_t version[2] = {2, 4};
+    int32_t thiszone = 0;
+    uint32_t rest[3] = {0, snaplen, LINKTYPE_ETHERNET}; // sigfigs, snaplen, and link type
+
+    return fwrite(&magic, sizeof(magic), 1, file) == 1 &&
+	fwrite(version, sizeof(version), 1, file) == 1 &&
+	fwrite(&thiszone, sizeof(thiszone), 1, file) == 1 &&
+	fwrite(rest, sizeof(rest), 1, file) == 1;
+}
+
+/*
+ * close() - Stops the forwarding path from queueing frames for a recording, and closes its file,
+ * writing out whatever is still buffered. Its counters are kept for "show capture". Must be called
+ * with files_access held.
+ */
+void PacketRecorder::close(Recording &rec) {
+    rec.active.store(false);
+    if(rec.file != nullptr) {
+	if(fclose(rec.file) != 0 && rec.error.empty()) {
+	    rec.error = std::strerror(errno);
+	}
+	rec.file = nullptr;
+    }
+}
+
+/*
+ * fail() - Stops a recording whose file could not be written, keeping the reason for "show
+ * capture". Must be called with files_access held, right after the failed write.
+ */
+void PacketRecorder::fail(Recording &rec) {
+    rec.error = std::strerror(errno);
+    close(rec);
+}
@@ -0,0 +1,101 @@
+/*
+ * packet_ring.cpp - Implementation of the PacketRing class.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include "packet_ring.hpp"
+
+/*
+ * PacketRing() - Creates a ring of size slots, which must be a power of 2, each with room for
+ * reserve_len bytes up front.
+ */
+PacketRing::PacketRing(int size, int reserve_len)
+    : slots(new Slot[size]),
+      mask(size - 1) {
+    for(int i = 0; i < size; i++) {
+	slots[i].seq.store(i);
+	slots[i].data.reserve(reserve_len);
+    }
+}
+
+/*
+ * push() - Copies up to max_len bytes of the packet into the ring for intf, along with a tag which
+ * means nothing to the ring. Returns false, without waiting, if the ring is full.
+ */
+bool PacketRing::push(const pcpp::RawPacket &pckt, int intf, uint32_t max_len, uint64_t tag) {
+    uint64_t pos = tail.load(std::memory_order_relaxed);
+    Slot *slot;
+    while(true) {
+	slot = &slots[pos & mask];
+	int64_t diff = static_cast<int64_t>(slot->seq.load(std::memory_order_acquire) - pos);
+	if(diff == 0) {
+	    if(tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+		break;
+	    }
+	} else if(diff < 0) {
+	    // The consumer has not released this slot since the last time around
+	    dropped.fetch_add(1, std::memory_order_relaxed);
+	    return false;
+	} else {
+	    pos = tail.load(std::memory_order_relaxed);
+	}
+    }
+
+    uint32_t len = std::min<uint32_t>(pckt.getRawDataLen(), max_len);
+    slot->data.assign(pckt.getRawData(), pckt.getRawData() + len);
+    slot->intf = intf;
+    slot->tag = tag;
+    slot->timestamp = pckt.getPacketTimeStamp();
+    slot->orig_len = pckt.getRawDataLen();
+    slot->seq.store(pos + 1, std::memory_order_release);
+
+    // The fence keeps the check of sleeping from moving ahead of publishing the slot, so that a
+    // consumer going to sleep either sees the slot or is woken up
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(sleeping.load(std::memory_order_relaxed)) {
+	std::lock_guard<std::mutex> guard(mtx);
+	cond.notify_one();
+    }
+    return true;
+}
+
+/*
+ * front() - Returns the oldest complete copy, or nullptr if there is none. Only the consumer may
+ * call this.
+ */
+PacketRing::Slot *PacketRing::front() {
+    Slot &slot = slots[head & mask];
+    return slot.seq.load(std::memory_order_acquire) == head + 1 ? &slot : nullptr;
+}
+
+/*
+ * pop() - Releases the slot returned by front() for reuse. Only the consumer may call this.
+ */
+void PacketRing::pop() {
+    slots[head & mask].seq.store(head + mask + 1, std::memory_order_release);
+    head++;
+}
+
+/*
+ * wait() - Waits for up to timeout_ms milliseconds for a copy to be pushed. Returns whether one is
+ * ready. Only the consumer may call this.
+ */
+bool PacketRing::wait(int timeout_ms) {
+    if(front() != nullptr) {
+	return true;
+    }
+
+    std::unique_lock<std::mutex> lock(mtx);
+    sleeping.store(true);
+    cond.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this]() {
+	return front() != nullptr;
+    });
+    sleeping.store(false);
+
+    return front() != nullptr;
+}
+
+uint64_t PacketRing::get_dropped() const {
+    return dropped.load(std::memory_order_relaxed);
+}
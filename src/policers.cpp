@@ -0,0 +1,192 @@
+/*
+ * policers.cpp - Implementation of the Policers class.
+ */
+
+#include <algorithm>
+#include <iomanip>
+#include <string>
+#include "policers.hpp"
+
+// The CLI keyword for each unit, in the order of Policers::rate_unit
+static const char *unit_names[] = {
+    "pps", "bps"
+};
+
+Policers::Policers(int num_intfs) : policers(num_intfs) {}
+
+bool Policers::is_valid(const Config &config) {
+    if(config.rate == 0 || config.burst == 0) {
+	return false;
+    }
+    return config.peak_rate == 0 || (config.peak_rate >= config.rate && config.peak_burst > 0);
+}
+
+bool Policers::set(int intf, const Config &config) {
+    if(intf < 0 || intf >= static_cast<int>(policers.size()) ||
+       (config.enabled && !is_valid(config))) {
+	return false;
+    }
+
+    PortPolicer &policer = policers[intf];
+    std::lock_guard<std::mutex> guard(policer.config_access);
+    policer.config = config;
+    policer.generation.fetch_add(1, std::memory_order_release);
+    return true;
+}
+
+void Policers::reset_intf(int intf) {
+    if(!set(intf, Config())) {
+	return;
+    }
+
+    policers[intf].conform.store(0);
+    policers[intf].exceed.store(0);
+    policers[intf].violate.store(0);
+}
+
+bool Policers::police(int intf, const pcpp::RawPacket &pckt) {
+    PortPolicer &policer = policers[intf];
+
+    // Pick up any change to the configuration, starting again with full buckets
+    unsigned generation = policer.generation.load(std::memory_order_acquire);
+    if(generation != policer.active_generation) {
+	std::lock_guard<std::mutex> guard(policer.config_access);
+	policer.active = policer.config;
+	policer.active_generation = policer.generation.load();
+	policer.last_ns = 0;
+
+	// Buckets are measured in bits for bps policers, whose bursts are given in bytes
+	int scale = policer.active.unit == BPS ? 8 : 1;
+	policer.tokens = static_cast<double>(policer.active.burst) * scale;
+	policer.peak_tokens = static_cast<double>(policer.active.peak_burst) * scale;
+    }
+
+    const Config &config = policer.active;
+    if(!config.enabled) {
+	return true;
+    }
+
+    // Capture timestamps may step backwards if the clock is adjusted, which refills nothing
+    timespec ts = pckt.getPacketTimeStamp();
+    int64_t now_ns = static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    double elapsed = 0;
+    if(policer.last_ns != 0) {
+	elapsed = std::max<int64_t>(now_ns - policer.last_ns, 0) / 1e9;
+    }
+    policer.last_ns = now_ns;
+
+    double cost = 1;
+    double burst = config.burst, peak_burst = config.peak_burst;
+    if(config.unit == BPS) {
+	cost = pckt.getRawDataLen() * 8.0;
+	burst *= 8;
+	peak_burst *= 8;
+    }
+
+    policer.tokens = std::min(policer.tokens + config.rate * elapsed, burst);
+    if(config.peak_rate == 0) {
+	if(policer.tokens < cost) {
+	    policer.exceed.fetch_add(1, std::memory_order_relaxed);
+	    return false;
+	}
+
+	policer.tokens -= cost;
+	policer.conform.fetch_add(1, std::memory_order_relaxed);
+	return true;
+    }
+
+    policer.peak_tokens = std::min(policer.peak_tokens + config.peak_rate * elapsed, peak_burst);
+    if(policer.peak_tokens < cost) {
+	policer.violate.fetch_add(1, std::memory_order_relaxed);
+	return false;
+    }
+
+    policer.peak_tokens -= cost;
+    if(policer.tokens < cost) {
+	policer.exceed.fetch_add(1, std::memory_order_relaxed);
+    } else {
+	policer.tokens -= cost;
+	policer.conform.fetch_add(1, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+Policers::PolicerCounters Policers::get_counters(int intf) {
+    PolicerCounters counters;
+    if(intf < 0 || intf >= static_cast<int>(policers.size())) {
+	return counters;
+    }
+
+    counters.conform = policers[intf].conform.load(std::memory_order_relaxed);
+    counters.exceed = policers[intf].exceed.load(std::memory_order_relaxed);
+    counters.violate = policers[intf].violate.load(std::memory_order_relaxed);
+    return counters;
+}
+
+void Policers::clear_counters() {
+    for(auto &policer : policers) {
+	policer.conform.store(0);
+	policer.exceed.store(0);
+	policer.violate.store(0);
+    }
+}
+
+Policers::Config Policers::get_config(int intf) {
+    std::lock_guard<std::mutex> guard(policers[intf].config_access);
+    return policers[intf].config;
+}
+
+void Policers::print_policers(std::ostream &out, const std::vector<Ports::PortInfo> &ports) {
+    int pad = 14;
+    std::vector<std::string> headers = {"Port", "Rate", "Burst", "PeakRate", "PeakBurst",
+					"Conform", "Exceed", "Violate"};
+
+    out << std::setw(pad + 2) << std::left << headers[0];
+    for(long unsigned i = 1; i < headers.size(); i++) {
+	out << std::setw(pad) << std::right << headers[i];
+    }
+    out << std::endl;
+
+    for(auto &port : ports) {
+	Config config = get_config(port.index);
+	auto counters = get_counters(port.index);
+	std::string unit = unit_names[config.unit];
+	std::string burst_unit = config.unit == PPS ? "p" : "B";
+	bool two_rate = config.enabled && config.peak_rate != 0;
+
+	out << std::setw(pad + 2) << std::left << port.dev->getName() << std::right;
+	if(config.enabled) {
+	    out << std::setw(pad) << std::to_string(config.rate) + unit
+		<< std::setw(pad) << std::to_string(config.burst) + burst_unit;
+	} else {
+	    out << std::setw(pad) << "-" << std::setw(pad) << "-";
+	}
+
+	if(two_rate) {
+	    out << std::setw(pad) << std::to_string(config.peak_rate) + unit
+		<< std::setw(pad) << std::to_string(config.peak_burst) + burst_unit;
+	} else {
+	    out << std::setw(pad) << "-" << std::setw(pad) << "-";
+	}
+
+	out << std::setw(pad) << counters.conform << std::setw(pad) << counters.exceed
+	    << std::setw(pad) << counters.violate << std::endl;
+    }
+    out << std::endl;
+}
+
+void Policers::write_config(std::ostream &out, const std::vector<Ports::PortInfo> &ports) {
+    for(auto &port : ports) {
+	Config config = get_config(port.index);
+	if(!config.enabled) {
+	    continue;
+	}
+
+	out << port.dev->getName() << " police rate " << config.rate << " " << unit_names[config.unit]
+	    << " burst " << config.burst;
+	if(config.peak_rate != 0) {
+	    out << " peak-rate " << config.peak_rate << " burst " << config.peak_burst;
+	}
+	out << std::endl;
+    }
+}
@@ -0,0 +1,327 @@
+/*
+ * port_mirror.cpp - Implementation of the PortMirror class.
+ */
+
+#include <climits>
+#include <string>
+#include "port_mirror.hpp"
+
+// The CLI keyword for each direction, indexed by PortMirror::direction
+static const char *direction_names[] = {
+    "", "rx", "tx", "both"
+};
+
+PortMirror::PortMirror(Ports *ports, Vlans *vlans, DuplicateManager *dup_mgr)
+    : ports(ports),
+      vlans(vlans),
+      dup_mgr(dup_mgr),
+      ring(RING_SIZE, 2048),
+      intf_masks(Ports::MAX_PORTS),
+      vlan_masks(MAX_VLAN + 1) {}
+
+bool PortMirror::add_source_intf(int session, int intf, direction dir) {
+    if(!is_valid_session(session) || intf < 0 || intf >= Ports::MAX_PORTS) {
+	return false;
+    }
+
+    std::lock_guard<std::mutex> lock(config_access);
+    sessions[session - 1].intfs[intf] = dir;
+    publish();
+    return true;
+}
+
+bool PortMirror::add_source_vlan(int session, int vlan, direction dir) {
+    if(!is_valid_session(session) || vlan < 1 || vlan > MAX_VLAN) {
+	return false;
+    }
+
+    std::lock_guard<std::mutex> lock(config_access);
+    sessions[session - 1].vlans[vlan] = dir;
+    publish();
+    return true;
+}
+
+bool PortMirror::remove_source_intf(int session, int intf) {
+    if(!is_valid_session(session)) {
+	return false;
+    }
+
+    std::lock_guard<std::mutex> lock(config_access);
+    if(sessions[session - 1].intfs.erase(intf) == 0) {
+	return false;
+    }
+    publish();
+    return true;
+}
+
+bool PortMirror::remove_source_vlan(int session, int vlan) {
+    if(!is_valid_session(session)) {
+	return false;
+    }
+
+    std::lock_guard<std::mutex> lock(config_access);
+    if(sessions[session - 1].vlans.erase(vlan) == 0) {
+	return false;
+    }
+    publish();
+    return true;
+}
+
+/*
+ * set_destination() - Sends a session's copies out of intf, or with an intf of -1, stops sending
+ * them anywhere.
+ */
+bool PortMirror::set_destination(int session, int intf) {
+    if(!is_valid_session(session) || intf < -1 || intf >= Ports::MAX_PORTS) {
+	return false;
+    }
+
+    std::lock_guard<std::mutex> lock(config_access);
+    sessions[session - 1].dst = intf;
+    publish();
+    return true;
+}
+
+/*
+ * set_truncate() - Truncates a session's copies to len bytes, or with a len of 0, mirrors whole
+ * frames.
+ */
+bool PortMirror::set_truncate(int session, int len) {
+    if(!is_valid_session(session) || (len != 0 && (len < MIN_TRUNCATE || len > MAX_TRUNCATE))) {
+	return false;
+    }
+
+    std::lock_guard<std::mutex> lock(config_access);
+    sessions[session - 1].truncate = len;
+    publish();
+    return true;
+}
+
+/*
+ * set_sample() - Has a session mirror one in every rate frames from each of its sources, as seen by
+ * each thread mirroring them.
+ */
+bool PortMirror::set_sample(int session, int rate) {
+    if(!is_valid_session(session) || rate < 1 || rate > MAX_SAMPLE) {
+	return false;
+    }
+
+    std::lock_guard<std::mutex> lock(config_access);
+    sessions[session - 1].sample = rate;
+    publish();
+    return true;
+}
+
+bool PortMirror::remove_session(int session) {
+    if(!is_valid_session(session)) {
+	return false;
+    }
+
+    std::lock_guard<std::mutex> lock(config_access);
+    sessions[session - 1] = Session();
+    publish();
+    active[session - 1].mirrored.store(0);
+    active[session - 1].dropped.store(0);
+    return true;
+}
+
+/*
+ * reset_intf() - Removes a port from every session, whether as a source or as the destination.
+ */
+void PortMirror::reset_intf(int intf) {
+    std::lock_guard<std::mutex> lock(config_access);
+    for(auto &session : sessions) {
+	session.intfs.erase(intf);
+	if(session.dst == intf) {
+	    session.dst = -1;
+	}
+    }
+    publish();
+}
+
+/*
+ * mirror() - Queues a copy of a frame received or sent on intf for each session mirroring it. This
+ * is called by the forwarding path, and never waits.
+ */
+void PortMirror::mirror(int intf, direction dir, const pcpp::RawPacket &pckt) {
+    int shift = dir == TX ? MAX_SESSIONS : 0;
+    unsigned mask = intf_masks[intf].load(std::memory_order_acquire) >> shift & 0xf;
+    if(num_vlan_sources.load(std::memory_order_relaxed) != 0) {
+	int vlan = vlans->get_vlan_for_intf(intf);
+	if(vlan >= 1 && vlan <= MAX_VLAN) {
+	    mask |= vlan_masks[vlan].load(std::memory_order_acquire) >> shift & 0xf;
+	}
+    }
+
+    if(mask == 0) {
+	return;
+    }
+
+    // Frames are counted per thread, so that sampling shares nothing between them
+    thread_local std::array<uint32_t, MAX_SESSIONS> skipped{};
+    for(int i = 0; i < MAX_SESSIONS; i++) {
+	if((mask & 1u << i) == 0) {
+	    continue;
+	}
+
+	ActiveSession &session = active[i];
+	int dst = session.dst.load(std::memory_order_relaxed);
+	if(dst == -1 || dst == intf) {
+	    continue;
+	}
+
+	uint32_t sample = session.sample.load(std::memory_order_relaxed);
+	if(sample > 1 && ++skipped[i] < sample) {
+	    continue;
+	}
+	skipped[i] = 0;
+
+	uint32_t truncate = session.truncate.load(std::memory_order_relaxed);
+	if(ring.push(pckt, dst, truncate == 0 ? UINT32_MAX : truncate)) {
+	    session.mirrored.fetch_add(1, std::memory_order_relaxed);
+	} else {
+	    session.dropped.fetch_add(1, std::memory_order_relaxed);
+	}
+    }
+}
+
+/*
+ * send_pending() - Waits briefly for copies to be queued, and sends every one that is out of its
+ * destination port. Only the mirroring thread may call this.
+ */
+void PortMirror::send_pending() {
+    if(!ring.wait(WAIT_MS)) {
+	return;
+    }
+
+    PacketRing::Slot *slot;
+    while((slot = ring.front()) != nullptr) {
+	// Skip ports removed after the copy was queued
+	pcpp::PcapLiveDevice *dev = ports->get(slot->intf);
+	if(dev != nullptr) {
+	    pcpp::RawPacket copy(slot->data.data(), slot->data.size(), slot->timestamp, false);
+	    dup_mgr->mark_duplicate(slot->intf, copy);
+	    dev->sendPacket(copy);
+	}
+	ring.pop();
+    }
+}
+
+void PortMirror::clear_counters() {
+    for(auto &session : active) {
+	session.mirrored.store(0);
+	session.dropped.store(0);
+    }
+}
+
+void PortMirror::print_sessions(std::ostream &out) {
+    std::lock_guard<std::mutex> lock(config_access);
+    bool any = false;
+    for(int i = 0; i < MAX_SESSIONS; i++) {
+	Session &session = sessions[i];
+	if(session.dst == -1 && session.intfs.empty() && session.vlans.empty()) {
+	    continue;
+	}
+	any = true;
+
+	pcpp::PcapLiveDevice *dst = session.dst == -1 ? nullptr : ports->get(session.dst);
+	out << "Session " << i + 1 << std::endl;
+	out << "  Destination:  " << (dst == nullptr ? "-" : dst->getName()) << std::endl;
+	out << "  Sources:     ";
+	if(session.intfs.empty() && session.vlans.empty()) {
+	    out << " -";
+	}
+	for(auto [intf, dir] : session.intfs) {
+	    pcpp::PcapLiveDevice *dev = ports->get(intf);
+	    out << " " << (dev == nullptr ? "-" : dev->getName()) << " (" << direction_names[dir]
+		<< ")";
+	}
+	for(auto [vlan, dir] : session.vlans) {
+	    out << " vlan " << vlan << " (" << direction_names[dir] << ")";
+	}
+	out << std::endl;
+
+	out << "  Truncate:     ";
+	if(session.truncate == 0) {
+	    out << "-" << std::endl;
+	} else {
+	    out << session.truncate << " bytes" << std::endl;
+	}
+	out << "  Sample:       1 in " << session.sample << std::endl;
+	out << "  Mirrored:     " << active[i].mirrored.load() << std::endl;
+	out << "  Dropped:      " << active[i].dropped.load() << std::endl << std::endl;
+    }
+
+    if(!any) {
+	out << "No monitor sessions are configured." << std::endl << std::endl;
+    }
+}
+
+void PortMirror::write_config(std::ostream &out) {
+    std::lock_guard<std::mutex> lock(config_access);
+    for(int i = 0; i < MAX_SESSIONS; i++) {
+	Session &session = sessions[i];
+	std::string prefix = "monitor session " + std::to_string(i + 1);
+	for(auto [intf, dir] : session.intfs) {
+	    pcpp::PcapLiveDevice *dev = ports->get(intf);
+	    if(dev != nullptr) {
+		out << prefix << " source interface " << dev->getName() << " "
+		    << direction_names[dir] << std::endl;
+	    }
+	}
+	for(auto [vlan, dir] : session.vlans) {
+	    out << prefix << " source vlan " << vlan << " " << direction_names[dir] << std::endl;
+	}
+
+	pcpp::PcapLiveDevice *dst = session.dst == -1 ? nullptr : ports->get(session.dst);
+	if(dst != nullptr) {
+	    out << prefix << " destination interface " << dst->getName() << std::endl;
+	}
+	if(session.truncate != 0) {
+	    out << prefix << " truncate " << session.truncate << std::endl;
+	}
+	if(session.sample != 1) {
+	    out << prefix << " sample " << session.sample << std::endl;
+	}
+    }
+}
+
+bool PortMirror::is_valid_session(int session) const {
+    return session >= 1 && session <= MAX_SESSIONS;
+}
+
+/*
+ * publish() - Recomputes what the forwarding path reads from the configured sessions. Sessions are
+ * written before the masks which lead to them. Must be called with config_access held.
+ */
+void PortMirror::publish() {
+    std::vector<uint8_t> new_intf_masks(intf_masks.size(), 0);
+    std::vector<uint8_t> new_vlan_masks(vlan_masks.size(), 0);
+    int new_vlan_sources = 0;
+
+    for(int i = 0; i < MAX_SESSIONS; i++) {
+	Session &session = sessions[i];
+	active[i].truncate.store(session.truncate);
+	active[i].sample.store(session.sample);
+	active[i].dst.store(session.dst);
+
+	auto bits = [i](direction dir) {
+	    return (dir & RX ? 1u << i : 0) | (dir & TX ? 1u << (i + MAX_SESSIONS) : 0);
+	};
+	for(auto [intf, dir] : session.intfs) {
+	    new_intf_masks[intf] |= bits(dir);
+	}
+	for(auto [vlan, dir] : session.vlans) {
+	    new_vlan_masks[vlan] |= bits(dir);
+	}
+	new_vlan_sources += session.vlans.size();
+    }
+
+    for(long unsigned i = 0; i < intf_masks.size(); i++) {
+	intf_masks[i].store(new_intf_masks[i], std::memory_order_release);
+    }
+    for(long unsigned i = 0; i < vlan_masks.size(); i++) {
+	vlan_masks[i].store(new_vlan_masks[i], std::memory_order_release);
+    }
+    num_vlan_sources.store(new_vlan_sources);
+}
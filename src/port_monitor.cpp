@@ -0,0 +1,213 @@
+/*
+ * port_monitor.cpp - Implementation of the PortMonitor class.
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <err.h>
+#include <linux/if.h>
+#include <linux/rtnetlink.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "port_monitor.hpp"
+#include "vswitch_utils.hpp"
+
+/*
+ * is_link_up() - A port only forwards while it is administratively up and has a carrier.
+ */
+static bool is_link_up(const LinkInfo &link) {
+    return (link.flags & IFF_UP) && (link.flags & IFF_LOWER_UP);
+}
+
+PortMonitor::PortMonitor(VswitchShmem *shmem,
+			 const std::string &prefix,
+			 pcpp::OnPacketArrivesCallback on_packet)
+    : shmem(shmem),
+      prefix(prefix),
+      on_packet(on_packet)
+{}
+
+PortMonitor::~PortMonitor() {
+    if(nl_fd != -1) {
+	close(nl_fd);
+    }
+}
+
+bool PortMonitor::listen() {
+    int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if(fd == -1) {
+	warn("socket() failed. Ports will not be added or removed at runtime.");
+	return false;
+    }
+
+    struct sockaddr_nl addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = RTMGRP_LINK;
+    if(bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == -1) {
+	warn("Cannot subscribe to link notifications. Ports will not be added or removed at runtime.");
+	close(fd);
+	return false;
+    }
+
+    nl_fd = fd;
+    return true;
+}
+
+void PortMonitor::sync() {
+    std::vector<LinkInfo> links;
+    if(!dump_links(links)) {
+	return;
+    }
+
+    // Ports opened at startup are matched up with their kernel interfaces by name, and any link
+    // that changed between startup and subscribing to notifications is brought up to date.
+    std::map<int, bool> present;
+    for(auto &link : links) {
+	present[link.index] = true;
+	update_link(link);
+    }
+
+    std::vector<int> gone;
+    for(auto &mapping : kernel_to_port) {
+	if(present.count(mapping.first) == 0) {
+	    gone.push_back(mapping.first);
+	}
+    }
+    for(int kernel_index : gone) {
+	remove_link(kernel_index);
+    }
+}
+
+void PortMonitor::serve() {
+    if(nl_fd == -1) {
+	return;
+    }
+
+    char buf[16384];
+    while(true) {
+	ssize_t len = recv(nl_fd, buf, sizeof(buf), 0);
+	if(len == -1) {
+	    if(errno == EINTR) {
+		continue;
+	    } else if(errno == ENOBUFS) {
+		// Notifications were dropped, so resynchronize from a full dump
+		sync();
+		continue;
+	    }
+	    warn("recv() failed. No longer tracking ports.");
+	    return;
+	}
+
+	auto msg = reinterpret_cast<struct nlmsghdr *>(buf);
+	for(int remaining = len; NLMSG_OK(msg, remaining); msg = NLMSG_NEXT(msg, remaining)) {
+	    LinkInfo link;
+	    if(!parse_link_msg(msg, link)) {
+		continue;
+	    }
+
+	    if(msg->nlmsg_type == RTM_DELLINK) {
+		remove_link(link.index);
+	    } else {
+		update_link(link);
+	    }
+	}
+    }
+}
+
+void PortMonitor::update_link(const LinkInfo &link) {
+    auto mapping = kernel_to_port.find(link.index);
+    bool matches = link.name.compare(0, prefix.size(), prefix) == 0;
+
+    if(mapping == kernel_to_port.end()) {
+	if(!matches) {
+	    return;
+	}
+
+	int port = shmem->ports.find(link.name);
+	if(port == -1) {
+	    add_port(link);
+	} else {
+	    kernel_to_port[link.index] = port;
+	    set_link(port, is_link_up(link));
+	}
+    } else if(!matches || shmem->ports.get(mapping->second)->getName() != link.name) {
+	// A renamed interface is treated as a new one, since libpcap identifies it by name
+	remove_link(link.index);
+	update_link(link);
+    } else {
+	set_link(mapping->second, is_link_up(link));
+    }
+}
+
+void PortMonitor::remove_link(int kernel_index) {
+    auto mapping = kernel_to_port.find(kernel_index);
+    if(mapping == kernel_to_port.end()) {
+	return;
+    }
+
+    int port = mapping->second;
+    kernel_to_port.erase(mapping);
+
+    pcpp::PcapLiveDevice *intf = shmem->ports.remove(port);
+    if(intf == nullptr) {
+	return;
+    }
+
+    intf->stopCapture();
+    intf->close();
+
+    // The device itself is kept alive, since queued packets may still refer to it. Everything else
+    // about the port is reset so that its slot can be reused by the next interface to appear.
+    shmem->mac_tbl.flush_intf(port);
+    shmem->counters.reset(port);
+    shmem->dup_mgr.clear(port);
+    shmem->lags.reset_intf(port);
+    shmem->acls.reset_intf(port);
+    shmem->vlans.reset_intf(port);
+    shmem->egress_queues.reset_intf(port);
+    shmem->policers.reset_intf(port);
+    shmem->storm_ctl.reset_intf(port);
+    shmem->snooping.reset_intf(port);
+    shmem->rstp.reset_intf(port);
+    shmem->mirror.reset_intf(port);
+    shmem->recorder.reset_intf(port);
+    std::cerr << "Removed port " << intf->getName() << std::endl;
+}
+
+void PortMonitor::add_port(const LinkInfo &link) {
+    pcpp::PcapLiveDevice *intf = open_intf(link.name, shmem->capture.get_config(link.name));
+    if(intf == nullptr) {
+	return;
+    }
+
+    int port = shmem->ports.add(intf);
+    if(port == -1) {
+	std::cerr << "Cannot add port " << link.name << ". The switch already has "
+		  << Ports::MAX_PORTS << " ports." << std::endl;
+	intf->close();
+	return;
+    }
+
+    kernel_to_port[link.index] = port;
+    shmem->ports.set_link(port, is_link_up(link));
+    intf->startCapture(on_packet, shmem->cookie_for(port));
+    std::cerr << "Added port " << link.name << std::endl;
+}
+
+void PortMonitor::set_link(int port, bool up) {
+    bool was_up = shmem->ports.is_link_up(port);
+    shmem->ports.set_link(port, up);
+
+    if(was_up && !up) {
+	shmem->mac_tbl.flush_intf(port);
+    }
+
+    // The link may have come back up at another speed
+    pcpp::PcapLiveDevice *intf = shmem->ports.get(port);
+    if(up && intf != nullptr) {
+	shmem->storm_ctl.set_link_speed(port, get_link_speed(intf->getName()));
+    }
+}
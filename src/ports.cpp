@@ -0,0 +1,179 @@
+/*
+ * ports.cpp - Implementation file for Ports
+ *
+ * Implements all of the class functions declared in include/ports.hpp.
+ */
+
+#include "ports.hpp"
+
+Ports::Ports(const std::vector<pcpp::PcapLiveDevice *> &intfs)
+    : initial_blocked(0), high_water(0) {
+    for(int i = 0; i < MAX_PORTS; i++) {
+	devs[i].store(nullptr);
+	blocked[i].store(LINK_DOWN);
+	removed_at[i].store(0);
+    }
+
+    for(auto intf : intfs) {
+	add(intf);
+    }
+}
+
+int Ports::add(pcpp::PcapLiveDevice *dev) {
+    std::lock_guard<std::mutex> guard(membership);
+
+    for(int i = 0; i < MAX_PORTS; i++) {
+	if(devs[i].load() != nullptr) {
+	    continue;
+	}
+
+	blocked[i].store(initial_blocked.load());
+	devs[i].store(dev);
+	if(i >= high_water.load()) {
+	    high_water.store(i + 1);
+	}
+	return i;
+    }
+
+    return -1;
+}
+
+pcpp::PcapLiveDevice *Ports::remove(int index) {
+    if(index < 0 || index >= MAX_PORTS) {
+	return nullptr;
+    }
+
+    std::lock_guard<std::mutex> guard(membership);
+    blocked[index].fetch_or(LINK_DOWN);
+    removed_at[index].store(removals.fetch_add(1) + 1);
+    return devs[index].exchange(nullptr);
+}
+
+pcpp::PcapLiveDevice *Ports::get(int index) const {
+    if(index < 0 || index >= MAX_PORTS) {
+	return nullptr;
+    }
+    return devs[index].load(std::memory_order_acquire);
+}
+
+bool Ports::is_forwarding(int index) const {
+    if(index < 0 || index >= MAX_PORTS) {
+	return false;
+    }
+    return blocked[index].load(std::memory_order_relaxed) == 0 &&
+	devs[index].load(std::memory_order_acquire) != nullptr;
+}
+
+bool Ports::is_link_up(int index) const {
+    if(index < 0 || index >= MAX_PORTS) {
+	return false;
+    }
+    return (blocked[index].load(std::memory_order_relaxed) & LINK_DOWN) == 0 &&
+	devs[index].load(std::memory_order_acquire) != nullptr;
+}
+
+void Ports::set_link(int index, bool up) {
+    if(index < 0 || index >= MAX_PORTS) {
+	return;
+    }
+
+    if(up) {
+	blocked[index].fetch_and(~LINK_DOWN);
+    } else {
+	blocked[index].fetch_or(LINK_DOWN);
+    }
+}
+
+Ports::stp_state Ports::get_stp_state(int index) const {
+    if(index < 0 || index >= MAX_PORTS) {
+	return STP_DISCARDING;
+    }
+
+    uint8_t bits = blocked[index].load(std::memory_order_relaxed);
+    if(bits & STP_BLOCKED) {
+	return STP_DISCARDING;
+    }
+    return (bits & STP_NOT_FORWARDING) ? STP_LEARNING : STP_FORWARDING;
+}
+
+void Ports::set_stp_state(int index, stp_state state) {
+    if(index < 0 || index >= MAX_PORTS) {
+	return;
+    }
+
+    // The link state may change at the same time, so only the spanning tree bits are swapped
+    uint8_t bits = stp_bits(state);
+    uint8_t cur = blocked[index].load();
+    while(!blocked[index].compare_exchange_weak(cur, (cur & LINK_DOWN) | bits)) {}
+}
+
+void Ports::set_initial_stp_state(stp_state state) {
+    initial_blocked.store(stp_bits(state));
+}
+
+uint8_t Ports::stp_bits(stp_state state) {
+    switch(state) {
+    case STP_DISCARDING:
+	return STP_BLOCKED | STP_NOT_FORWARDING;
+    case STP_LEARNING:
+	return STP_NOT_FORWARDING;
+    default:
+	return 0;
+    }
+}
+
+int Ports::find(const pcpp::PcapLiveDevice *dev) const {
+    int last = end();
+    for(int i = 0; i < last; i++) {
+	if(devs[i].load(std::memory_order_acquire) == dev) {
+	    return i;
+	}
+    }
+    return -1;
+}
+
+int Ports::find(const std::string &name) const {
+    int last = end();
+    for(int i = 0; i < last; i++) {
+	auto dev = devs[i].load(std::memory_order_acquire);
+	if(dev != nullptr && dev->getName() == name) {
+	    return i;
+	}
+    }
+    return -1;
+}
+
+int Ports::end() const {
+    return high_water.load(std::memory_order_acquire);
+}
+
+/*
+ * get_epoch() - Returns how many interfaces have been removed so far, for stamping packets with
+ * before their forwarding decision is made.
+ */
+uint64_t Ports::get_epoch() const {
+    return removals.load();
+}
+
+/*
+ * is_current() - Returns whether the interface in a slot is still the one it held at the given
+ * epoch, so that packets meant for a removed interface are never sent out of its replacement.
+ */
+bool Ports::is_current(int index, uint64_t epoch) const {
+    if(index < 0 || index >= MAX_PORTS) {
+	return false;
+    }
+    return removed_at[index].load() <= epoch;
+}
+
+std::vector<Ports::PortInfo> Ports::snapshot() const {
+    std::vector<PortInfo> ports;
+    int last = end();
+    for(int i = 0; i < last; i++) {
+	auto dev = devs[i].load(std::memory_order_acquire);
+	if(dev != nullptr) {
+	    ports.push_back({i, dev, (blocked[i].load() & LINK_DOWN) == 0});
+	}
+    }
+    return ports;
+}
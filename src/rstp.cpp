@@ -0,0 +1,881 @@
+/*
+ * rstp.cpp - Implementation of the Rstp class.
+ */
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <tuple>
+#include "rstp.hpp"
+#include "vswitch_utils.hpp"
+
+// BPDUs are sent to the bridge group address, in 802.3 frames with an LLC header
+static const uint8_t BPDU_DST[6] = {0x01, 0x80, 0xc2, 0x00, 0x00, 0x00};
+static const size_t LLC_OFFSET = 14;
+static const size_t BPDU_OFFSET = 17;
+static const uint8_t LLC_STP_SAP = 0x42;
+static const uint8_t LLC_UI = 0x03;
+static const size_t MIN_FRAME_LEN = 60;
+
+// BPDU types, and the length of each
+static const int TYPE_CONFIG = 0x00;
+static const int TYPE_RST = 0x02;
+static const int TYPE_TCN = 0x80;
+static const size_t TCN_BPDU_LEN = 4;
+static const size_t CONFIG_BPDU_LEN = 35;
+static const size_t RST_BPDU_LEN = 36;
+
+// BPDU flags, including the sending port's role
+static const uint8_t FLAG_TC = 0x01;
+static const uint8_t FLAG_PROPOSAL = 0x02;
+static const int ROLE_SHIFT = 2;
+static const uint8_t FLAG_LEARNING = 0x10;
+static const uint8_t FLAG_FORWARDING = 0x20;
+static const uint8_t FLAG_AGREEMENT = 0x40;
+static const int BPDU_ROLE_ALTERNATE = 1;
+static const int BPDU_ROLE_ROOT = 2;
+static const int BPDU_ROLE_DESIGNATED = 3;
+
+// Path costs are 20,000,000 divided by the link speed in Mbit/s (802.1D-2004, table 17-3)
+static const uint32_t COST_DIVIDEND = 20000000;
+static const uint32_t DEFAULT_COST = 20000;
+static const uint32_t MAX_COST = 200000000;
+
+// Times in BPDUs are in 1/256ths of a second
+static const int TIME_UNIT = 256;
+
+static const char *role_names[] = {
+    "disabled", "root", "designated", "alternate", "backup"
+};
+
+static const char *state_names[] = {
+    "discarding", "learning", "forwarding"
+};
+
+static uint64_t read_bytes(const uint8_t *data, int len) {
+    uint64_t value = 0;
+    for(int i = 0; i < len; i++) {
+	value = (value << 8) | data[i];
+    }
+    return value;
+}
+
+static void write_bytes(uint8_t *data, int len, uint64_t value) {
+    for(int i = len - 1; i >= 0; i--) {
+	data[i] = value & 0xff;
+	value >>= 8;
+    }
+}
+
+/*
+ * format_id() - Formats a bridge ID as its priority and MAC address.
+ */
+static std::string format_id(uint64_t id) {
+    std::ostringstream out;
+    out << (id >> 48) << "." << std::hex << std::setfill('0');
+    for(int shift = 40; shift >= 0; shift -= 8) {
+	out << std::setw(2) << ((id >> shift) & 0xff) << (shift > 0 ? ":" : "");
+    }
+    return out.str();
+}
+
+bool Rstp::PriorityVector::operator<(const PriorityVector &other) const {
+    return std::tie(root_id, root_cost, bridge_id, port_id) <
+	std::tie(other.root_id, other.root_cost, other.bridge_id, other.port_id);
+}
+
+Rstp::Rstp(Ports *ports, MacAddrTable *mac_tbl, DuplicateManager *dup_mgr)
+    : ports(ports),
+      mac_tbl(mac_tbl),
+      dup_mgr(dup_mgr),
+      port_states(Ports::MAX_PORTS)
+{}
+
+void Rstp::set_enabled(bool enabled) {
+    std::lock_guard<std::mutex> guard(state_access);
+    if(enabled == this->enabled.load()) {
+	return;
+    }
+
+    // Everything but the configuration is started over
+    for(auto &port : port_states) {
+	PortState fresh;
+	fresh.priority = port.priority;
+	fresh.admin_cost = port.admin_cost;
+	fresh.admin_edge = port.admin_edge;
+	port = fresh;
+    }
+    root = PriorityVector();
+    root_port = -1;
+    root_age = 0;
+    hello_while = 0;
+
+    // Ports discard until the spanning tree has chosen their roles
+    Ports::stp_state initial = enabled ? Ports::STP_DISCARDING : Ports::STP_FORWARDING;
+    ports->set_initial_stp_state(initial);
+    for(int i = 0; i < ports->end(); i++) {
+	ports->set_stp_state(i, initial);
+    }
+
+    this->enabled.store(enabled);
+    if(enabled) {
+	choose_bridge_mac();
+	update_ports();
+	update_roles();
+	send_pending();
+    }
+}
+
+bool Rstp::is_enabled() const {
+    return enabled.load();
+}
+
+bool Rstp::set_bridge_priority(int priority) {
+    if(priority < 0 || priority > 61440 || priority % 4096 != 0) {
+	return false;
+    }
+
+    std::lock_guard<std::mutex> guard(state_access);
+    bridge_priority = priority;
+    if(enabled.load()) {
+	update_roles();
+	send_pending();
+    }
+    return true;
+}
+
+bool Rstp::set_port_priority(int intf, int priority) {
+    if(intf < 0 || intf >= Ports::MAX_PORTS || priority < 0 || priority > 240 ||
+       priority % 16 != 0) {
+	return false;
+    }
+
+    std::lock_guard<std::mutex> guard(state_access);
+    port_states[intf].priority = priority;
+    if(enabled.load()) {
+	update_roles();
+	send_pending();
+    }
+    return true;
+}
+
+bool Rstp::set_port_cost(int intf, uint32_t cost) {
+    if(intf < 0 || intf >= Ports::MAX_PORTS || cost > MAX_COST) {
+	return false;
+    }
+
+    std::lock_guard<std::mutex> guard(state_access);
+    PortState &port = port_states[intf];
+    port.admin_cost = cost;
+    if(enabled.load() && port.enabled) {
+	port.cost = path_cost(intf);
+	update_roles();
+	send_pending();
+    }
+    return true;
+}
+
+void Rstp::set_edge(int intf, bool edge) {
+    if(intf < 0 || intf >= Ports::MAX_PORTS) {
+	return;
+    }
+
+    std::lock_guard<std::mutex> guard(state_access);
+    PortState &port = port_states[intf];
+    port.admin_edge = edge;
+    if(enabled.load() && port.enabled) {
+	port.oper_edge = edge;
+	advance(intf);
+	send_pending();
+    }
+}
+
+void Rstp::reset_intf(int intf) {
+    if(intf < 0 || intf >= Ports::MAX_PORTS) {
+	return;
+    }
+
+    std::lock_guard<std::mutex> guard(state_access);
+    port_states[intf] = PortState();
+    if(enabled.load()) {
+	update_roles();
+	send_pending();
+    }
+}
+
+bool Rstp::is_bpdu(const pcpp::RawPacket &pckt) {
+    return pckt.getRawDataLen() >= static_cast<int>(sizeof(BPDU_DST)) &&
+	std::equal(BPDU_DST, BPDU_DST + sizeof(BPDU_DST), pckt.getRawData());
+}
+
+void Rstp::receive_bpdu(int intf, const pcpp::RawPacket &pckt) {
+    const uint8_t *data = pckt.getRawData();
+    size_t len = pckt.getRawDataLen();
+    if(len < BPDU_OFFSET + TCN_BPDU_LEN || data[LLC_OFFSET] != LLC_STP_SAP ||
+       data[LLC_OFFSET + 1] != LLC_STP_SAP || read_bytes(data + BPDU_OFFSET, 2) != 0) {
+	return;
+    }
+
+    const uint8_t *bpdu = data + BPDU_OFFSET;
+    int type = bpdu[3];
+    std::lock_guard<std::mutex> guard(state_access);
+    PortState &port = port_states[intf];
+    if(!enabled.load() || !port.enabled) {
+	return;
+    }
+
+    // Whatever sent this is a bridge, so the port is not an edge port after all
+    port.quiet_for = 0;
+    port.oper_edge = false;
+
+    if(type == TYPE_TCN) {
+	if(port.role == DESIGNATED) {
+	    topology_change(intf, true);
+	}
+	send_pending();
+	return;
+    }
+
+    if((type != TYPE_CONFIG || len < BPDU_OFFSET + CONFIG_BPDU_LEN) &&
+       (type != TYPE_RST || len < BPDU_OFFSET + RST_BPDU_LEN)) {
+	return;
+    }
+
+    // Legacy configuration BPDUs only ever come from designated ports, and carry no handshake
+    uint8_t flags = bpdu[4];
+    int role = BPDU_ROLE_DESIGNATED;
+    if(type == TYPE_RST) {
+	role = (flags >> ROLE_SHIFT) & 0x3;
+    } else {
+	flags &= FLAG_TC;
+    }
+
+    PriorityVector msg;
+    msg.root_id = read_bytes(bpdu + 5, 8);
+    msg.root_cost = read_bytes(bpdu + 13, 4);
+    msg.bridge_id = read_bytes(bpdu + 17, 8);
+    msg.port_id = read_bytes(bpdu + 25, 2);
+    int msg_age = read_bytes(bpdu + 27, 2) / TIME_UNIT;
+    int max_age = read_bytes(bpdu + 29, 2) / TIME_UNIT;
+    if(msg_age >= max_age) {
+	return;
+    }
+
+    bool same_sender = port.has_info && msg.bridge_id == port.info.bridge_id &&
+	msg.port_id == port.info.port_id;
+    if(role == BPDU_ROLE_DESIGNATED) {
+	if(msg < designated_vector(intf) || same_sender) {
+	    bool changed = !port.has_info || msg < port.info || port.info < msg;
+	    port.has_info = true;
+	    port.info = msg;
+	    port.info_age = msg_age;
+	    port.info_while = 3 * HELLO_TIME;
+	    if(changed) {
+		update_roles();
+	    }
+
+	    // The designated port will not forward until this end agrees. A root port agrees once
+	    // every designated port is synced, while alternate and backup ports already discard.
+	    if(flags & FLAG_PROPOSAL) {
+		if(port.role == ROOT) {
+		    sync(intf);
+		}
+		if(port.role != DESIGNATED) {
+		    port.agree = true;
+		    port.send_now = true;
+		}
+	    }
+	} else {
+	    // The other end thinks it is designated, so it is told about the better information
+	    port.send_now = true;
+	}
+    } else {
+	// The other end has stopped being designated, so what it said before no longer applies
+	if(same_sender) {
+	    port.has_info = false;
+	    update_roles();
+	}
+
+	if((flags & FLAG_AGREEMENT) && port.role == DESIGNATED && msg.root_id == root.root_id) {
+	    port.agreed = true;
+	    advance(intf);
+	}
+    }
+
+    if((flags & FLAG_TC) && (port.role == ROOT || port.role == DESIGNATED)) {
+	topology_change(intf, true);
+    }
+    send_pending();
+}
+
+void Rstp::tick() {
+    if(!enabled.load()) {
+	return;
+    }
+
+    std::lock_guard<std::mutex> guard(state_access);
+    choose_bridge_mac();
+    update_ports();
+
+    bool expired = false;
+    for(int i = 0; i < ports->end(); i++) {
+	PortState &port = port_states[i];
+	if(port.enabled && port.has_info && --port.info_while <= 0) {
+	    port.has_info = false;
+	    expired = true;
+	}
+    }
+    if(expired) {
+	update_roles();
+    }
+
+    for(int i = 0; i < ports->end(); i++) {
+	PortState &port = port_states[i];
+	if(!port.enabled) {
+	    continue;
+	}
+
+	// Nothing has answered a proposal, so there is no bridge on the other end
+	if(port.role == DESIGNATED && port.proposing && !port.oper_edge &&
+	   ++port.quiet_for >= EDGE_DELAY) {
+	    port.oper_edge = true;
+	}
+	advance(i);
+
+	if(port.tc_while > 0) {
+	    port.tc_while--;
+	}
+    }
+
+    if(--hello_while <= 0) {
+	hello_while = HELLO_TIME;
+	for(int i = 0; i < ports->end(); i++) {
+	    if(port_states[i].enabled && port_states[i].role == DESIGNATED) {
+		port_states[i].send_now = true;
+	    }
+	}
+    }
+    send_pending();
+}
+
+void Rstp::print_spanning_tree(std::ostream &out, const std::vector<Ports::PortInfo> &ports) {
+    if(!enabled.load()) {
+	out << "Spanning tree is disabled." << std::endl << std::endl;
+	return;
+    }
+
+    // Copied out, so that formatting does not hold up BPDU processing
+    state_access.lock();
+    uint64_t own_id = bridge_id();
+    PriorityVector cur_root = root;
+    int cur_root_port = root_port;
+    std::vector<PortState> states = port_states;
+    state_access.unlock();
+
+    std::string root_port_name = "-";
+    for(auto &port : ports) {
+	if(port.index == cur_root_port) {
+	    root_port_name = port.dev->getName();
+	}
+    }
+
+    out << "Bridge ID:  " << format_id(own_id) << std::endl;
+    out << "Root ID:    " << format_id(cur_root.root_id)
+	<< (cur_root.root_id == own_id ? " (this bridge)" : "") << std::endl;
+    out << "Root cost:  " << cur_root.root_cost << std::endl;
+    out << "Root port:  " << root_port_name << std::endl << std::endl;
+
+    int pad = 14;
+    std::vector<std::string> headers = {"Port", "Role", "State", "Cost", "Priority", "Edge"};
+    out << std::setw(pad + 2) << std::left << headers[0];
+    for(long unsigned i = 1; i < headers.size(); i++) {
+	out << std::setw(pad) << std::right << headers[i];
+    }
+    out << std::endl;
+
+    for(auto &port : ports) {
+	PortState &state = states[port.index];
+	out << std::setw(pad + 2) << std::left << port.dev->getName() << std::right
+	    << std::setw(pad) << role_names[state.role] << std::setw(pad)
+	    << state_names[state.state] << std::setw(pad) << state.cost << std::setw(pad)
+	    << state.priority << std::setw(pad) << (state.oper_edge ? "yes" : "no") << std::endl;
+    }
+    out << std::endl;
+}
+
+void Rstp::write_config(std::ostream &out, const std::vector<Ports::PortInfo> &ports) {
+    std::lock_guard<std::mutex> guard(state_access);
+    if(bridge_priority != DEFAULT_BRIDGE_PRIORITY) {
+	out << "spanning-tree priority " << bridge_priority << std::endl;
+    }
+    if(enabled.load()) {
+	out << "spanning-tree" << std::endl;
+    }
+
+    for(auto &port : ports) {
+	PortState &state = port_states[port.index];
+	if(state.admin_cost != 0) {
+	    out << port.dev->getName() << " spanning-tree cost " << state.admin_cost << std::endl;
+	}
+	if(state.priority != DEFAULT_PORT_PRIORITY) {
+	    out << port.dev->getName() << " spanning-tree priority " << state.priority << std::endl;
+	}
+	if(state.admin_edge) {
+	    out << port.dev->getName() << " spanning-tree edge" << std::endl;
+	}
+    }
+}
+
+/*
+ * write_state() - Appends the spanning tree as it stands to lines, for a switch taking over from
+ * this one: a line for the bridge and its root, and then a line for each port. Nothing is written
+ * while the spanning tree is disabled.
+ */
+void Rstp::write_state(std::vector<std::string> &lines) {
+    std::lock_guard<std::mutex> guard(state_access);
+    if(!enabled.load()) {
+	return;
+    }
+
+    std::ostringstream bridge;
+    bridge << "bridge " << bridge_mac << " " << root.root_id << " " << root.root_cost << " "
+	   << root.bridge_id << " " << root.port_id << " " << root_age;
+    lines.push_back(bridge.str());
+
+    for(int i = 0; i < ports->end(); i++) {
+	pcpp::PcapLiveDevice *dev = ports->get(i);
+	if(dev == nullptr) {
+	    continue;
+	}
+
+	PortState &port = port_states[i];
+	std::ostringstream line;
+	line << "port " << dev->getName() << " " << port.enabled << " " << port.cost << " "
+	     << port.oper_edge << " " << port.role << " " << port.state << " " << port.agreed << " "
+	     << port.has_info << " " << port.info.root_id << " " << port.info.root_cost << " "
+	     << port.info.bridge_id << " " << port.info.port_id << " " << port.info_age;
+	lines.push_back(line.str());
+    }
+}
+
+/*
+ * adopt_state() - Carries on from the spanning tree written by write_state() in the switch being
+ * taken over. Ports are put straight into their old roles and states rather than through
+ * set_state(), so that adopting them is not a topology change and flushes nothing. Ports which
+ * the old switch did not have start over, and links which have changed since are caught up with
+ * on the next tick.
+ */
+void Rstp::adopt_state(const std::vector<std::string> &lines) {
+    std::lock_guard<std::mutex> guard(state_access);
+    if(!enabled.load() || lines.empty()) {
+	return;
+    }
+
+    std::istringstream bridge(lines[0]);
+    std::string first, name;
+    PriorityVector old_root;
+    uint64_t old_mac;
+    int old_age;
+    if(!(bridge >> first >> old_mac >> old_root.root_id >> old_root.root_cost >>
+	 old_root.bridge_id >> old_root.port_id >> old_age) || first != "bridge") {
+	return;
+    }
+
+    for(auto &port : port_states) {
+	PortState fresh;
+	fresh.priority = port.priority;
+	fresh.admin_cost = port.admin_cost;
+	fresh.admin_edge = port.admin_edge;
+	port = fresh;
+    }
+    bridge_mac = old_mac;
+    root = old_root;
+    root_port = -1;
+    root_age = old_age;
+    hello_while = 0;
+
+    for(long unsigned i = 1; i < lines.size(); i++) {
+	std::istringstream words(lines[i]);
+	PortState adopted;
+	int role, state;
+	if(!(words >> first >> name >> adopted.enabled >> adopted.cost >> adopted.oper_edge >>
+	     role >> state >> adopted.agreed >> adopted.has_info >> adopted.info.root_id >>
+	     adopted.info.root_cost >> adopted.info.bridge_id >> adopted.info.port_id >>
+	     adopted.info_age) || first != "port" || role < DISABLED || role > BACKUP ||
+	   state < Ports::STP_DISCARDING || state > Ports::STP_FORWARDING) {
+	    continue;
+	}
+
+	int intf = ports->find(name);
+	if(intf == -1) {
+	    continue;
+	}
+
+	PortState &port = port_states[intf];
+	port.enabled = adopted.enabled;
+	port.cost = adopted.cost;
+	port.oper_edge = adopted.oper_edge;
+	port.role = static_cast<port_role>(role);
+	port.state = static_cast<Ports::stp_state>(state);
+	port.agreed = adopted.agreed;
+	port.has_info = adopted.has_info;
+	port.info = adopted.info;
+	port.info_age = adopted.info_age;
+	port.info_while = 3 * HELLO_TIME;
+
+	// A designated port which was still on its way to forwarding starts its forward delay over
+	if(port.role == DESIGNATED && port.state != Ports::STP_FORWARDING) {
+	    port.proposing = true;
+	    port.fd_while = FORWARD_DELAY;
+	}
+	if(port.role == ROOT) {
+	    root_port = intf;
+	}
+    }
+
+    for(int i = 0; i < ports->end(); i++) {
+	ports->set_stp_state(i, port_states[i].state);
+    }
+
+    // The old root port is gone, so the root has to be chosen again
+    if(root_port == -1 && root.root_id != bridge_id()) {
+	update_roles();
+    }
+}
+
+uint64_t Rstp::bridge_id() const {
+    return (static_cast<uint64_t>(bridge_priority) << 48) | bridge_mac;
+}
+
+uint16_t Rstp::port_id(int intf) const {
+    return ((port_states[intf].priority & 0xf0) << 8) | ((intf + 1) & 0x0fff);
+}
+
+uint32_t Rstp::path_cost(int intf) const {
+    if(port_states[intf].admin_cost != 0) {
+	return port_states[intf].admin_cost;
+    }
+
+    pcpp::PcapLiveDevice *dev = ports->get(intf);
+    long speed = dev != nullptr ? get_link_speed(dev->getName()) : -1;
+    if(speed <= 0) {
+	return DEFAULT_COST;
+    }
+    return std::max<uint32_t>(COST_DIVIDEND / speed, 1);
+}
+
+/*
+ * designated_vector() - Returns what the port would advertise as a designated port.
+ */
+Rstp::PriorityVector Rstp::designated_vector(int intf) const {
+    PriorityVector vector;
+    vector.root_id = root.root_id;
+    vector.root_cost = root.root_cost;
+    vector.bridge_id = bridge_id();
+    vector.port_id = port_id(intf);
+    return vector;
+}
+
+/*
+ * choose_bridge_mac() - Takes the lowest MAC address of the switch's ports for its bridge ID, the
+ * first time there are any ports to take it from. It then stays the same as ports come and go.
+ */
+void Rstp::choose_bridge_mac() {
+    if(bridge_mac != 0) {
+	return;
+    }
+
+    for(auto &port : ports->snapshot()) {
+	uint8_t addr[6];
+	port.dev->getMacAddress().copyTo(addr);
+	uint64_t mac = read_bytes(addr, 6);
+	if(mac != 0 && (bridge_mac == 0 || mac < bridge_mac)) {
+	    bridge_mac = mac;
+	}
+    }
+}
+
+/*
+ * update_ports() - Enables and disables ports as their links come and go, then reworks every
+ * port's role if any changed.
+ */
+void Rstp::update_ports() {
+    bool changed = false;
+    for(int i = 0; i < ports->end(); i++) {
+	PortState &port = port_states[i];
+	bool up = ports->is_link_up(i);
+	if(up == port.enabled) {
+	    continue;
+	}
+
+	changed = true;
+	port.enabled = up;
+	port.has_info = false;
+	port.tc_while = 0;
+	port.quiet_for = 0;
+	if(up) {
+	    port.cost = path_cost(i);
+	    port.oper_edge = port.admin_edge;
+	}
+    }
+
+    if(changed) {
+	update_roles();
+    }
+}
+
+/*
+ * update_roles() - Chooses the root port from the best information received on any port, then
+ * gives every other port its role. Ports which discard are changed first, and designated ports are
+ * synced when the root port changes, so that the new root port never forwards into a loop.
+ */
+void Rstp::update_roles() {
+    PriorityVector best;
+    best.root_id = best.bridge_id = bridge_id();
+    int best_port = -1, best_age = 0;
+
+    for(int i = 0; i < ports->end(); i++) {
+	PortState &port = port_states[i];
+	if(!port.enabled || !port.has_info || port.info.bridge_id == bridge_id()) {
+	    continue;
+	}
+
+	PriorityVector candidate = port.info;
+	candidate.root_cost += port.cost;
+	bool tied = best_port != -1 && !(best < candidate) && !(candidate < best);
+	if(candidate < best || (tied && port_id(i) < port_id(best_port))) {
+	    best = candidate;
+	    best_port = i;
+	    best_age = port.info_age + 1;
+	}
+    }
+
+    bool root_changed = best < root || root < best;
+    int old_root_port = root_port;
+    root = best;
+    root_port = best_port;
+    root_age = best_age;
+
+    for(int i = 0; i < ports->end(); i++) {
+	PortState &port = port_states[i];
+	port_role role = DESIGNATED;
+	if(!port.enabled) {
+	    role = DISABLED;
+	} else if(i == root_port) {
+	    continue;
+	} else if(port.has_info && port.info < designated_vector(i)) {
+	    role = port.info.bridge_id == bridge_id() ? BACKUP : ALTERNATE;
+	}
+
+	set_role(i, role);
+	if(root_changed && role == DESIGNATED) {
+	    port.send_now = true;
+	}
+    }
+
+    if(root_port != old_root_port) {
+	for(int i = 0; i < ports->end(); i++) {
+	    port_states[i].agreed = false;
+	}
+	sync(root_port);
+    }
+
+    if(root_port != -1) {
+	set_role(root_port, ROOT);
+    }
+}
+
+void Rstp::set_role(int intf, port_role role) {
+    PortState &port = port_states[intf];
+    if(port.role == role) {
+	return;
+    }
+
+    port.role = role;
+    port.proposing = false;
+    port.agreed = false;
+    port.agree = false;
+    port.quiet_for = 0;
+
+    switch(role) {
+    case ROOT:
+	set_state(intf, Ports::STP_FORWARDING);
+	break;
+    case DESIGNATED:
+	if(port.oper_edge) {
+	    set_state(intf, Ports::STP_FORWARDING);
+	} else {
+	    set_state(intf, Ports::STP_DISCARDING);
+	    port.proposing = true;
+	    port.fd_while = FORWARD_DELAY;
+	}
+	port.send_now = true;
+	break;
+    default:
+	set_state(intf, Ports::STP_DISCARDING);
+	port.tc_while = 0;
+	break;
+    }
+}
+
+/*
+ * set_state() - Moves a port to a new state, both here and in Ports. A port which stops
+ * forwarding forgets what it learned, and a port which starts forwarding changes the topology.
+ */
+void Rstp::set_state(int intf, Ports::stp_state state) {
+    PortState &port = port_states[intf];
+    if(port.state == state) {
+	return;
+    }
+
+    port.state = state;
+    ports->set_stp_state(intf, state);
+    if(state == Ports::STP_DISCARDING) {
+	mac_tbl->flush_intf(intf);
+    } else if(state == Ports::STP_FORWARDING && !port.oper_edge) {
+	topology_change(intf, false);
+    }
+}
+
+/*
+ * sync() - Has every designated port which the other end has not agreed to discard, and propose
+ * again, before a root port forwards or agrees to a proposal.
+ */
+void Rstp::sync(int except) {
+    for(int i = 0; i < ports->end(); i++) {
+	PortState &port = port_states[i];
+	if(i == except || port.role != DESIGNATED || port.oper_edge || port.agreed) {
+	    continue;
+	}
+
+	set_state(i, Ports::STP_DISCARDING);
+	port.proposing = true;
+	port.fd_while = FORWARD_DELAY;
+	port.send_now = true;
+    }
+}
+
+/*
+ * topology_change() - Flushes what was learned on every other port, since stations behind them may
+ * now be reached another way, and tells the other bridges. A change heard from another bridge is
+ * passed on through every port but the one it came in on.
+ */
+void Rstp::topology_change(int intf, bool received) {
+    for(int i = 0; i < ports->end(); i++) {
+	PortState &port = port_states[i];
+	if(i == intf || !port.enabled) {
+	    continue;
+	}
+	mac_tbl->flush_intf(i);
+    }
+
+    for(int i = 0; i < ports->end(); i++) {
+	PortState &port = port_states[i];
+	if((received && i == intf) || port.oper_edge ||
+	   (port.role != ROOT && port.role != DESIGNATED)) {
+	    continue;
+	}
+	port.tc_while = HELLO_TIME + 1;
+	port.send_now = true;
+    }
+}
+
+/*
+ * advance() - Moves a designated port towards forwarding: right away if it is an edge port or the
+ * other end has agreed, and otherwise through learning, one forward delay at a time.
+ */
+void Rstp::advance(int intf) {
+    PortState &port = port_states[intf];
+    if(port.role != DESIGNATED || port.state == Ports::STP_FORWARDING) {
+	return;
+    }
+
+    if(port.agreed || port.oper_edge) {
+	port.proposing = false;
+	set_state(intf, Ports::STP_FORWARDING);
+	return;
+    }
+
+    if(--port.fd_while > 0) {
+	return;
+    }
+    port.fd_while = FORWARD_DELAY;
+    if(port.state == Ports::STP_DISCARDING) {
+	set_state(intf, Ports::STP_LEARNING);
+    } else {
+	port.proposing = false;
+	set_state(intf, Ports::STP_FORWARDING);
+    }
+}
+
+void Rstp::send_bpdu(int intf) {
+    pcpp::PcapLiveDevice *dev = ports->get(intf);
+    if(dev == nullptr) {
+	return;
+    }
+
+    PortState &port = port_states[intf];
+    uint8_t frame[MIN_FRAME_LEN] = {};
+    std::copy(BPDU_DST, BPDU_DST + sizeof(BPDU_DST), frame);
+    dev->getMacAddress().copyTo(frame + sizeof(BPDU_DST));
+    write_bytes(frame + 12, 2, BPDU_OFFSET - LLC_OFFSET + RST_BPDU_LEN);
+    frame[LLC_OFFSET] = LLC_STP_SAP;
+    frame[LLC_OFFSET + 1] = LLC_STP_SAP;
+    frame[LLC_OFFSET + 2] = LLC_UI;
+
+    int role = BPDU_ROLE_ALTERNATE;
+    if(port.role == ROOT) {
+	role = BPDU_ROLE_ROOT;
+    } else if(port.role == DESIGNATED) {
+	role = BPDU_ROLE_DESIGNATED;
+    }
+
+    uint8_t flags = role << ROLE_SHIFT;
+    if(port.tc_while > 0) {
+	flags |= FLAG_TC;
+    }
+    if(port.role == DESIGNATED && port.proposing && port.state != Ports::STP_FORWARDING) {
+	flags |= FLAG_PROPOSAL;
+    }
+    if(port.state != Ports::STP_DISCARDING) {
+	flags |= FLAG_LEARNING;
+    }
+    if(port.state == Ports::STP_FORWARDING) {
+	flags |= FLAG_FORWARDING;
+    }
+    if(port.agree) {
+	flags |= FLAG_AGREEMENT;
+    }
+
+    uint8_t *bpdu = frame + BPDU_OFFSET;
+    PriorityVector vector = designated_vector(intf);
+    bpdu[2] = TYPE_RST; // the protocol version, which matches the BPDU type for RSTP
+    bpdu[3] = TYPE_RST;
+    bpdu[4] = flags;
+    write_bytes(bpdu + 5, 8, vector.root_id);
+    write_bytes(bpdu + 13, 4, vector.root_cost);
+    write_bytes(bpdu + 17, 8, vector.bridge_id);
+    write_bytes(bpdu + 25, 2, vector.port_id);
+    write_bytes(bpdu + 27, 2, (root_port == -1 ? 0 : root_age) * TIME_UNIT);
+    write_bytes(bpdu + 29, 2, MAX_AGE * TIME_UNIT);
+    write_bytes(bpdu + 31, 2, HELLO_TIME * TIME_UNIT);
+    write_bytes(bpdu + 33, 2, FORWARD_DELAY * TIME_UNIT);
+
+    timeval now = {0, 0};
+    pcpp::RawPacket pckt(frame, sizeof(frame), now, false);
+    dup_mgr->mark_duplicate(intf, pckt);
+    dev->sendPacket(pckt);
+}
+
+void Rstp::send_pending() {
+    for(int i = 0; i < ports->end(); i++) {
+	PortState &port = port_states[i];
+	if(!port.enabled || !port.send_now) {
+	    continue;
+	}
+
+	send_bpdu(i);
+	port.send_now = false;
+	port.agree = false;
+    }
+}
@@ -0,0 +1,182 @@
+/*
+ * stats_segment.cpp - Implementation of the StatsSegment class.
+ *
+ * The writer side creates and sizes the segment, and removes it from /dev/shm when the switch exits
+ * or it is destroyed. The reader side maps it read-only and validates its magic number and version
+ * before use.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <err.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "stats_segment.hpp"
+
+// How many times a reader retries a torn copy before giving up for this call.
+static const int MAX_READ_RETRIES = 64;
+
+StatsSegment::~StatsSegment() {
+    if(header != nullptr) {
+	munmap(header, map_len);
+    }
+
+    if(owner) {
+	shm_unlink(name.c_str());
+    }
+}
+
+bool StatsSegment::create(const std::string &name, uint32_t max_ports) {
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(fd == -1) {
+	warn("shm_open() failed. Cannot publish stats to %s", name.c_str());
+	return false;
+    }
+
+    map_len = sizeof(StatsHeader) + max_ports * sizeof(StatsPort);
+    if(ftruncate(fd, map_len) == -1) {
+	warn("ftruncate() failed. Cannot publish stats to %s", name.c_str());
+	close(fd);
+	shm_unlink(name.c_str());
+	return false;
+    }
+
+    void *mem = mmap(nullptr, map_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mem == MAP_FAILED) {
+	warn("mmap() failed. Cannot publish stats to %s", name.c_str());
+	shm_unlink(name.c_str());
+	return false;
+    }
+
+    this->name = name;
+    owner = true;
+    header = static_cast<StatsHeader *>(mem);
+    ports = reinterpret_cast<StatsPort *>(header + 1);
+
+    header->seq.store(0, std::memory_order_relaxed);
+    header->max_ports = max_ports;
+    header->num_ports = 0;
+    header->writer_pid = getpid();
+    header->version = VERSION;
+
+    // The magic number is written last so readers never accept a half initialized segment.
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = MAGIC;
+    return true;
+}
+
+bool StatsSegment::attach(const std::string &name) {
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if(fd == -1) {
+	return false;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) == -1 || st.st_size < static_cast<off_t>(sizeof(StatsHeader))) {
+	close(fd);
+	return false;
+    }
+
+    map_len = st.st_size;
+    void *mem = mmap(nullptr, map_len, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mem == MAP_FAILED) {
+	return false;
+    }
+
+    header = static_cast<StatsHeader *>(mem);
+    ports = reinterpret_cast<StatsPort *>(header + 1);
+
+    if(header->magic != MAGIC || header->version != VERSION ||
+       map_len < sizeof(StatsHeader) + header->max_ports * sizeof(StatsPort)) {
+	munmap(header, map_len);
+	header = nullptr;
+	ports = nullptr;
+	return false;
+    }
+
+    this->name = name;
+    return true;
+}
+
+void StatsSegment::publish(const Snapshot &snapshot) {
+    std::lock_guard<std::mutex> lock(publish_access);
+    if(header == nullptr || !owner || stopped) {
+	return;
+    }
+
+    uint64_t seq = header->seq.load(std::memory_order_relaxed);
+    header->seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    header->timestamp_ns = snapshot.timestamp_ns;
+    header->mac_tbl_size = snapshot.mac_tbl_size;
+    header->queue_to_process = snapshot.queue_to_process;
+    header->queue_to_egress = snapshot.queue_to_egress;
+    header->queue_capacity = snapshot.queue_capacity;
+
+    uint32_t num_ports = std::min<long unsigned>(snapshot.ports.size(), header->max_ports);
+    header->num_ports = num_ports;
+    memcpy(ports, snapshot.ports.data(), num_ports * sizeof(StatsPort));
+
+    header->seq.store(seq + 2, std::memory_order_release);
+    return;
+}
+
+/*
+ * stop() - Stops publishing, waiting for any publish in progress to finish, so that another switch
+ * may recreate the segment under the same name. The name then belongs to that switch, so it is no
+ * longer removed by this one.
+ */
+void StatsSegment::stop() {
+    std::lock_guard<std::mutex> lock(publish_access);
+    stopped = true;
+    owner = false;
+}
+
+/*
+ * remove() - Stops publishing and removes the segment from /dev/shm, unless another switch has
+ * taken it over, so that readers never find a stale segment once the switch has exited. The
+ * destructor does the same, but the switch exits without running it.
+ */
+void StatsSegment::remove() {
+    std::lock_guard<std::mutex> lock(publish_access);
+    stopped = true;
+    if(owner) {
+	shm_unlink(name.c_str());
+	owner = false;
+    }
+}
+
+bool StatsSegment::read(Snapshot &snapshot) const {
+    if(header == nullptr) {
+	return false;
+    }
+
+    for(int attempt = 0; attempt < MAX_READ_RETRIES; attempt++) {
+	uint64_t before = header->seq.load(std::memory_order_acquire);
+	if(before & 1) {
+	    continue;
+	}
+
+	snapshot.timestamp_ns = header->timestamp_ns;
+	snapshot.mac_tbl_size = header->mac_tbl_size;
+	snapshot.queue_to_process = header->queue_to_process;
+	snapshot.queue_to_egress = header->queue_to_egress;
+	snapshot.queue_capacity = header->queue_capacity;
+
+	uint32_t num_ports = std::min(header->num_ports, header->max_ports);
+	snapshot.ports.resize(num_ports);
+	memcpy(snapshot.ports.data(), ports, num_ports * sizeof(StatsPort));
+
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if(header->seq.load(std::memory_order_relaxed) == before) {
+	    return true;
+	}
+    }
+
+    return false;
+}
@@ -0,0 +1,174 @@
+/*
+ * storm_control.cpp - Implementation of the StormControl class.
+ */
+
+#include <iomanip>
+#include <string>
+#include "storm_control.hpp"
+
+// The CLI keyword for each class of traffic, in the order of StormControl::traffic_class
+static const char *class_names[] = {
+    "broadcast", "multicast", "unknown-unicast"
+};
+
+StormControl::StormControl(int num_intfs) : levels(num_intfs), link_speeds(num_intfs) {}
+
+bool StormControl::set(int intf,
+		       traffic_class type,
+		       level_unit unit,
+		       uint64_t level,
+		       long link_mbps) {
+    if(intf < 0 || intf >= static_cast<int>(levels.size()) || level == 0) {
+	return false;
+    }
+
+    if(unit == PERCENT) {
+	if(level > 100 || link_mbps <= 0) {
+	    return false;
+	}
+	link_speeds[intf].store(link_mbps);
+    }
+
+    // The unit is stored last, since it is what enables the level
+    Level &cur = levels[intf][type];
+    cur.level.store(level);
+    cur.unit.store(unit);
+    return true;
+}
+
+void StormControl::reset(int intf, traffic_class type) {
+    if(intf < 0 || intf >= static_cast<int>(levels.size())) {
+	return;
+    }
+    levels[intf][type].unit.store(NONE);
+}
+
+void StormControl::reset_intf(int intf) {
+    if(intf < 0 || intf >= static_cast<int>(levels.size())) {
+	return;
+    }
+
+    for(auto &level : levels[intf]) {
+	level.unit.store(NONE);
+	level.dropped.store(0);
+    }
+    link_speeds[intf].store(0);
+}
+
+/*
+ * set_link_speed() - Records the port's current link speed, which its percentage levels are taken
+ * of from then on. An unknown speed leaves the last one known in place.
+ */
+void StormControl::set_link_speed(int intf, long link_mbps) {
+    if(intf < 0 || intf >= static_cast<int>(levels.size()) || link_mbps <= 0) {
+	return;
+    }
+    link_speeds[intf].store(link_mbps, std::memory_order_relaxed);
+}
+
+StormControl::traffic_class StormControl::classify(const pcpp::MacAddress &dst_mac) {
+    uint8_t addr[6];
+    dst_mac.copyTo(addr);
+
+    if((addr[0] & 0x01) == 0) {
+	return UNKNOWN_UNICAST;
+    }
+
+    for(uint8_t octet : addr) {
+	if(octet != 0xff) {
+	    return MULTICAST;
+	}
+    }
+    return BROADCAST;
+}
+
+bool StormControl::admit(int intf, const pcpp::MacAddress &dst_mac, const pcpp::RawPacket &pckt) {
+    Level &level = levels[intf][classify(dst_mac)];
+    int unit = level.unit.load(std::memory_order_relaxed);
+    if(unit == NONE) {
+	return true;
+    }
+
+    // A timestamp before the current interval means the clock was adjusted, so start over
+    timespec ts = pckt.getPacketTimeStamp();
+    int64_t now_ns = static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    if(now_ns - level.interval_start >= INTERVAL_NS || now_ns < level.interval_start) {
+	level.interval_start = now_ns;
+	level.used = 0;
+    }
+
+    uint64_t cost = 1;
+    uint64_t limit = level.level.load(std::memory_order_relaxed);
+    if(unit == PERCENT) {
+	cost = pckt.getRawDataLen();
+	limit = link_speeds[intf].load(std::memory_order_relaxed) * 1000000 / 8 * limit / 100;
+    }
+
+    if(level.used + cost > limit) {
+	level.dropped.fetch_add(1, std::memory_order_relaxed);
+	return false;
+    }
+
+    level.used += cost;
+    return true;
+}
+
+uint64_t StormControl::get_dropped(int intf, traffic_class type) {
+    if(intf < 0 || intf >= static_cast<int>(levels.size())) {
+	return 0;
+    }
+    return levels[intf][type].dropped.load(std::memory_order_relaxed);
+}
+
+void StormControl::clear_counters() {
+    for(auto &intf_levels : levels) {
+	for(auto &level : intf_levels) {
+	    level.dropped.store(0);
+	}
+    }
+}
+
+void StormControl::print_storm_control(std::ostream &out,
+				       const std::vector<Ports::PortInfo> &ports) {
+    int pad = 18;
+    std::vector<std::string> headers = {"Port", "Class", "Level", "Dropped"};
+
+    out << std::setw(pad) << std::left << headers[0];
+    for(long unsigned i = 1; i < headers.size(); i++) {
+	out << std::setw(pad) << std::right << headers[i];
+    }
+    out << std::endl;
+
+    for(auto &port : ports) {
+	for(int i = 0; i < NUM_CLASSES; i++) {
+	    Level &level = levels[port.index][i];
+	    int unit = level.unit.load();
+	    std::string shown = "-";
+	    if(unit == PERCENT) {
+		shown = std::to_string(level.level.load()) + "%";
+	    } else if(unit == PPS) {
+		shown = std::to_string(level.level.load()) + "pps";
+	    }
+
+	    out << std::setw(pad) << std::left << (i == 0 ? port.dev->getName() : "") << std::right
+		<< std::setw(pad) << class_names[i] << std::setw(pad) << shown
+		<< std::setw(pad) << level.dropped.load() << std::endl;
+	}
+    }
+    out << std::endl;
+}
+
+void StormControl::write_config(std::ostream &out, const std::vector<Ports::PortInfo> &ports) {
+    for(auto &port : ports) {
+	for(int i = 0; i < NUM_CLASSES; i++) {
+	    Level &level = levels[port.index][i];
+	    int unit = level.unit.load();
+	    if(unit == NONE) {
+		continue;
+	    }
+
+	    out << port.dev->getName() << " storm-control " << class_names[i] << " level "
+		<< (unit == PPS ? "pps " : "") << level.level.load() << std::endl;
+	}
+    }
+}
@@ -28,8 +28,12 @@ TestData::TestData(std::vector<pcpp::PcapLiveDevice *> veth_intfs)
 {}
 
 pcpp::RawPacket create_broadcast_pckt(pcpp::PcapLiveDevice *src_intf) {
-    pcpp::EthLayer eth_layer(src_intf->getMacAddress(),
-			     pcpp::MacAddress("ff:ff:ff:ff:ff:ff"));
+    return create_broadcast_pckt(src_intf, src_intf->getMacAddress());
+}
+
+pcpp::RawPacket create_broadcast_pckt(pcpp::PcapLiveDevice *src_intf,
+				      const pcpp::MacAddress &src_mac) {
+    pcpp::EthLayer eth_layer(src_mac, pcpp::MacAddress("ff:ff:ff:ff:ff:ff"));
 
     pcpp::IPv4Layer ip_layer(src_intf->getIPv4Address(),
 			     pcpp::IPv4Address("255.255.255.255"));
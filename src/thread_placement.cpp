@@ -0,0 +1,221 @@
+/*
+ * thread_placement.cpp - Implementation of the ThreadPlacement class.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <err.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "thread_placement.hpp"
+
+// The CLI keyword for each role, in the order of ThreadPlacement::role
+static const char *role_names[] = {
+    "capture", "forwarding", "egress", "housekeeping"
+};
+
+ThreadPlacement::ThreadPlacement() {
+    // Roles without a CPU list fall back to whatever the process was started with, e.g. by taskset.
+    CPU_ZERO(&startup_cpus);
+    if(sched_getaffinity(0, sizeof(startup_cpus), &startup_cpus) == -1) {
+	for(int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+	    CPU_SET(cpu, &startup_cpus);
+	}
+    }
+}
+
+bool ThreadPlacement::parse_cpu_list(const std::string &cpu_list, std::vector<int> &cpus) {
+    long num_cpus = sysconf(_SC_NPROCESSORS_CONF);
+    std::istringstream in(cpu_list);
+    std::string range;
+
+    // Accepts the same syntax as taskset -c, e.g. "0,2-4"
+    cpus.clear();
+    while(std::getline(in, range, ',')) {
+	int first, last;
+	char extra;
+	if(sscanf(range.c_str(), "%d-%d%c", &first, &last, &extra) != 2) {
+	    if(sscanf(range.c_str(), "%d%c", &first, &extra) != 1) {
+		return false;
+	    }
+	    last = first;
+	}
+
+	if(first < 0 || first > last || last >= num_cpus || last >= CPU_SETSIZE) {
+	    return false;
+	}
+	for(int cpu = first; cpu <= last; cpu++) {
+	    cpus.push_back(cpu);
+	}
+    }
+
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return !cpus.empty();
+}
+
+std::string ThreadPlacement::format_cpu_list(const std::vector<int> &cpus) {
+    std::string formatted;
+    for(long unsigned i = 0; i < cpus.size(); i++) {
+	long unsigned last = i;
+	while(last + 1 < cpus.size() && cpus[last + 1] == cpus[last] + 1) {
+	    last++;
+	}
+
+	formatted.append(formatted.empty() ? "" : ",").append(std::to_string(cpus[i]));
+	if(last > i) {
+	    formatted.append("-").append(std::to_string(cpus[last]));
+	}
+	i = last;
+    }
+    return formatted;
+}
+
+bool ThreadPlacement::set_cpus(role type, const std::string &cpu_list) {
+    std::vector<int> cpus;
+    if(!parse_cpu_list(cpu_list, cpus)) {
+	return false;
+    }
+
+    std::lock_guard<std::mutex> guard(placement_access);
+    placements[type].cpus = cpus;
+    return true;
+}
+
+void ThreadPlacement::reset_cpus(role type) {
+    std::lock_guard<std::mutex> guard(placement_access);
+    placements[type].cpus.clear();
+}
+
+bool ThreadPlacement::set_priority(role type, int priority) {
+    if(priority < MIN_PRIORITY || priority > MAX_PRIORITY) {
+	return false;
+    }
+
+    std::lock_guard<std::mutex> guard(placement_access);
+    placements[type].priority = priority;
+    return true;
+}
+
+void ThreadPlacement::reset_priority(role type) {
+    std::lock_guard<std::mutex> guard(placement_access);
+    placements[type].priority = 0;
+}
+
+void ThreadPlacement::set_memory_lock(bool lock) {
+    std::lock_guard<std::mutex> guard(placement_access);
+    memory_lock = lock;
+}
+
+bool ThreadPlacement::lock_memory() {
+    placement_access.lock();
+    bool lock = memory_lock;
+    placement_access.unlock();
+
+    if(!lock) {
+	return true;
+    }
+
+    // Keep freed packet buffers in the heap rather than returning them to the kernel, since they
+    // would have to be faulted in again the next time they are allocated.
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+
+    // Faults in and locks everything mapped so far, including the packet queue, and every mapping
+    // made from now on, including the stacks of threads yet to be created.
+    if(mlockall(MCL_CURRENT | MCL_FUTURE) == -1) {
+	warn("mlockall() failed. Memory will not be locked");
+	return false;
+    }
+    return true;
+}
+
+bool ThreadPlacement::apply(role type, int instance) {
+    placement_access.lock();
+    Placement placement = placements[type];
+    placement_access.unlock();
+
+    bool ok = true;
+    cpu_set_t cpus;
+    if(placement.cpus.empty()) {
+	cpus = startup_cpus;
+    } else if(type == CAPTURE) {
+	CPU_ZERO(&cpus);
+	CPU_SET(placement.cpus[instance % placement.cpus.size()], &cpus);
+    } else {
+	CPU_ZERO(&cpus);
+	for(int cpu : placement.cpus) {
+	    CPU_SET(cpu, &cpus);
+	}
+    }
+
+    int ret = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    if(ret != 0) {
+	warnx("Cannot pin %s thread: %s", role_names[type], strerror(ret));
+	ok = false;
+    }
+
+    // Threads inherit their creator's scheduling policy, so normal scheduling is set explicitly.
+    struct sched_param param;
+    param.sched_priority = placement.priority;
+    int policy = placement.priority > 0 ? SCHED_FIFO : SCHED_OTHER;
+    ret = pthread_setschedparam(pthread_self(), policy, &param);
+    if(ret != 0) {
+	warnx("Cannot set priority of %s thread: %s", role_names[type], strerror(ret));
+	ok = false;
+    }
+
+    return ok;
+}
+
+void ThreadPlacement::print_placement(std::ostream &out) {
+    std::lock_guard<std::mutex> guard(placement_access);
+    std::vector<std::pair<std::string, int>> headers = {
+	{"Role", 14},
+	{"CPUs", 24},
+	{"Priority", 10}
+    };
+
+    for(auto [name, len] : headers) {
+	out << std::setw(len + 1) << std::left << name;
+    }
+    out << std::endl;
+    for(auto [name, len] : headers) {
+	out << std::string(len, '-') << ' ';
+    }
+    out << std::endl;
+
+    for(int i = 0; i < NUM_ROLES; i++) {
+	auto &placement = placements[i];
+	out << std::setw(headers[0].second + 1) << std::left << role_names[i]
+	    << std::setw(headers[1].second + 1)
+	    << (placement.cpus.empty() ? "any" : format_cpu_list(placement.cpus))
+	    << std::setw(headers[2].second + 1)
+	    << (placement.priority > 0 ? "fifo " + std::to_string(placement.priority) : "normal")
+	    << std::endl;
+    }
+    out << std::endl << "Memory locked: " << (memory_lock ? "yes" : "no") << std::endl;
+}
+
+void ThreadPlacement::write_config(std::ostream &out) {
+    std::lock_guard<std::mutex> guard(placement_access);
+    for(int i = 0; i < NUM_ROLES; i++) {
+	if(!placements[i].cpus.empty()) {
+	    out << "thread " << role_names[i] << " cpus " << format_cpu_list(placements[i].cpus)
+		<< std::endl;
+	}
+	if(placements[i].priority > 0) {
+	    out << "thread " << role_names[i] << " priority " << placements[i].priority
+		<< std::endl;
+	}
+    }
+
+    if(memory_lock) {
+	out << "memory lock" << std::endl;
+    }
+}
@@ -5,7 +5,6 @@
  */
 
 #include <iomanip>
-#include <PcapLiveDevice.h>
 #include "vlans.hpp"
 
 Vlans::Vlans(int num_intfs)
@@ -34,7 +33,9 @@ bool Vlans::add_vlan(int vlan) {
 	return false;
     }
 
+    vlan_set_access.lock();
     vlans.insert(vlan);
+    vlan_set_access.unlock();
     return true;
 }
 
@@ -50,7 +51,10 @@ bool Vlans::remove_vlan(int vlan) {
 	}
 	intf_vlan_mapping_access[i].unlock();
     }
+    generation.fetch_add(1, std::memory_order_release);
+    vlan_set_access.lock();
     vlans.erase(vlan);
+    vlan_set_access.unlock();
     return true;
 }
 
@@ -66,11 +70,45 @@ bool Vlans::add_intf_to_vlan(int intf, int vlan) {
     intf_vlan_mapping_access[intf].lock();
     intf_to_vlan[intf] = vlan;
     intf_vlan_mapping_access[intf].unlock();
+    generation.fetch_add(1, std::memory_order_release);
 
     return true;
 }
 
-void Vlans::print_vlans(std::ostream &out, const std::vector<pcpp::PcapLiveDevice *> &veth_intfs) {
+void Vlans::reset_intf(int intf) {
+    if(intf < 0 || intf >= static_cast<int>(intf_to_vlan.size())) {
+	return;
+    }
+
+    intf_vlan_mapping_access[intf].lock();
+    intf_to_vlan[intf] = DEFAULT_VLAN;
+    intf_vlan_mapping_access[intf].unlock();
+    generation.fetch_add(1, std::memory_order_release);
+}
+
+uint64_t Vlans::get_generation() const {
+    return generation.load(std::memory_order_acquire);
+}
+
+std::set<int> Vlans::get_vlans() {
+    vlan_set_access.lock();
+    std::set<int> vlans_cpy = vlans;
+    vlan_set_access.unlock();
+    return vlans_cpy;
+}
+
+std::vector<int> Vlans::get_intf_vlans() {
+    std::vector<int> intf_vlans(intf_to_vlan.size());
+    for(long unsigned i = 0; i < intf_to_vlan.size(); i++) {
+	intf_vlan_mapping_access[i].lock();
+	intf_vlans[i] = intf_to_vlan[i];
+	intf_vlan_mapping_access[i].unlock();
+    }
+
+    return intf_vlans;
+}
+
+void Vlans::print_vlans(std::ostream &out, const std::vector<Ports::PortInfo> &ports) {
     std::vector<std::pair<std::string, int>> headers = {
 	{"VLAN", 5},
 	{"Ports", 73}
@@ -85,16 +123,18 @@ void Vlans::print_vlans(std::ostream &out, const std::vector<pcpp::PcapLiveDevic
     }
     out << std::endl;
 
-    for(auto vlan : vlans) {
+    auto vlans_cpy = get_vlans();
+    auto intf_vlans = get_intf_vlans();
+    for(auto vlan : vlans_cpy) {
 	std::string intfs;
 
 	out << std::setw(headers[0].second + 1) << std::left << vlan;
-	for(long unsigned i = 0; i < intf_to_vlan.size(); i++) {
-	    if(intf_to_vlan[i] != vlan) {
+	for(auto &port : ports) {
+	    if(intf_vlans[port.index] != vlan) {
 		continue;
 	    }
 
-	    intfs.append(veth_intfs[i]->getName());
+	    intfs.append(port.dev->getName());
 	    intfs.append(", ");
 	}
 	if(intfs.size() > 1) {
@@ -107,3 +147,22 @@ void Vlans::print_vlans(std::ostream &out, const std::vector<pcpp::PcapLiveDevic
 
     return;
 }
+
+void Vlans::write_config(std::ostream &out, const std::vector<Ports::PortInfo> &ports) {
+    auto vlans_cpy = get_vlans();
+    auto intf_vlans = get_intf_vlans();
+
+    for(auto vlan : vlans_cpy) {
+	if(vlan != DEFAULT_VLAN) {
+	    out << "vlan " << vlan << std::endl;
+	}
+    }
+
+    for(auto &port : ports) {
+	if(intf_vlans[port.index] != DEFAULT_VLAN) {
+	    out << port.dev->getName() << " vlan " << intf_vlans[port.index] << std::endl;
+	}
+    }
+
+    return;
+}
@@ -4,26 +4,143 @@
  * Contains definitions for all utility functions in include/vswitch_utils.hpp
  */
 
+#include <algorithm>
+#include <atomic>
+#include <fstream>
 #include <iostream>
 #include <string>
+#include <thread>
 #include <vector>
 #include <PcapLiveDevice.h>
 #include <PcapLiveDeviceList.h>
+#include <pcap.h>
 #include "vswitch_utils.hpp"
 
-std::vector<pcpp::PcapLiveDevice *> get_intfs_prefixed_by(const std::string &prefix) {
+/*
+ * HotplugDevice - A PcapLiveDevice for an interface created after PcapLiveDeviceList enumerated
+ * the system's interfaces. PcapLiveDeviceList only builds its list once, so interfaces that appear
+ * later have to be constructed directly.
+ */
+class HotplugDevice : public pcpp::PcapLiveDevice {
+public:
+    HotplugDevice(pcap_if_t *intf) : pcpp::PcapLiveDevice(intf, true, true, false) {}
+};
+
+/*
+ * find_intfs_prefixed_by() - Returns every interface whose name begins with the given prefix,
+ * without opening any of them.
+ */
+std::vector<pcpp::PcapLiveDevice *> find_intfs_prefixed_by(const std::string &prefix) {
     std::vector<pcpp::PcapLiveDevice *> veth_intfs, all_intfs =
 	pcpp::PcapLiveDeviceList::getInstance().getPcapLiveDevicesList();
 
     for(auto intf : all_intfs) {
 	std::string intf_name = intf->getName();
 	if(intf_name.compare(0, prefix.size(), prefix) == 0) {
-	    if(!intf->open()) {
-		std::cerr << "Could not open intf " << intf_name << std::endl;
-	    }
 	    veth_intfs.push_back(intf);
 	}
     }
 
     return veth_intfs;
 }
+
+/*
+ * open_intfs() - Opens every given interface with the configuration chosen for it, spreading the
+ * work across one thread per CPU since opening a capture handle is slow. Returns the interfaces
+ * which were opened successfully, in their original order.
+ */
+std::vector<pcpp::PcapLiveDevice *> open_intfs(const std::vector<pcpp::PcapLiveDevice *> &intfs,
+					       IntfConfigFunc config_for) {
+    std::vector<char> opened(intfs.size(), false);
+    std::atomic<long unsigned> next(0);
+
+    auto open_next = [&]() {
+	long unsigned i;
+	while((i = next++) < intfs.size()) {
+	    opened[i] = intfs[i]->open(config_for(intfs[i]->getName()));
+	}
+    };
+
+    long unsigned num_threads = std::min<long unsigned>(std::thread::hardware_concurrency(),
+							intfs.size());
+    std::vector<std::thread> openers;
+    for(long unsigned i = 1; i < num_threads; i++) {
+	openers.emplace_back(open_next);
+    }
+    open_next();
+    for(auto &opener : openers) {
+	opener.join();
+    }
+
+    std::vector<pcpp::PcapLiveDevice *> opened_intfs;
+    for(long unsigned i = 0; i < intfs.size(); i++) {
+	if(opened[i]) {
+	    opened_intfs.push_back(intfs[i]);
+	} else {
+	    std::cerr << "Could not open intf " << intfs[i]->getName() << std::endl;
+	}
+    }
+
+    return opened_intfs;
+}
+
+/*
+ * get_intfs_prefixed_by() - Finds and opens every interface whose name begins with the given
+ * prefix, using PcapPlusPlus' default configuration.
+ */
+std::vector<pcpp::PcapLiveDevice *> get_intfs_prefixed_by(const std::string &prefix) {
+    return open_intfs(find_intfs_prefixed_by(prefix), [](const std::string &) {
+	return pcpp::PcapLiveDevice::DeviceConfiguration();
+    });
+}
+
+/*
+ * open_intf() - Opens the interface with the given name and configuration, even if it did not
+ * exist when the switch started. Returns nullptr if the interface does not exist or cannot be
+ * opened. Devices returned by this function are never freed, since packets still in flight may
+ * refer to them.
+ */
+pcpp::PcapLiveDevice *open_intf(const std::string &name,
+				const pcpp::PcapLiveDevice::DeviceConfiguration &config) {
+    pcpp::PcapLiveDevice *intf =
+	pcpp::PcapLiveDeviceList::getInstance().getPcapLiveDeviceByName(name);
+
+    if(intf == nullptr) {
+	pcap_if_t *all_intfs;
+	char errbuf[PCAP_ERRBUF_SIZE];
+	if(pcap_findalldevs(&all_intfs, errbuf) == -1) {
+	    std::cerr << "Could not list interfaces: " << errbuf << std::endl;
+	    return nullptr;
+	}
+
+	for(pcap_if_t *cur = all_intfs; cur != nullptr; cur = cur->next) {
+	    if(name == cur->name) {
+		intf = new HotplugDevice(cur);
+		break;
+	    }
+	}
+	pcap_freealldevs(all_intfs);
+    }
+
+    if(intf == nullptr) {
+	return nullptr;
+    } else if(!intf->isOpened() && !intf->open(config)) {
+	std::cerr << "Could not open intf " << name << std::endl;
+	return nullptr;
+    }
+
+    return intf;
+}
+
+/*
+ * get_link_speed() - Returns the interface's link speed in Mbit/s, as reported through sysfs, or -1
+ * if the interface does not report one.
+ */
+long get_link_speed(const std::string &name) {
+    std::ifstream file("/sys/class/net/" + name + "/speed");
+    long speed = -1;
+    if(!(file >> speed) || speed <= 0) {
+	return -1;
+    }
+    return speed;
+}
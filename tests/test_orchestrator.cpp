@@ -82,7 +82,16 @@ const std::vector<std::pair<std::string, std::string>> tests_and_args = {
      "vswitch-test1 vlan 444\n"
      "vswitch-test2 vlan 444\n"
      "vswitch-test3 vlan 444\n"
-    }
+    },
+    {"acl_classifier_test", ""},
+    {"ethernet_view_test", ""},
+    {"egress_scheduler_test", ""},
+    {"mac_move_test", ""},
+    {"forwarding_cache_test", ""},
+    {"igmp_mld_records_test", ""},
+    {"cpu_list_test", ""},
+    {"packet_recorder_test", ""},
+    {"storm_control_test", ""}
 };
 
 class Proc {
@@ -6,14 +6,33 @@
  */
 
 #include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
 #include <functional>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <random>
+#include <sstream>
 #include <string>
+#include <vector>
 #include <PcapLiveDevice.h>
 #include <SystemUtils.h>
+#include <unistd.h>
+#include "access_lists.hpp"
+#include "egress_queues.hpp"
+#include "ethernet_view.hpp"
+#include "forwarding_cache.hpp"
+#include "mac_addr_table.hpp"
+#include "multicast_snooping.hpp"
+#include "packet_queue.hpp"
+#include "packet_recorder.hpp"
+#include "ports.hpp"
+#include "storm_control.hpp"
 #include "testing_utils.hpp"
+#include "thread_placement.hpp"
+#include "vlans.hpp"
 #include "vswitch_utils.hpp"
 
 /*
@@ -388,6 +407,688 @@ void vlan_moving_test_setup(TestData &data) {
     return;
 }
 
+/*
+ * check() - Used by tests which exercise a class directly rather than sending packets through the
+ * switch. Marks the test as failed, and says what went wrong, if the condition does not hold.
+ */
+static void check(TestData &data, bool condition, const std::string &what) {
+    if(!condition) {
+	std::cerr << "\tFAIL: " << what << std::endl;
+	data.test_status = TestData::FAIL;
+    }
+}
+
+/*
+ * raw_frame() - Returns a packet holding a copy of the given bytes, for building frames which are
+ * handed to a class directly.
+ */
+static pcpp::RawPacket raw_frame(const std::vector<uint8_t> &bytes) {
+    uint8_t *raw_data = new uint8_t[bytes.size()];
+    std::copy(bytes.begin(), bytes.end(), raw_data);
+    return pcpp::RawPacket(raw_data, bytes.size(), timespec{}, true);
+}
+
+/*
+ * ip_frame() - Returns an untagged IPv4 frame from src_ip, or an IPv6 frame if src_ip has 16 bytes,
+ * carrying the start of a TCP or UDP header with the given destination port.
+ */
+static pcpp::RawPacket ip_frame(const std::vector<uint8_t> &src_ip, uint8_t protocol,
+				uint16_t dst_port) {
+    std::vector<uint8_t> bytes = {0x02, 0, 0, 0, 0, 0x02, 0x02, 0, 0, 0, 0, 0x01};
+    std::vector<uint8_t> l4 = {0x30, 0x39, uint8_t(dst_port >> 8), uint8_t(dst_port), 0, 8, 0, 0};
+
+    if(src_ip.size() == 4) {
+	std::vector<uint8_t> ip = {0x08, 0x00, 0x45, 0, 0, 28, 0, 0, 0, 0, 64, protocol, 0, 0};
+	ip.insert(ip.end(), src_ip.begin(), src_ip.end());
+	ip.insert(ip.end(), {192, 0, 2, 1});
+	bytes.insert(bytes.end(), ip.begin(), ip.end());
+    } else {
+	std::vector<uint8_t> ip = {0x86, 0xdd, 0x60, 0, 0, 0, 0, 8, protocol, 64};
+	ip.insert(ip.end(), src_ip.begin(), src_ip.end());
+	ip.insert(ip.end(), {0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1});
+	bytes.insert(bytes.end(), ip.begin(), ip.end());
+    }
+    bytes.insert(bytes.end(), l4.begin(), l4.end());
+    return raw_frame(bytes);
+}
+
+/*
+ * acl_hits() - Returns the match count shown for each rule of the ACLs, by sequence number. Frames
+ * which matched no rule are counted under "(no".
+ */
+static std::map<std::string, std::string> acl_hits(AccessLists &acls) {
+    std::stringstream out;
+    acls.print_acls(out, {});
+
+    std::map<std::string, std::string> hits;
+    std::string line;
+    while(std::getline(out, line)) {
+	std::istringstream words(line);
+	std::string first, word, last;
+	words >> first;
+	while(words >> word) {
+	    last = word;
+	}
+	hits[first] = last;
+    }
+    return hits;
+}
+
+/*
+ * acl_classifier_test_setup() - Checks the tuple space classifier behind access lists directly.
+ * Rules 10, 30 and 50 share a tuple, which is searched first, so a later tuple must still be
+ * searched when its first rule comes before the match found so far, and must not be once it
+ * comes after. IPv4 prefixes must not match IPv6 addresses, frames matching nothing are denied,
+ * and each frame is counted against the single rule which decided it. Rule 50 repeats rule 10,
+ * and so never matches.
+ *
+ * Configuration: default
+ */
+void acl_classifier_test_setup(TestData &data) {
+    Vlans vlans(1);
+    AccessLists acls(1, &vlans);
+
+    acls.set_rule("test", 10, AccessLists::PERMIT);
+    acls.set_match("test", 10, AccessLists::PROTOCOL, "17");
+    acls.set_match("test", 10, AccessLists::DST_PORT, "9");
+    acls.set_rule("test", 20, AccessLists::DENY);
+    acls.set_match("test", 20, AccessLists::SRC_IP, "10.0.0.0/8");
+    acls.set_rule("test", 30, AccessLists::PERMIT);
+    acls.set_match("test", 30, AccessLists::PROTOCOL, "17");
+    acls.set_match("test", 30, AccessLists::DST_PORT, "10");
+    acls.set_rule("test", 40, AccessLists::PERMIT);
+    acls.set_match("test", 40, AccessLists::SRC_IP, "0.0.0.0/0");
+    acls.set_rule("test", 50, AccessLists::DENY);
+    acls.set_match("test", 50, AccessLists::PROTOCOL, "17");
+    acls.set_match("test", 50, AccessLists::DST_PORT, "9");
+    acls.apply_intf(0, "test");
+
+    std::vector<uint8_t> inside = {10, 1, 1, 1}, outside = {192, 168, 1, 1};
+    std::vector<uint8_t> ipv6 = {0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0, 0, 0, 0, 0, 10, 1, 1, 1};
+    check(data, acls.permit(0, ip_frame(inside, 17, 9)),
+	  "Rule 10 did not decide a frame matching rules 10, 20 and 40");
+    check(data, !acls.permit(0, ip_frame(inside, 17, 10)),
+	  "Rule 30 decided a frame matching rule 20 in a later tuple");
+    check(data, acls.permit(0, ip_frame(outside, 17, 10)),
+	  "Rule 40 decided a frame matching rule 30 in an earlier tuple");
+    check(data, acls.permit(0, ip_frame(outside, 6, 80)),
+	  "Rule 40 did not permit an IPv4 frame");
+    check(data, !acls.permit(0, ip_frame(ipv6, 6, 80)),
+	  "An IPv4 prefix matched an IPv6 address");
+    check(data, !acls.permit(0, raw_frame({0x02, 0, 0, 0, 0, 0x02, 0x02, 0, 0, 0, 0, 0x01,
+					   0x08, 0x06})),
+	  "A frame matching no rule was not denied");
+
+    auto hits = acl_hits(acls);
+    check(data, hits["10"] == "1" && hits["20"] == "1" && hits["30"] == "1" && hits["40"] == "1",
+	  "Each rule should have matched exactly one frame");
+    check(data, hits["50"] == "0", "Rule 50 matched, though rule 10 comes before it");
+    check(data, hits["(no"] == "2", "Two frames should have matched no rule");
+
+    // Without rule 20, the frame it denied falls through to rule 30
+    acls.remove_rule("test", 20);
+    check(data, acls.permit(0, ip_frame(inside, 17, 10)),
+	  "Rule 30 did not decide a frame once rule 20 was removed");
+    check(data, acl_hits(acls)["30"] == "2", "Rule 30 was not counted once rule 20 was removed");
+    return;
+}
+
+/*
+ * ethernet_view_test_setup() - Checks that EthernetView never reads past the end of a frame, and
+ * that it reads up to two VLAN tags, leaving any further tag as the EtherType. A tag which is cut
+ * short is not read.
+ *
+ * Configuration: default
+ */
+void ethernet_view_test_setup(TestData &data) {
+    std::vector<uint8_t> header = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x02, 0, 0, 0, 0, 0x01};
+
+    EthernetView runt(header.data(), 13);
+    check(data, !runt.is_valid() && runt.payload_len() == 0, "A 13 byte frame was valid");
+
+    std::vector<uint8_t> untagged = header;
+    untagged.insert(untagged.end(), {0x08, 0x00});
+    EthernetView plain(untagged.data(), untagged.size());
+    check(data, plain.is_valid() && plain.num_tags() == 0 && plain.ether_type() == 0x0800 &&
+	  plain.payload_len() == 0, "An untagged header was misread");
+    check(data, plain.src_mac() == untagged.data() + 6, "The source address was misplaced");
+
+    // Single tag: TPID, PCP 3 and VLAN 5, then the EtherType
+    std::vector<uint8_t> tagged = header;
+    tagged.insert(tagged.end(), {0x81, 0x00, 0x60, 0x05, 0x86, 0xdd, 0xaa});
+    EthernetView single(tagged.data(), tagged.size());
+    check(data, single.num_tags() == 1 && single.tci(0) == 0x6005 &&
+	  single.ether_type() == 0x86dd && single.payload() == tagged.data() + 18 &&
+	  single.payload_len() == 1, "A single tagged header was misread");
+
+    EthernetView cut_tag(tagged.data(), 17);
+    check(data, cut_tag.is_valid() && cut_tag.num_tags() == 0 && cut_tag.ether_type() == 0x8100 &&
+	  cut_tag.payload_len() == 3, "A tag cut short was read");
+
+    // 802.1ad outer tag for VLAN 100, and an 802.1Q inner tag for VLAN 12 with PCP 5
+    std::vector<uint8_t> stacked = header;
+    stacked.insert(stacked.end(), {0x88, 0xa8, 0x00, 0x64, 0x81, 0x00, 0xa0, 0x0c, 0x08, 0x00,
+				   0x45, 0x00});
+    EthernetView double_tag(stacked.data(), stacked.size());
+    check(data, double_tag.num_tags() == 2 && double_tag.tci(0) == 0x0064 &&
+	  double_tag.tci(1) == 0xa00c && double_tag.ether_type() == 0x0800 &&
+	  double_tag.payload() == stacked.data() + 22 && double_tag.payload_len() == 2,
+	  "A double tagged header was misread");
+
+    EthernetView cut_inner(stacked.data(), 21);
+    check(data, cut_inner.num_tags() == 1 && cut_inner.ether_type() == 0x8100 &&
+	  cut_inner.payload_len() == 3, "An inner tag cut short was read");
+
+    std::vector<uint8_t> triple = header;
+    triple.insert(triple.end(), {0x88, 0xa8, 0x00, 0x64, 0x81, 0x00, 0x00, 0x0c, 0x81, 0x00,
+				 0x00, 0x01, 0x08, 0x00});
+    EthernetView three_tags(triple.data(), triple.size());
+    check(data, three_tags.num_tags() == EthernetView::MAX_TAGS &&
+	  three_tags.ether_type() == 0x8100 && three_tags.payload_len() == 4,
+	  "More than two tags were read");
+
+    pcpp::RawPacket pckt = raw_frame(stacked);
+    EthernetView from_pckt(pckt);
+    check(data, from_pckt.dst_mac() == pckt.getRawData() &&
+	  from_pckt.payload_len() == stacked.size() - 22,
+	  "A view of a packet did not point into its data");
+    return;
+}
+
+/*
+ * egress_entry() - Returns a forwarded packet of len bytes, headed for dst_intfs. The frame is
+ * given an 802.1Q tag with the priority pcp, or left untagged if pcp is -1.
+ */
+static std::shared_ptr<PQueueEntry> egress_entry(int pcp,
+						 int src_intf,
+						 std::vector<int> dst_intfs,
+						 size_t len = 64) {
+    std::vector<uint8_t> bytes = {0x02, 0, 0, 0, 0, 0x02, 0x02, 0, 0, 0, 0, 0x01};
+    if(pcp >= 0) {
+	bytes.insert(bytes.end(), {0x81, 0x00, uint8_t(pcp << 5), 0x01});
+    }
+    bytes.insert(bytes.end(), {0x08, 0x00});
+    bytes.resize(len);
+
+    auto entry = std::make_shared<PQueueEntry>(raw_frame(bytes), src_intf);
+    entry->dst_intfs = dst_intfs;
+    return entry;
+}
+
+/*
+ * egress_scheduler_test_setup() - Checks the order EgressQueues sends packets in. Strict queues
+ * come first, highest first, and untagged packets take their ingress port's priority. With
+ * weights of 1 and 3, two DRR queues of full sized frames share a port 1:3. Ports take turns, a
+ * flooded packet is queued once per port, and full queues drop.
+ *
+ * Configuration: default
+ */
+void egress_scheduler_test_setup(TestData &data) {
+    EgressQueues queues(3);
+    int intf;
+    std::shared_ptr<PQueueEntry> entry;
+
+    std::vector<std::shared_ptr<PQueueEntry>> bulk;
+    for(int i = 0; i < 3; i++) {
+	bulk.push_back(egress_entry(0, 0, {0}));
+	queues.enqueue(bulk.back());
+    }
+    auto control = egress_entry(7, 0, {0});
+    queues.enqueue(control);
+    check(data, queues.dequeue(intf, entry) && intf == 0 && entry == control,
+	  "A strict queue was not served first");
+
+    queues.set_strict(2);
+    auto video = egress_entry(4, 0, {0});
+    queues.enqueue(video);
+    queues.enqueue(control);
+    check(data, queues.dequeue(intf, entry) && entry == control,
+	  "The higher of two strict queues was not served first");
+    check(data, queues.dequeue(intf, entry) && entry == video,
+	  "The lower of two strict queues was not served before DRR queues");
+    queues.reset_queue(2);
+
+    // An untagged packet from port 1 takes its priority of 7, and so goes ahead of the bulk
+    queues.set_intf_priority(1, 7);
+    auto untagged = egress_entry(-1, 1, {0});
+    queues.enqueue(untagged);
+    check(data, queues.dequeue(intf, entry) && entry == untagged,
+	  "An untagged packet did not take its ingress port's priority");
+    queues.reset_intf(1);
+
+    for(auto &expected : bulk) {
+	check(data, queues.dequeue(intf, entry) && entry == expected,
+	      "Packets in the same queue were sent out of order");
+    }
+    check(data, queues.is_empty() && !queues.dequeue(intf, entry),
+	  "Packets were left after everything was sent");
+
+    EgressQueues drr(1);
+    drr.set_weight(1, 3);
+    for(int i = 0; i < 8; i++) {
+	drr.enqueue(egress_entry(0, 0, {0}, 1514));
+	drr.enqueue(egress_entry(2, 0, {0}, 1514));
+    }
+    int weighted = 0;
+    for(int i = 0; i < 8; i++) {
+	drr.dequeue(intf, entry);
+	weighted += EthernetView(entry->pckt).tci(0) >> 13 == 2;
+    }
+    check(data, weighted == 6, "The queue weighted 3 sent " + std::to_string(weighted) +
+	  " of 8 packets, instead of 6");
+
+    // Port 0 has two packets waiting, but ports 1 and 2 are served before its second
+    auto flooded = egress_entry(0, 0, {0, 1, 2});
+    auto unicast = egress_entry(0, 0, {0});
+    queues.enqueue(flooded);
+    queues.enqueue(unicast);
+    for(int expected : {0, 1, 2}) {
+	check(data, queues.dequeue(intf, entry) && intf == expected && entry == flooded,
+	      "A flooded packet was not sent out of each port in turn");
+    }
+    check(data, queues.dequeue(intf, entry) && intf == 0 && entry == unicast,
+	  "A port's second packet was not sent last");
+
+    for(int i = 0; i < EgressQueues::QUEUE_LIMIT + 2; i++) {
+	queues.enqueue(egress_entry(0, 0, {2}));
+    }
+    auto counters = queues.get_counters(2)[0];
+    check(data, counters.depth == EgressQueues::QUEUE_LIMIT && counters.dropped_pckts == 2,
+	  "A full queue did not drop new packets");
+    return;
+}
+
+/*
+ * mac_move_test_setup() - After the second interface sends to the first, so that the decision is
+ * cached, the first interface's address moves to the third. Frames from the second interface to
+ * that address must now only be sent out of the third, rather than where the stale decision says.
+ *
+ * Configuration: default
+ */
+void mac_move_test_setup(TestData &data) {
+    if(data.veth_intfs.size() < 3) {
+	std::cerr << __func__
+		  << ": Expected at least 3 interfaces, but has "
+		  << data.veth_intfs.size()
+		  << ". Skipping test..."
+		  << std::endl;
+	return;
+    }
+
+    // Wave 1 - The first intf broadcasts, so that its address is learned
+    data.test_waves.push_back(TestWave(data.veth_intfs.size()));
+    TestWave &wave1 = data.test_waves[0];
+
+    pcpp::RawPacket orig_pckt = create_broadcast_pckt(data.veth_intfs[0]);
+    wave1.pckts_to_transmit.push_back({orig_pckt, data.veth_intfs[0]});
+    data.dup_mgr.mark_duplicate(0, orig_pckt);
+    for(long unsigned int i = 1; i < data.veth_intfs.size(); i++) {
+	wave1.expected.mark_duplicate(i, orig_pckt);
+    }
+
+    // Waves 2 and 3 - The second intf sends to the first twice, the second time from the cache
+    pcpp::RawPacket direct_pckt = create_pckt(data.veth_intfs[1], data.veth_intfs[0]);
+    for(int i = 0; i < 2; i++) {
+	data.test_waves.push_back(TestWave(data.veth_intfs.size()));
+	TestWave &wave = data.test_waves.back();
+	wave.pckts_to_transmit.push_back({direct_pckt, data.veth_intfs[1]});
+	data.dup_mgr.mark_duplicate(1, direct_pckt);
+	wave.expected.mark_duplicate(0, direct_pckt);
+    }
+
+    // Wave 4 - The third intf broadcasts from the first intf's address, moving it
+    data.test_waves.push_back(TestWave(data.veth_intfs.size()));
+    TestWave &wave4 = data.test_waves[3];
+
+    pcpp::RawPacket move_pckt = create_broadcast_pckt(data.veth_intfs[2],
+						      data.veth_intfs[0]->getMacAddress());
+    wave4.pckts_to_transmit.push_back({move_pckt, data.veth_intfs[2]});
+    data.dup_mgr.mark_duplicate(2, move_pckt);
+    for(long unsigned int i = 0; i < data.veth_intfs.size(); i++) {
+	if(i == 2) {
+	    continue;
+	}
+	wave4.expected.mark_duplicate(i, move_pckt);
+    }
+
+    // Wave 5 - The second intf sends to the same address, which is now on the third intf
+    data.test_waves.push_back(TestWave(data.veth_intfs.size()));
+    TestWave &wave5 = data.test_waves[4];
+    wave5.pckts_to_transmit.push_back({direct_pckt, data.veth_intfs[1]});
+    data.dup_mgr.mark_duplicate(1, direct_pckt);
+    wave5.expected.mark_duplicate(2, direct_pckt);
+
+    return;
+}
+
+/*
+ * forwarding_cache_test_setup() - Checks that a cached decision is only found for the same ingress
+ * port and addresses, and only while the generation it was made in is current. The MAC address
+ * table's generation must change whenever a known address moves, ages out, is flushed or is
+ * restored, but not when a new address is learned or an old one refreshed.
+ *
+ * Configuration: default
+ */
+void forwarding_cache_test_setup(TestData &data) {
+    ForwardingCache cache;
+    uint8_t macs[12] = {0x02, 0, 0, 0, 0, 0x01, 0x02, 0, 0, 0, 0, 0x02};
+    uint8_t swapped[12] = {0x02, 0, 0, 0, 0, 0x02, 0x02, 0, 0, 0, 0, 0x01};
+
+    check(data, cache.find(0, macs, 0) == nullptr, "An empty cache had an entry");
+    cache.insert(0, macs, 5, 3, 0);
+    auto entry = cache.find(0, macs, 5);
+    check(data, entry != nullptr && entry->dst_intf == 3, "A cached decision was not found");
+    check(data, cache.find(1, macs, 5) == nullptr, "A decision was found for another port");
+    check(data, cache.find(0, swapped, 5) == nullptr,
+	  "A decision was found for other addresses");
+    check(data, cache.find(0, macs, 6) == nullptr, "A stale decision was found");
+
+    MacAddrTable mac_tbl;
+    pcpp::MacAddress host_a("02:00:00:00:00:0a"), host_b("02:00:00:00:00:0b");
+    uint64_t generation = mac_tbl.get_generation();
+
+    mac_tbl.push_mapping(host_a, 1);
+    mac_tbl.push_mapping(host_b, 2);
+    mac_tbl.push_mapping(host_a, 1);
+    check(data, mac_tbl.get_generation() == generation,
+	  "Learning or refreshing an address changed the generation");
+
+    mac_tbl.push_mapping(host_a, 3);
+    check(data, mac_tbl.get_generation() > generation,
+	  "An address moving did not change the generation");
+
+    generation = mac_tbl.get_generation();
+    mac_tbl.flush_intf(4);
+    check(data, mac_tbl.get_generation() == generation,
+	  "Flushing a port without addresses changed the generation");
+    mac_tbl.flush_intf(3);
+    check(data, mac_tbl.get_generation() > generation,
+	  "Flushing an address did not change the generation");
+
+    generation = mac_tbl.get_generation();
+    mac_tbl.restore(mac_tbl.snapshot());
+    check(data, mac_tbl.get_generation() > generation,
+	  "Restoring the table did not change the generation");
+
+    generation = mac_tbl.get_generation();
+    mac_tbl.modify_aging_time(1);
+    pcpp::multiPlatformSleep(3);
+    check(data, mac_tbl.age_mappings() == 1 && mac_tbl.get_generation() > generation,
+	  "Aging out an address did not change the generation");
+    return;
+}
+
+/*
+ * igmp_frame() - Returns an IGMP message sent to 224.0.0.22, in an IPv4 header with a router alert.
+ */
+static pcpp::RawPacket igmp_frame(const std::vector<uint8_t> &msg) {
+    size_t total_len = 24 + msg.size();
+    std::vector<uint8_t> bytes = {0x01, 0x00, 0x5e, 0x00, 0x00, 0x16, 0x02, 0, 0, 0, 0, 0x01,
+				  0x08, 0x00, 0x46, 0xc0, uint8_t(total_len >> 8),
+				  uint8_t(total_len), 0, 0, 0, 0, 1, 2, 0, 0, 10, 0, 0, 1,
+				  224, 0, 0, 22, 0x94, 0x04, 0, 0};
+    bytes.insert(bytes.end(), msg.begin(), msg.end());
+    return raw_frame(bytes);
+}
+
+/*
+ * mld_frame() - Returns an MLD message sent to ff02::16, after a hop-by-hop options header with a
+ * router alert.
+ */
+static pcpp::RawPacket mld_frame(const std::vector<uint8_t> &msg) {
+    size_t payload_len = 8 + msg.size();
+    std::vector<uint8_t> bytes = {0x33, 0x33, 0x00, 0x00, 0x00, 0x16, 0x02, 0, 0, 0, 0, 0x01,
+				  0x86, 0xdd, 0x60, 0, 0, 0, uint8_t(payload_len >> 8),
+				  uint8_t(payload_len), 0, 1};
+    std::vector<uint8_t> addrs = {0xfe, 0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1,
+				  0xff, 0x02, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x16};
+    bytes.insert(bytes.end(), addrs.begin(), addrs.end());
+    bytes.insert(bytes.end(), {58, 0, 5, 2, 0, 0, 1, 0});
+    bytes.insert(bytes.end(), msg.begin(), msg.end());
+    return raw_frame(bytes);
+}
+
+/*
+ * snoop() - Passes a frame received on src_intf in VLAN 1 through snooping, returning whether it
+ * was only sent to the VLAN's router ports rather than flooded.
+ */
+static bool snoop(MulticastSnooping &snooping, const pcpp::RawPacket &pckt, int src_intf) {
+    EthernetView eth(pckt);
+    MulticastSnooping::PortMask dst_intfs;
+    return snooping.filter_flood(pckt, pcpp::MacAddress(eth.dst_mac()), src_intf, 1, dst_intfs);
+}
+
+/*
+ * group_members() - Returns the ports snooping has as members of a group in VLAN 1.
+ */
+static std::vector<int> group_members(MulticastSnooping &snooping,
+				      const MulticastSnooping::IpAddr &group) {
+    for(auto &info : snooping.snapshot_groups()) {
+	if(info.vlan == 1 && info.group == group) {
+	    return info.intfs;
+	}
+    }
+    return {};
+}
+
+/*
+ * igmp_mld_records_test_setup() - Checks that every group record of IGMPv3 and MLDv2 reports is
+ * read, skipping each record's sources and auxiliary data, and that reading stops at the end of a
+ * report which claims more records than it holds. Records which leave a group, and groups with
+ * link-local scope, must not add members.
+ *
+ * Configuration: default
+ */
+void igmp_mld_records_test_setup(TestData &data) {
+    MulticastSnooping snooping;
+    snooping.set_enabled(true);
+
+    auto v4 = [](uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+	return MulticastSnooping::IpAddr{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff, a, b, c, d};
+    };
+    auto v6 = [](uint8_t scope, uint8_t id) {
+	return MulticastSnooping::IpAddr{0xff, scope, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, id};
+    };
+    std::vector<int> port_2 = {2}, port_3 = {3}, port_4 = {4};
+
+    check(data, snoop(snooping, igmp_frame({0x16, 0, 0, 0, 239, 1, 1, 1}), 1),
+	  "An IGMPv2 report was flooded");
+    check(data, group_members(snooping, v4(239, 1, 1, 1)) == std::vector<int>{1},
+	  "An IGMPv2 report did not join its group");
+
+    // Exclude with auxiliary data, allow with two sources, block, link-local, change to exclude
+    check(data, snoop(snooping, igmp_frame({0x22, 0, 0, 0, 0, 0, 0, 5,
+					     2, 1, 0, 0, 239, 2, 2, 2, 0xaa, 0xaa, 0xaa, 0xaa,
+					     5, 0, 0, 2, 239, 3, 3, 3, 10, 0, 0, 1, 10, 0, 0, 2,
+					     6, 0, 0, 1, 239, 5, 5, 5, 10, 0, 0, 1,
+					     2, 0, 0, 0, 224, 0, 0, 251,
+					     4, 0, 0, 0, 239, 4, 4, 4}), 2),
+	  "An IGMPv3 report was flooded");
+    check(data, group_members(snooping, v4(239, 2, 2, 2)) == port_2 &&
+	  group_members(snooping, v4(239, 3, 3, 3)) == port_2 &&
+	  group_members(snooping, v4(239, 4, 4, 4)) == port_2,
+	  "An IGMPv3 record was not read");
+    check(data, group_members(snooping, v4(239, 5, 5, 5)).empty(),
+	  "An IGMPv3 record blocking sources joined its group");
+    check(data, group_members(snooping, v4(224, 0, 0, 251)).empty(),
+	  "A link-local IPv4 group was snooped");
+
+    // The second record is cut short, and the third is missing
+    snoop(snooping, igmp_frame({0x22, 0, 0, 0, 0, 0, 0, 3,
+				2, 0, 0, 0, 239, 6, 6, 6,
+				2, 0, 0, 0}), 3);
+    check(data, group_members(snooping, v4(239, 6, 6, 6)) == port_3,
+	  "The record before one cut short was not read");
+
+    // The first record's sources run past the end, so the second is never reached
+    snoop(snooping, igmp_frame({0x22, 0, 0, 0, 0, 0, 0, 2,
+				2, 0, 0, 100, 239, 7, 7, 7,
+				2, 0, 0, 0, 239, 8, 8, 8}), 3);
+    check(data, group_members(snooping, v4(239, 8, 8, 8)).empty(),
+	  "A record was read from the sources of the one before it");
+
+    std::vector<uint8_t> mld = {143, 0, 0, 0, 0, 0, 0, 3};
+    std::vector<uint8_t> records[] = {
+	{2, 1, 0, 0, 0xff, 0x0e, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0xaa, 0xaa, 0xaa, 0xaa},
+	{5, 0, 0, 1, 0xff, 0x0e, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2,
+	 0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
+	{2, 0, 0, 0, 0xff, 0x02, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 3}
+    };
+    for(auto &record : records) {
+	mld.insert(mld.end(), record.begin(), record.end());
+    }
+    check(data, snoop(snooping, mld_frame(mld), 4), "An MLDv2 report was flooded");
+    check(data, group_members(snooping, v6(0x0e, 1)) == port_4 &&
+	  group_members(snooping, v6(0x0e, 2)) == port_4,
+	  "An MLDv2 record was not read");
+    check(data, group_members(snooping, v6(0x02, 3)).empty(),
+	  "A link-local IPv6 group was snooped");
+
+    // Frames to a group's MAC address only go to its members
+    MulticastSnooping::PortMask dst_intfs;
+    check(data, snooping.filter_flood(raw_frame({0x01, 0x00, 0x5e, 0x04, 0x04, 0x04}),
+				      pcpp::MacAddress("01:00:5e:04:04:04"), 1, 1, dst_intfs) &&
+	  dst_intfs.count() == 1 && dst_intfs.test(2),
+	  "A frame to a snooped group was not sent to its member");
+
+    // Changing to include no sources leaves a group, but including some does not
+    snoop(snooping, igmp_frame({0x22, 0, 0, 0, 0, 0, 0, 2,
+				3, 0, 0, 0, 239, 2, 2, 2,
+				1, 0, 0, 1, 239, 3, 3, 3, 10, 0, 0, 1}), 2);
+    std::vector<uint8_t> done = {143, 0, 0, 0, 0, 0, 0, 1,
+				 3, 0, 0, 0, 0xff, 0x0e, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1};
+    snoop(snooping, mld_frame(done), 4);
+    pcpp::multiPlatformSleep(MulticastSnooping::LEAVE_TIMEOUT + 1);
+    snooping.age_entries();
+    check(data, group_members(snooping, v4(239, 2, 2, 2)).empty() &&
+	  group_members(snooping, v6(0x0e, 1)).empty(),
+	  "A record including no sources did not leave its group");
+    check(data, group_members(snooping, v4(239, 3, 3, 3)) == port_2 &&
+	  group_members(snooping, v6(0x0e, 2)) == port_4,
+	  "A group was left without a record leaving it");
+    return;
+}
+
+/*
+ * cpu_list_test_setup() - Checks the CPU lists accepted for thread placement, which follow taskset
+ * -c. Lists are kept sorted without repeats, and written back with consecutive CPUs as ranges.
+ * Malformed lists, reversed ranges and CPUs the machine does not have are rejected, leaving the
+ * previous list in place.
+ *
+ * Configuration: default
+ */
+void cpu_list_test_setup(TestData &data) {
+    ThreadPlacement placement;
+    long num_cpus = sysconf(_SC_NPROCESSORS_CONF);
+    auto config = [&placement]() {
+	std::stringstream out;
+	placement.write_config(out);
+	return out.str();
+    };
+
+    check(data, placement.set_cpus(ThreadPlacement::CAPTURE, "0,0,0-0") &&
+	  config() == "thread capture cpus 0\n", "A list of CPU 0 was not accepted as \"0\"");
+
+    std::vector<std::string> invalid = {"", ",", "abc", "0x", "0-", "-1", "1-0", "0,,0", "0-1-2",
+					std::to_string(num_cpus), "0-" + std::to_string(num_cpus)};
+    for(auto &cpu_list : invalid) {
+	check(data, !placement.set_cpus(ThreadPlacement::CAPTURE, cpu_list),
+	      "The CPU list \"" + cpu_list + "\" was accepted");
+    }
+    check(data, config() == "thread capture cpus 0\n", "A rejected CPU list replaced the last one");
+
+    if(num_cpus >= 4) {
+	check(data, placement.set_cpus(ThreadPlacement::EGRESS, "3,0-1,1") &&
+	      config() == "thread capture cpus 0\nthread egress cpus 0-1,3\n",
+	      "The CPU list \"3,0-1,1\" was not kept as \"0-1,3\"");
+	check(data, placement.set_cpus(ThreadPlacement::EGRESS, "2,0,1") &&
+	      config() == "thread capture cpus 0\nthread egress cpus 0-2\n",
+	      "The CPU list \"2,0,1\" was not kept as \"0-2\"");
+	placement.reset_cpus(ThreadPlacement::EGRESS);
+    }
+
+    placement.reset_cpus(ThreadPlacement::CAPTURE);
+    check(data, config().empty(), "A reset CPU list was still written");
+    return;
+}
+
+/*
+ * packet_recorder_test_setup() - Checks that frames still queued for a port's last recording are
+ * not written to its next one, and that a recording whose file cannot be written is stopped and
+ * shown as failed.
+ */
+void packet_recorder_test_setup(TestData &data) {
+    const long PCAP_HEADER_LEN = 24, FRAME_HEADER_LEN = 16, FRAME_LEN = 60;
+    std::string first = "/tmp/vswitch_recorder_test_1.pcap";
+    std::string second = "/tmp/vswitch_recorder_test_2.pcap";
+    PacketRecorder recorder;
+    Ports ports({});
+    pcpp::RawPacket frame = raw_frame(std::vector<uint8_t>(FRAME_LEN, 0xff));
+
+    // Two frames are queued for the first recording, which is replaced before they are written
+    check(data, recorder.start(0, first, 0, 0), "Could not start recording to " + first);
+    recorder.record(0, frame);
+    recorder.record(0, frame);
+    check(data, recorder.start(0, second, 0, 0), "Could not start recording to " + second);
+    recorder.record(0, frame);
+    recorder.write_pending();
+    recorder.stop(0);
+
+    std::ifstream file(second, std::ios::binary | std::ios::ate);
+    check(data, file.tellg() == PCAP_HEADER_LEN + FRAME_HEADER_LEN + FRAME_LEN,
+	  "The second recording did not hold exactly the one frame queued for it");
+    std::remove(first.c_str());
+    std::remove(second.c_str());
+
+    // The header fits in the write buffer, so the failure only shows once the buffer is flushed
+    check(data, recorder.start(0, "/dev/full", 0, 0), "Could not start recording to /dev/full");
+    recorder.record(0, frame);
+    recorder.write_pending();
+    recorder.write_pending();
+
+    std::stringstream out;
+    recorder.print_recordings(out, ports);
+    check(data, out.str().find("failed") != std::string::npos,
+	  "A recording which could not be written was not shown as failed");
+    recorder.stop(0);
+    return;
+}
+
+/*
+ * storm_control_test_setup() - Checks that a percentage level is taken of the port's current link
+ * speed, rather than the one it had when the level was set. Every frame carries the same
+ * timestamp, so they all fall within one interval.
+ */
+void storm_control_test_setup(TestData &data) {
+    const int FRAME_LEN = 1000;
+    StormControl storm_ctl(1);
+    pcpp::MacAddress broadcast("ff:ff:ff:ff:ff:ff");
+    std::vector<uint8_t> bytes(FRAME_LEN, 0);
+    std::fill(bytes.begin(), bytes.begin() + 6, 0xff);
+    pcpp::RawPacket frame = raw_frame(bytes);
+
+    // 1% of 10 Mbit/s is 12500 bytes, or 12 frames
+    auto admitted = [&storm_ctl, &broadcast, &frame](int tries) {
+	int num_admitted = 0;
+	for(int i = 0; i < tries; i++) {
+	    num_admitted += storm_ctl.admit(0, broadcast, frame);
+	}
+	return num_admitted;
+    };
+    check(data, storm_ctl.set(0, StormControl::BROADCAST, StormControl::PERCENT, 1, 10),
+	  "Could not set a level of 1% on a 10 Mbit/s link");
+    check(data, admitted(20) == 12, "1% of 10 Mbit/s did not admit 12 frames");
+
+    // At 100 Mbit/s, the same level admits 125 frames, 12 of which were already used
+    storm_ctl.set_link_speed(0, 100);
+    check(data, admitted(200) == 113, "1% did not follow the link speed up to 100 Mbit/s");
+
+    // An unknown speed leaves the last one in place
+    storm_ctl.set_link_speed(0, -1);
+    check(data, admitted(1) == 0, "An unknown link speed raised the level");
+    return;
+}
+
 int main(int argc, char *argv[]) {
     std::map<std::string, std::function<void(TestData &)>> tests = {
 	{"broadcast_test", broadcast_test_setup},
@@ -399,7 +1100,16 @@ int main(int argc, char *argv[]) {
 	{"vlan_intf_outside_mac_tbl_test", vlan_intf_outside_mac_tbl_test_setup},
 	{"multiple_vlans_test", multiple_vlans_test_setup},
 	{"vlan_removal_test", vlan_removal_test_setup},
-	{"mult_vlan_moves_test", vlan_moving_test_setup}
+	{"mult_vlan_moves_test", vlan_moving_test_setup},
+	{"acl_classifier_test", acl_classifier_test_setup},
+	{"ethernet_view_test", ethernet_view_test_setup},
+	{"egress_scheduler_test", egress_scheduler_test_setup},
+	{"mac_move_test", mac_move_test_setup},
+	{"forwarding_cache_test", forwarding_cache_test_setup},
+	{"igmp_mld_records_test", igmp_mld_records_test_setup},
+	{"cpu_list_test", cpu_list_test_setup},
+	{"packet_recorder_test", packet_recorder_test_setup},
+	{"storm_control_test", storm_control_test_setup}
     };
 
     // Validate command line argument. Ensure the given strings corresponds to a valid test.
@@ -420,8 +1130,13 @@ int main(int argc, char *argv[]) {
     std::vector<pcpp::PcapLiveDevice *> veth_intfs = get_intfs_prefixed_by("test");
     TestData data(veth_intfs);
 
-    // Call the setup function for the test requested by the caller.
+    // Call the setup function for the test requested by the caller. Tests which check a class
+    // directly have already finished by the time it returns.
     test_it->second(data);
+    if(data.test_status == TestData::FAIL) {
+	std::cerr << "FAIL: At setup" << std::endl;
+	return TestData::FAIL;
+    }
 
     // Run the test.
     for(auto intf : veth_intfs) {
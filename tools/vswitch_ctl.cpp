@@ -0,0 +1,81 @@
+/*
+ * vswitch_ctl.cpp - Entry point for vswitch-ctl.
+ *
+ * A scriptable client for the vswitch control socket. When given a command as arguments, it runs
+ * that single command. Otherwise, it reads commands from standard input, one per line, and sends
+ * them all as a single batch. The exit status is 0 if every command succeeded, 1 if any of them
+ * failed, and 2 if any of them was not a valid command (in which case none of them were run).
+ *
+ * Examples:
+ *     vswitch-ctl show vlan
+ *     printf "vlan 2\nvswitch-host1 vlan 2\n" | vswitch-ctl
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "control_client.hpp"
+
+static void usage(const char *prog) {
+    std::cerr
+	<< "Usage: " << prog << " [-C control_socket] [command ...]" << std::endl
+	<< "  -C  Path of the control socket (default " << ControlClient::DEFAULT_PATH << ")"
+	<< std::endl
+	<< "Without a command, commands are read from standard input and run as one batch."
+	<< std::endl;
+}
+
+int main(int argc, char *argv[]) {
+    int opt;
+    std::string ctl_path = ControlClient::DEFAULT_PATH;
+
+    while((opt = getopt(argc, argv, "+C:h")) != -1) {
+	switch(opt) {
+	case 'C':
+	    ctl_path = optarg;
+	    break;
+	default:
+	    usage(argv[0]);
+	    return 2;
+	}
+    }
+
+    ControlClient client;
+    if(!client.connect(ctl_path)) {
+	std::cerr << "Could not connect to " << ctl_path << ". Is vswitch running?" << std::endl;
+	return 2;
+    }
+
+    std::string status, output;
+    bool sent;
+    if(optind < argc) {
+	std::string cmd;
+	for(int i = optind; i < argc; i++) {
+	    cmd.append(i == optind ? "" : " ").append(argv[i]);
+	}
+	sent = client.request(cmd, status, output);
+    } else {
+	std::vector<std::string> cmds;
+	std::string line;
+	while(std::getline(std::cin, line)) {
+	    if(line.find_first_not_of(" \t\r") != std::string::npos) {
+		cmds.push_back(line);
+	    }
+	}
+	sent = client.batch(cmds, status, output);
+    }
+
+    if(!sent) {
+	std::cerr << "Lost connection to " << ctl_path << std::endl;
+	return 2;
+    }
+
+    std::cout << output << std::flush;
+    if(status == ControlClient::STATUS_OK) {
+	return 0;
+    } else if(status == ControlClient::STATUS_FAILED) {
+	return 1;
+    }
+    return 2;
+}
@@ -0,0 +1,162 @@
+/*
+ * vswitch_stat.cpp - Entry point for vswitch-stat.
+ *
+ * Attaches read-only to the shared memory stats segment published by a running vswitch (see
+ * StatsSegment) and prints its contents. When given an interval, it keeps printing per-port packet
+ * and byte rates computed between consecutive samples. Since it only reads shared memory, it has no
+ * effect on the switch it is monitoring.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include "stats_segment.hpp"
+
+/*
+ * print_totals() - Prints the running totals stored in a single snapshot.
+ */
+static void print_totals(const StatsSegment::Snapshot &snap) {
+    int pad = 16;
+    std::vector<std::string> headers = {
+	"Port", "VLAN", "InBytes", "InPckts", "OutBytes", "OutPckts"
+    };
+
+    std::cout
+	<< "MAC table entries: " << snap.mac_tbl_size
+	<< "    Queue: " << snap.queue_to_process << " to process, "
+	<< snap.queue_to_egress << " to egress, capacity " << snap.queue_capacity << std::endl;
+
+    std::cout << std::setw(pad) << std::left << headers[0];
+    for(long unsigned i = 1; i < headers.size(); i++) {
+	std::cout << std::setw(pad) << std::right << headers[i];
+    }
+    std::cout << std::endl;
+
+    for(auto &port : snap.ports) {
+	std::string name(port.name, strnlen(port.name, sizeof(port.name)));
+	std::cout
+	    << std::setw(pad) << std::left << name
+	    << std::right
+	    << std::setw(pad) << port.vlan
+	    << std::setw(pad) << port.ingress_bytes
+	    << std::setw(pad) << port.ingress_pckts
+	    << std::setw(pad) << port.egress_bytes
+	    << std::setw(pad) << port.egress_pckts
+	    << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+/*
+ * print_rates() - Prints per-port rates computed from two snapshots taken some time apart.
+ */
+static void print_rates(const StatsSegment::Snapshot &prev, const StatsSegment::Snapshot &cur) {
+    int pad = 16;
+    std::vector<std::string> headers = {"Port", "InPps", "InBps", "OutPps", "OutBps"};
+    double secs = (cur.timestamp_ns - prev.timestamp_ns) / 1e9;
+    if(secs <= 0) {
+	return;
+    }
+
+    std::cout
+	<< "MAC table entries: " << cur.mac_tbl_size
+	<< "    Queue: " << cur.queue_to_process << " to process, "
+	<< cur.queue_to_egress << " to egress, capacity " << cur.queue_capacity << std::endl;
+
+    std::cout << std::setw(pad) << std::left << headers[0];
+    for(long unsigned i = 1; i < headers.size(); i++) {
+	std::cout << std::setw(pad) << std::right << headers[i];
+    }
+    std::cout << std::endl;
+
+    std::cout << std::fixed << std::setprecision(0);
+    for(auto &b : cur.ports) {
+	// Ports come and go as the switch runs, so match them up by name. A port that is new since
+	// the last sample has no rate yet.
+	auto a_it = std::find_if(prev.ports.begin(), prev.ports.end(), [&b](const StatsPort &a) {
+	    return strncmp(a.name, b.name, sizeof(a.name)) == 0;
+	});
+	if(a_it == prev.ports.end() || a_it->ingress_pckts > b.ingress_pckts ||
+	   a_it->egress_pckts > b.egress_pckts) {
+	    continue;
+	}
+
+	auto &a = *a_it;
+	std::cout
+	    << std::setw(pad) << std::left << std::string(b.name, strnlen(b.name, sizeof(b.name)))
+	    << std::right
+	    << std::setw(pad) << (b.ingress_pckts - a.ingress_pckts) / secs
+	    << std::setw(pad) << (b.ingress_bytes - a.ingress_bytes) * 8 / secs
+	    << std::setw(pad) << (b.egress_pckts - a.egress_pckts) / secs
+	    << std::setw(pad) << (b.egress_bytes - a.egress_bytes) * 8 / secs
+	    << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+static void usage(const char *prog) {
+    std::cerr
+	<< "Usage: " << prog << " [-n segment_name] [-i interval_secs] [-c count]" << std::endl
+	<< "  -n  Name of the stats segment (default " << StatsSegment::DEFAULT_NAME << ")"
+	<< std::endl
+	<< "  -i  Print rates every interval_secs seconds instead of the totals once" << std::endl
+	<< "  -c  Stop after printing count samples" << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+    int opt, interval = 0, count = -1;
+    std::string name = StatsSegment::DEFAULT_NAME;
+
+    while((opt = getopt(argc, argv, "n:i:c:")) != -1) {
+	switch(opt) {
+	case 'n':
+	    name = optarg;
+	    break;
+	case 'i':
+	    interval = atoi(optarg);
+	    break;
+	case 'c':
+	    count = atoi(optarg);
+	    break;
+	default:
+	    usage(argv[0]);
+	    return 1;
+	}
+    }
+
+    StatsSegment segment;
+    if(!segment.attach(name)) {
+	std::cerr << "Could not attach to stats segment " << name
+		  << ". Is vswitch running?" << std::endl;
+	return 1;
+    }
+
+    StatsSegment::Snapshot prev, cur;
+    if(!segment.read(prev)) {
+	std::cerr << "Could not read a consistent sample from " << name << std::endl;
+	return 1;
+    }
+
+    if(interval <= 0) {
+	print_totals(prev);
+	return 0;
+    }
+
+    for(int i = 0; count < 0 || i < count; i++) {
+	std::this_thread::sleep_for(std::chrono::seconds(interval));
+	if(!segment.read(cur)) {
+	    continue;
+	}
+
+	print_rates(prev, cur);
+	prev = cur;
+    }
+
+    return 0;
+}